@@ -9,42 +9,59 @@
 #include "graph.h"
 #include "train.h"
 #include "connect.h"
+#include "kernel.h"
+#include "batch.h"
+#include "pool.h"
 
 /**************************** Simple Helper Procedures ***********************/
 
+static void fillHistory(Group G, real *history) {
+  int i, n = Net->historyLength * G->numUnits;
+  if (!history) return;
+  if (G->type & LESIONED) {
+    for (i = 0; i < Net->historyLength; i++)
+      FOR_EACH_UNIT2(G, history[i * G->numUnits + u] = NaN);
+  } else for (i = 0; i < n; i++) history[i] = NaN;
+}
+
 void clearAllHistories(void) {
-  int i, len = Net->historyLength;
-  FOR_EACH_GROUP(FOR_EACH_UNIT(G, {
-    if (U->inputHistory) for (i = 0; i < len; i++)
-      U->inputHistory[i] = NaN;
-    if (U->outputHistory) for (i = 0; i < len; i++)
-      U->outputHistory[i] = NaN;
-    if (U->targetHistory) for (i = 0; i < len; i++)
-      U->targetHistory[i] = NaN;
-    if (U->outputDerivHistory) for (i = 0; i < len; i++)
-      U->outputDerivHistory[i] = NaN;
-  }));
+  FOR_EACH_GROUP({
+    fillHistory(G, G->inputHistory);
+    fillHistory(G, G->outputHistory);
+    fillHistory(G, G->targetHistory);
+    fillHistory(G, G->outputDerivHistory);
+  });
+}
+
+/* The units of a lesioned group are copied one at a time so the lesioned
+   ones keep their values. */
+static void copyValues(Group G, real *to, real *from) {
+  if (G->type & LESIONED) FOR_EACH_UNIT2(G, to[u] = from[u])
+  else memcpy(to, from, G->numUnits * sizeof(real));
+}
+
+/* This copies values from a row of history, or sets them to NaN if there is
+   none. */
+static void restoreValues(Group G, real *to, real *history, int tick) {
+  if (history) copyValues(G, to, history + HISTORY_INDEX(tick) * G->numUnits);
+  else FOR_EACH_UNIT2(G, to[u] = NaN);
+}
+
+static void storeValues(Group G, real *history, real *from, int tick) {
+  if (!Net->historyLength || !history) return;
+  copyValues(G, history + HISTORY_INDEX(tick) * G->numUnits, from);
 }
 
 void storeInputs(Group G, int tick) {
-  int index;
-  if (!Net->historyLength) return;
-  index = HISTORY_INDEX(tick);
-  FOR_EACH_UNIT(G, SET_HISTORY(U, inputHistory, index, U->input));
+  storeValues(G, G->inputHistory, G->input, tick);
 }
 
 void storeOutputs(Group G, int tick) {
-  int index;
-  if (!Net->historyLength) return;
-  index = HISTORY_INDEX(tick);
-  FOR_EACH_UNIT(G, SET_HISTORY(U, outputHistory, index, U->output));
+  storeValues(G, G->outputHistory, G->output, tick);
 }
 
 void storeTargets(Group G, int tick) {
-  int index;
-  if (!Net->historyLength) return;
-  index = HISTORY_INDEX(tick);
-  FOR_EACH_UNIT(G, SET_HISTORY(U, targetHistory, index, U->target));
+  storeValues(G, G->targetHistory, G->target, tick);
 }
 
 void storeOutputsAndTargets(int tick) {
@@ -58,63 +75,56 @@ void storeOutputsAndTargets(int tick) {
 }
 
 void storeOutputDerivs(Group G, int tick) {
-  int index;
-  if (!Net->historyLength) return;
-  index = HISTORY_INDEX(tick);
-  FOR_EACH_UNIT(G, SET_HISTORY(U, outputDerivHistory, index, U->outputDeriv));
+  storeValues(G, G->outputDerivHistory, G->outputDeriv, tick);
 }
 
 void cacheOutputs(Group G) {
-  real *O = G->output;
-  FOR_EACH_UNIT2(G, O[u] = U->output);
+  real *O = G->outputCache;
+  FOR_EACH_UNIT2(G, O[u] = G->output[u]);
 }
 
 /* This resets the cache as well. */
 void resetOutputs(Group G) {
-  real *O = G->output,
+  real *O = G->outputCache,
     initOutput = chooseValue(G->initOutput, Net->initOutput);
-  FOR_EACH_UNIT2(G, U->output = O[u] = initOutput);
+  FOR_EACH_UNIT2(G, G->output[u] = O[u] = initOutput);
 }
 
 /* This caches the restored values as well. */
 void restoreOutputs(Group G, int tick) {
-  int index = HISTORY_INDEX(tick);
-  real *O = G->output;
-  FOR_EACH_UNIT2(G, U->output = O[u] = GET_HISTORY(U, outputHistory, index));
+  restoreValues(G, G->output, G->outputHistory, tick);
+  copyValues(G, G->outputCache, G->output);
 }
 
 void restoreInputs(Group G, int tick) {
-  int index = HISTORY_INDEX(tick);
-  FOR_EACH_UNIT(G, U->input = GET_HISTORY(U, inputHistory, index));
+  restoreValues(G, G->input, G->inputHistory, tick);
 }
 
 void cacheOutputDerivs(Group G) {
-  real *D = G->outputDeriv;
-  FOR_EACH_UNIT2(G, D[u] = U->outputDeriv);
+  real *D = G->outputDerivCache;
+  FOR_EACH_UNIT2(G, D[u] = G->outputDeriv[u]);
 }
 
 void injectOutputDerivCache(Group G) {
-  real *D = G->outputDeriv;
-  FOR_EACH_UNIT2(G, U->outputDeriv += D[u]);
+  real *D = G->outputDerivCache;
+  FOR_EACH_UNIT2(G, G->outputDeriv[u] += D[u]);
 }
 
 void resetOutputDerivCache(Group G) {
-  memset(G->outputDeriv, 0, G->numUnits * sizeof(real));
+  memset(G->outputDerivCache, 0, G->numUnits * sizeof(real));
 }
 
 void resetOutputDerivs(Group G) {
-  FOR_EACH_UNIT(G, U->outputDeriv = 0.0);
-  memset(G->outputDeriv, 0, G->numUnits * sizeof(real));
+  FOR_EACH_UNIT2(G, G->outputDeriv[u] = 0.0);
+  memset(G->outputDerivCache, 0, G->numUnits * sizeof(real));
 }
 
 /* This does not cache the restored values. */
 void restoreOutputDerivs(Group G, int tick) {
-  int index = HISTORY_INDEX(tick);
   if (G->costType) {
-    FOR_EACH_UNIT(G, U->outputDeriv =
-		  GET_HISTORY(U, outputDerivHistory, index));
+    restoreValues(G, G->outputDeriv, G->outputDerivHistory, tick);
   } else {
-    FOR_EACH_UNIT(G, U->outputDeriv = 0.0);
+    FOR_EACH_UNIT2(G, G->outputDeriv[u] = 0.0);
   }
 }
 
@@ -151,15 +161,21 @@ void resetBackwardIntegrators(Group G) {
   }
 }
 
+/* A dense group's derivs are all in one piece, so they are cleared at once. */
 void resetLinkDerivs(Group G) {
-  FOR_EACH_UNIT(G, U->gainDeriv = 0.0; FOR_EACH_LINK(U, L->deriv = 0.0));
+  FOR_EACH_UNIT(G, U->gainDeriv = 0.0);
+  if (G->linkMatrix)
+    memset(G->unit->deriv, 0, G->numUnits * G->denseIncoming * sizeof(real));
+  else FOR_EACH_UNIT(G, {
+    if (U->numIncoming) memset(U->deriv, 0, U->numIncoming * sizeof(real));
+  });
 }
 
 void scaleLinkDerivsByDt(Group G) {
   real scale = (real) 1.0 / Net->ticksPerInterval;
   FOR_EACH_UNIT(G, {
     U->gainDeriv *= scale;
-    FOR_EACH_LINK(U, L->deriv *= scale);
+    FOR_EACH_LINK(U, U->deriv[l] *= scale);
   });
 }
 
@@ -167,60 +183,353 @@ void injectLinkDerivNoise(Group G) {
   if (G->noiseProc) {
     real range = chooseValue(G->noiseRange, Net->noiseRange);
     FOR_EACH_UNIT(G, FOR_EACH_LINK(U, {
-      L->deriv = G->noiseProc(L->deriv, range);}));
+      U->deriv[l] = G->noiseProc(U->deriv[l], range);}));
+  }
+}
+
+
+/********************************* Live Links ********************************/
+/* Lesioned units send nothing, so a dot-product group whose senders include
+   lesioned units skips their links.  Its live index lists the runs of links
+   from live senders in each unit's blocks.  Like the blocks, a run gives the
+   number of links, the first sender and its output and the offset from there to
+   its outputDeriv, as well as the position of the run's first link.  The
+   index is built when the plan is compiled and freed whenever the links or
+   the lesions change.  A group with a dense link matrix only needs the runs
+   of its first unit.  There is no index if no links would be skipped. */
+
+typedef struct liveBlock {
+  int    link;
+  int    numUnits;
+  Unit   unit;
+  real  *output;
+  int    groupUnits;
+} *LiveBlock;
+
+struct liveIndex {
+  int       *start;     /* Where each unit's runs begin */
+  LiveBlock  block;
+};
+
+/* Steps through the runs of live links of U, like FOR_EACH_LINK_BLOCK. */
+#define FOR_EACH_LIVE_BLOCK(G, U, proc) {\
+  LiveIndex _X = (G)->liveIndex;\
+  if (_X) {\
+    int l; int _v = ((G)->linkMatrix) ? 0 : (U)->num;\
+    LiveBlock B; LiveBlock sB;\
+    for (B = _X->block + _X->start[_v], sB = _X->block + _X->start[_v + 1];\
+	 B < sB; B++) {l = B->link; proc;}\
+  } else FOR_EACH_LINK_BLOCK(G, U, proc);}
+
+void freeLiveIndex(Group G) {
+  LiveIndex X = G->liveIndex;
+  if (!X) return;
+  FREE(X->start);
+  FREE(X->block);
+  FREE(G->liveIndex);
+}
+
+/* Lesioned senders have no effect on the sums, so a run only ends at a gap
+   of at least LIVE_GAP of them, which is worth another call to the kernel. */
+#define LIVE_GAP 16
+#define LESIONED_SENDER(B, i) ((B)->unit[i].type & LESIONED)
+
+/* This fills in the runs of U, or just counts them if X->block is NULL.  It
+   adds the number of links that are skipped to skipped. */
+static int liveBlocks(LiveIndex X, Unit U, int r, int *skipped) {
+  int i, j, k;
+  FOR_EACH_LINK_BLOCK(U->group, U, {
+    for (i = 0; i < B->numUnits; i = j) {
+      for (k = i; i < B->numUnits && LESIONED_SENDER(B, i); i++);
+      *skipped += i - k;
+      if (i == B->numUnits) break;
+      for (j = i; j < B->numUnits;) {
+	for (; j < B->numUnits && !LESIONED_SENDER(B, j); j++);
+	for (k = j; k < B->numUnits && LESIONED_SENDER(B, k); k++);
+	if (k == B->numUnits || k - j >= LIVE_GAP) break;
+	j = k;
+      }
+      if (X->block) {
+	X->block[r].link       = l + i;
+	X->block[r].numUnits   = j - i;
+	X->block[r].unit       = B->unit + i;
+	X->block[r].output     = B->output + i;
+	X->block[r].groupUnits = B->groupUnits;
+      }
+      r++;
+    }
+  });
+  return r;
+}
+
+/* This builds G's live index if any of its links can be skipped. */
+static void buildLiveIndex(Group G) {
+  LiveIndex X;
+  flag lesioned = FALSE;
+  int n = (G->linkMatrix) ? 1 : G->numUnits, u, r, skipped = 0;
+  freeLiveIndex(G);
+  for (u = 0; u < n && !lesioned; u++)
+    FOR_EACH_BLOCK((G->unit + u), {
+      if (B->unit->group->type & LESIONED) lesioned = TRUE;});
+  if (!lesioned) return;
+  X = G->liveIndex = (LiveIndex) safeCalloc(1, sizeof(struct liveIndex),
+					    "buildLiveIndex:X");
+  for (u = 0, r = 0; u < n; u++) r = liveBlocks(X, G->unit + u, r, &skipped);
+  if (!skipped) {
+    freeLiveIndex(G);
+    return;
+  }
+  X->start = intArray(n + 1, "buildLiveIndex:X->start");
+  X->block = (LiveBlock) safeMalloc(imax(r, 1) * sizeof(struct liveBlock),
+				    "buildLiveIndex:X->block");
+  for (u = 0, r = 0; u < n; u++) {
+    X->start[u] = r;
+    r = liveBlocks(X, G->unit + u, r, &skipped);
+  }
+  X->start[n] = r;
+}
+
+
+/******************************* Sparse Inputs *******************************/
+/* When few of the units sending to a dot-product group are active, as with
+   sparse input examples, its inputs are summed over the active senders
+   alone.  This uses a transposed index of the group's links, built when
+   first needed and freed whenever its links change.  A group with a dense
+   link matrix needs only its first unit's blocks, so its index just holds
+   the active links found on each tick.  Other groups list the links of each
+   sending unit, grouped by the sending group. */
+
+struct sparseIndex {
+  real  *value;         /* The outputs of the active senders, */
+  int   *link;          /* and their links' positions in a dense group */
+  int    numSources;
+  Group *source;        /* The sending groups of a group that isn't dense */
+  int  **start;         /* Where each sending unit's links begin */
+  int  **unit;          /* The receiving unit of each link */
+  int  **pos;           /* And the link's position in that unit */
+};
+
+/* This also frees the group's live index. */
+void freeSparseIndex(Group G) {
+  SparseIndex X = G->sparseIndex;
+  int s;
+  freeLiveIndex(G);
+  if (!X) return;
+  for (s = 0; s < X->numSources; s++) {
+    FREE(X->start[s]);
+    FREE(X->unit[s]);
+    FREE(X->pos[s]);
+  }
+  FREE(X->source);
+  FREE(X->start);
+  FREE(X->unit);
+  FREE(X->pos);
+  FREE(X->value);
+  FREE(X->link);
+  FREE(G->sparseIndex);
+}
+
+static SparseIndex buildSparseIndex(Group G) {
+  SparseIndex X = (SparseIndex) safeCalloc(1, sizeof(struct sparseIndex),
+					   "buildSparseIndex:X");
+  int *sourceNum, s, i, v;
+  Group F;
+  if (G->linkMatrix) {
+    X->value = realArray(G->denseIncoming, "buildSparseIndex:X->value");
+    X->link  = intArray(G->denseIncoming, "buildSparseIndex:X->link");
+    return X;
+  }
+  sourceNum = intArray(Net->numGroups, "buildSparseIndex:sourceNum");
+  for (i = 0; i < Net->numGroups; i++) sourceNum[i] = -1;
+  X->source = (Group *) safeMalloc(Net->numGroups * sizeof(Group),
+				   "buildSparseIndex:X->source");
+  FOR_EVERY_UNIT(G, FOR_EACH_BLOCK(U, {
+    F = B->unit->group;
+    if (sourceNum[F->num] < 0) {
+      sourceNum[F->num] = X->numSources;
+      X->source[X->numSources++] = F;
+    }
+  }));
+  X->start = (int **) safeMalloc(X->numSources * sizeof(int *),
+				 "buildSparseIndex:X->start");
+  X->unit  = (int **) safeMalloc(X->numSources * sizeof(int *),
+				 "buildSparseIndex:X->unit");
+  X->pos   = (int **) safeMalloc(X->numSources * sizeof(int *),
+				 "buildSparseIndex:X->pos");
+  for (s = 0; s < X->numSources; s++)
+    X->start[s] = (int *) safeCalloc(X->source[s]->numUnits + 1, sizeof(int),
+				     "buildSparseIndex:X->start[s]");
+
+  /* Count each sender's links, then fill them in receiving unit order. */
+  FOR_EVERY_UNIT(G, FOR_EACH_BLOCK(U, {
+    int *start = X->start[sourceNum[B->unit->group->num]];
+    for (i = 0, v = B->unit->num; i < B->numUnits; i++, v++)
+      start[v + 1]++;
+  }));
+  for (s = 0; s < X->numSources; s++) {
+    int *start = X->start[s];
+    for (v = 0; v < X->source[s]->numUnits; v++)
+      start[v + 1] += start[v];
+    X->unit[s] = intArray(start[v], "buildSparseIndex:X->unit[s]");
+    X->pos[s]  = intArray(start[v], "buildSparseIndex:X->pos[s]");
+  }
+  /* Each start is used as the next free place and then shifted back. */
+  FOR_EVERY_UNIT(G, FOR_EACH_LINK_BLOCK(G, U, {
+    s = sourceNum[B->unit->group->num];
+    for (i = 0, v = B->unit->num; i < B->numUnits; i++, v++) {
+      X->unit[s][X->start[s][v]] = u;
+      X->pos[s][X->start[s][v]++] = l + i;
+    }
+  }));
+  for (s = 0; s < X->numSources; s++) {
+    int *start = X->start[s];
+    for (v = X->source[s]->numUnits; v > 0; v--)
+      start[v] = start[v - 1];
+    start[0] = 0;
+  }
+  FREE(sourceNum);
+  return X;
+}
+
+/* The outputs of a sending group F are read from output[F->num], or from
+   its outputCache if output is NULL.  The batch trainer passes the columns
+   of its own arrays. */
+#define SOURCE_OUTPUT(O, F) ((O) ? (O)[(F)->num] : (F)->outputCache)
+
+/* This returns the number of G's incoming links whose senders are active,
+   or -1 if that isn't below the network's sparseFraction of its links.  For
+   a dense group, it also lists the active links.  Lesioned groups and the
+   slices of split groups always use the ordinary loops. */
+int sparseInputs(Group G, real **output) {
+  SparseIndex X;
+  int active = 0, s, v, i;
+  real limit = Net->sparseFraction * G->numIncoming, *O;
+  Group F;
+  if (limit <= 0.0 || G->type & LESIONED || G != Net->group[G->num])
+    return -1;
+  if (!G->sparseIndex) G->sparseIndex = buildSparseIndex(G);
+  X = G->sparseIndex;
+  if (G->linkMatrix) {
+    limit = Net->sparseFraction * G->denseIncoming;
+    FOR_EACH_LINK_BLOCK(G, G->unit, {
+      F = B->unit->group;
+      O = SOURCE_OUTPUT(output, F) + B->unit->num;
+      for (i = 0; i < B->numUnits; i++)
+	if (O[i] != 0.0) {
+	  if (active + 1 >= limit) return -1;
+	  X->link[active]    = l + i;
+	  X->value[active++] = O[i];
+	}
+    });
+  } else {
+    for (s = 0; s < X->numSources; s++) {
+      int *start = X->start[s];
+      F = X->source[s];
+      O = SOURCE_OUTPUT(output, F);
+      for (v = 0; v < F->numUnits; v++)
+	if (O[v] != 0.0 && (active += start[v + 1] - start[v]) >= limit)
+	  return -1;
+    }
+  }
+  return active;
+}
+
+/* This sets the inputs of G's units, in the order of the active links. */
+void sparseDotProduct(Group G, int active, real **output, real *input) {
+  SparseIndex X = G->sparseIndex;
+  int s, v, k;
+  real o, *O;
+  Group F;
+  if (G->linkMatrix) {
+    FOR_EVERY_UNIT(G, {
+      real sum = 0.0;
+      for (k = 0; k < active; k++)
+	sum += X->value[k] * U->weight[X->link[k]];
+      input[u] = sum;
+    });
+    return;
+  }
+  memset(input, 0, G->numUnits * sizeof(real));
+  for (s = 0; s < X->numSources; s++) {
+    int *start = X->start[s], *unit = X->unit[s], *pos = X->pos[s];
+    F = X->source[s];
+    O = SOURCE_OUTPUT(output, F);
+    for (v = 0; v < F->numUnits; v++)
+      if ((o = O[v]) != 0.0)
+	for (k = start[v]; k < start[v + 1]; k++)
+	  input[unit[k]] += o * G->unit[unit[k]].weight[pos[k]];
+  }
+}
+
+/* This adds to the link derivs of the active senders, whose outputs were
+   found by sparseInputs().  The others wouldn't change, so this gives
+   exactly the same derivs as the ordinary loops.  The senders' derivs still
+   need every link and are left to the caller. */
+void sparseLinkDerivs(Group G, int active, real **output, real *inputDeriv) {
+  SparseIndex X = G->sparseIndex;
+  int s, v, k;
+  real o, *O;
+  Group F;
+  if (G->linkMatrix) {
+    FOR_EVERY_UNIT(G, {
+      real deriv = inputDeriv[u];
+      for (k = 0; k < active; k++)
+	U->deriv[X->link[k]] += deriv * X->value[k];
+    });
+    return;
+  }
+  for (s = 0; s < X->numSources; s++) {
+    int *start = X->start[s], *unit = X->unit[s], *pos = X->pos[s];
+    F = X->source[s];
+    O = SOURCE_OUTPUT(output, F);
+    for (v = 0; v < F->numUnits; v++)
+      if ((o = O[v]) != 0.0)
+	for (k = start[v]; k < start[v + 1]; k++)
+	  G->unit[unit[k]].deriv[pos[k]] += inputDeriv[unit[k]] * o;
   }
 }
 
 
 /***************************** Input Procedures ******************************/
-/* The backward input procedures cannot assume that U->input is what it was
+/* The backward input procedures cannot assume that G->input is what it was
    following the corresponding forward procedure.  Procedures that
    need this information in the backward step must store it in the forward
    step.
    These procedures will override the previous input value. */
 
+/* The inner loops over each block are the kernels in kernel.c. */
 static void dotProductInput(Group G, GroupProc P) {
-  FOR_EACH_UNIT(G, {
+  int active = sparseInputs(G, NULL);
+  if (active >= 0) {
+    sparseDotProduct(G, active, NULL, G->input);
+    return;
+  }
+  FOR_EACH_UNIT2(G, {
     real input = 0.0;
-    FOR_EACH_LINK_FAST_FORW(U, input += V_OUT * L_WGT, {
-      input +=  V_OUT * L_WGT + V_OUT_(1) * L_WGT_(1) +
-	V_OUT_(2) * L_WGT_(2) + V_OUT_(3) * L_WGT_(3) +
-	V_OUT_(4) * L_WGT_(4) + V_OUT_(5) * L_WGT_(5) +
-	V_OUT_(6) * L_WGT_(6) + V_OUT_(7) * L_WGT_(7) +
-	V_OUT_(8) * L_WGT_(8) + V_OUT_(9) * L_WGT_(9);
-    });
-    U->input = input;
+    FOR_EACH_LIVE_BLOCK(G, U, input = dotLinks(input, U->weight + l,
+					       B->output, B->numUnits));
+    G->input[u] = input;
   });
 }
 
 static void dotProductInputBack(Group G, GroupProc P) {
-  FOR_EACH_UNIT(G, {
-    real inputDeriv = U->inputDeriv;
-    FOR_EACH_LINK_FAST_BACK(U, {
-      V_DRV     += inputDeriv * L_WGT;
-      L_DRV     += inputDeriv * V_OUT;
-    }, {
-      V_DRV_(0) += inputDeriv * L_WGT_(0);
-      L_DRV_(0) += inputDeriv * V_OUT_(0);
-      V_DRV_(1) += inputDeriv * L_WGT_(1);
-      L_DRV_(1) += inputDeriv * V_OUT_(1);
-      V_DRV_(2) += inputDeriv * L_WGT_(2);
-      L_DRV_(2) += inputDeriv * V_OUT_(2);
-      V_DRV_(3) += inputDeriv * L_WGT_(3);
-      L_DRV_(3) += inputDeriv * V_OUT_(3);
-      V_DRV_(4) += inputDeriv * L_WGT_(4);
-      L_DRV_(4) += inputDeriv * V_OUT_(4);
-      V_DRV_(5) += inputDeriv * L_WGT_(5);
-      L_DRV_(5) += inputDeriv * V_OUT_(5);
-      V_DRV_(6) += inputDeriv * L_WGT_(6);
-      L_DRV_(6) += inputDeriv * V_OUT_(6);
-      V_DRV_(7) += inputDeriv * L_WGT_(7);
-      L_DRV_(7) += inputDeriv * V_OUT_(7);
-      V_DRV_(8) += inputDeriv * L_WGT_(8);
-      L_DRV_(8) += inputDeriv * V_OUT_(8);
-      V_DRV_(9) += inputDeriv * L_WGT_(9);
-      L_DRV_(9) += inputDeriv * V_OUT_(9);
+  int active = sparseInputs(G, NULL);
+  if (active >= 0) {
+    FOR_EACH_UNIT2(G, {
+      real inputDeriv = G->inputDeriv[u];
+      FOR_EACH_LIVE_BLOCK(G, U, dotLinksBackSenders(inputDeriv, U->weight + l,
+						    B->output + B->groupUnits,
+						    B->numUnits));
     });
+    sparseLinkDerivs(G, active, NULL, G->inputDeriv);
+    return;
+  }
+  FOR_EACH_UNIT2(G, {
+    real inputDeriv = G->inputDeriv[u];
+    FOR_EACH_LIVE_BLOCK(G, U, dotLinksBack(inputDeriv, U->weight + l,
+					   U->deriv + l, B->output,
+					   B->output + B->groupUnits,
+					   B->numUnits));
   });
 }
 
@@ -231,23 +540,22 @@ static void dotProductInputInit(Group G, GroupProc P) {
 
 
 static void distanceInput(Group G, GroupProc P) {
-  FOR_EACH_UNIT(G, {
+  FOR_EACH_UNIT2(G, {
     real input = 0.0;
-    FOR_EACH_LINK_FORW(U, input += SQUARE(L_WGT - V_OUT));
-    U->input = input;
+    FOR_EACH_LIVE_BLOCK(G, U, input = distanceLinks(input, U->weight + l,
+						    B->output, B->numUnits));
+    G->input[u] = input;
   });
 }
 
 static void distanceInputBack(Group G, GroupProc P) {
-  real delta;
-  FOR_EACH_UNIT(G, {
-    real inputDeriv = U->inputDeriv * 2.0;
+  FOR_EACH_UNIT2(G, {
+    real inputDeriv = G->inputDeriv[u] * 2.0;
     if (inputDeriv != 0.0) {
-      FOR_EACH_LINK_BACK(U, {
-	delta = inputDeriv * (L_WGT - V_OUT);
-	V_DRV -= delta;
-	L_DRV += delta;
-      });
+      FOR_EACH_LIVE_BLOCK(G, U, distanceLinksBack(inputDeriv, U->weight + l,
+						  U->deriv + l, B->output,
+						  B->output + B->groupUnits,
+						  B->numUnits));
     }
   });
 }
@@ -263,14 +571,14 @@ static void productInput(Group G, GroupProc P) {
   FOR_EACH_UNIT2(G, {
     real input = 1.0;
     FOR_EACH_LINK_FORW(U, input *= V_OUT * L_WGT);
-    U->input = inputStore[u] = input;
+    G->input[u] = inputStore[u] = input;
   });
 }
 
 static void productInputBack(Group G, GroupProc P) {
   real *inputStore = P->unitHistoryData[HISTORY_INDEX(Net->currentTick)];
   FOR_EACH_UNIT2(G, {
-    real v; real p = U->inputDeriv * inputStore[u];
+    real v; real p = G->inputDeriv[u] * inputStore[u];
     FOR_EACH_LINK_BACK(U, {
       v = p / (V_OUT * L_WGT);
       V_DRV += v * L_WGT;
@@ -287,21 +595,28 @@ static void productInputInit(Group G, GroupProc P) {
 }
 
 
+/* Clamped units get no input, since boltzmannOutput ignores it anyway. */
 static void boltzmannInput(Group G, GroupProc P) {
   real input;
-  FOR_EACH_UNIT(G, {
+  FOR_EACH_UNIT2(G, {
     input = 0.0;
-    if (isNaN(U->externalInput) && (isNaN(U->target) || !Net->inGracePeriod)) {
-      FOR_EACH_LINK_FORW(U, input += V_OUT * L_WGT);
+    if (isNaN(G->externalInput[u]) &&
+	(isNaN(G->target[u]) || !Net->inGracePeriod)) {
+      FOR_EACH_LIVE_BLOCK(G, U, input = dotLinks(input, U->weight + l,
+						 B->output, B->numUnits));
     }
-    U->input = input;
+    G->input[u] = input;
   });
 }
 
+/* The outputDerivCache holds the outputs from the positive phase. */
 static void boltzmannInputBack(Group G, GroupProc P) {
-  FOR_EACH_UNIT(G, {
-    real output = U->output; real deriv = U->outputDeriv;
-    FOR_EACH_LINK_BACK(U, L_DRV += output * V_OUT - deriv * V_DRV);
+  FOR_EACH_UNIT2(G, {
+    real output = G->output[u]; real deriv = G->outputDeriv[u];
+    FOR_EACH_LIVE_BLOCK(G, U, contrastLinksBack(output, deriv, U->deriv + l,
+						B->output,
+						B->output + B->groupUnits,
+						B->numUnits));
   });
 }
 
@@ -315,10 +630,10 @@ static void softClampInput(Group G, GroupProc P) {
   real initOutput = chooseValue(G->initOutput, Net->initOutput),
     gain = chooseValue(G->gain, Net->gain),
     strength = chooseValue(G->clampStrength, Net->clampStrength), val;
-  FOR_EACH_UNIT(G, {
-    if (!isNaN(U->externalInput)) {
-      val = initOutput + strength * (U->externalInput - initOutput);
-      U->input += INV_SIGMOID(val, gain);
+  FOR_EACH_UNIT2(G, {
+    if (!isNaN(G->externalInput[u])) {
+      val = initOutput + strength * (G->externalInput[u] - initOutput);
+      G->input[u] += INV_SIGMOID(val, gain);
     }
   });
 }
@@ -333,8 +648,8 @@ static void softClampInputInit(Group G, GroupProc P) {
 static void integrateInput(Group G, GroupProc P) {
   real dt = Net->dt * G->dtScale, *lastInput = P->unitData;
   FOR_EACH_UNIT2(G, {
-    lastInput[u] += dt * U->dtScale * (U->input - lastInput[u]);
-    U->input = lastInput[u];
+    lastInput[u] += dt * U->dtScale * (G->input[u] - lastInput[u]);
+    G->input[u] = lastInput[u];
   });
 }
 
@@ -342,8 +657,8 @@ static void integrateInputBack(Group G, GroupProc P) {
   real dt = Net->dt * G->dtScale, *lastInputDeriv = P->unitData;
   FOR_EACH_UNIT2(G, {
     real d = dt * U->dtScale * lastInputDeriv[u];
-    lastInputDeriv[u] += U->inputDeriv - d;
-    U->inputDeriv = d;
+    lastInputDeriv[u] += G->inputDeriv[u] - d;
+    G->inputDeriv[u] = d;
   });
 }
 
@@ -358,11 +673,11 @@ static void normalizeInput(Group G, GroupProc P) {
   int tick = HISTORY_INDEX(Net->currentTick);
   real *normedInput = P->unitHistoryData[tick];
   double scale = 0.0;
-  FOR_EACH_UNIT(G, scale += U->input);
+  FOR_EACH_UNIT2(G, scale += G->input[u]);
   if (scale != 0.0) {
     scale = (double) 1.0 / scale;
-    FOR_EACH_UNIT2(G, U->input *= scale; normedInput[u] = U->input);
-  } else FOR_EACH_UNIT2(G, normedInput[u] = U->input);
+    FOR_EACH_UNIT2(G, G->input[u] *= scale; normedInput[u] = G->input[u]);
+  } else FOR_EACH_UNIT2(G, normedInput[u] = G->input[u]);
   P->groupHistoryData[tick] = scale;
 }
 
@@ -370,8 +685,8 @@ static void normalizeInputBack(Group G, GroupProc P) {
   int tick = HISTORY_INDEX(Net->currentTick);
   real shift = 0.0, scale = P->groupHistoryData[tick],
     *normedInput = P->unitHistoryData[tick];
-  FOR_EACH_UNIT2(G, shift += U->inputDeriv * normedInput[u]);
-  FOR_EACH_UNIT(G, U->inputDeriv = scale * (U->inputDeriv - shift););
+  FOR_EACH_UNIT2(G, shift += G->inputDeriv[u] * normedInput[u]);
+  FOR_EACH_UNIT2(G, G->inputDeriv[u] = scale * (G->inputDeriv[u] - shift););
 }
 
 static void normalizeInputInit(Group G, GroupProc P) {
@@ -387,7 +702,7 @@ static void normalizeInputInit(Group G, GroupProc P) {
 static void noisyInput(Group G, GroupProc P) {
   if (G->noiseProc) {
     real range = chooseValue(G->noiseRange, Net->noiseRange);
-    FOR_EACH_UNIT(G, U->input = G->noiseProc(U->input, range));
+    FOR_EACH_UNIT2(G, G->input[u] = G->noiseProc(G->input[u], range));
   }
 }
 
@@ -404,7 +719,7 @@ static void noisyInputInit(Group G, GroupProc P) {
 static void noisyInputDerivBack(Group G, GroupProc P) {
   if (G->noiseProc) {
     real range = chooseValue(G->noiseRange, Net->noiseRange);
-    FOR_EACH_UNIT(G, U->inputDeriv = G->noiseProc(U->inputDeriv, range));
+    FOR_EACH_UNIT2(G, G->inputDeriv[u] = G->noiseProc(G->inputDeriv[u], range));
   }
 }
 
@@ -422,7 +737,7 @@ static void copyInputs(Group G, GroupProc P) {
   source = D->source;
   offset = D->offset;
   FOR_EACH_UNIT2(G, {
-    U->input = *((real *)((char *)(source->unit + u) + offset));
+    G->input[u] = GROUP_FIELD(source, offset)[u];
   });
 }
 
@@ -433,8 +748,9 @@ static void copyInputsInit(Group G, GroupProc P) {
 
 static void incrementClampInput(Group G, GroupProc P) {
   real strength = chooseValue(G->clampStrength, Net->clampStrength);
-  FOR_EACH_UNIT(G, {
-    if (!isNaN(U->externalInput)) U->input += strength * U->externalInput;
+  FOR_EACH_UNIT2(G, {
+    if (!isNaN(G->externalInput[u]))
+      G->input[u] += strength * G->externalInput[u];
   });
 }
 
@@ -446,18 +762,18 @@ static void incrementClampInputInit(Group G, GroupProc P) {
 
 
 /***************************** Output Procedures *****************************/
-/* The backward output procedures may assume that U->output and U->input are
+/* The backward output procedures may assume that G->output and G->input are
    what they were following the corresponding forward procedure.  Procedures
    that alter the unit output in the forward step must undo the alteration in
    the backward step.
    These procedures will override the previous output value. */
 
 static void linearOutput(Group G, GroupProc P) {
-  FOR_EACH_UNIT(G, U->output = U->input);
+  FOR_EACH_UNIT2(G, G->output[u] = G->input[u]);
 }
 
 static void linearOutputBack(Group G, GroupProc P) {
-  FOR_EACH_UNIT(G, U->inputDeriv = U->outputDeriv);
+  FOR_EACH_UNIT2(G, G->inputDeriv[u] = G->outputDeriv[u]);
 }
 
 static void linearOutputInit(Group G, GroupProc P) {
@@ -466,29 +782,46 @@ static void linearOutputInit(Group G, GroupProc P) {
 }
 
 
+/* This runs proc on each run of consecutive units in a lesioned group's
+   list of live units, with u the first unit of the run and n its length. */
+#define FOR_EACH_LIVE_RUN(G, proc) {\
+  Unit *_L = (G)->liveUnit; Unit *_sL = _L + (G)->numLive; int u; int n;\
+  while (_L < _sL) {\
+    for (n = 1; _L + n < _sL && _L[n] == _L[0] + n; n++);\
+    u = _L[0] - (G)->unit;\
+    _L += n;\
+    {proc;}}}
+
+/* Lesioned units keep their old values, so those groups go a run of live
+   units at a time. */
+#define GROUP_VALUES(G, kernel, y, x, arg) {\
+  if (!((G)->type & LESIONED)) kernel(y, x, arg, (G)->numUnits);\
+  else if (LIVE_UNITS(G))\
+    FOR_EACH_LIVE_RUN(G, kernel((y) + u, (x) + u, arg, n))\
+  else FOR_EACH_UNIT2(G, kernel((y) + u, (x) + u, arg, 1));}
+
 static void logisticOutput(Group G, GroupProc P) {
   if (G->type & ADAPTIVE_GAIN) {
-    FOR_EACH_UNIT(G, {
-      U->output = fastSigmoid(U->input * U->gain);
-    });
+    FOR_EACH_UNIT2(G, G->output[u] = G->input[u] * U->gain);
+    GROUP_VALUES(G, sigmoidValues, G->output, G->output, 1.0);
   } else {
     real gain = chooseValue(G->gain, Net->gain);
-    FOR_EACH_UNIT(G, U->output = fastSigmoid(U->input * gain));
+    GROUP_VALUES(G, sigmoidValues, G->output, G->input, gain);
   }
 }
 
 static void logisticOutputBack(Group G, GroupProc P) {
   if (G->type & ADAPTIVE_GAIN) {
     real x;
-    FOR_EACH_UNIT(G, {
-      x = U->outputDeriv * U->output * (1.0 - U->output);
-      U->inputDeriv = x * U->gain;
-      U->gainDeriv += x * U->input;
+    FOR_EACH_UNIT2(G, {
+      x = G->outputDeriv[u] * G->output[u] * (1.0 - G->output[u]);
+      G->inputDeriv[u] = x * U->gain;
+      U->gainDeriv += x * G->input[u];
     });
   } else {
     real gain = chooseValue(G->gain, Net->gain);
-    FOR_EACH_UNIT(G, U->inputDeriv = U->outputDeriv *
-		  U->output * (1.0 - U->output) * gain);
+    FOR_EACH_UNIT2(G, G->inputDeriv[u] = G->outputDeriv[u] *
+		  G->output[u] * (1.0 - G->output[u]) * gain);
   }
 }
 
@@ -501,20 +834,20 @@ static void logisticOutputInit(Group G, GroupProc P) {
 static void ternaryOutput(Group G, GroupProc P) {
   real x, z, gain = chooseValue(G->gain, Net->gain),
     y = EXP(gain * chooseValue(G->ternaryShift, Net->ternaryShift));
-  FOR_EACH_UNIT(G, {
-    x = EXP(gain * U->input);
+  FOR_EACH_UNIT2(G, {
+    x = EXP(gain * G->input[u]);
     z = x * y;
-    U->output = (x * z - y) / ((x + y) * (z + 1.0));
+    G->output[u] = (x * z - y) / ((x + y) * (z + 1.0));
   });
 }
 
 static void ternaryOutputBack(Group G, GroupProc P) {
   real x, z, v, w, gain = chooseValue(G->gain, Net->gain),
     y = EXP(gain * chooseValue(G->ternaryShift, Net->ternaryShift));
-  FOR_EACH_UNIT(G, {
-    x = EXP(gain * U->input);
+  FOR_EACH_UNIT2(G, {
+    x = EXP(gain * G->input[u]);
     z = x * y; v = SQUARE(x + y); w = SQUARE(z + 1.0);
-    U->inputDeriv = U->outputDeriv * gain * z * (v + w) / (v * w);
+    G->inputDeriv[u] = G->outputDeriv[u] * gain * z * (v + w) / (v * w);
   });
 }
 
@@ -526,25 +859,26 @@ static void ternaryOutputInit(Group G, GroupProc P) {
 
 static void tanhOutput(Group G, GroupProc P) {
   if (G->type & ADAPTIVE_GAIN) {
-    FOR_EACH_UNIT(G, U->output = CALC_TANH(U->gain * U->input));
+    FOR_EACH_UNIT2(G, G->output[u] = U->gain * G->input[u]);
+    GROUP_VALUES(G, tanhValues, G->output, G->output, 1.0);
   } else {
     real gain = chooseValue(G->gain, Net->gain);
-    FOR_EACH_UNIT(G, U->output = CALC_TANH(gain * U->input));
+    GROUP_VALUES(G, tanhValues, G->output, G->input, gain);
   }
 }
 
 static void tanhOutputBack(Group G, GroupProc P) {
   if (G->type & ADAPTIVE_GAIN) {
     real x;
-    FOR_EACH_UNIT(G, {
-      x = U->outputDeriv * TANH_DERIV(U->input);
-      U->inputDeriv = x * U->gain;
-      U->gainDeriv += x * U->input;
+    FOR_EACH_UNIT2(G, {
+      x = G->outputDeriv[u] * TANH_DERIV(G->input[u]);
+      G->inputDeriv[u] = x * U->gain;
+      U->gainDeriv += x * G->input[u];
     });
   } else {
     real gain = chooseValue(G->gain, Net->gain);
-    FOR_EACH_UNIT(G, U->inputDeriv = U->outputDeriv * gain *
-                  TANH_DERIV(U->input));
+    FOR_EACH_UNIT2(G, G->inputDeriv[u] = G->outputDeriv[u] * gain *
+                  TANH_DERIV(G->input[u]));
   }
 }
 
@@ -555,11 +889,11 @@ static void tanhOutputInit(Group G, GroupProc P) {
 
 
 static void exponentialOutput(Group G, GroupProc P) {
-  FOR_EACH_UNIT(G, U->output = EXP(U->input));
+  GROUP_VALUES(G, expValues, G->output, G->input, 0.0);
 }
 
 static void exponentialOutputBack(Group G, GroupProc P) {
-  FOR_EACH_UNIT(G, U->inputDeriv = U->output * U->outputDeriv);
+  FOR_EACH_UNIT2(G, G->inputDeriv[u] = G->output[u] * G->outputDeriv[u]);
 }
 
 static void exponentialOutputInit(Group G, GroupProc P) {
@@ -571,32 +905,33 @@ static void exponentialOutputInit(Group G, GroupProc P) {
 static void gaussianOutput(Group G, GroupProc P) {
   real x;
   if (G->type & ADAPTIVE_GAIN) {
-    FOR_EACH_UNIT(G, {
-      x = U->input * U->gain;
-      U->output = EXP(-x * x);
+    FOR_EACH_UNIT2(G, {
+      x = G->input[u] * U->gain;
+      G->output[u] = -x * x;
     });
   } else {
     real gain = chooseValue(G->gain, Net->gain);
-    FOR_EACH_UNIT(G, {
-      x = U->input * gain;
-      U->output = EXP(-x * x);
+    FOR_EACH_UNIT2(G, {
+      x = G->input[u] * gain;
+      G->output[u] = -x * x;
     });
   }
+  GROUP_VALUES(G, expValues, G->output, G->output, 0.0);
 }
 
 static void gaussianOutputBack(Group G, GroupProc P) {
   real scale;
   if (G->type & ADAPTIVE_GAIN) {
-    FOR_EACH_UNIT(G, {
-      scale = -2.0 * U->input * U->gain * U->output * U->outputDeriv;
-      U->inputDeriv = scale * U->gain;
-      U->gainDeriv += scale * U->input;
+    FOR_EACH_UNIT2(G, {
+      scale = -2.0 * G->input[u] * U->gain * G->output[u] * G->outputDeriv[u];
+      G->inputDeriv[u] = scale * U->gain;
+      U->gainDeriv += scale * G->input[u];
     });
   } else {
     real gain = chooseValue(G->gain, Net->gain);
     scale = -2.0 * gain * gain;
-    FOR_EACH_UNIT(G, U->inputDeriv = U->outputDeriv * U->output *
-		  U->input * scale);
+    FOR_EACH_UNIT2(G, G->inputDeriv[u] = G->outputDeriv[u] * G->output[u] *
+		  G->input[u] * scale);
   }
 }
 
@@ -610,18 +945,18 @@ static void gaussianOutputInit(Group G, GroupProc P) {
    the shift to avoid overflow. */
 static void softMaxOutput(Group G, GroupProc P) {
   double maxInput = 0.0, outputSum = 0.0, scale;
-  FOR_EACH_UNIT(G, if (U->input > maxInput) maxInput = U->input);
-  FOR_EACH_UNIT(G, U->output = EXP(U->input - maxInput);
-	       outputSum += U->output);
+  FOR_EACH_UNIT2(G, if (G->input[u] > maxInput) maxInput = G->input[u]);
+  GROUP_VALUES(G, expValues, G->output, G->input, maxInput);
+  FOR_EACH_UNIT2(G, outputSum += G->output[u]);
   scale = (real) 1.0 / outputSum;
-  FOR_EACH_UNIT(G, U->output *= scale);
+  FOR_EACH_UNIT2(G, G->output[u] *= scale);
 }
 
 static void softMaxOutputBack(Group G, GroupProc P) {
   double outputDerivSum = 0.0;
-  FOR_EACH_UNIT(G, outputDerivSum += U->outputDeriv * U->output);
-  FOR_EACH_UNIT(G, U->inputDeriv = U->output *
-		(U->outputDeriv - outputDerivSum));
+  FOR_EACH_UNIT2(G, outputDerivSum += G->outputDeriv[u] * G->output[u]);
+  FOR_EACH_UNIT2(G, G->inputDeriv[u] = G->output[u] *
+		(G->outputDeriv[u] - outputDerivSum));
 }
 
 static void softMaxOutputInit(Group G, GroupProc P) {
@@ -641,34 +976,109 @@ static real distanceSquared(real ai, real aj, real bi, real bj,
   return SQUARE(di) + SQUARE(dj);
 }
 
+/* The neighborhood is cached in P->unitData as the half-width of the span
+   of columns that is within range on each row, by the row's distance from
+   the winner's row, or -1 if none is.  The first KOHONEN_KEY values hold
+   the neighborhood, numColumns, and periodicBoundary it was built for. */
+#define KOHONEN_KEY 3
+
+static real *kohonenWidths(Group G, GroupProc P, int cols, int rows) {
+  real *key = P->unitData, *width = key + KOHONEN_KEY,
+    neigh = SQUARE(G->neighborhood);
+  int d, w, maxW, numRows;
+  flag periodic = G->periodicBoundary;
+  if (key[0] == G->neighborhood && key[1] == cols && key[2] == periodic)
+    return width;
+
+  /* Periodic distances are taken the short way around. */
+  numRows = (periodic) ? rows / 2 + 1 : (G->numUnits + cols - 1) / cols;
+  maxW = (periodic) ? cols / 2 : cols - 1;
+  for (d = 0, w = maxW; d < numRows; d++) {
+    while (w >= 0 && distanceSquared(w, d, 0, 0, cols, rows, periodic) > neigh)
+      w--;
+    width[d] = w;
+  }
+  key[0] = G->neighborhood;
+  key[1] = cols;
+  key[2] = periodic;
+  return width;
+}
+
+/* This sets the outputs of the units in columns lo to hi of row j, which
+   may wrap around. */
+static void kohonenSpan(Group G, real scale, int cols, int j, int lo, int hi) {
+  int u, v, end;
+  if (lo < 0) {
+    kohonenSpan(G, scale, cols, j, lo + cols, cols - 1);
+    lo = 0;
+  } else if (hi >= cols) {
+    kohonenSpan(G, scale, cols, j, 0, hi - cols);
+    hi = cols - 1;
+  }
+  v = j * cols;
+  end = imin(v + hi + 1, G->numUnits);
+  for (u = v + lo; u < end; u++)
+    G->output[u] = 1.0 - G->input[u] * scale;
+}
+
+/* Without lesions, the winner is found with minMaxValues, and only the
+   units within the cached neighborhood are visited after clearing the
+   outputs.  A periodic map with a partial last row uses the full scan. */
 static void kohonenOutput(Group G, GroupProc P) {
-  real max = 0.0, min = LARGE_VAL, scale, neigh;
-  int i, j, mu = 0, mi, mj, cols = G->numColumns, rows = G->numUnits / cols;
+  real max = 0.0, min = LARGE_VAL, scale, neigh, lo, hi, *width;
+  int i, j, n, w, mu = 0, mi, mj, cols = G->numColumns,
+    rows = G->numUnits / cols;
   flag periodic = G->periodicBoundary;
 
-  FOR_EACH_UNIT(G, {
-    if (U->input > max) max = U->input;
-    if (U->input < min) {min = U->input; mu = U->num;}
+  if (!(G->type & LESIONED) && !(periodic && G->numUnits % cols)) {
+    i = minMaxValues(G->input, G->numUnits, &lo, &hi);
+    if (hi > max) max = hi;
+    if (lo < min) {min = lo; mu = i;}
+    scale = (real) 1.0 / max;
+    mi = mu % cols;  mj = mu / cols;
+    width = kohonenWidths(G, P, cols, rows);
+    memset(G->output, 0, G->numUnits * sizeof(real));
+    if (periodic) {
+      for (n = 0; n < rows; n++) {
+	if ((w = width[imin(n, rows - n)]) < 0) continue;
+	j = (mj + n) % rows;
+	if (2 * w + 1 >= cols) kohonenSpan(G, scale, cols, j, 0, cols - 1);
+	else kohonenSpan(G, scale, cols, j, mi - w, mi + w);
+      }
+    } else {
+      for (j = 0; j * cols < G->numUnits; j++)
+	if ((w = width[(j > mj) ? j - mj : mj - j]) >= 0)
+	  kohonenSpan(G, scale, cols, j, imax(mi - w, 0),
+		      imin(mi + w, cols - 1));
+    }
+    return;
+  }
+
+  FOR_EACH_UNIT2(G, {
+    if (G->input[u] > max) max = G->input[u];
+    if (G->input[u] < min) {min = G->input[u]; mu = U->num;}
   });
   scale = (real) 1.0 / max;
   neigh = SQUARE(G->neighborhood);
   mi = mu % cols;  mj = mu / cols;
-  FOR_EACH_UNIT(G, {
+  FOR_EACH_UNIT2(G, {
     i = U->num % cols; j = U->num / cols;
     if (distanceSquared(i, j, mi, mj, cols, rows, periodic) <= neigh)
-      U->output = 1.0 - U->input * scale;
-    else U->output = 0.0;
+      G->output[u] = 1.0 - G->input[u] * scale;
+    else G->output[u] = 0.0;
   });
 }
 
 /* The gain is just used as some kind of scaling factor. */
 static void kohonenOutputBack(Group G, GroupProc P) {
-  FOR_EACH_UNIT(G, U->inputDeriv = (U->output > 0) ? 1.0 : 0.0);
+  FOR_EACH_UNIT2(G, G->inputDeriv[u] = (G->output[u] > 0) ? 1.0 : 0.0);
 }
 
 static void kohonenOutputInit(Group G, GroupProc P) {
   P->forwardProc  = kohonenOutput;
   P->backwardProc = kohonenOutputBack;
+  P->unitData = realArray(KOHONEN_KEY + G->numUnits + 1, "KOHONEN:unitData");
+  P->unitData[0] = NaN;
 }
 
 
@@ -676,12 +1086,13 @@ static void boltzmannOutput(Group G, GroupProc P) {
   real gain = chooseValue(G->gain, Net->gain),
     dt = Net->dt * G->dtScale, *lastOutput = P->unitData;
   FOR_EACH_UNIT2(G, {
-    lastOutput[u] = U->output;
-    if (!isNaN(U->externalInput))
-      U->output = U->externalInput;
-    else if (!isNaN(U->target) && Net->inGracePeriod)
-      U->output = U->target;
-    else U->output += dt * U->dtScale * (SIGMOID(U->input, gain) - U->output);
+    lastOutput[u] = G->output[u];
+    if (!isNaN(G->externalInput[u]))
+      G->output[u] = G->externalInput[u];
+    else if (!isNaN(G->target[u]) && Net->inGracePeriod)
+      G->output[u] = G->target[u];
+    else G->output[u] += dt * U->dtScale *
+	   (SIGMOID(G->input[u], gain) - G->output[u]);
   });
 }
 
@@ -697,9 +1108,9 @@ static void hardClampOutput(Group G, GroupProc P) {
   int tick = HISTORY_INDEX(Net->currentTick);
   real *externalInputHistory = P->unitHistoryData[tick];
   FOR_EACH_UNIT2(G, {
-    if (!isNaN(U->externalInput))
-      U->output = U->externalInput;
-    externalInputHistory[u] = U->externalInput;
+    if (!isNaN(G->externalInput[u]))
+      G->output[u] = G->externalInput[u];
+    externalInputHistory[u] = G->externalInput[u];
   });
 }
 
@@ -708,7 +1119,7 @@ static void hardClampOutputBack(Group G, GroupProc P) {
   real *externalInputHistory = P->unitHistoryData[tick];
   FOR_EACH_UNIT2(G, {
     if (!isNaN(externalInputHistory[u]))
-      U->inputDeriv = 0.0;
+      G->inputDeriv[u] = 0.0;
   });
 }
 
@@ -721,11 +1132,11 @@ static void hardClampOutputInit(Group G, GroupProc P) {
 
 
 static void biasClampOutput(Group G, GroupProc P) {
-  FOR_EACH_UNIT(G, U->output = 1.0);
+  FOR_EACH_UNIT2(G, G->output[u] = 1.0);
 }
 
 static void biasClampOutputBack(Group G, GroupProc P) {
-  FOR_EACH_UNIT(G, U->inputDeriv = 0.0);
+  FOR_EACH_UNIT2(G, G->inputDeriv[u] = 0.0);
 }
 
 static void biasClampOutputInit(Group G, GroupProc P) {
@@ -739,8 +1150,8 @@ static void biasClampOutputInit(Group G, GroupProc P) {
 static void elmanClampOutput(Group G, GroupProc P) {
   real *elmanInput;
   if (!(P->otherData)) return;
-  elmanInput = ((Group) P->otherData)->output;
-  FOR_EACH_UNIT2(G, U->output += elmanInput[u]);
+  elmanInput = ((Group) P->otherData)->outputCache;
+  FOR_EACH_UNIT2(G, G->output[u] += elmanInput[u]);
 }
 
 /* For this to work the source group's output array must be the same as it was
@@ -748,11 +1159,11 @@ static void elmanClampOutput(Group G, GroupProc P) {
 static void elmanClampOutputBack(Group G, GroupProc P) {
   real *elmanInput, *elmanDeriv;
   if (!(P->otherData)) return;
-  elmanInput = ((Group) P->otherData)->output;
-  elmanDeriv = ((Group) P->otherData)->outputDeriv;
+  elmanInput = ((Group) P->otherData)->outputCache;
+  elmanDeriv = ((Group) P->otherData)->outputDerivCache;
   FOR_EACH_UNIT2(G, {
-    elmanDeriv[u] += U->outputDeriv;
-    U->output -= elmanInput[u];
+    elmanDeriv[u] += G->outputDeriv[u];
+    G->output[u] -= elmanInput[u];
   });
 }
 
@@ -766,9 +1177,9 @@ static void weakClampOutput(Group G, GroupProc P) {
   real *originalOutput = P->unitHistoryData[HISTORY_INDEX(Net->currentTick)],
     strength = chooseValue(G->clampStrength, Net->clampStrength);
   FOR_EACH_UNIT2(G, {
-    originalOutput[u] = U->output;
-    if (!isNaN(U->externalInput))
-      U->output += strength * (U->externalInput - U->output);
+    originalOutput[u] = G->output[u];
+    if (!isNaN(G->externalInput[u]))
+      G->output[u] += strength * (G->externalInput[u] - G->output[u]);
   });
 }
 
@@ -776,9 +1187,9 @@ static void weakClampOutputBack(Group G, GroupProc P) {
   real *originalOutput = P->unitHistoryData[HISTORY_INDEX(Net->currentTick)],
     scale = 1.0 - chooseValue(G->clampStrength, Net->clampStrength);
   FOR_EACH_UNIT2(G, {
-    if (U->output != originalOutput[u]) {
-      U->output = originalOutput[u];
-      U->outputDeriv *= scale;
+    if (G->output[u] != originalOutput[u]) {
+      G->output[u] = originalOutput[u];
+      G->outputDeriv[u] *= scale;
     }
   });
 }
@@ -796,9 +1207,9 @@ static void integrateOutput(Group G, GroupProc P) {
   real *lastOutput = P->unitData;
   real *instantOutput = P->unitHistoryData[HISTORY_INDEX(Net->currentTick)];
   FOR_EACH_UNIT2(G, {
-    instantOutput[u] = U->output;
-    lastOutput[u] += dt * U->dtScale * (U->output - lastOutput[u]);
-    U->output = lastOutput[u];
+    instantOutput[u] = G->output[u];
+    lastOutput[u] += dt * U->dtScale * (G->output[u] - lastOutput[u]);
+    G->output[u] = lastOutput[u];
   });
 }
 
@@ -808,9 +1219,9 @@ static void integrateOutputBack(Group G, GroupProc P) {
   real *instantOutput = P->unitHistoryData[HISTORY_INDEX(Net->currentTick)];
   FOR_EACH_UNIT2(G, {
     real d = dt * U->dtScale * lastOutputDeriv[u];
-    U->output = instantOutput[u];
-    lastOutputDeriv[u] += U->outputDeriv - d;
-    U->outputDeriv = d;
+    G->output[u] = instantOutput[u];
+    lastOutputDeriv[u] += G->outputDeriv[u] - d;
+    G->outputDeriv[u] = d;
   });
 }
 
@@ -826,11 +1237,11 @@ static void integrateOutputInit(Group G, GroupProc P) {
 static void normalizeOutput(Group G, GroupProc P) {
   int tick = HISTORY_INDEX(Net->currentTick);
   real scale = 0.0, *originalOutput = P->unitHistoryData[tick];
-  FOR_EACH_UNIT(G, scale += U->output);
+  FOR_EACH_UNIT2(G, scale += G->output[u]);
   if (scale != 0.0) {
     scale = (real) 1.0 / scale;
-    FOR_EACH_UNIT2(G, originalOutput[u] = U->output; U->output *= scale);
-  } else FOR_EACH_UNIT2(G, originalOutput[u] = U->output);
+    FOR_EACH_UNIT2(G, originalOutput[u] = G->output[u]; G->output[u] *= scale);
+  } else FOR_EACH_UNIT2(G, originalOutput[u] = G->output[u]);
   P->groupHistoryData[tick] = scale;
 }
 
@@ -838,10 +1249,10 @@ static void normalizeOutputBack(Group G, GroupProc P) {
   int tick = HISTORY_INDEX(Net->currentTick);
   real shift = 0.0, scale = P->groupHistoryData[tick],
     *originalOutput = P->unitHistoryData[tick];
-  FOR_EACH_UNIT(G, shift += U->outputDeriv * U->output);
+  FOR_EACH_UNIT2(G, shift += G->outputDeriv[u] * G->output[u]);
   FOR_EACH_UNIT2(G, {
-    U->outputDeriv = scale * (U->outputDeriv - shift);
-    U->output = originalOutput[u];
+    G->outputDeriv[u] = scale * (G->outputDeriv[u] - shift);
+    G->output[u] = originalOutput[u];
   });
 }
 
@@ -859,14 +1270,14 @@ static void noisyOutput(Group G, GroupProc P) {
   real *cleanOutput = P->unitHistoryData[HISTORY_INDEX(Net->currentTick)],
     range = chooseValue(G->noiseRange, Net->noiseRange);
   FOR_EACH_UNIT2(G, {
-    cleanOutput[u] = U->output;
-    if (G->noiseProc) U->output = G->noiseProc(U->output, range);
+    cleanOutput[u] = G->output[u];
+    if (G->noiseProc) G->output[u] = G->noiseProc(G->output[u], range);
   });
 }
 
 static void noisyOutputBack(Group G, GroupProc P) {
   real *cleanOutput = P->unitHistoryData[HISTORY_INDEX(Net->currentTick)];
-  FOR_EACH_UNIT2(G, U->output = cleanOutput[u]);
+  FOR_EACH_UNIT2(G, G->output[u] = cleanOutput[u]);
 }
 
 static void noisyOutputInit(Group G, GroupProc P) {
@@ -882,8 +1293,8 @@ static void noisyOutputInit(Group G, GroupProc P) {
 static void noisyOutputDerivBack(Group G, GroupProc P) {
   if (G->noiseProc) {
     real range = chooseValue(G->noiseRange, Net->noiseRange);
-    FOR_EACH_UNIT(G, U->outputDeriv =
-		  G->noiseProc(U->outputDeriv, range));
+    FOR_EACH_UNIT2(G, G->outputDeriv[u] =
+		  G->noiseProc(G->outputDeriv[u], range));
   }
 }
 
@@ -896,15 +1307,15 @@ static void croppedOutput(Group G, GroupProc P) {
   real *originalOutput = P->unitHistoryData[HISTORY_INDEX(Net->currentTick)];
   real max = G->maxOutput, min = G->minOutput;
   FOR_EACH_UNIT2(G, {
-    originalOutput[u] = U->output;
-    if (U->output > max) U->output = max;
-    else if (U->output < min) U->output = min;
+    originalOutput[u] = G->output[u];
+    if (G->output[u] > max) G->output[u] = max;
+    else if (G->output[u] < min) G->output[u] = min;
   });
 }
 
 static void croppedOutputBack(Group G, GroupProc P) {
   real *originalOutput = P->unitHistoryData[HISTORY_INDEX(Net->currentTick)];
-  FOR_EACH_UNIT2(G, U->output = originalOutput[u]);
+  FOR_EACH_UNIT2(G, G->output[u] = originalOutput[u]);
 }
 
 static void croppedOutputInit(Group G, GroupProc P) {
@@ -924,7 +1335,7 @@ static void copyOutputs(Group G, GroupProc P) {
   source = D->source;
   offset = D->offset;
   FOR_EACH_UNIT2(G, {
-    U->output = *((real *)((char *)(source->unit + u) + offset));
+    G->output[u] = GROUP_FIELD(source, offset)[u];
   });
 }
 
@@ -938,17 +1349,17 @@ static void winnerTakeAllOutput(Group G, GroupProc P) {
   real max = G->minOutput;
   Unit winner = NULL;
   FOR_EACH_UNIT2(G, {
-    originalOutput[u] = U->output;
-    if (U->output > max) {max = U->output; winner = U;}
+    originalOutput[u] = G->output[u];
+    if (G->output[u] > max) {max = G->output[u]; winner = U;}
   });
-  FOR_EACH_UNIT(G, {
-    if (U != winner) U->output = G->minOutput;
+  FOR_EACH_UNIT2(G, {
+    if (U != winner) G->output[u] = G->minOutput;
   });
 }
 
 static void winnerTakeAllOutputBack(Group G, GroupProc P) {
   real *originalOutput = P->unitHistoryData[HISTORY_INDEX(Net->currentTick)];
-  FOR_EACH_UNIT2(G, U->output = originalOutput[u]);
+  FOR_EACH_UNIT2(G, G->output[u] = originalOutput[u]);
 }
 
 static void winnerTakeAllOutputInit(Group G, GroupProc P) {
@@ -967,13 +1378,13 @@ static void interactiveActivation(Group G, GroupProc P) {
   real rest = chooseValue(G->initOutput, Net->initOutput);
   real in, out;
   FOR_EACH_UNIT2(G, {
-    in  = U->input;
+    in  = G->input[u];
     out = lastOutput[u];
     if (in > 0.0) out += dt * U->dtScale * ((max - out) * in - (out - rest));
     else out += dt * U->dtScale * ((out - min) * in - (out - rest));
     if (out > max) out = max;
     else if (out < 0.0) out = 0.0;
-    U->output = lastOutput[u] = out;
+    G->output[u] = lastOutput[u] = out;
   });
 }
 
@@ -993,19 +1404,19 @@ static void squaredError(Group G, GroupProc P) {
     targetRadius = chooseValue(G->targetRadius, Net->targetRadius),
     zeroErrorRadius = chooseValue(G->zeroErrorRadius, Net->zeroErrorRadius);
   if (targetRadius != 0.0 || zeroErrorRadius != 0.0) {
-    FOR_EACH_UNIT(G, {
-      if (!isNaN(U->target)) {
-	output = U->output;  target = U->target;
-	target = U->adjustedTarget =
+    FOR_EACH_UNIT2(G, {
+      if (!isNaN(G->target[u])) {
+	output = G->output[u];  target = G->target[u];
+	target = G->adjustedTarget[u] =
 	  ADJUSTED_TARGET(output, target, targetRadius, zeroErrorRadius);
 	error += SQUARE(output - target);
       }
     });
   } else {
-    FOR_EACH_UNIT(G, {
-      if (!isNaN(U->target)) {
-	output = U->output;
-	target = U->adjustedTarget = U->target;
+    FOR_EACH_UNIT2(G, {
+      if (!isNaN(G->target[u])) {
+	output = G->output[u];
+	target = G->adjustedTarget[u] = G->target[u];
 	error += SQUARE(output - target);
       }
     });
@@ -1019,8 +1430,8 @@ static void squaredError(Group G, GroupProc P) {
 static void squaredErrorBack(Group G, GroupProc P) {
   real scale = ((Net->pseudoExampleFreq) ?
 		Net->currentExample->frequency : 1.0) * G->errorScale * 2.0;
-  FOR_EACH_UNIT(G, if (!isNaN(U->target)) {
-    U->outputDeriv += scale * (U->output - U->adjustedTarget);
+  FOR_EACH_UNIT2(G, if (!isNaN(G->target[u])) {
+    G->outputDeriv[u] += scale * (G->output[u] - G->adjustedTarget[u]);
   });
 }
 
@@ -1030,28 +1441,37 @@ static void squaredErrorInit(Group G, GroupProc P) {
 }
 
 
+/* Units without targets get NaN adjusted targets, which the error sums
+   skip. */
+static void adjustTargets(Group G, real targetRadius, real zeroErrorRadius) {
+  real output, target;
+  if (targetRadius != 0.0 || zeroErrorRadius != 0.0) {
+    FOR_EACH_UNIT2(G, {
+      output = G->output[u]; target = G->target[u];
+      if (!isNaN(target)) target =
+	ADJUSTED_TARGET(output, target, targetRadius, zeroErrorRadius);
+      G->adjustedTarget[u] = target;
+    });
+  } else FOR_EACH_UNIT2(G, G->adjustedTarget[u] = G->target[u]);
+}
+
+#define GROUP_SUM(G, kernel, sum) {\
+  if (!((G)->type & LESIONED))\
+    sum = kernel(G->output, G->adjustedTarget, (G)->numUnits);\
+  else {\
+    sum = 0.0;\
+    if (LIVE_UNITS(G)) FOR_EACH_LIVE_RUN(G, {\
+      sum += kernel(G->output + u, G->adjustedTarget + u, n);})\
+    else FOR_EACH_UNIT2(G, {\
+      sum += kernel(G->output + u, G->adjustedTarget + u, 1);});\
+  }}
+
 static void crossEntropyError(Group G, GroupProc P) {
-  real output, target, error = 0.0,
+  real error,
     targetRadius = chooseValue(G->targetRadius, Net->targetRadius),
     zeroErrorRadius = chooseValue(G->zeroErrorRadius, Net->zeroErrorRadius);
-  if (targetRadius != 0.0 || zeroErrorRadius != 0.0) {
-    FOR_EACH_UNIT(G, {
-      if (!isNaN(U->target)) {
-	output = U->output;  target = U->target;
-	target = U->adjustedTarget =
-	  ADJUSTED_TARGET(output, target, targetRadius, zeroErrorRadius);
-	error += CROSS_ENTROPY_ERROR(output, target);
-      }
-    });
-  } else {
-    FOR_EACH_UNIT(G, {
-      if (!isNaN(U->target)) {
-	output = U->output;
-	target = U->adjustedTarget = U->target;
-	error += CROSS_ENTROPY_ERROR(output, target);
-      }
-    });
-  }
+  adjustTargets(G, targetRadius, zeroErrorRadius);
+  GROUP_SUM(G, crossEntropySum, error);
   error *= G->errorScale / Net->ticksPerInterval *
     ((Net->pseudoExampleFreq) ? Net->currentExample->frequency : 1.0);
   G->error += error;
@@ -1061,10 +1481,10 @@ static void crossEntropyError(Group G, GroupProc P) {
 static void crossEntropyErrorBack(Group G, GroupProc P) {
   real scale = ((Net->pseudoExampleFreq) ? Net->currentExample->frequency :
 		1.0) * G->errorScale, output, target;
-  FOR_EACH_UNIT(G, {
-    if (!isNaN(U->target)) {
-      output = U->output; target = U->adjustedTarget;
-      U->outputDeriv += scale * CROSS_ENTROPY_DERIV(output, target);
+  FOR_EACH_UNIT2(G, {
+    if (!isNaN(G->target[u])) {
+      output = G->output[u]; target = G->adjustedTarget[u];
+      G->outputDeriv[u] += scale * CROSS_ENTROPY_DERIV(output, target);
     }
   });
 }
@@ -1076,27 +1496,11 @@ static void crossEntropyErrorInit(Group G, GroupProc P) {
 
 
 static void divergenceError(Group G, GroupProc P) {
-  real output, target, error = 0.0,
+  real error,
     targetRadius = chooseValue(G->targetRadius, Net->targetRadius),
     zeroErrorRadius = chooseValue(G->zeroErrorRadius, Net->zeroErrorRadius);
-  if (targetRadius != 0.0 || zeroErrorRadius != 0.0) {
-    FOR_EACH_UNIT(G, {
-      if (!isNaN(U->target)) {
-	output = U->output; target = U->target;
-	target = U->adjustedTarget =
-	  ADJUSTED_TARGET(output, target, targetRadius, zeroErrorRadius);
-	error += DIVERGENCE_ERROR(output, target);
-      }
-    });
-  } else {
-    FOR_EACH_UNIT(G, {
-      if (!isNaN(U->target)) {
-	output = U->output;
-	target = U->adjustedTarget = U->target;
-	error += DIVERGENCE_ERROR(output, target);
-      }
-    });
-  }
+  adjustTargets(G, targetRadius, zeroErrorRadius);
+  GROUP_SUM(G, divergenceSum, error);
   error *= G->errorScale / Net->ticksPerInterval *
     ((Net->pseudoExampleFreq) ? Net->currentExample->frequency : 1.0);
   G->error += error;
@@ -1106,10 +1510,10 @@ static void divergenceError(Group G, GroupProc P) {
 static void divergenceErrorBack(Group G, GroupProc P) {
   real scale = ((Net->pseudoExampleFreq) ? Net->currentExample->frequency :
 		1.0) * G->errorScale, output, target;
-  FOR_EACH_UNIT(G, {
-    if (!isNaN(U->target)) {
-      output = U->output; target = U->adjustedTarget;
-      U->outputDeriv += scale * DIVERGENCE_DERIV(output, target);
+  FOR_EACH_UNIT2(G, {
+    if (!isNaN(G->target[u])) {
+      output = G->output[u]; target = G->adjustedTarget[u];
+      G->outputDeriv[u] += scale * DIVERGENCE_DERIV(output, target);
     }
   });
 }
@@ -1134,10 +1538,10 @@ static void cosineError(Group G, GroupProc P) {
   CosineData data = (CosineData) P->otherData;
 
   if (targetRadius != 0.0 || zeroErrorRadius != 0.0) {
-    FOR_EACH_UNIT(G, {
-      if (!isNaN(U->target)) {
-	output = U->output;  target = U->target;
-	target = U->adjustedTarget =
+    FOR_EACH_UNIT2(G, {
+      if (!isNaN(G->target[u])) {
+	output = G->output[u];  target = G->target[u];
+	target = G->adjustedTarget[u] =
 	  ADJUSTED_TARGET(output, target, targetRadius, zeroErrorRadius);
         sqoutlen += output * output;
         sqtarlen += target * target;
@@ -1145,10 +1549,10 @@ static void cosineError(Group G, GroupProc P) {
       }
     });
   } else {
-    FOR_EACH_UNIT(G, {
-      if (!isNaN(U->target)) {
-	output = U->output;
-	target = U->adjustedTarget = U->target;
+    FOR_EACH_UNIT2(G, {
+      if (!isNaN(G->target[u])) {
+	output = G->output[u];
+	target = G->adjustedTarget[u] = G->target[u];
         sqoutlen += output * output;
         sqtarlen += target * target;
         dotprod  += output * target;
@@ -1173,9 +1577,9 @@ static void cosineErrorBack(Group G, GroupProc P) {
   real cosine = data->cosine, invdotprod = data->invdotprod,
     invsqoutlen = data->invsqoutlen;
   if (cosine == 0.0) return;
-  FOR_EACH_UNIT(G, if (!isNaN(U->target)) {
-    U->outputDeriv += cosine * (U->output * invsqoutlen -
-				U->adjustedTarget * invdotprod);
+  FOR_EACH_UNIT2(G, if (!isNaN(G->target[u])) {
+    G->outputDeriv[u] += cosine * (G->output[u] * invsqoutlen -
+				G->adjustedTarget[u] * invdotprod);
   });
 }
 
@@ -1196,7 +1600,7 @@ static void copyTargets(Group G, GroupProc P) {
   source = D->source;
   offset = D->offset;
   FOR_EACH_UNIT2(G, {
-    U->target = *((real *)((char *)(source->unit + u) + offset));
+    G->target[u] = GROUP_FIELD(source, offset)[u];
   });
 }
 
@@ -1209,12 +1613,13 @@ static void copyTargetsInit(Group G, GroupProc P) {
 static void linearCost(Group G, GroupProc P) {
   real cost = 0.0, min = G->minOutput, max = G->maxOutput;
   if (isNaN(min) || isNaN(max)) {
-    FOR_EACH_UNIT(G, cost += ABS(U->output));
+    FOR_EACH_UNIT2(G, cost += ABS(G->output[u]));
   } else {
     real p = chooseValue(G->outputCostPeak, Net->outputCostPeak),
       invP = 1.0 / (p - min), inv1mP = 1.0 / (max - p);
-    FOR_EACH_UNIT(G, cost += (U->output <= p) ? (U->output - min) * invP :
-		  (max - U->output) * inv1mP);
+    FOR_EACH_UNIT2(G, cost += (G->output[u] <= p) ?
+		   (G->output[u] - min) * invP :
+		   (max - G->output[u]) * inv1mP);
   }
   cost *= G->outputCostScale / Net->ticksPerInterval;
   G->outputCost += cost;
@@ -1225,15 +1630,15 @@ static void linearCostBack(Group G, GroupProc P) {
   real strength = Net->outputCostStrength * G->outputCostScale /
     Net->ticksPerInterval, min = G->minOutput, max = G->maxOutput;
   if (isNaN(min) || isNaN(max)) {
-    FOR_EACH_UNIT(G, U->outputDeriv += (U->output > 0) ? strength :
-		  (U->output < 0) ? -strength : 0.0);
+    FOR_EACH_UNIT2(G, G->outputDeriv[u] += (G->output[u] > 0) ? strength :
+		  (G->output[u] < 0) ? -strength : 0.0);
   } else {
     real p = chooseValue(G->outputCostPeak, Net->outputCostPeak),
       leftDeriv = strength / (p - min),
       rightDeriv = strength / (p - max);
-    FOR_EACH_UNIT(G, {
-      U->outputDeriv += (U->output < p) ? leftDeriv :
-	(U->output > p) ? rightDeriv : 0.0;
+    FOR_EACH_UNIT2(G, {
+      G->outputDeriv[u] += (G->output[u] < p) ? leftDeriv :
+	(G->output[u] > p) ? rightDeriv : 0.0;
     });
   }
 }
@@ -1247,13 +1652,13 @@ static void linearCostInit(Group G, GroupProc P) {
 static void quadraticCost(Group G, GroupProc P) {
   real cost = 0.0, min = G->minOutput, max = G->maxOutput;
   if (isNaN(min) || isNaN(max)) {
-    FOR_EACH_UNIT(G, cost += SQUARE(U->output));
+    FOR_EACH_UNIT2(G, cost += SQUARE(G->output[u]));
   } else {
     real p = chooseValue(G->outputCostPeak, Net->outputCostPeak),
       invP = 1.0 / (p - min), inv1mP = 1.0 / (max - p), v;
-    FOR_EACH_UNIT(G, {
-      v = (U->output <= p) ? ((U->output - min) * invP) :
-	(max - U->output) * inv1mP;
+    FOR_EACH_UNIT2(G, {
+      v = (G->output[u] <= p) ? ((G->output[u] - min) * invP) :
+	(max - G->output[u]) * inv1mP;
       cost += SQUARE(v);
     });
   }
@@ -1266,14 +1671,15 @@ static void quadraticCostBack(Group G, GroupProc P) {
   real strength = Net->outputCostStrength * G->outputCostScale * 2.0 /
     Net->ticksPerInterval, min = G->minOutput, max = G->maxOutput;
   if (isNaN(min) || isNaN(max)) {
-    FOR_EACH_UNIT(G, U->outputDeriv += strength * U->output);
+    FOR_EACH_UNIT2(G, G->outputDeriv[u] += strength * G->output[u]);
   } else {
     real p = chooseValue(G->outputCostPeak, Net->outputCostPeak),
       leftScale = strength / SQUARE(p - min),
       rightScale = -strength / SQUARE(max - p);
-    FOR_EACH_UNIT(G, {
-      U->outputDeriv += (U->output < p) ? leftScale * (U->output - min) :
-	(U->output > p) ? rightScale * (max - U->output) : 0.0;
+    FOR_EACH_UNIT2(G, {
+      G->outputDeriv[u] += (G->output[u] < p) ?
+	leftScale * (G->output[u] - min) :
+	(G->output[u] > p) ? rightScale * (max - G->output[u]) : 0.0;
     });
   }
 }
@@ -1290,7 +1696,8 @@ static void convexQuadraticCost(Group G, GroupProc P) {
     p = chooseValue(G->outputCostPeak, Net->outputCostPeak),
     min = (p < 0.5) ? p * 2 - 1 : 0.0,
     scale = 1.0 / (p * p - min);
-  FOR_EACH_UNIT(G, cost += (U->output * (p * 2 - U->output) - min) * scale);
+  FOR_EACH_UNIT2(G, cost += (G->output[u] * (p * 2 - G->output[u]) - min) *
+		 scale);
   cost *= G->outputCostScale / Net->ticksPerInterval;
   G->outputCost += cost;
   Net->outputCost += cost;
@@ -1301,7 +1708,7 @@ static void convexQuadraticCostBack(Group G, GroupProc P) {
     min = (p < 0.5) ? 2 * p - 1 : 0.0,
     scale = Net->outputCostStrength * G->outputCostScale * 2.0 /
     (Net->ticksPerInterval * (p * p - min));
-  FOR_EACH_UNIT(G, U->outputDeriv += (p - U->output) * scale);
+  FOR_EACH_UNIT2(G, G->outputDeriv[u] += (p - G->output[u]) * scale);
 }
 
 static void convexQuadraticCostInit(Group G, GroupProc P) {
@@ -1316,8 +1723,8 @@ static void logisticCost(Group G, GroupProc P) {
     p = chooseValue(G->outputCostPeak, Net->outputCostPeak),
     logp = LOG(p), log1mp = LOG(1.0 - p),
     scale = (p <= 0.5) ? (real) 1.0 / logp : (real) 1.0 / log1mp, x;
-  FOR_EACH_UNIT(G, {
-    x = U->output;
+  FOR_EACH_UNIT2(G, {
+    x = G->output[u];
     if (x <= 0.0) cost += -log1mp * scale + 1.0;
     else if (x >= 1.0) cost += -logp * scale + 1.0;
     else cost += (x*(LOG(x)-logp) + (1-x)*(LOG(1-x)-log1mp)) * scale + 1.0;
@@ -1333,11 +1740,11 @@ static void logisticCostBack(Group G, GroupProc P) {
     p = chooseValue(G->outputCostPeak, Net->outputCostPeak),
     logp = LOG(p), log1mp = LOG(1.0-p),
     scale = (p <= 0.5) ? strength / logp : strength / log1mp, x;
-  FOR_EACH_UNIT(G, {
-    x = U->output;
+  FOR_EACH_UNIT2(G, {
+    x = G->output[u];
     if (x < 1e-6) x = 1e-6;
     else if (x > (1.0 - 1e-6)) x = 1.0 - 1e-6;
-    U->outputDeriv += (LOG(x) - logp - LOG(1-x) + log1mp) * scale;
+    G->outputDeriv[u] += (LOG(x) - logp - LOG(1-x) + log1mp) * scale;
   });
 }
 
@@ -1353,9 +1760,9 @@ static void cosineCost(Group G, GroupProc P) {
     p = chooseValue(G->outputCostPeak, Net->outputCostPeak),
     invp = 1.0 / p,
     inv1mp = 1.0 / (1.0 - p);
-  FOR_EACH_UNIT(G, {
-    cost += (U->output <= p) ? (1 - cos(PI * invp * U->output)) :
-      (1 - cos(PI * inv1mp * (U->output - 2 * p + 1)));
+  FOR_EACH_UNIT2(G, {
+    cost += (G->output[u] <= p) ? (1 - cos(PI * invp * G->output[u])) :
+      (1 - cos(PI * inv1mp * (G->output[u] - 2 * p + 1)));
   });
   cost *= G->outputCostScale / Net->ticksPerInterval;
   G->outputCost += cost;
@@ -1368,10 +1775,10 @@ static void cosineCostBack(Group G, GroupProc P) {
     p = chooseValue(G->outputCostPeak, Net->outputCostPeak),
     invp = 1.0 / p,
     inv1mp = 1.0 / (1.0 - p);
-  FOR_EACH_UNIT(G, {
-    U->outputDeriv += (U->output <= p) ?
-      strength * invp * sin(PI * invp * U->output) :
-      strength * inv1mp * sin(PI * inv1mp * (U->output - 2 * p + 1));
+  FOR_EACH_UNIT2(G, {
+    G->outputDeriv[u] += (G->output[u] <= p) ?
+      strength * invp * sin(PI * invp * G->output[u]) :
+      strength * inv1mp * sin(PI * inv1mp * (G->output[u] - 2 * p + 1));
   });
 }
 
@@ -1390,7 +1797,7 @@ static void deltaCost(Group G, GroupProc P) {
     return;
   FOR_EACH_UNIT2(G, {
     lastOutput[u] = thisOutput[u];
-    thisOutput[u] = U->output;
+    thisOutput[u] = G->output[u];
     delta = thisOutput[u] - lastOutput[u];
     cost += delta * delta;
   });
@@ -1404,12 +1811,12 @@ static void deltaCostBack(Group G, GroupProc P) {
     strength;
   if (G->type & RESET_ON_EXAMPLE &&
       GET_HISTORY(Net, resetHistory, HISTORY_INDEX(Net->currentTick))) {
-    FOR_EACH_UNIT2(G, lastOutput[u] = U->output);
+    FOR_EACH_UNIT2(G, lastOutput[u] = G->output[u]);
   } else {
     strength = Net->outputCostStrength * G->outputCostScale * 2.0 /
       Net->ticksPerInterval;
     FOR_EACH_UNIT2(G, {
-      U->outputDeriv += strength * (thisOutput[u] - lastOutput[u]);
+      G->outputDeriv[u] += strength * (thisOutput[u] - lastOutput[u]);
     });
   }
 }
@@ -1425,8 +1832,8 @@ static void deltaCostInit(Group G, GroupProc P) {
 /* Each unit's output must be within the criterion of its target.
    TRUE if all targets are NaN. */
 static flag standardGroupCriterion(Group G, real criterion) {
-  FOR_EACH_UNIT(G, {
-    if (!isNaN(U->target) && (ABS(U->output - U->target) >= criterion))
+  FOR_EACH_UNIT2(G, {
+    if (!isNaN(G->target[u]) && (ABS(G->output[u] - G->target[u]) >= criterion))
       return FALSE;
   });
   return TRUE;
@@ -1444,11 +1851,11 @@ static flag maxGroupCriterion(Group G, real criterion) {
   Unit maxOutUnit = NULL, maxTargUnit = NULL;
   real maxOut = -LARGE_VAL, maxTarg = -LARGE_VAL;
   flag allTargetsNaN = TRUE;
-  FOR_EACH_UNIT(G, {
-    if (isNaN(U->target)) continue;
+  FOR_EACH_UNIT2(G, {
+    if (isNaN(G->target[u])) continue;
     allTargetsNaN = FALSE;
-    if (U->output > maxOut)  {maxOut  = U->output; maxOutUnit  = U;}
-    if (U->target > maxTarg) {maxTarg = U->target; maxTargUnit = U;}
+    if (G->output[u] > maxOut)  {maxOut  = G->output[u]; maxOutUnit  = U;}
+    if (G->target[u] > maxTarg) {maxTarg = G->target[u]; maxTargUnit = U;}
   });
   if (allTargetsNaN || (maxOutUnit == maxTargUnit &&
 			ABS(maxOut - maxTarg) < criterion)) return TRUE;
@@ -1479,133 +1886,604 @@ flag groupCriteriaReached(flag training) {
 
 /* This is true if every unit in the group has an externalInput. */
 static flag fullyClamped(Group G) {
-  FOR_EACH_UNIT(G, if (isNaN(U->externalInput)) return FALSE);
+  FOR_EACH_UNIT2(G, if (isNaN(G->externalInput[u])) return FALSE);
   return TRUE;
 }
 
+/* Wide groups are split among the thread pool.  Each task runs the procs on
+   a slice of the group, a copy of the group structure that covers a range of
+   its units.  This only works for procs that touch nothing but the fields of
+   their own units. */
+#define SPLIT_INPUT_TYPES  DOT_PRODUCT
+#define SPLIT_OUTPUT_TYPES (LINEAR | LOGISTIC | TERNARY | TANH | EXPONENTIAL \
+			    | GAUSSIAN | BIAS_CLAMP)
+
+typedef struct groupSplit {
+  Group  group;
+  struct groupPlan *plan;
+  int    numTasks;
+  int   *offset;        /* The start of each group's derivs in a buffer */
+  real  *derivs;        /* The other tasks' shares of the source derivs */
+  int    size;          /* The length of each task's buffer */
+} *GroupSplit;
+
+static real *SplitDerivs = NULL;
+static int   SplitDerivSize = 0;
+static int  *SplitOffset = NULL;
+static int   SplitOffsetSize = 0;
+
+/* This returns the number of tasks that a group's unit loops are split
+   into when the pool is free.  It is 1 unless the group is wider than
+   threadUnits or has more than threadLinks incoming links. */
+static int splitTasks(Group G) {
+  int links = 0;
+  if (Net->numThreads <= 1 || G->numUnits < 2) return 1;
+  if (G->numUnits <= Net->threadUnits) {
+    FOR_EVERY_UNIT(G, links += U->numIncoming);
+    if (links <= Net->threadLinks) return 1;
+  }
+  return imin(Net->numThreads, G->numUnits);
+}
+
+int groupTasks(Group G) {
+  return poolTasks(splitTasks(G));
+}
+
+/* This fills S with the slice of G that holds the units of one task. */
+void sliceGroup(Group G, Group S, int task, int numTasks) {
+  int first = TASK_FIRST(G->numUnits, task, numTasks);
+  *S = *G;
+  S->unit             += first;
+  S->input            += first;
+  S->output           += first;
+  S->target           += first;
+  S->externalInput    += first;
+  S->adjustedTarget   += first;
+  S->inputDeriv       += first;
+  S->outputDeriv      += first;
+  S->outputCache      += first;
+  S->outputDerivCache += first;
+  S->numUnits = TASK_LAST(G->numUnits, task, numTasks) - first;
+  if ((G->type & LESIONED) && LIVE_UNITS(G)) {
+    Unit *L = G->liveUnit, *sL = L + G->numLive;
+    for (; L < sL && *L < S->unit; L++);
+    S->liveUnit = L;
+    for (; L < sL && *L < S->unit + S->numUnits; L++);
+    S->numLive = L - S->liveUnit;
+  }
+}
+
+/******************************* Execution Plans *****************************/
+
+/* A network's plan lists the procs of each group in the order that each
+   pass runs them, with the tests that only depend on the group types worked
+   out in advance.  It is compiled on the first tick after it is freed, which
+   happens when the structure, a group type or the lesions change, or if the
+   links or the thread parameters have changed since.  Compiling also lists
+   the live units of lesioned groups and the live links of their receivers. */
+
+enum planPass {INPUT_FORWARD, INPUT_BACKWARD, OUTPUT_FORWARD, OUTPUT_BACKWARD,
+	       COST_FORWARD, COST_BACKWARD, NUM_PASSES};
+
+static char *PassName[NUM_PASSES] = {"input", "inputBack", "output",
+				     "outputBack", "cost", "costBack"};
+
+#define PLAN_NO_INPUTS    (1 << 0)  /* There are no input procs */
+#define PLAN_NO_COSTS     (1 << 1)  /* There are no cost procs */
+#define PLAN_CLAMPED      (1 << 2)  /* HARD_CLAMP is an output type */
+#define PLAN_ONLY_CLAMPED (1 << 3)  /* HARD_CLAMP is the only output type */
+#define PLAN_CLEAR_INPUT  (1 << 4)  /* The input procs don't set the inputs */
+#define PLAN_CLEAR_OUTPUT (1 << 5)  /* The output procs don't set the outputs */
+#define PLAN_SPLIT_INPUT  (1 << 6)
+#define PLAN_SPLIT_OUTPUT (1 << 7)
+#define PLAN_ERROR        (1 << 8)  /* There is an error type */
+#define PLAN_INPUT_HIST   (1 << 9)
+#define PLAN_OUTPUT_HIST  (1 << 10)
+#define PLAN_TARGET_HIST  (1 << 11)
+#define PLAN_DERIV_HIST   (1 << 12)
+#define PLAN_FUSED        (1 << 13) /* The fused loops can run the group */
+#define NUM_PLAN_FLAGS    14
+
+static char *PlanFlagName[NUM_PLAN_FLAGS] = {"noInputs", "noCosts", "clamped",
+  "onlyClamped", "clearInput", "clearOutput", "splitInput", "splitOutput",
+  "error", "inputHist", "outputHist", "targetHist", "derivHist", "fused"};
+
+typedef struct planCall {
+  void    (*proc)(Group G, GroupProc P);
+  GroupProc P;
+} *PlanCall;
+
+typedef struct groupPlan {
+  Group     group;
+  mask      flags;
+  int       tasks;               /* The split tasks when the pool is free */
+  PlanCall  pass[NUM_PASSES + 1]; /* Each pass ends where the next begins */
+} *GroupPlan;
+
+struct netPlan {
+  int       numGroups;
+  GroupPlan group;
+  PlanCall  call;
+  int       lastSource;          /* The last Elman group or source for one */
+  int       numLinks;
+  int       numThreads;
+  int       threadUnits;
+  int       threadLinks;
+};
+
+void freeNetPlan(Network N) {
+  if (!N || !N->plan) return;
+  FREE(N->plan->group);
+  FREE(N->plan->call);
+  FREE(N->plan);
+}
+
+/* This adds the forward procs of a list to the plan, or the backward ones in
+   reverse order. */
+static PlanCall planProcs(PlanCall C, GroupProc L, flag backward) {
+  GroupProc P;
+  if (!backward) {
+    for (P = L; P; P = P->next)
+      if (P->forwardProc) {C->proc = P->forwardProc; C->P = P; C++;}
+  } else if (L && (P = L->prev)) do {
+    if (P->backwardProc) {C->proc = P->backwardProc; C->P = P; C++;}
+    P = P->prev;
+  } while (P != L->prev);
+  return C;
+}
+
+/* This builds the plan for the current network. */
+NetPlan compileNet(void) {
+  NetPlan L;
+  GroupPlan X;
+  GroupProc P;
+  PlanCall C;
+  int numCalls = 0;
+  flag lesioned = FALSE;
+
+  freeNetPlan(Net);
+  FOR_EACH_GROUP({
+    for (P = G->inputProcs;  P; P = P->next) numCalls += 2;
+    for (P = G->outputProcs; P; P = P->next) numCalls += 2;
+    for (P = G->costProcs;   P; P = P->next) numCalls += 2;
+  });
+  L = Net->plan = (NetPlan) safeCalloc(1, sizeof(struct netPlan),
+				       "compileNet:L");
+  L->numGroups = Net->numGroups;
+  L->group = (GroupPlan) safeCalloc(Net->numGroups, sizeof(struct groupPlan),
+				    "compileNet:L->group");
+  C = L->call = (PlanCall) safeCalloc(numCalls, sizeof(struct planCall),
+				      "compileNet:L->call");
+  L->lastSource  = -1;
+  L->numLinks    = Net->numLinks;
+  L->numThreads  = Net->numThreads;
+  L->threadUnits = Net->threadUnits;
+  L->threadLinks = Net->threadLinks;
+
+  FOR_EACH_GROUP({
+    if (G->type & LESIONED) {
+      lesioned = TRUE;
+      if (!LIVE_UNITS(G)) buildLiveUnits(G);
+    }
+  });
+  FOR_EACH_GROUP({
+    X = L->group + g;
+    if (lesioned && G->inputType & DOT_PRODUCT) buildLiveIndex(G);
+    X->group = G;
+    if (!G->inputProcs) X->flags |= PLAN_NO_INPUTS;
+    if (!G->costProcs)  X->flags |= PLAN_NO_COSTS;
+    if (G->outputType & HARD_CLAMP) X->flags |= PLAN_CLAMPED;
+    if (G->outputType == HARD_CLAMP) X->flags |= PLAN_ONLY_CLAMPED;
+    if (!(G->inputType & BASIC_INPUT_TYPES)) X->flags |= PLAN_CLEAR_INPUT;
+    if (!(G->outputType & (BASIC_OUTPUT_TYPES | BIAS_CLAMP)))
+      X->flags |= PLAN_CLEAR_OUTPUT;
+    if ((X->tasks = splitTasks(G)) > 1) {
+      if (G->inputProcs && !(G->inputType & ~SPLIT_INPUT_TYPES))
+	X->flags |= PLAN_SPLIT_INPUT;
+      if (!(G->outputType & ~SPLIT_OUTPUT_TYPES)) X->flags |= PLAN_SPLIT_OUTPUT;
+    }
+    if (G->costType & ERROR_MASKS)      X->flags |= PLAN_ERROR;
+    if (G->type & USE_INPUT_HIST)     X->flags |= PLAN_INPUT_HIST;
+    if (G->type & USE_OUTPUT_HIST)    X->flags |= PLAN_OUTPUT_HIST;
+    if (G->type & USE_TARGET_HIST)    X->flags |= PLAN_TARGET_HIST;
+    if (G->type & USE_OUT_DERIV_HIST) X->flags |= PLAN_DERIV_HIST;
+    if (G->inputType == DOT_PRODUCT && !G->inputProcs->next &&
+	(G->outputType == LOGISTIC || G->outputType == TANH) &&
+	!G->outputProcs->next && !(G->type & ADAPTIVE_GAIN) &&
+	(!G->costProcs || (!G->costProcs->next &&
+			   (G->costType == CROSS_ENTROPY ||
+			    G->costType == SUM_SQUARED))) && X->tasks == 1)
+      X->flags |= PLAN_FUSED;
+
+    X->pass[INPUT_FORWARD]   = C; C = planProcs(C, G->inputProcs,  FALSE);
+    X->pass[INPUT_BACKWARD]  = C; C = planProcs(C, G->inputProcs,  TRUE);
+    X->pass[OUTPUT_FORWARD]  = C; C = planProcs(C, G->outputProcs, FALSE);
+    X->pass[OUTPUT_BACKWARD] = C; C = planProcs(C, G->outputProcs, TRUE);
+    X->pass[COST_FORWARD]    = C; C = planProcs(C, G->costProcs,   FALSE);
+    X->pass[COST_BACKWARD]   = C; C = planProcs(C, G->costProcs,   TRUE);
+    X->pass[NUM_PASSES]      = C;
+
+    /* Backprop through time only needs to go back as far as this. */
+    if (G->type & ELMAN) {
+      if (g > L->lastSource) L->lastSource = g;
+      for (P = G->outputProcs; P; P = P->next)
+	if (P->type == ELMAN_CLAMP && ((Group) P->otherData) &&
+	    ((Group) P->otherData)->num > L->lastSource)
+	  L->lastSource = ((Group) P->otherData)->num;
+    }
+  });
+  return L;
+}
+
+/* This returns the current network's plan, compiling it if it is missing or
+   out of date. */
+static NetPlan netPlan(void) {
+  NetPlan L = Net->plan;
+  if (!L || L->numGroups != Net->numGroups || L->numLinks != Net->numLinks ||
+      L->numThreads != Net->numThreads || L->threadUnits != Net->threadUnits ||
+      L->threadLinks != Net->threadLinks)
+    L = compileNet();
+  return L;
+}
+
+static GroupPlan groupPlan(Group G) {
+  NetPlan L = netPlan();
+  if (L->group[G->num].group != G) L = compileNet();
+  return L->group + G->num;
+}
+
+static void runPass(Group G, GroupPlan X, int pass) {
+  PlanCall C, end = X->pass[pass + 1];
+  for (C = X->pass[pass]; C < end; C++) C->proc(G, C->P);
+}
+
+/* This appends a description of the current network's plan to the
+   result. */
+void appendNetPlan(void) {
+  NetPlan L = compileNet();
+  GroupPlan X;
+  PlanCall C;
+  int i;
+  append("lastSource %d\n", L->lastSource);
+  FOR_EACH_GROUP({
+    X = L->group + g;
+    append("%s: %d task%s", G->name, X->tasks, (X->tasks == 1) ? "" : "s");
+    for (i = 0; i < NUM_PLAN_FLAGS; i++)
+      if (X->flags & (1 << i)) append(" %s", PlanFlagName[i]);
+    append("\n");
+    for (i = 0; i < NUM_PASSES; i++) {
+      if (X->pass[i] == X->pass[i + 1]) continue;
+      append("  %-10s", PassName[i]);
+      for (C = X->pass[i]; C < X->pass[i + 1]; C++)
+	append(" %s", lookupTypeName(C->P->type, C->P->class));
+      append("\n");
+    }
+  });
+}
+
+static void splitInputTask(void *data, int task) {
+  GroupSplit X = (GroupSplit) data;
+  struct group slice;
+  sliceGroup(X->group, &slice, task, X->numTasks);
+  runPass(&slice, X->plan, INPUT_FORWARD);
+}
+
+static void splitOutputTask(void *data, int task) {
+  GroupSplit X = (GroupSplit) data;
+  struct group slice;
+  sliceGroup(X->group, &slice, task, X->numTasks);
+  runPass(&slice, X->plan, OUTPUT_FORWARD);
+}
+
+/* Task 0 adds straight into the sending groups' outputDeriv caches.  The
+   others add into their own buffers, which are summed into the caches
+   afterwards in task order.  The link derivs belong to the receiving units,
+   so they never collide. */
+static void splitInputBackTask(void *data, int task) {
+  GroupSplit X = (GroupSplit) data;
+  struct group slice;
+  Group G = &slice, F;
+  real *D;
+  sliceGroup(X->group, &slice, task, X->numTasks);
+  if (task == 0) {
+    dotProductInputBack(G, NULL);
+    return;
+  }
+  D = X->derivs + (task - 1) * X->size;
+  FOR_EACH_UNIT2(G, {
+    real inputDeriv = G->inputDeriv[u];
+    FOR_EACH_LIVE_BLOCK(G, U, {
+      F = B->unit->group;
+      dotLinksBack(inputDeriv, U->weight + l, U->deriv + l, B->output,
+		   D + X->offset[F->num] + (B->output - F->outputCache),
+		   B->numUnits);
+    });
+  });
+}
+
+static void splitInputBack(Group G, int numTasks) {
+  struct groupSplit X;
+  real *D;
+  int t, i, n = 0;
+  if (SplitOffsetSize < Net->numGroups) {
+    SplitOffsetSize = Net->numGroups;
+    SplitOffset = (int *) safeRealloc(SplitOffset, SplitOffsetSize *
+				      sizeof(int), "splitInputBack");
+  }
+  FOR_EACH_GROUP({SplitOffset[g] = n; n += G->numUnits;});
+  if (SplitDerivSize < (numTasks - 1) * n) {
+    SplitDerivSize = (numTasks - 1) * n;
+    SplitDerivs = (real *) safeRealloc(SplitDerivs, SplitDerivSize *
+				       sizeof(real), "splitInputBack");
+  }
+  memset(SplitDerivs, 0, (numTasks - 1) * n * sizeof(real));
+
+  X.group    = G;
+  X.plan     = NULL;
+  X.numTasks = numTasks;
+  X.offset   = SplitOffset;
+  X.derivs   = SplitDerivs;
+  X.size     = n;
+  poolRun(numTasks, splitInputBackTask, &X);
+
+  for (t = 1; t < numTasks; t++)
+    FOR_EACH_GROUP({
+      D = SplitDerivs + (t - 1) * n + SplitOffset[g];
+      for (i = 0; i < G->numUnits; i++) G->outputDerivCache[i] += D[i];
+    });
+}
+
+/******************************** Fused Groups *******************************/
+
+/* Groups with just a DOT_PRODUCT input, a LOGISTIC or TANH output without
+   adaptive gain, and a CROSS_ENTROPY, SUM_SQUARED, or no error run through
+   these loops instead of their procs.  They go through the units a chunk at
+   a time, doing all that the procs would do to each unit while it is still
+   in the cache, with the same arithmetic so the results don't change.
+   Lesioned groups still use the procs. */
+#define FUSED_CHUNK 64
+
+#define FUSED(G, X) ((X)->flags & PLAN_FUSED && !((G)->type & LESIONED))
+
+/* This does the work of computeInput, if input is true, computeOutput, and
+   computeCost. */
+static void fusedForward(Group G, GroupPlan X, flag input, flag alwaysStore,
+			 flag storeCost) {
+  int first, last, u, active = (input) ? sparseInputs(G, NULL) : -1;
+  flag cost = (G->costProcs && !Net->inGracePeriod);
+  real gain = chooseValue(G->gain, Net->gain), error = 0.0, output, target,
+    targetRadius = chooseValue(G->targetRadius, Net->targetRadius),
+    zeroErrorRadius = chooseValue(G->zeroErrorRadius, Net->zeroErrorRadius);
+  flag adjust = (targetRadius != 0.0 || zeroErrorRadius != 0.0);
+  Unit U;
+
+  if (active >= 0) sparseDotProduct(G, active, NULL, G->input);
+  for (first = 0; first < G->numUnits; first = last) {
+    last = imin(first + FUSED_CHUNK, G->numUnits);
+    if (input && active < 0)
+      for (u = first, U = G->unit + u; u < last; u++, U++) {
+	real in = 0.0;
+	FOR_EACH_LIVE_BLOCK(G, U, in = dotLinks(in, U->weight + l, B->output,
+						B->numUnits));
+	G->input[u] = in;
+      }
+    if (G->outputType == LOGISTIC)
+      sigmoidValues(G->output + first, G->input + first, gain, last - first);
+    else tanhValues(G->output + first, G->input + first, gain, last - first);
+    for (u = first; u < last; u++) {
+      G->outputCache[u] = output = G->output[u];
+      if (!cost) continue;
+      target = G->target[u];
+      /* As in adjustTargets and squaredError. */
+      if (G->costType == CROSS_ENTROPY) {
+	if (!isNaN(target) && adjust) target =
+	  ADJUSTED_TARGET(output, target, targetRadius, zeroErrorRadius);
+	G->adjustedTarget[u] = target;
+      } else if (!isNaN(target)) {
+	if (adjust) target =
+	  ADJUSTED_TARGET(output, target, targetRadius, zeroErrorRadius);
+	G->adjustedTarget[u] = target;
+	error += SQUARE(output - target);
+      }
+    }
+  }
+
+  if (input && (UnitUp || alwaysStore || X->flags & PLAN_INPUT_HIST))
+    storeInputs(G, Net->currentTick);
+  if (UnitUp || alwaysStore || X->flags & PLAN_OUTPUT_HIST)
+    storeOutputs(G, Net->currentTick);
+  if (cost) {
+    if (G->costType == CROSS_ENTROPY)
+      error = crossEntropySum(G->output, G->adjustedTarget, G->numUnits);
+    error *= G->errorScale / Net->ticksPerInterval *
+      ((Net->pseudoExampleFreq) ? Net->currentExample->frequency : 1.0);
+    G->error += error;
+    Net->error += error;
+  }
+  if ((UnitUp || storeCost || X->flags & PLAN_TARGET_HIST) &&
+      X->flags & PLAN_ERROR) {
+    if (Net->inGracePeriod)
+      FOR_EACH_UNIT(G, SET_UNIT_HISTORY(U, targetHistory,
+					HISTORY_INDEX(Net->currentTick), NaN))
+    else storeTargets(G, Net->currentTick);
+  }
+}
+
+/* This does the work of computeCostBack after the forward pass. */
+static void fusedCostBack(Group G) {
+  real freq = (Net->pseudoExampleFreq) ? Net->currentExample->frequency : 1.0,
+    output, target, deriv;
+  real scale = freq * G->errorScale, squaredScale = freq * G->errorScale * 2.0;
+  flag cost = (G->costProcs && !Net->inGracePeriod);
+  int u;
+  for (u = 0; u < G->numUnits; u++) {
+    deriv = 0.0;
+    if (cost && !isNaN(G->target[u])) {
+      output = G->output[u]; target = G->adjustedTarget[u];
+      if (G->costType == CROSS_ENTROPY)
+	deriv += scale * CROSS_ENTROPY_DERIV(output, target);
+      else deriv += squaredScale * (output - target);
+    }
+    G->outputDeriv[u] = deriv;
+  }
+}
+
+/* This does the work of computeOutputBack. */
+static void fusedOutputBack(Group G) {
+  real gain = chooseValue(G->gain, Net->gain), *D = G->outputDerivCache;
+  int u;
+  if (G->outputType == LOGISTIC) {
+    for (u = 0; u < G->numUnits; u++) {
+      G->outputDeriv[u] += D[u];
+      D[u] = 0.0;
+      G->inputDeriv[u] = G->outputDeriv[u] *
+	G->output[u] * (1.0 - G->output[u]) * gain;
+    }
+  } else {
+    for (u = 0; u < G->numUnits; u++) {
+      G->outputDeriv[u] += D[u];
+      D[u] = 0.0;
+      G->inputDeriv[u] = G->outputDeriv[u] * gain * TANH_DERIV(G->input[u]);
+    }
+  }
+}
+
+
 /* This computes the input to each unit. */
 void computeInput(Group G, flag alwaysStore) {
-  GroupProc P;
-  flag clamped = (!G->inputProcs || ((G->outputType & HARD_CLAMP) &&
-				     fullyClamped(G)));
+  GroupPlan X = groupPlan(G);
+  int numTasks;
+  flag clamped = ((X->flags & PLAN_NO_INPUTS) ||
+		  ((X->flags & PLAN_CLAMPED) && fullyClamped(G)));
 
   /* Clear the input if it won't be over-written. */
-  if (clamped || !(G->inputType & BASIC_INPUT_TYPES)) {
-    FOR_EACH_UNIT(G, U->input = 0.0);
+  if (clamped || X->flags & PLAN_CLEAR_INPUT) {
+    FOR_EACH_UNIT2(G, G->input[u] = 0.0);
   }
   if (!clamped) {
-    for (P = G->inputProcs; P; P = P->next)
-      if (P->forwardProc) P->forwardProc(G, P);
+    if (X->flags & PLAN_SPLIT_INPUT && (numTasks = poolTasks(X->tasks)) > 1 &&
+	sparseInputs(G, NULL) < 0) {
+      struct groupSplit S = {G, X, numTasks, NULL, NULL, 0};
+      poolRun(numTasks, splitInputTask, &S);
+    } else runPass(G, X, INPUT_FORWARD);
   }
   /* Record the inputs in the history */
-  if (UnitUp || alwaysStore || G->type & USE_INPUT_HIST)
+  if (UnitUp || alwaysStore || X->flags & PLAN_INPUT_HIST)
     storeInputs(G, Net->currentTick);
 }
 
 /* This takes the units' inputDerivs and increments the sending units'
    outputDerivs. */
 void computeInputBack(Group G) {
-  GroupProc P;
-  if (!G->inputProcs || ((G->outputType & HARD_CLAMP) &&
-			 (G->outputType == HARD_CLAMP || fullyClamped(G))))
+  GroupPlan X = groupPlan(G);
+  int numTasks;
+  if ((X->flags & PLAN_NO_INPUTS) ||
+      ((X->flags & PLAN_CLAMPED) &&
+       ((X->flags & PLAN_ONLY_CLAMPED) || fullyClamped(G))))
     return;
 
-  /* Do the backward procedures in reverse order. */
-  if (G->inputProcs) {
-    if ((P = G->inputProcs->prev)) do {
-      if (P->backwardProc) P->backwardProc(G, P);
-      P = P->prev;
-    } while (P != G->inputProcs->prev);
+  if (X->flags & PLAN_SPLIT_INPUT && (numTasks = poolTasks(X->tasks)) > 1 &&
+      sparseInputs(G, NULL) < 0) {
+    splitInputBack(G, numTasks);
+    return;
   }
+  /* Do the backward procedures in reverse order. */
+  runPass(G, X, INPUT_BACKWARD);
 }
 
 
 /* This computes the output for each unit and caches and stores them. */
 void computeOutput(Group G, flag alwaysStore) {
-  GroupProc P;
+  GroupPlan X = groupPlan(G);
+  int numTasks;
   /* Clear the output if it won't be over-written. */
-  if (!(G->outputType & (BASIC_OUTPUT_TYPES | BIAS_CLAMP)))
-    FOR_EACH_UNIT(G, U->output = 0.0);
+  if (X->flags & PLAN_CLEAR_OUTPUT)
+    FOR_EACH_UNIT2(G, G->output[u] = 0.0);
   /* Do the forward procedures in order. */
-  for (P = G->outputProcs; P; P = P->next)
-    if (P->forwardProc) P->forwardProc(G, P);
+  if (X->flags & PLAN_SPLIT_OUTPUT && (numTasks = poolTasks(X->tasks)) > 1) {
+    struct groupSplit S = {G, X, numTasks, NULL, NULL, 0};
+    poolRun(numTasks, splitOutputTask, &S);
+  } else runPass(G, X, OUTPUT_FORWARD);
   cacheOutputs(G);
   /* Record the outputs in the history and cache. */
-  if (UnitUp || alwaysStore || G->type & USE_OUTPUT_HIST)
+  if (UnitUp || alwaysStore || X->flags & PLAN_OUTPUT_HIST)
     storeOutputs(G, Net->currentTick);
 }
 
 /* This takes the units' cached and regular outputDerivs and computes their
    inputDerivs. */
 void computeOutputBack(Group G) {
-  GroupProc P;
+  GroupPlan X = groupPlan(G);
+  if (FUSED(G, X)) {
+    fusedOutputBack(G);
+    return;
+  }
   injectOutputDerivCache(G);
   resetOutputDerivCache(G);
   /* Do the backward procedures in reverse order. */
-  if (G->outputProcs) {
-    if ((P = G->outputProcs->prev)) do {
-      if (P->backwardProc) P->backwardProc(G, P);
-      P = P->prev;
-    } while (P != G->outputProcs->prev);
-  }
+  runPass(G, X, OUTPUT_BACKWARD);
 }
 
 
 /* This increments the network's error and outputCost. */
 void computeCost(Group G, flag alwaysStore) {
-  GroupProc P;
+  GroupPlan X = groupPlan(G);
+  flag store = ((UnitUp || alwaysStore || X->flags & PLAN_TARGET_HIST) &&
+		X->flags & PLAN_ERROR);
   if (Net->inGracePeriod) {
-    if ((UnitUp || alwaysStore || G->type & USE_TARGET_HIST) &&
-	G->costType & ERROR_MASKS)
-      FOR_EACH_UNIT(G, SET_HISTORY(U, targetHistory,
-				   HISTORY_INDEX(Net->currentTick), NaN));
+    if (store)
+      FOR_EACH_UNIT(G, SET_UNIT_HISTORY(U, targetHistory,
+					HISTORY_INDEX(Net->currentTick), NaN));
   } else {
     /* Do the forward procedures in order. */
-    for (P = G->costProcs; P; P = P->next)
-      if (P->forwardProc) P->forwardProc(G, P);
+    runPass(G, X, COST_FORWARD);
     /* Record the targets in the history. */
-    if ((UnitUp || alwaysStore || G->type & USE_TARGET_HIST) &&
-	G->costType & ERROR_MASKS)
-      storeTargets(G, Net->currentTick);
+    if (store) storeTargets(G, Net->currentTick);
   }
 }
 
 /* This sets and stores the outputDerivs of output units. It overrides any
-   previous values in U->outputDeriv. */
+   previous values in G->outputDeriv. */
 void computeCostBack(Group G, flag alwaysStore) {
-  GroupProc P;
-  FOR_EACH_UNIT(G, U->outputDeriv = 0.0);
+  GroupPlan X = groupPlan(G);
+  if (FUSED(G, X)) fusedCostBack(G);
+  else FOR_EACH_UNIT2(G, G->outputDeriv[u] = 0.0);
   /* Do the backward procedures in reverse order. */
-  if (G->costProcs) {
-    if (!Net->inGracePeriod && (P = G->costProcs->prev)) do {
-      if (P->backwardProc) P->backwardProc(G, P);
-      P = P->prev;
-    } while (P != G->costProcs->prev);
+  if (!(X->flags & PLAN_NO_COSTS)) {
+    if (!Net->inGracePeriod && !FUSED(G, X)) runPass(G, X, COST_BACKWARD);
     /* Only stored if there was an errorProc. */
-    if (UnitUp || alwaysStore || G->type & USE_OUT_DERIV_HIST)
+    if (UnitUp || alwaysStore || X->flags & PLAN_DERIV_HIST)
       storeOutputDerivs(G, Net->currentTick);
   }
 }
 
 
+/* This computes the group's inputs, unless input is false, then its outputs
+   and its error, as computeInput, computeOutput, and computeCost would. */
+void computeForward(Group G, flag input, flag alwaysStore, flag storeCost) {
+  GroupPlan X = groupPlan(G);
+  if (FUSED(G, X)) {
+    fusedForward(G, X, input, alwaysStore, storeCost);
+    return;
+  }
+  if (input) computeInput(G, alwaysStore);
+  computeOutput(G, alwaysStore);
+  computeCost(G, storeCost);
+}
+
+
 /**************** Standard (Non-continuous) Network Procedures ***************/
 
 flag netForward(Event V) {
-  FOR_EACH_GROUP({
-    computeInput(G,  FALSE);
-    computeOutput(G, FALSE);
-    computeCost(G,   FALSE);
-  });
+  FOR_EACH_GROUP(computeForward(G, TRUE, FALSE, FALSE));
   return TCL_OK;
 }
 
 flag netForwardBackward(Event V) {
-  int i, lastSource = -1;
+  int i, lastSource;
 
   FOR_EACH_GROUP({
-    computeInput(G,  Net->backpropTicks > 1);
-    computeOutput(G, Net->backpropTicks > 1);
-    computeCost(G,   FALSE);
+    computeForward(G, TRUE, Net->backpropTicks > 1, FALSE);
     resetBackwardIntegrators(G);
     computeCostBack(G, FALSE);
     resetOutputDerivCache(G);
@@ -1618,17 +2496,9 @@ flag netForwardBackward(Event V) {
      Elman layer or a source for one.  This is used to avoid unnecessary
      work. */
   if (Net->backpropTicks > 1) {
-    GroupProc P;
     flag wasReset;
-    /* Find the last group that we need to consider. */
-    FOR_EACH_GROUP({
-      if (G->type & ELMAN) {
-	if (g > lastSource) lastSource = g;
-	for (P = G->outputProcs; P; P = P->next)
-	  if (P->type == ELMAN_CLAMP && ((Group) P->otherData) &&
-	      ((Group) P->otherData)->num > lastSource)
-	    lastSource = ((Group) P->otherData)->num;
-      }});
+    /* The plan knows the last group that we need to consider. */
+    lastSource = netPlan()->lastSource;
 
     for (i = 1; i < Net->backpropTicks; i++) {
       wasReset = GET_HISTORY(Net,resetHistory,HISTORY_INDEX(Net->currentTick));
@@ -1644,7 +2514,7 @@ flag netForwardBackward(Event V) {
       });
       /* Backpropagate. */
       FOR_EACH_GROUP_IN_RANGE_BACK(lastSource, 0, {
-	FOR_EACH_UNIT(G, U->outputDeriv = 0.0);
+	FOR_EACH_UNIT2(G, G->outputDeriv[u] = 0.0);
 	BACKPROP(G);
       });
     }
@@ -1659,15 +2529,263 @@ flag netForwardBackward(Event V) {
 }
 
 
+/******************** Checkpointed Backprop Through Time *********************/
+
+/* If checkpointTicks is K, the histories only hold K + 1 ticks.  Starting
+   with the first tick that runs the tick proc, the training tick saves the
+   state of the network every K ticks, along with the history of the tick
+   before.  When the backward pass reaches a stretch of K ticks that are no
+   longer in the histories, it reruns them from their checkpoint. */
+struct checkpoints {
+  int        ticks;            /* The ticks between checkpoints */
+  int        first;            /* The first tick that runs the tick proc */
+  int        size;             /* The values in one checkpoint */
+  int        maxSaved;
+  int        numSaved;
+  real      *data;             /* The last one holds the backward state */
+  RandState *rand;
+  flag      *grace;            /* Whether each tick was in a grace period */
+  real      *groupError;       /* The error and outputCost of each group */
+};
+
+void freeCheckpoints(Network N) {
+  if (!N || !N->checkpoints) return;
+  FREE(N->checkpoints->data);
+  FREE(N->checkpoints->rand);
+  FREE(N->checkpoints->grace);
+  FREE(N->checkpoints->groupError);
+  FREE(N->checkpoints);
+}
+
+static void copyReals(real *buf, int *n, real *x, int len, flag save) {
+  if (buf) {
+    if (save) memcpy(buf + *n, x, len * sizeof(real));
+    else memcpy(x, buf + *n, len * sizeof(real));
+  }
+  *n += len;
+}
+
+/* The unitData of the integrators and the delta cost carry over from one
+   tick to the next. */
+static void copyProcState(Group G, GroupProc L, real *buf, int *n,
+			  flag save) {
+  GroupProc P;
+  for (P = L; P; P = P->next)
+    if (P->unitData)
+      copyReals(buf, n, P->unitData, (P->type == DELTA_COST) ?
+		2 * G->numUnits : G->numUnits, save);
+}
+
+static void copyProcHistory(Group G, GroupProc L, int row, real *buf, int *n,
+			    flag save) {
+  GroupProc P;
+  for (P = L; P; P = P->next) {
+    if (P->unitHistoryData)
+      copyReals(buf, n, P->unitHistoryData[row], G->numUnits, save);
+    if (P->groupHistoryData)
+      copyReals(buf, n, P->groupHistoryData + row, 1, save);
+  }
+}
+
+/* This copies the unit values of each group, which are one block, and the
+   procedure data to or from buf.  It returns the number of values. */
+static int copyNetState(real *buf, flag save) {
+  int n = 0;
+  FOR_EACH_GROUP({
+    copyReals(buf, &n, G->input,
+	      G->outputDerivCache + G->numUnits - G->input, save);
+    copyProcState(G, G->inputProcs, buf, &n, save);
+    copyProcState(G, G->outputProcs, buf, &n, save);
+    copyProcState(G, G->costProcs, buf, &n, save);
+  });
+  return n;
+}
+
+/* This copies the histories of one tick to or from buf. */
+static int copyHistoryRow(real *buf, int tick, flag save) {
+  int n = 0, row = HISTORY_INDEX(tick), nU;
+  FOR_EACH_GROUP({
+    nU = G->numUnits;
+    if (G->inputHistory)
+      copyReals(buf, &n, G->inputHistory + row * nU, nU, save);
+    if (G->outputHistory)
+      copyReals(buf, &n, G->outputHistory + row * nU, nU, save);
+    if (G->targetHistory)
+      copyReals(buf, &n, G->targetHistory + row * nU, nU, save);
+    if (G->outputDerivHistory)
+      copyReals(buf, &n, G->outputDerivHistory + row * nU, nU, save);
+    copyProcHistory(G, G->inputProcs, row, buf, &n, save);
+    copyProcHistory(G, G->outputProcs, row, buf, &n, save);
+    copyProcHistory(G, G->costProcs, row, buf, &n, save);
+  });
+  return n;
+}
+
+int checkpointStateSize(void) {
+  return copyNetState(NULL, TRUE);
+}
+
+static int procHistorySize(Group G, GroupProc L) {
+  int n = 0;
+  GroupProc P;
+  for (P = L; P; P = P->next) {
+    if (P->unitHistoryData) n += G->numUnits;
+    if (P->groupHistoryData) n++;
+  }
+  return n;
+}
+
+/* The history values of one tick, with the group histories counted as
+   buildGroupHistories would allocate them. */
+int checkpointRowSize(void) {
+  int n = 0;
+  FOR_EACH_GROUP({
+    n += 2 * G->numUnits;
+    if (G->costType & ERROR_MASKS || G->type & USE_TARGET_HIST)
+      n += G->numUnits;
+    if (G->costType || G->type & USE_OUT_DERIV_HIST) n += G->numUnits;
+    n += procHistorySize(G, G->inputProcs) + procHistorySize(G, G->outputProcs)
+      + procHistorySize(G, G->costProcs);
+  });
+  return n;
+}
+
+/* This is done on the first tick of each example.  There are no checkpoints
+   if the histories can hold the whole example. */
+static void startCheckpoints(void) {
+  Checkpoints C = Net->checkpoints;
+  int K = Net->checkpointTicks, first = (Net->type & CONTINUOUS) ? 1 : 0,
+    maxSaved = (Net->maxTicks - first + K - 1) / K,
+    size = copyNetState(NULL, TRUE) + copyHistoryRow(NULL, 0, TRUE);
+
+  if (Net->historyLength <= K || Net->maxTicks - first <= K) {
+    freeCheckpoints(Net);
+    return;
+  }
+  if (!C || C->ticks != K || C->maxSaved != maxSaved || C->size != size) {
+    freeCheckpoints(Net);
+    C = Net->checkpoints = (Checkpoints)
+      safeCalloc(1, sizeof(struct checkpoints), "startCheckpoints:C");
+    C->ticks    = K;
+    C->first    = first;
+    C->size     = size;
+    C->maxSaved = maxSaved;
+    C->data  = realArray((maxSaved + 1) * size, "startCheckpoints:C->data");
+    C->rand  = (RandState *) safeMalloc(maxSaved * sizeof(RandState),
+					"startCheckpoints:C->rand");
+    C->grace = (flag *) intArray(Net->maxTicks, "startCheckpoints:C->grace");
+    C->groupError = realArray(2 * Net->numGroups,
+			      "startCheckpoints:C->groupError");
+  }
+  C->numSaved = 0;
+}
+
+/* This is called by the training tick procs before running the tick. */
+static void saveCheckpoint(void) {
+  Checkpoints C;
+  real *buf;
+  int tick = Net->currentTick;
+
+  if (tick == ((Net->type & CONTINUOUS) ? 1 : 0)) startCheckpoints();
+  if (!(C = Net->checkpoints)) return;
+  C->grace[tick] = Net->inGracePeriod;
+  if ((tick - C->first) % C->ticks || C->numSaved >= C->maxSaved) return;
+
+  buf = C->data + C->numSaved * C->size;
+  buf += copyNetState(buf, TRUE);
+  if (tick > 0) copyHistoryRow(buf, tick - 1, TRUE);
+  saveRandState(C->rand + C->numSaved++);
+}
+
+/* The checkpoints are only used if they were all saved on this example. */
+static Checkpoints exampleCheckpoints(void) {
+  Checkpoints C = Net->checkpoints;
+  if (Net->checkpointTicks <= 0 || !C || Net->ticksOnExample <= C->first ||
+      C->numSaved != (Net->ticksOnExample - 1 - C->first) / C->ticks + 1)
+    return NULL;
+  return C;
+}
+
+/* This reruns the ticks from checkpoint s to the next one, so they are back
+   in the histories.  The state of the backward pass is left as it was.  The
+   events are reloaded, but the tick procs are not run again. */
+static flag rerunTicks(Checkpoints C, Example E, int s,
+		       void (*forward)(void)) {
+  int t, start = C->first + s * C->ticks,
+    stop = imin(start + C->ticks, Net->ticksOnExample),
+    currentTick = Net->currentTick;
+  real error = Net->error, outputCost = Net->outputCost,
+    *live = C->data + C->maxSaved * C->size, *buf = C->data + s * C->size;
+  flag inGracePeriod = Net->inGracePeriod, value = TCL_OK;
+  RandState R;
+
+  copyNetState(live, TRUE);
+  FOR_EACH_GROUP({
+    C->groupError[2 * g] = G->error;
+    C->groupError[2 * g + 1] = G->outputCost;
+  });
+  saveRandState(&R);
+
+  buf += copyNetState(buf, FALSE);
+  if (start > 0) {
+    copyHistoryRow(buf, start - 1, FALSE);
+    Net->resetHistory[HISTORY_INDEX(start - 1)] = (start - 1 == 0);
+  }
+  restoreRandState(C->rand + s);
+  for (t = start; t < stop && !value; t++) {
+    Net->currentTick = t;
+    Net->inGracePeriod = C->grace[t];
+    Net->resetHistory[HISTORY_INDEX(t)] = (t == 0);
+    if (t > start && Net->eventHistory[t] != Net->eventHistory[t - 1])
+      value = E->set->loadEvent(E->event + Net->eventHistory[t]);
+    if (!value) forward();
+  }
+
+  copyNetState(live, FALSE);
+  FOR_EACH_GROUP({
+    G->error = C->groupError[2 * g];
+    G->outputCost = C->groupError[2 * g + 1];
+  });
+  Net->error = error;
+  Net->outputCost = outputCost;
+  restoreRandState(&R);
+  Net->currentTick = currentTick;
+  Net->inGracePeriod = inGracePeriod;
+  return value;
+}
+
+/* If tick ends a stretch whose history has been overwritten, this reruns
+   it. */
+static flag checkpointTicks(Example E, int tick, void (*forward)(void)) {
+  Checkpoints C = exampleCheckpoints();
+  int s;
+  if (!C || (tick + 1 - C->first) % C->ticks) return TCL_OK;
+  s = (tick + 1 - C->first) / C->ticks - 1;
+  if (s < 0 || s >= C->numSaved - 1) return TCL_OK;
+  return rerunTicks(C, E, s, forward);
+}
+
+/* This puts the last stretch back in the histories after the backward
+   pass, so they end with the last ticks, as they would have otherwise. */
+static flag lastCheckpointTicks(Example E, void (*forward)(void)) {
+  Checkpoints C = exampleCheckpoints();
+  if (!C || C->numSaved <= 1) return TCL_OK;
+  return rerunTicks(C, E, C->numSaved - 1, forward);
+}
+
+
 /******************** Simple Recurrent Backprop Through Time *****************/
 
-flag srbpttNetForward(Event V) {
+static void srbpttTick(void) {
   FOR_EACH_GROUP({
-    computeInput(G, TRUE);
-    computeOutput(G, TRUE);
-    computeCost(G, TRUE);
+    computeForward(G, TRUE, TRUE, TRUE);
     computeCostBack(G, TRUE);
   });
+}
+
+flag srbpttNetForward(Event V) {
+  if (Net->checkpointTicks > 0) saveCheckpoint();
+  srbpttTick();
   return TCL_OK;
 }
 
@@ -1680,6 +2798,7 @@ flag srbpttNetExampleBack(Example E) {
 
   for (Net->currentTick = Net->ticksOnExample - 2;
        Net->currentTick >= 0; Net->currentTick--) {
+    if (checkpointTicks(E, Net->currentTick, srbpttTick)) return TCL_ERROR;
     /* Set outputDerivs to the stored instant error derivatives. */
     FOR_EACH_GROUP({
       restoreOutputDerivs(G, Net->currentTick);
@@ -1689,6 +2808,7 @@ flag srbpttNetExampleBack(Example E) {
     FOR_EACH_GROUP_BACK(BACKPROP(G));
   }
   /* Restore the final outputs for continuity with the next example */
+  if (lastCheckpointTicks(E, srbpttTick)) return TCL_ERROR;
   FOR_EACH_GROUP(restoreOutputs(G, Net->ticksOnExample - 1));
   return TCL_OK;
 }
@@ -1696,6 +2816,49 @@ flag srbpttNetExampleBack(Example E) {
 
 /*********************** Continuous Network Procedures ***********************/
 
+/* The link derivs are scaled and given noise like this before an update. */
+static void finishLinkDerivs(void) {
+  if (Net->type & CONTINUOUS)
+    FOR_EACH_GROUP(scaleLinkDerivsByDt(G));
+  FOR_EACH_GROUP(if (G->type & DERIV_NOISE) injectLinkDerivNoise(G));
+}
+
+/* With streamTicks W and streamOverlap H, this is done every W ticks and at
+   the end of the example.  It backpropagates from the current tick through
+   the last W + H ticks, injecting the error of only the last W, so each
+   tick's error is injected once.  The forward state of the network is left
+   as it was, and the weights are updated if streamUpdates is set. */
+static void streamBack(int newTicks) {
+  int end = Net->currentTick, stop = imax(end - newTicks - Net->streamOverlap,
+					  0);
+  real *state = realArray(copyNetState(NULL, TRUE), "streamBack:state");
+
+  copyNetState(state, TRUE);
+  FOR_EACH_GROUP(resetOutputDerivCache(G); resetBackwardIntegrators(G));
+  for (; Net->currentTick > stop; Net->currentTick--) {
+    FOR_EACH_GROUP({
+      if (Net->currentTick > end - newTicks)
+	restoreOutputDerivs(G, Net->currentTick);
+      else FOR_EACH_UNIT2(G, G->outputDeriv[u] = 0.0);
+    });
+    FOR_EACH_GROUP(computeOutputBack(G));
+    FOR_EACH_GROUP({
+      restoreOutputs(G, Net->currentTick - 1);
+      restoreInputs(G, Net->currentTick - 1);
+    });
+    FOR_EACH_GROUP(computeInputBack(G));
+  }
+  Net->currentTick = end;
+  copyNetState(state, FALSE);
+  FREE(state);
+
+  if (Net->streamUpdates) {
+    finishLinkDerivs();
+    getAlgorithm(Net->algorithm)->updateWeights(FALSE);
+    FOR_EACH_GROUP(resetLinkDerivs(G));
+  }
+}
+
 flag continuousNetTickForward(Event V) {
   /* Do the main procedures for each group. */
   FOR_EACH_GROUP(computeInput(G, TRUE));
@@ -1704,20 +2867,39 @@ flag continuousNetTickForward(Event V) {
   return TCL_OK;
 }
 
-flag continuousNetTrainTickForward(Event V) {
-  continuousNetTickForward(V);
+static void continuousTrainTick(void) {
+  continuousNetTickForward(NULL);
   /* Calculate and store the outputDerivs. */
   FOR_EACH_GROUP(computeCostBack(G, TRUE));
+}
+
+flag continuousNetTrainTickForward(Event V) {
+  /* The backward pass ends on the outputs of tick 0, which
+     storeOutputsAndTargets() only keeps for the unit viewer. */
+  if (Net->currentTick == 1) FOR_EACH_GROUP(storeOutputs(G, 0));
+  if (Net->checkpointTicks > 0) saveCheckpoint();
+  continuousTrainTick();
+  if (Net->streamTicks > 0 && Net->currentTick % Net->streamTicks == 0)
+    streamBack(Net->streamTicks);
   return TCL_OK;
 }
 
 flag continuousNetExampleBack(Example E) {
+  /* When streaming, only the ticks since the last window are left. */
+  if (Net->streamTicks > 0) {
+    Net->currentTick = Net->ticksOnExample - 1;
+    if (Net->currentTick % Net->streamTicks)
+      streamBack(Net->currentTick % Net->streamTicks);
+    return TCL_OK;
+  }
   /* Clear the output deriv caches. */
   /* If integrating, reset the deriv accumulators. */
   FOR_EACH_GROUP(resetOutputDerivCache(G); resetBackwardIntegrators(G));
 
   for (Net->currentTick = Net->ticksOnExample - 1;
        Net->currentTick > 0; Net->currentTick--) {
+    if (checkpointTicks(E, Net->currentTick, continuousTrainTick))
+      return TCL_ERROR;
     /* When you get here, the outputs are the outputs from Net->currentTick and
        the outputDeriv caches contain the backpropagated error from the next
        tick. */
@@ -1734,6 +2916,7 @@ flag continuousNetExampleBack(Example E) {
     FOR_EACH_GROUP(computeInputBack(G));
   }
   /* Restore the final outputs for continuity with the next example */
+  if (lastCheckpointTicks(E, continuousTrainTick)) return TCL_ERROR;
   FOR_EACH_GROUP(restoreOutputs(G, Net->ticksOnExample - 1));
   return TCL_OK;
 }
@@ -1854,7 +3037,11 @@ flag standardNetTrainBatch(flag *allCorrect) {
     return warning("You must specify a non-zero batch size when reading from "
 		   "a pipe.");
 
-  for (i = 0; i < numExamples; i++) {
+  if (numExamples > 1 && miniBatchEligible(S))
+    value = miniBatchTrain(S, numExamples, allCorrect);
+  else if (numExamples > 1 && boltzmannBatchEligible(S))
+    value = boltzmannBatchTrain(S, numExamples, allCorrect);
+  else for (i = 0; i < numExamples; i++) {
     if (loadNextExample(S)) return TCL_ERROR;
     E = S->currentExample;
 
@@ -1877,10 +3064,7 @@ flag standardNetTrainBatch(flag *allCorrect) {
     }
   }
 
-  if (Net->type & CONTINUOUS)
-    FOR_EACH_GROUP(scaleLinkDerivsByDt(G));
-  FOR_EACH_GROUP(if (G->type & DERIV_NOISE) injectLinkDerivNoise(G));
-
+  finishLinkDerivs();
   return value;
 }
 
@@ -2100,7 +3284,7 @@ static flag boltzmannSettled(flag training) {
 	  real *lastOutput = P->unitData;
 	  int u;
 	  for (u = 0; u < G->numUnits; u++)
-	    if (ABS(G->output[u] - lastOutput[u]) > criterion)
+	    if (ABS(G->outputCache[u] - lastOutput[u]) > criterion)
 	      return FALSE;
 	}
     }
@@ -2111,10 +3295,10 @@ static flag boltzmannSettled(flag training) {
 static void initializeBoltzmannOutputs(Group G) {
   real initOutput = chooseValue(G->initOutput, Net->initOutput);
 
-  FOR_EACH_UNIT(G, {
-    if (!isNaN(U->externalInput)) U->output = U->externalInput;
-    else if (!isNaN(U->target)) U->output = U->target;
-    else U->output = initOutput;
+  FOR_EACH_UNIT2(G, {
+    if (!isNaN(G->externalInput[u])) G->output[u] = G->externalInput[u];
+    else if (!isNaN(G->target[u])) G->output[u] = G->target[u];
+    else G->output[u] = initOutput;
   });
   cacheOutputs(G);
 }
@@ -2124,9 +3308,9 @@ static void resetBoltzmannOutputs(Group G) {
   real clampStrength = chooseValue(G->clampStrength, Net->clampStrength),
     retain = 1.0 - clampStrength,
     initOutput = chooseValue(G->initOutput, Net->initOutput) * clampStrength;
-  FOR_EACH_UNIT(G, {
-    if (isNaN(U->externalInput))
-      U->output = initOutput + U->output * retain;
+  FOR_EACH_UNIT2(G, {
+    if (isNaN(G->externalInput[u]))
+      G->output[u] = initOutput + G->output[u] * retain;
   });
   cacheOutputs(G);
 }
@@ -2188,7 +3372,7 @@ flag boltzmannNetTrainExample(Example E, flag (*tickProc)(Event),
     if (phaseDone) {
       if (phase == POSITIVE) {
 	FOR_EACH_GROUP({
-	  FOR_EACH_UNIT(G, U->outputDeriv = U->output);
+	  FOR_EACH_UNIT2(G, G->outputDeriv[u] = G->output[u]);
 	  cacheOutputDerivs(G);
 	  if (G->type & RESET_ON_EXAMPLE) resetBoltzmannOutputs(G);
 	});
@@ -2231,7 +3415,7 @@ flag boltzmannNetTestExample(Example E, flag (*tickProc)(Event),
       if (E->set->loadEvent(V)) return TCL_ERROR;
       FOR_EACH_GROUP({
 	initializeBoltzmannOutputs(G);
-	FOR_EACH_UNIT(G, U->outputDeriv = U->output);
+	FOR_EACH_UNIT2(G, G->outputDeriv[u] = G->output[u]);
 	cacheOutputDerivs(G);
 	if (G->type & RESET_ON_EXAMPLE) resetBoltzmannOutputs(G);
       });
@@ -23,15 +23,32 @@ extern void injectLinkDerivNoise(Group G);
 
 extern flag groupCriteriaReached(flag training);
 
+extern void freeLiveIndex(Group G);
+extern void freeSparseIndex(Group G);
+extern int  sparseInputs(Group G, real **output);
+extern void sparseDotProduct(Group G, int active, real **output, real *input);
+extern void sparseLinkDerivs(Group G, int active, real **output,
+			     real *inputDeriv);
+extern void freeNetPlan(Network N);
+extern NetPlan compileNet(void);
+extern void appendNetPlan(void);
+extern void freeCheckpoints(Network N);
+extern int  checkpointRowSize(void);
+extern int  checkpointStateSize(void);
+extern int  groupTasks(Group G);
+extern void sliceGroup(Group G, Group S, int task, int numTasks);
 extern void computeInput(Group G, flag alwaysStore);
 extern void computeInputBack(Group G);
 extern void computeOutput(Group G, flag alwaysStore);
 extern void computeOutputBack(Group G);
 extern void computeCost(Group G, flag alwaysStore);
 extern void computeCostBack(Group G, flag alwaysStore);
+extern void computeForward(Group G, flag input, flag alwaysStore,
+			   flag storeCost);
 
 extern flag netForward(Event V);
 extern flag netForwardBackward(Event V);
+extern flag srbpttNetForward(Event V);
 extern flag srbpttNetExampleBack(Example E);
 extern flag continuousNetTickForward(Event V);
 extern flag continuousNetExampleBack(Example E);
@@ -107,46 +124,54 @@ extern void registerNetAndGroupTypes(void);
        ((real) -(d)/(y)))
 
 
+/* LW and LD step through the weights and derivs of the links. */
 #define FOR_EACH_LINK_FORW(U, proc) {\
-  Link L, sL; real *O; Block B, sB;\
-  for (B = U->block, sB = B + U->numBlocks, L = U->incoming; B < sB; B++)\
-    for (O = B->output, sL = L + B->numUnits; L < sL; O++, L++)\
+  real *LW, *sLW, *O; Block B, sB;\
+  for (B = U->block, sB = B + U->numBlocks, LW = U->weight; B < sB; B++)\
+    for (O = B->output, sLW = LW + B->numUnits; LW < sLW; O++, LW++)\
       {proc;}}
 
 #define FOR_EACH_LINK_FAST_FORW(U, proc, unrollproc) {\
- Link L, sL; real *O; Block B, sB;\
- for (B = U->block, sB = B + U->numBlocks, L = U->incoming; B < sB; B++) {\
-   for (O = B->output, sL = L + B->numUnits; L + 10 < sL;\
-	O += 10, L += 10)   {unrollproc;}\
-   for (; L < sL; O++, L++) {proc;}}}
+ real *LW, *sLW, *O; Block B, sB;\
+ for (B = U->block, sB = B + U->numBlocks, LW = U->weight; B < sB; B++) {\
+   for (O = B->output, sLW = LW + B->numUnits; LW + 10 < sLW;\
+	O += 10, LW += 10)   {unrollproc;}\
+   for (; LW < sLW; O++, LW++) {proc;}}}
 
 #define FOR_EACH_LINK_BACK(U, proc) {\
-  Link L, sL; real *O; Block B, sB; int nU;\
-  for (B = U->block, sB = B + U->numBlocks, L = U->incoming; B < sB; B++)\
-    for (O = B->output, nU = B->groupUnits, sL = L + B->numUnits; L < sL;\
-         O++, L++)\
+  real *LW, *LD, *sLW, *O; Block B, sB; int nU;\
+  for (B = U->block, sB = B + U->numBlocks, LW = U->weight, LD = U->deriv;\
+       B < sB; B++)\
+    for (O = B->output, nU = B->groupUnits, sLW = LW + B->numUnits;\
+	 LW < sLW; O++, LW++, LD++)\
       {proc;}}
 
 #define FOR_EACH_LINK_FAST_BACK(U, proc, unrollproc) {\
- Link L, sL; real *O, *D; Block B, sB; int nU;\
- for (B = U->block, sB = B + U->numBlocks, L = U->incoming; B < sB; B++) {\
-   for (O = B->output, nU = B->groupUnits, D = O + nU, sL = L + B->numUnits;\
-	L + 10 < sL; O += 10, L += 10, D += 10) {unrollproc;}\
-   for (; L < sL; O++, L++)                     {proc;}}}
-
-#define L_WGT     L->weight
-#define L_WGT_(i) L[i].weight
-#define L_DRV     L->deriv
-#define L_DRV_(i) L[i].deriv
+ real *LW, *LD, *sLW, *O, *D; Block B, sB; int nU;\
+ for (B = U->block, sB = B + U->numBlocks, LW = U->weight, LD = U->deriv;\
+      B < sB; B++) {\
+   for (O = B->output, nU = B->groupUnits, D = O + nU, sLW = LW + B->numUnits;\
+	LW + 10 < sLW; O += 10, LW += 10, LD += 10, D += 10) {unrollproc;}\
+   for (; LW < sLW; O++, LW++, LD++)                       {proc;}}}
+
+/* Steps through the incoming blocks of U with l at the first link of each.
+   Groups with a dense link matrix share the blocks of their first unit. */
+#define FOR_EACH_LINK_BLOCK(G, U, proc) {\
+  int l; Block B, sB; Unit _V = (G->linkMatrix) ? G->unit : U;\
+  for (B = _V->block, sB = B + _V->numBlocks, l = 0; B < sB;\
+       l += B->numUnits, B++) {proc;}}
+
+#define L_WGT     LW[0]
+#define L_WGT_(i) LW[i]
+#define L_DRV     LD[0]
+#define L_DRV_(i) LD[i]
 #define V_OUT     O[0]
 #define V_OUT_(i) O[i]
 #define V_DRV     O[nU]  /* output and outputDeriv arrays consecutive */
 #define V_DRV_(i) D[i]
 
 
-#define UPDATE(G)   {computeInput(G,  TRUE);\
-                     computeOutput(G, TRUE);\
-                     computeCost(G,   TRUE);}
+#define UPDATE(G)   computeForward(G, TRUE, TRUE, TRUE)
 #define BACKPROP(G) {computeOutputBack(G);\
                      computeInputBack(G);}
 
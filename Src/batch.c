@@ -0,0 +1,628 @@
+#include <string.h>
+#include "system.h"
+#ifdef HAVE_THREADS
+#include <pthread.h>
+#endif /* HAVE_THREADS */
+#include "util.h"
+#include "type.h"
+#include "network.h"
+#include "act.h"
+#include "control.h"
+#include "display.h"
+#include "kernel.h"
+#include "batch.h"
+#include "pool.h"
+#include "graph.h"
+
+/* A mini-batch runs up to this many examples side by side.  Each group keeps
+   one row of unit values per example, and each unit's links are applied to
+   all of the rows before moving on, so the weights are read from memory once
+   per mini-batch rather than once per example.  The output and cost
+   procedures are still run one example at a time on the units. */
+#define MINI_BATCH_COLUMNS 32
+
+#define BATCH_OUTPUT_TYPES (LINEAR | LOGISTIC | TERNARY | TANH | EXPONENTIAL |\
+			    GAUSSIAN | SOFT_MAX | BIAS_CLAMP | HARD_CLAMP)
+#define BATCH_COST_TYPES   (ERROR_MASKS | LINEAR_COST | QUADRATIC_COST |\
+			    CONV_QUAD_COST | LOGISTIC_COST | COSINE_COST)
+
+/* Each matrix is MINI_BATCH_COLUMNS x numUnits, one row per example. */
+typedef struct batchGroup {
+  real *input;
+  real *output;
+  real *externalInput;
+  real *target;
+  real *outputDeriv;       /* from the cost procedures */
+  real *outputDerivCache;  /* backpropagated from later groups */
+  real *inputDeriv;
+  real  groupError[MINI_BATCH_COLUMNS];
+  real  groupCost[MINI_BATCH_COLUMNS];
+  real  netError[MINI_BATCH_COLUMNS];
+  real  netCost[MINI_BATCH_COLUMNS];
+} *BatchGroup;
+
+typedef struct batchColumn {
+  Example example;
+  flag    inGracePeriod;
+  int     historyStart;
+  flag    critGroups;
+  flag    reached;
+} *BatchColumn;
+
+/* Each worker runs a chunk of up to MINI_BATCH_COLUMNS examples on its own
+   copy of the network. */
+typedef struct batchWorker {
+  Network    net;
+  BatchGroup X;
+  struct batchColumn col[MINI_BATCH_COLUMNS];
+  int        numColumns;
+#ifdef HAVE_THREADS
+  pthread_t  thread;
+  flag       started;
+#endif /* HAVE_THREADS */
+} *BatchWorker;
+
+/* Simple recurrent nets record every tick in the histories. */
+static flag AlwaysStore;
+
+#define GATHER(G, field, row) \
+  memcpy(row, (G)->field, (G)->numUnits * sizeof(real))
+#define SCATTER(G, field, row) \
+  memcpy((G)->field, row, (G)->numUnits * sizeof(real))
+
+
+/* This is true if a batch can be run a mini-batch at a time with the same
+   results as running the examples one by one.  That requires a single tick
+   on each example, no Tcl procedures that could look at the net between
+   examples, and a strictly feed-forward net whose groups use only the
+   procedures that keep no state from one example to the next.  With one
+   tick, a simple recurrent net trains the same way as a standard one. */
+flag miniBatchEligible(ExampleSet S) {
+  if (Net->maxTicks != 1 ||
+      Net->netTrainExample != standardNetRunExample || Net->outputFile)
+    return FALSE;
+  if (!(Net->netTrainTick == netForwardBackward && !Net->netTrainExampleBack &&
+	Net->backpropTicks <= 1) &&
+      !(Net->netTrainTick == srbpttNetForward &&
+	Net->netTrainExampleBack == srbpttNetExampleBack))
+    return FALSE;
+  if (Net->preExampleProc || Net->postExampleProc ||
+      Net->preExampleBackProc || Net->preEventProc || Net->postEventProc ||
+      Net->preTickProc || Net->postTickProc || Net->preTickBackProc)
+    return FALSE;
+  /* The pipe reuses the same example structure. */
+  if (S->mode == PIPE && Net->pseudoExampleFreq) return FALSE;
+
+  FOR_EACH_GROUP({
+    if (G->type & (ELMAN | LESIONED)) return FALSE;
+    if (G->inputProcs && G->inputType != DOT_PRODUCT) return FALSE;
+    if (G->outputType & ~BATCH_OUTPUT_TYPES) return FALSE;
+    if (G->inputProcs && G->outputType & HARD_CLAMP) return FALSE;
+    if (G->costType & ~BATCH_COST_TYPES) return FALSE;
+    FOR_EVERY_UNIT(G, FOR_EACH_BLOCK(U, {
+      if (B->unit->group->num >= G->num) return FALSE;
+    }));
+  });
+  return TRUE;
+}
+
+
+static BatchGroup allocBatchGroups(void) {
+  BatchGroup X = (BatchGroup) safeCalloc(Net->numGroups,
+					 sizeof(struct batchGroup),
+					 "allocBatchGroups:X");
+  FOR_EACH_GROUP({
+    int size = MINI_BATCH_COLUMNS * G->numUnits;
+    X[g].input            = realArray(size, "allocBatchGroups:input");
+    X[g].output           = realArray(size, "allocBatchGroups:output");
+    X[g].externalInput    = realArray(size, "allocBatchGroups:externalInput");
+    X[g].target           = realArray(size, "allocBatchGroups:target");
+    X[g].outputDeriv      = realArray(size, "allocBatchGroups:outputDeriv");
+    X[g].outputDerivCache = realArray(size,
+				      "allocBatchGroups:outputDerivCache");
+    X[g].inputDeriv       = realArray(size, "allocBatchGroups:inputDeriv");
+  });
+  return X;
+}
+
+static void freeBatchGroups(BatchGroup X) {
+  int g;
+  for (g = 0; g < Net->numGroups; g++) {
+    FREE(X[g].input);
+    FREE(X[g].output);
+    FREE(X[g].externalInput);
+    FREE(X[g].target);
+    FREE(X[g].outputDeriv);
+    FREE(X[g].outputDerivCache);
+    FREE(X[g].inputDeriv);
+  }
+  FREE(X);
+}
+
+/* Makes the net look the way it would while running column C alone. */
+static void useColumn(BatchColumn C) {
+  Net->currentExample      = C->example;
+  Net->inGracePeriod       = C->inGracePeriod;
+  Net->exampleHistoryStart = C->historyStart;
+  Net->currentTick         = 0;
+}
+
+/* This loads the next example into column b, as standardNetRunExample would
+   before its one tick. */
+static flag loadColumn(ExampleSet S, BatchGroup X, BatchColumn C, int b) {
+  Example E;
+  Event V;
+
+  if (loadNextExample(S)) return TCL_ERROR;
+  E = C->example = S->currentExample;
+  if (E->set->loadEvent(V = E->event)) return TCL_ERROR;
+  C->inGracePeriod = (chooseValue(V->graceTime, E->set->graceTime) > 0.0);
+  C->critGroups = FALSE;
+  C->reached = TRUE;
+
+  Net->exampleHistoryStart =
+    (Net->exampleHistoryStart + Net->ticksOnExample) % Net->historyLength;
+  Net->ticksOnExample = 1;
+  C->historyStart = Net->exampleHistoryStart;
+  Net->resetHistory[HISTORY_INDEX(0)] = TRUE;
+  Net->eventHistory[0] = 0;
+
+  FOR_EACH_GROUP({
+    GATHER(G, externalInput, X[g].externalInput + b * G->numUnits);
+    GATHER(G, target, X[g].target + b * G->numUnits);
+  });
+
+  /* The tick is used up on the first event, but the second is still
+     loaded. */
+  if (E->numEvents > 1 && E->set->loadEvent(E->event + 1)) return TCL_ERROR;
+  return TCL_OK;
+}
+
+/* This points O at each group's outputs in column c, as the sparse loops
+   in act.c expect. */
+static void columnOutputs(BatchGroup X, int c, real **O) {
+  FOR_EACH_GROUP(O[g] = X[g].output + c * G->numUnits);
+}
+
+/* The inputs to G for each column, summed in the same order as
+   dotProductInput.  Columns with few active senders use the sparse loops. */
+static void batchDotProduct(Group G, BatchGroup X, int n) {
+  int nU = G->numUnits, c, active;
+  real *I = X[G->num].input;
+  real **R = (real **) safeMalloc(Net->numGroups * sizeof(real *),
+				  "batchDotProduct:R");
+  flag sparse[MINI_BATCH_COLUMNS];
+  for (c = 0; c < n; c++) {
+    columnOutputs(X, c, R);
+    if ((sparse[c] = ((active = sparseInputs(G, R)) >= 0)))
+      sparseDotProduct(G, active, R, I + c * nU);
+  }
+  FREE(R);
+  FOR_EVERY_UNIT(G, {
+    for (c = 0; c < n; c++) if (!sparse[c]) I[c * nU + u] = 0.0;
+    FOR_EACH_LINK_BLOCK(G, U, {
+      Group S = B->unit->group;
+      int nS = S->numUnits;
+      real *O = X[S->num].output + (B->output - S->outputCache);
+      for (c = 0; c < n; c++) if (!sparse[c])
+	I[c * nU + u] = dotLinks(I[c * nU + u], U->weight + l, O + c * nS,
+				 B->numUnits);
+    });
+  });
+}
+
+/* This accumulates the link derivs and the sending groups' outputDeriv
+   caches for each column, as dotProductInputBack does.  The active senders
+   of sparse columns are found again for their link derivs, since a dense
+   group only keeps the last column's list. */
+static void batchDotProductBack(Group G, BatchGroup X, int n) {
+  int nU = G->numUnits, nS, offset, c;
+  real *ID = X[G->num].inputDeriv, *O, *D;
+  real **R = (real **) safeMalloc(Net->numGroups * sizeof(real *),
+				  "batchDotProductBack:R");
+  flag sparse[MINI_BATCH_COLUMNS];
+  Group S;
+  for (c = 0; c < n; c++) {
+    columnOutputs(X, c, R);
+    sparse[c] = (sparseInputs(G, R) >= 0);
+  }
+  FOR_EVERY_UNIT(G, {
+    FOR_EACH_LINK_BLOCK(G, U, {
+      S = B->unit->group;
+      nS = S->numUnits;
+      offset = B->output - S->outputCache;
+      O = X[S->num].output + offset;
+      D = X[S->num].outputDerivCache + offset;
+      for (c = 0; c < n; c++) {
+	if (sparse[c])
+	  dotLinksBackSenders(ID[c * nU + u], U->weight + l, D + c * nS,
+			      B->numUnits);
+	else dotLinksBack(ID[c * nU + u], U->weight + l, U->deriv + l,
+			  O + c * nS, D + c * nS, B->numUnits);
+      }
+    });
+  });
+  for (c = 0; c < n; c++) if (sparse[c]) {
+    columnOutputs(X, c, R);
+    sparseLinkDerivs(G, sparseInputs(G, R), R, ID + c * nU);
+  }
+  FREE(R);
+}
+
+static void batchForward(BatchGroup X, BatchColumn col, int n) {
+  int nU, c;
+  real criterion, netError, netCost, groupError, groupCost;
+  BatchGroup Y;
+  FOR_EACH_GROUP({
+    Y = X + g;
+    nU = G->numUnits;
+    criterion = chooseValue(G->trainGroupCrit, Net->trainGroupCrit);
+
+    if (G->inputProcs) batchDotProduct(G, X, n);
+    else memset(Y->input, 0, n * nU * sizeof(real));
+    memset(Y->outputDerivCache, 0, n * nU * sizeof(real));
+
+    for (c = 0; c < n; c++) {
+      BatchColumn C = col + c;
+      useColumn(C);
+      if (G->type & RESET_ON_EXAMPLE) resetOutputs(G);
+      SCATTER(G, input, Y->input + c * nU);
+      SCATTER(G, externalInput, Y->externalInput + c * nU);
+      SCATTER(G, target, Y->target + c * nU);
+      if (UnitUp || AlwaysStore || G->type & USE_INPUT_HIST)
+	storeInputs(G, 0);
+      /* The error is added in later in example order. */
+      netError = Net->error;  netCost = Net->outputCost;
+      groupError = G->error;  groupCost = G->outputCost;
+      Net->error = Net->outputCost = G->error = G->outputCost = 0.0;
+      computeForward(G, FALSE, AlwaysStore, AlwaysStore);
+      Y->netError[c]   = Net->error;  Y->netCost[c]   = Net->outputCost;
+      Y->groupError[c] = G->error;    Y->groupCost[c] = G->outputCost;
+      Net->error = netError;  Net->outputCost = netCost;
+      G->error = groupError;  G->outputCost = groupCost;
+      memcpy(Y->output + c * nU, G->outputCache, nU * sizeof(real));
+
+      computeCostBack(G, AlwaysStore);
+      GATHER(G, outputDeriv, Y->outputDeriv + c * nU);
+
+      if (G->groupCriterionReached) {
+	C->critGroups = TRUE;
+	if (C->reached && !G->groupCriterionReached(G, criterion))
+	  C->reached = FALSE;
+      }
+    }
+  });
+}
+
+/* Groups with no inputs only need their own derivatives, which are only
+   visible for the last example. */
+static void batchBackward(BatchGroup X, BatchColumn col, int n) {
+  int c;
+  FOR_EACH_GROUP_BACK({
+    BatchGroup Y = X + g;
+    int nU = G->numUnits;
+    for (c = (G->inputProcs) ? 0 : n - 1; c < n; c++) {
+      useColumn(col + c);
+      SCATTER(G, input, Y->input + c * nU);
+      SCATTER(G, output, Y->output + c * nU);
+      SCATTER(G, externalInput, Y->externalInput + c * nU);
+      SCATTER(G, target, Y->target + c * nU);
+      SCATTER(G, outputDeriv, Y->outputDeriv + c * nU);
+      memcpy(G->outputCache, Y->output + c * nU, nU * sizeof(real));
+      memcpy(G->outputDerivCache, Y->outputDerivCache + c * nU,
+	     nU * sizeof(real));
+      computeOutputBack(G);
+      GATHER(G, inputDeriv, Y->inputDeriv + c * nU);
+    }
+    if (G->inputProcs) batchDotProductBack(G, X, n);
+  });
+}
+
+/* This runs one chunk of columns on the worker's network. */
+static void runChunk(BatchWorker W) {
+  batchForward(W->X, W->col, W->numColumns);
+  batchBackward(W->X, W->col, W->numColumns);
+}
+
+#ifdef HAVE_THREADS
+static void *workerThread(void *data) {
+  BatchWorker W = (BatchWorker) data;
+  Net = W->net;
+  runChunk(W);
+  return NULL;
+}
+#endif /* HAVE_THREADS */
+
+/* Worker 0 is the real network and runs in this thread.  If a thread can't
+   be started, its chunk is run here too. */
+static void runWorkers(BatchWorker W, int numWorkers) {
+  int t;
+  Network Master = Net;
+#ifdef HAVE_THREADS
+  for (t = 1; t < numWorkers; t++)
+    W[t].started = !pthread_create(&W[t].thread, NULL, workerThread, W + t);
+#endif /* HAVE_THREADS */
+  holdPool(numWorkers > 1);
+  runChunk(W);
+  holdPool(FALSE);
+  for (t = 1; t < numWorkers; t++) {
+#ifdef HAVE_THREADS
+    if (W[t].started) {
+      pthread_join(W[t].thread, NULL);
+      continue;
+    }
+#endif /* HAVE_THREADS */
+    Net = W[t].net;
+    runChunk(W + t);
+    Net = Master;
+  }
+}
+
+/* On an error, numColumns is left at the number of examples that loaded. */
+static flag loadChunk(ExampleSet S, BatchWorker W, int numColumns) {
+  for (W->numColumns = 0; W->numColumns < numColumns; W->numColumns++)
+    if (loadColumn(S, W->X, W->col + W->numColumns, W->numColumns))
+      return TCL_ERROR;
+  return TCL_OK;
+}
+
+/* This adds the errors in the order the examples were loaded. */
+static void addChunkError(BatchWorker W, flag *allCorrect) {
+  int c;
+  BatchGroup X = W->X;
+  for (c = 0; c < W->numColumns; c++) {
+    FOR_EACH_GROUP({
+      G->error      += X[g].groupError[c];
+      G->outputCost += X[g].groupCost[c];
+      Net->error      += X[g].netError[c];
+      Net->outputCost += X[g].netCost[c];
+    });
+    if (!(W->col[c].critGroups && W->col[c].reached)) *allCorrect = FALSE;
+  }
+}
+
+/* This adds a clone's link and gain derivs into the current network. */
+static void addCloneDerivs(Network N) {
+  real *D, *E;
+  int l, n;
+  Unit V;
+  FOR_EACH_GROUP({
+    V = N->group[g]->unit;
+    FOR_EVERY_UNIT(G, {
+      U->gainDeriv += V[u].gainDeriv;
+      for (l = 0, n = U->numIncoming, D = U->deriv, E = V[u].deriv; l < n; l++)
+	D[l] += E[l];
+    });
+  });
+}
+
+/* This does the main loop of standardNetTrainBatch a mini-batch at a time.
+   With numThreads > 1, each thread runs a chunk of the batch on its own
+   clone of the network, and the clones' derivs are added into the network
+   at the end.  The clones are rebuilt on every batch so they pick up any
+   changes to the weights and parameters.  The units are left as they would
+   be after the last example. */
+flag miniBatchTrain(ExampleSet S, int numExamples, flag *allCorrect) {
+  int i, t, numChunks, numWorkers, used, last;
+  BatchWorker W;
+  flag value = TCL_OK;
+
+  AlwaysStore = (Net->netTrainTick == srbpttNetForward);
+  numChunks = (numExamples + MINI_BATCH_COLUMNS - 1) / MINI_BATCH_COLUMNS;
+  numWorkers = imax(imin(Net->numThreads, numChunks), 1);
+  W = (BatchWorker) safeCalloc(numWorkers, sizeof(struct batchWorker),
+			       "miniBatchTrain:W");
+  for (t = 0; t < numWorkers; t++) {
+    W[t].net = (t == 0) ? Net : cloneNet();
+    W[t].X = allocBatchGroups();
+  }
+
+  for (i = 0; i < numExamples && !value; ) {
+    /* Worker 0 gets the last chunk, so the net ends on the last example. */
+    used = imin(numWorkers, (numExamples - i + MINI_BATCH_COLUMNS - 1) /
+		MINI_BATCH_COLUMNS);
+    for (t = used - 1; t >= 0; t--) {
+      value = loadChunk(S, W + t, imin(numExamples - i, MINI_BATCH_COLUMNS));
+      i += W[t].numColumns;
+      if (value) break;
+    }
+    /* If the set runs out, the examples that did load are still run, one
+       chunk at a time on the network itself, as they would have been. */
+    if (value) {
+      for (last = t, t = used - 1; t >= last; t--) {
+	if (W[t].numColumns == 0) continue;
+	runChunk(W + t);
+	addChunkError(W + t, allCorrect);
+	useColumn(W[t].col + W[t].numColumns - 1);
+      }
+      break;
+    }
+
+    runWorkers(W, used);
+    for (t = used - 1; t >= 0; t--)
+      addChunkError(W + t, allCorrect);
+    useColumn(W->col + W->numColumns - 1);
+
+    updateDisplays(ON_EXAMPLE);
+    if (smartUpdate(FALSE)) value = TCL_ERROR;
+  }
+
+  for (t = 0; t < numWorkers; t++) {
+    if (t > 0) {
+      addCloneDerivs(W[t].net);
+      freeNetClone(W[t].net);
+    }
+    freeBatchGroups(W[t].X);
+  }
+  FREE(W);
+  return value;
+}
+
+
+/************************** Parallel Boltzmann Settling **********************/
+
+/* Each Boltzmann worker settles a run of the batch's examples, one after
+   another, on its own copy of the network. */
+typedef struct boltzmannWorker {
+  Network    net;
+  Example   *example;
+  int        numExamples;
+  flag       allCorrect;
+  flag       value;
+#ifdef HAVE_THREADS
+  pthread_t  thread;
+  flag       started;
+#endif /* HAVE_THREADS */
+} *BoltzmannWorker;
+
+/* The examples of a deterministic Boltzmann machine don't interact until
+   the weights are updated, so they can settle in parallel as long as
+   nothing outside the network gets to look at it in the middle.  That rules
+   out Tcl procedures, the displays, and noise, which would draw from the
+   shared random number generator. */
+flag boltzmannBatchEligible(ExampleSet S) {
+  int i, j;
+  if (Net->numThreads <= 1 || Net->netTrainExample != boltzmannNetTrainExample
+      || Net->netTrainTick != boltzmannUpdate || Net->checkpointTicks > 0 ||
+      Net->outputFile)
+    return FALSE;
+  if (Net->preExampleProc || Net->postExampleProc ||
+      Net->preExampleBackProc || Net->preEventProc || Net->postEventProc ||
+      Net->preTickProc || Net->postTickProc || Net->preTickBackProc)
+    return FALSE;
+  if (UnitUp || LinkUp) return FALSE;
+  FOR_EACH_GRAPH(if (G->updateOn & (ON_TICK | ON_EXAMPLE)) return FALSE);
+
+  if (!(S->mode & (ORDERED | PERMUTED | RANDOMIZED | PROBABILISTIC)) ||
+      S->loadExample != standardLoadExample ||
+      S->loadEvent != standardLoadEvent)
+    return FALSE;
+  for (i = 0; i < S->numExamples; i++) {
+    Example E = S->example[i];
+    if (E->proc) return FALSE;
+    for (j = 0; j < E->numEvents; j++)
+      if (E->event[j].proc) return FALSE;
+  }
+
+  FOR_EACH_GROUP({
+    if (G->type & EXT_INPUT_NOISE) return FALSE;
+    if (G->inputType & (IN_NOISE | IN_DERIV_NOISE)) return FALSE;
+    if (G->outputType & (OUT_NOISE | OUT_DERIV_NOISE)) return FALSE;
+  });
+  return TRUE;
+}
+
+static void settleChunk(BoltzmannWorker W) {
+  int i;
+  Example E;
+  flag correct;
+  for (i = 0; i < W->numExamples && !W->value; i++) {
+    E = Net->currentExample = W->example[i];
+    if ((W->value = Net->netTrainExample(E, Net->netTrainTick, &correct)))
+      break;
+    if (Net->netTrainExampleBack) W->value = Net->netTrainExampleBack(E);
+    if (!correct) W->allCorrect = FALSE;
+  }
+}
+
+#ifdef HAVE_THREADS
+static void *settleThread(void *data) {
+  BoltzmannWorker W = (BoltzmannWorker) data;
+  Net = W->net;
+  settleChunk(W);
+  return NULL;
+}
+#endif /* HAVE_THREADS */
+
+/* The clones start with no error, so what they gather can be added in. */
+static void clearCloneError(Network N) {
+  int g;
+  N->error = N->outputCost = 0.0;
+  for (g = 0; g < N->numGroups; g++)
+    N->group[g]->error = N->group[g]->outputCost = 0.0;
+}
+
+static void addCloneError(Network N) {
+  FOR_EACH_GROUP({
+    G->error      += N->group[g]->error;
+    G->outputCost += N->group[g]->outputCost;
+  });
+  Net->error      += N->error;
+  Net->outputCost += N->outputCost;
+}
+
+/* This does the main loop of standardNetTrainBatch for a Boltzmann machine.
+   The examples are loaded first and split into one run per thread.  Each
+   clone settles its run and its errors and derivs are added into the
+   network at the end.  The network itself settles the last run, so it is
+   left on the last example.  The errors are summed in a different order
+   than when the examples run one by one. */
+flag boltzmannBatchTrain(ExampleSet S, int numExamples, flag *allCorrect) {
+  int i, t, numWorkers, size;
+  Example *example;
+  BoltzmannWorker W;
+  Network Master = Net;
+  flag value = TCL_OK;
+
+  example = (Example *) safeMalloc(numExamples * sizeof(Example),
+				   "boltzmannBatchTrain:example");
+  for (i = 0; i < numExamples; i++) {
+    if (loadNextExample(S)) {
+      FREE(example);
+      return TCL_ERROR;
+    }
+    example[i] = S->currentExample;
+  }
+
+  numWorkers = imax(imin(Net->numThreads, numExamples), 1);
+  W = (BoltzmannWorker) safeCalloc(numWorkers, sizeof(struct boltzmannWorker),
+				   "boltzmannBatchTrain:W");
+  /* Worker 0 gets the last run. */
+  for (i = numExamples, t = 0; t < numWorkers; t++) {
+    size = numExamples / numWorkers + (t < numExamples % numWorkers);
+    i -= size;
+    W[t].example = example + i;
+    W[t].numExamples = size;
+    W[t].allCorrect = TRUE;
+    if (t == 0) W[t].net = Net;
+    else {
+      W[t].net = cloneNet();
+      clearCloneError(W[t].net);
+    }
+  }
+
+#ifdef HAVE_THREADS
+  for (t = 1; t < numWorkers; t++)
+    W[t].started = !pthread_create(&W[t].thread, NULL, settleThread, W + t);
+#endif /* HAVE_THREADS */
+  holdPool(numWorkers > 1);
+  settleChunk(W);
+  holdPool(FALSE);
+  for (t = 1; t < numWorkers; t++) {
+#ifdef HAVE_THREADS
+    if (W[t].started) {
+      pthread_join(W[t].thread, NULL);
+      continue;
+    }
+#endif /* HAVE_THREADS */
+    Net = W[t].net;
+    settleChunk(W + t);
+    Net = Master;
+  }
+
+  for (t = 0; t < numWorkers; t++) {
+    if (W[t].value) value = TCL_ERROR;
+    if (!W[t].allCorrect) *allCorrect = FALSE;
+    if (t > 0) {
+      addCloneError(W[t].net);
+      addCloneDerivs(W[t].net);
+      freeNetClone(W[t].net);
+    }
+  }
+  FREE(W);
+  FREE(example);
+
+  updateDisplays(ON_EXAMPLE);
+  if (!value && smartUpdate(FALSE)) value = TCL_ERROR;
+  return value;
+}
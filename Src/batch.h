@@ -0,0 +1,15 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+/* Trains a batch several examples at a time, using numThreads threads, when
+   the network is a simple one-tick feed-forward net. */
+extern flag miniBatchEligible(ExampleSet S);
+extern flag miniBatchTrain(ExampleSet S, int numExamples, flag *allCorrect);
+
+/* Settles the examples of a Boltzmann machine's batch in parallel, one run
+   of examples per thread. */
+extern flag boltzmannBatchEligible(ExampleSet S);
+extern flag boltzmannBatchTrain(ExampleSet S, int numExamples,
+				flag *allCorrect);
+
+#endif /* BATCH_H */
@@ -621,9 +621,9 @@ ConfigureCanvRect(interp, canvas, itemPtr, objc, objv, flags)
 {
   int i;
   Group G;
-  Unit U;
+  Unit U, T;
   Block B;
-  Link L;
+  int l;
   real value = 0.0;
   CanvRectItem *canvRectPtr = (CanvRectItem *) itemPtr;
   Tk_Window tkwin = Tk_CanvasTkwin(canvas);
@@ -647,16 +647,16 @@ ConfigureCanvRect(interp, canvas, itemPtr, objc, objv, flags)
 	value = NaN; break;}
       if (Net->unitDisplayValue == UV_TARGETS ||
 	  (Net->unitDisplayValue == UV_OUT_TARG && canvRectPtr->link == -3)) {
-	if (!U->targetHistory)
-	  value = U->target;
+	if (!U->group->targetHistory)
+	  value = UNIT_VAL(U, target);
 	else if (ViewTick >= Net->ticksOnExample - Net->historyLength)
-	  value = GET_HISTORY(U, targetHistory, HISTORY_INDEX(ViewTick));
+	  value = GET_UNIT_HISTORY(U, targetHistory, HISTORY_INDEX(ViewTick));
 	else value = NaN;
       } else {
-	if (!U->outputHistory)
-	  value = U->output;
+	if (!U->group->outputHistory)
+	  value = UNIT_VAL(U, output);
 	else if (ViewTick >= Net->ticksOnExample - Net->historyLength)
-	  value = GET_HISTORY(U, outputHistory, HISTORY_INDEX(ViewTick));
+	  value = GET_UNIT_HISTORY(U, outputHistory, HISTORY_INDEX(ViewTick));
 	else value = NaN;
       }
       if (!isNaN(value)) {
@@ -678,50 +678,48 @@ ConfigureCanvRect(interp, canvas, itemPtr, objc, objv, flags)
     case UV_INPUTS:
       if (!Net->currentExample) {
 	value = NaN; break;}
-      if (!U->inputHistory)
-	value = U->input;
+      if (!U->group->inputHistory)
+	value = UNIT_VAL(U, input);
       else if (ViewTick >= Net->ticksOnExample - Net->historyLength)
-	value = GET_HISTORY(U, inputHistory, HISTORY_INDEX(ViewTick));
+	value = GET_UNIT_HISTORY(U, inputHistory, HISTORY_INDEX(ViewTick));
       else value = NaN;
       break;
     case UV_EXT_INPUTS:
       if (!Net->currentExample || ViewTick < Net->ticksOnExample - 1)
 	value = NaN;
-      else value = U->externalInput;
+      else value = UNIT_VAL(U, externalInput);
       break;
     case UV_OUTPUT_DERIVS:
       if (!Net->currentExample) {
 	value = NaN; break;}
-      if (!U->outputDerivHistory)
-	value = U->outputDeriv;
+      if (!U->group->outputDerivHistory)
+	value = UNIT_VAL(U, outputDeriv);
       else if (ViewTick >= Net->ticksOnExample - Net->historyLength)
-	value = GET_HISTORY(U, outputDerivHistory, HISTORY_INDEX(ViewTick));
+	value = GET_UNIT_HISTORY(U, outputDerivHistory, HISTORY_INDEX(ViewTick));
       else value = NaN;
       break;
     case UV_INPUT_DERIVS:
       if (!Net->currentExample || ViewTick < Net->ticksOnExample - 1)
 	value = NaN;
-      else value = U->inputDeriv;
+      else value = UNIT_VAL(U, inputDeriv);
       break;
     case UV_GAIN:
       value = U->gain;
       break;
     case UV_LINK_WEIGHTS:
-      if ((L = lookupLink(U, Net->unitDisplayUnit, NULL, ALL_LINKS)) ||
-	  (L = lookupLink(Net->unitDisplayUnit, U, NULL, ALL_LINKS)))
-	value = L->weight;
-      else value = NaN; break;
     case UV_LINK_DERIVS:
-      if ((L = lookupLink(U, Net->unitDisplayUnit, NULL, ALL_LINKS)) ||
-	  (L = lookupLink(Net->unitDisplayUnit, U, NULL, ALL_LINKS)))
-	value = L->deriv;
-      else value = NaN; break;
     case UV_LINK_DELTAS:
-      if ((L = lookupLink(U, Net->unitDisplayUnit, NULL, ALL_LINKS)))
-	value = getLink2(Net->unitDisplayUnit, L)->lastWeightDelta;
-      else if ((L = lookupLink(Net->unitDisplayUnit, U, NULL, ALL_LINKS)))
-	value = getLink2(U, L)->lastWeightDelta;
-      else value = NaN; break;
+      /* T is the unit that owns the link. */
+      T = Net->unitDisplayUnit;
+      if ((l = lookupLink(U, T, ALL_LINKS)) < 0) {
+	l = lookupLink(T, U, ALL_LINKS);
+	T = U;
+      }
+      if (l < 0) value = NaN;
+      else if (Net->unitDisplayValue == UV_LINK_WEIGHTS) value = T->weight[l];
+      else if (Net->unitDisplayValue == UV_LINK_DERIVS) value = T->deriv[l];
+      else value = T->lastWeightDelta[l];
+      break;
     default:
       fatalError("ConfigureCanvRect: bad Net->unitDisplayValue (%d)",
 		 Net->unitDisplayValue);
@@ -757,14 +755,14 @@ ConfigureCanvRect(interp, canvas, itemPtr, objc, objv, flags)
     if (canvRectPtr->link < 0 || canvRectPtr->link >= U->numIncoming)
       return warning("ConfigureCanvRect: link %d out of range (%s %d)",
 		     canvRectPtr->link, U->name, U->numIncoming);
-    L = U->incoming + canvRectPtr->link;
+    l = canvRectPtr->link;
     switch (Net->linkDisplayValue) {
     case UV_LINK_WEIGHTS:
-      value = L->weight; break;
+      value = U->weight[l]; break;
     case UV_LINK_DERIVS:
-      value = L->deriv; break;
+      value = U->deriv[l]; break;
     case UV_LINK_DELTAS:
-      value = getLink2(U, L)->lastWeightDelta; break;
+      value = U->lastWeightDelta[l]; break;
     default:
       fatalError("ConfigureCanvRect: bad Net->linkDisplayValue (%d)",
 		 Net->linkDisplayValue);
@@ -12,6 +12,7 @@
 #include "tk.h"
 #include "util.h"
 #include "type.h"
+#include "connect.h"
 #include "command.h"
 #include "control.h"
 
@@ -144,6 +145,8 @@ static int C_nice(TCL_CMDARGS) {
 static int C_exit(TCL_CMDARGS) {
   int val = 0;
   if (objc > 1) val = atoi(objv[1]);
+  closeAllNetOutputFiles();
+  finishCheckpoints();
   exit(val);
   return TCL_ERROR;
 }
@@ -1,11 +1,16 @@
 #include "system.h"
 #include <string.h>
+#include <ctype.h>
 #include <netinet/in.h>
 #include <unistd.h>
+#ifdef HAVE_THREADS
+#include <pthread.h>
+#endif /* HAVE_THREADS */
 #include "util.h"
 #include "type.h"
 #include "network.h"
 #include "connect.h"
+#include "act.h"
 
 #ifndef DOUBLE_REAL
 #define FLOAT_REAL
@@ -65,21 +70,20 @@ flag listLinkTypes(void) {
   return TCL_OK;
 }
 
-/* If there are multiple links of the same type between the units, this only
-   returns the first. */
-Link lookupLink(Unit preUnit, Unit postUnit, int *num, mask linkType) {
+/* This returns the index of the link in postUnit's arrays, or -1.  If there
+   are multiple links of the same type between the units, this only returns
+   the first. */
+int lookupLink(Unit preUnit, Unit postUnit, mask linkType) {
   int b, l;
   Block B;
 
-  if (!preUnit || !postUnit) return NULL;
+  if (!preUnit || !postUnit) return -1;
   for (b = 0, l = 0; b < postUnit->numBlocks; b++, l += B->numUnits) {
     B = postUnit->block + b;
-    if (LINK_TYPE_MATCH(linkType, B) && IN_BLOCK(preUnit, B)) {
-      if (num) *num = l + (preUnit - B->unit);
-      return postUnit->incoming + l + (preUnit - B->unit);
-    }
+    if (LINK_TYPE_MATCH(linkType, B) && IN_BLOCK(preUnit, B))
+      return l + (preUnit - B->unit);
   }
-  return NULL;
+  return -1;
 }
 
 Block getLinkBlock(Unit U, int l, int *offset) {
@@ -103,8 +107,8 @@ Unit lookupPreUnit(Unit postUnit, int num) {
   return B->unit + offset;
 }
 
-int getLinkType(Unit U, Link L) {
-  int b, l = (L - U->incoming);
+int getLinkType(Unit U, int l) {
+  int b;
   Block B;
   if (l < 0 || l >= U->numIncoming)
     return -1;
@@ -115,32 +119,28 @@ int getLinkType(Unit U, Link L) {
   return -1;
 }
 
-Link2 getLink2(Unit U, Link L) {
-  return U->incoming2 + (L - U->incoming);
-}
-
 /***************************** Weight Randomization **************************/
 
-static void randomizeLinkWeight(Link L, Block B, Group G) {
+static void randomizeLinkWeight(Unit U, int l, Block B) {
+  Group G = U->group;
   real mean, range;
   mean = chooseValue3(B->randMean, G->randMean, Net->randMean);
   range = chooseValue3(B->randRange, G->randRange, Net->randRange);
-  L->weight = randReal(mean, range);
+  U->weight[l] = randReal(mean, range);
 }
 
 void randomizeUnitWeights(Unit U, real range, real mean, real reqRange,
 			  real reqMean, mask linkType, flag doFrozen) {
   int l = 0;
-  Link L, sL;
-  real m, r;
+  real *W, *sW, m, r;
 
   if (!doFrozen && (U->type & FROZEN)) return;
   FOR_EACH_BLOCK(U, {
     if (LINK_TYPE_MATCH(linkType, B) && (doFrozen || !(B->type & FROZEN))) {
       m = chooseValue3(reqMean, B->randMean, mean);
       r = chooseValue3(reqRange, B->randRange, range);
-      for (L = U->incoming + l, sL = L + B->numUnits; L < sL; L++)
-	L->weight = randReal(m, r);
+      for (W = U->weight + l, sW = W + B->numUnits; W < sW; W++)
+	*W = randReal(m, r);
     }
     l += B->numUnits;
   });
@@ -207,53 +207,130 @@ static void initBlockValues(Block B, real mean, real range) {
   B->max          = DEF_B_max;
 }
 
-void initLinkValues(Link L, Link2 M) {
-  L->deriv = DEF_L_deriv;
-  M->lastWeightDelta = DEF_L_lastWeightDelta;
+void initLinkValues(Unit U, int l) {
+  U->deriv[l] = DEF_L_deriv;
+  U->lastWeightDelta[l] = DEF_L_lastWeightDelta;
 # ifdef ADVANCED
   /* This should be 1.0 for DBD.  It shouldn't affect quickProp. */
-  M->lastValue = DEF_L_lastValue;
+  U->lastValue[l] = DEF_L_lastValue;
 # endif
 }
 
+/* This points the link arrays of U into values, with each array size reals
+   after the one before. */
+void setUnitLinks(Unit U, real *values, int size) {
+  U->weight          = values;
+  U->deriv           = (values) ? values + size : NULL;
+  U->lastWeightDelta = (values) ? values + 2 * size : NULL;
+#ifdef ADVANCED
+  U->lastValue       = (values) ? values + 3 * size : NULL;
+#endif /* ADVANCED */
+}
+
+
+/***************************** Dense Link Storage ****************************/
+
+/* If every unit in a group has the same incoming blocks, as after a full
+   projection, the links are packed into a single matrix owned by the group,
+   with all of the weights first, then all of the derivs, and so on.  Each
+   unit's arrays then point to its rows, so the usual per-unit view of the
+   links still works. */
+static flag denseLayout(Group G) {
+  Unit V = G->unit;
+  int b;
+  if (G->numUnits <= 1 || V->numIncoming == 0) return FALSE;
+  FOR_EVERY_UNIT(G, {
+    if (U->numIncoming != V->numIncoming || U->numBlocks != V->numBlocks)
+      return FALSE;
+    for (b = 0; b < U->numBlocks; b++)
+      if (U->block[b].output != V->block[b].output ||
+	  U->block[b].numUnits != V->block[b].numUnits) return FALSE;
+  });
+  return TRUE;
+}
+
+/* Copies n links between blocks of link arrays that are spaced differently. */
+static void copyLinks(real *dest, int destSize, real *source, int sourceSize,
+		      int n) {
+  int k;
+  if (n <= 0) return;
+  for (k = 0; k < LINK_VALUES; k++)
+    memcpy(dest + k * destSize, source + k * sourceSize, n * sizeof(real));
+}
+
+void unpackGroupLinks(Group G) {
+  int n = G->denseIncoming, size = G->numUnits * n;
+  real *values;
+  if (!G->linkMatrix) return;
+  FOR_EVERY_UNIT(G, {
+    values = realArray(LINK_VALUES * n, "unpackGroupLinks:values");
+    copyLinks(values, n, U->weight, size, n);
+    setUnitLinks(U, values, n);
+  });
+  FREE(G->linkMatrix);
+  G->denseIncoming = 0;
+}
+
+flag packGroupLinks(Group G) {
+  int n, size;
+  if (G->linkMatrix || G->net->type & OPTIMIZED || !denseLayout(G))
+    return TCL_OK;
+  freeSparseIndex(G);
+  n = G->unit->numIncoming;
+  size = G->numUnits * n;
+  G->linkMatrix = realArray(LINK_VALUES * size,
+			    "packGroupLinks:G->linkMatrix");
+  FOR_EVERY_UNIT(G, {
+    copyLinks(G->linkMatrix + u * n, size, U->weight, n, n);
+    FREE(U->weight);
+    setUnitLinks(U, G->linkMatrix + u * n, size);
+  });
+  G->denseIncoming = n;
+  return TCL_OK;
+}
+
 
 /**************************** Building Connections ***************************/
 
+/* These four free the group's sparse index, which lists its links by
+   position. */
+
+/* This makes room for change new links at position l. */
 static flag growIncoming(Unit U, int change, int l) {
-  U->numIncoming += change;
-  U->incoming = safeRealloc(U->incoming,
-			    U->numIncoming * sizeof(struct link),
-			    "growIncoming:U->incoming");
-  U->incoming2 = safeRealloc(U->incoming2,
-			     U->numIncoming * sizeof(struct link2),
-			     "growIncoming:U->incoming2");
-  if (l != U->numIncoming - change) {
-    memmove(U->incoming + l + change, U->incoming + l,
-	    (U->numIncoming - l - change) * sizeof(struct link));
-    memmove(U->incoming2 + l + change, U->incoming2 + l,
-	    (U->numIncoming - l - change) * sizeof(struct link2));
-  }
+  int n, m;
+  real *values;
+  unpackGroupLinks(U->group);
+  freeSparseIndex(U->group);
+  n = U->numIncoming;
+  m = U->numIncoming += change;
+  values = realArray(LINK_VALUES * m, "growIncoming:values");
+  copyLinks(values, m, U->weight, n, l);
+  copyLinks(values + l + change, m, U->weight + l, n, n - l);
+  FREE(U->weight);
+  setUnitLinks(U, values, m);
   return TCL_OK;
 }
 
+/* This removes change links starting at position l. */
 static flag shrinkIncoming(Unit U, int change, int l) {
-  U->numIncoming -= change;
-  if (l != U->numIncoming) {
-    memmove(U->incoming + l, U->incoming + l + change,
-	    (U->numIncoming - l) * sizeof(struct link));
-    memmove(U->incoming2 + l, U->incoming2 + l + change,
-	    (U->numIncoming - l) * sizeof(struct link2));
+  int n, m;
+  real *values = NULL;
+  unpackGroupLinks(U->group);
+  freeSparseIndex(U->group);
+  n = U->numIncoming;
+  m = U->numIncoming -= change;
+  if (m > 0) {
+    values = realArray(LINK_VALUES * m, "shrinkIncoming:values");
+    copyLinks(values, m, U->weight, n, l);
+    copyLinks(values + l, m, U->weight + l + change, n, m - l);
   }
-  U->incoming = safeRealloc(U->incoming,
-			    U->numIncoming * sizeof(struct link),
-			    "shrinkIncoming:U->incoming");
-  U->incoming2 = safeRealloc(U->incoming2,
-			     U->numIncoming * sizeof(struct link2),
-			     "shrinkIncoming:U->incoming2");
+  FREE(U->weight);
+  setUnitLinks(U, values, m);
   return TCL_OK;
 }
 
 static flag growBlocks(Unit U, int b) {
+  freeSparseIndex(U->group);
   U->numBlocks++;
   U->block = safeRealloc(U->block, U->numBlocks * sizeof(struct block),
 			 "growBlocks:U->block");
@@ -267,6 +344,7 @@ static flag growBlocks(Unit U, int b) {
 
 static flag shrinkBlocks(Unit U, int b) {
   if (freeBlockExtension(U->block + b)) return TCL_ERROR;
+  freeSparseIndex(U->group);
   U->numBlocks--;
   if (b != U->numBlocks)
     memmove(U->block + b, U->block + b + 1,
@@ -280,7 +358,6 @@ enum connectMode {NEW_BLOCK, PREPEND_BLOCK, APPEND_BLOCK, JOIN_BLOCKS};
 flag connectUnits(Unit preUnit, Unit postUnit, mask linkType,
 		  real range, real mean, flag frozen) {
   int b, l, mode;
-  Link L;
   Block B = NULL;
   mode = NEW_BLOCK;
   /* Figure out where to add it */
@@ -327,7 +404,7 @@ flag connectUnits(Unit preUnit, Unit postUnit, mask linkType,
     B->numUnits = 1;
     B->unit = preUnit;
     B->groupUnits = preUnit->group->numUnits;
-    B->output = preUnit->group->output + preUnit->num;
+    B->output = preUnit->group->outputCache + preUnit->num;
     B->type = 0;
     SET_LINK_TYPE(linkType, B);
     eval("catch {.initBlock group(%d).unit(%d).block(%d)}",
@@ -350,11 +427,10 @@ flag connectUnits(Unit preUnit, Unit postUnit, mask linkType,
   }
 
   if (growIncoming(postUnit, 1, l)) return TCL_ERROR;
-  L = postUnit->incoming + l;
 
   initBlockValues(B, mean, range);
-  randomizeLinkWeight(L, B, postUnit->group);
-  initLinkValues(L, getLink2(postUnit, L));
+  randomizeLinkWeight(postUnit, l, B);
+  initLinkValues(postUnit, l);
   preUnit->numOutgoing++;
   postUnit->group->numIncoming++;
   preUnit->group->numOutgoing++;
@@ -369,7 +445,6 @@ flag connectUnits(Unit preUnit, Unit postUnit, mask linkType,
 flag connectGroupToUnit(Group preGroup, Unit postUnit, mask linkType,
 			real range, real mean, flag frozen) {
   int b, l, stop;
-  Link L;
   Block B;
   /* Figure out where to add it */
   for (b = 0, l = 0; b < postUnit->numBlocks; b++, l += B->numUnits) {
@@ -391,7 +466,7 @@ flag connectGroupToUnit(Group preGroup, Unit postUnit, mask linkType,
   B->numUnits = preGroup->numUnits;
   B->unit = preGroup->unit;
   B->groupUnits = preGroup->numUnits;
-  B->output = preGroup->output;
+  B->output = preGroup->outputCache;
   B->type = 0;
   SET_LINK_TYPE(linkType, B);
   initBlockValues(B, mean, range);
@@ -401,9 +476,8 @@ flag connectGroupToUnit(Group preGroup, Unit postUnit, mask linkType,
   if (growIncoming(postUnit, preGroup->numUnits, l)) return TCL_ERROR;
 
   for (stop = l + preGroup->numUnits; l < stop; l++) {
-    L = postUnit->incoming + l;
-    randomizeLinkWeight(L, B, postUnit->group);
-    initLinkValues(L, getLink2(postUnit, L));
+    randomizeLinkWeight(postUnit, l, B);
+    initLinkValues(postUnit, l);
     preGroup->unit[l - stop + preGroup->numUnits].numOutgoing++;
   }
 
@@ -422,7 +496,7 @@ flag fullConnectGroups(Group preGroup, Group postGroup, mask linkType,
   FOR_EVERY_UNIT(postGroup, {
     if (connectGroupToUnit(preGroup, U, linkType, range, mean, FALSE))
       return TCL_ERROR;});
-  return TCL_OK;
+  return packGroupLinks(postGroup);
 }
 
 static flag randomConnectGroups(Group preGroup, Group postGroup, mask linkType,
@@ -570,6 +644,7 @@ flag elmanConnect(Group source, Group elman) {
     if (P->type == ELMAN_CLAMP && !P->otherData) {
       P->otherData = (void *) source;
       set = TRUE;
+      freeNetPlan(Net);
     }
   }
   if (!set) return warning("Group \"%s\" has no empty ELMAN_CLAMP slots.",
@@ -645,8 +720,6 @@ flag disconnectUnits(Unit preUnit, Unit postUnit, mask linkType) {
   });
   if (postUnit->numBlocks == 0) {
     postUnit->block = NULL;
-    postUnit->incoming = NULL;
-    postUnit->incoming2 = NULL;
   }
   return TCL_OK;
 }
@@ -671,8 +744,6 @@ flag disconnectGroupFromUnit(Group preGroup, Unit postUnit, mask linkType) {
   });
   if (postUnit->numBlocks == 0) {
     postUnit->block = NULL;
-    postUnit->incoming = NULL;
-    postUnit->incoming2 = NULL;
   }
   return TCL_OK;
 }
@@ -684,8 +755,10 @@ flag disconnectGroups(Group preGroup, Group postGroup, mask linkType) {
   });
   if (linkType == ALL_LINKS && postGroup->outputType & ELMAN_CLAMP)
     for (P = postGroup->outputProcs; P; P = P->next) {
-      if ((P->type & ELMAN_CLAMP) && ((Group) P->otherData == preGroup))
+      if ((P->type & ELMAN_CLAMP) && ((Group) P->otherData == preGroup)) {
 	P->otherData = NULL;
+	freeNetPlan(Net);
+      }
     }
   return TCL_OK;
 }
@@ -712,8 +785,6 @@ flag deleteUnitInputs(Unit U, mask linkType) {
 
   if (U->numBlocks == 0) {
     U->block = NULL;
-    U->incoming = NULL;
-    U->incoming2 = NULL;
   }
   return TCL_OK;
 }
@@ -723,7 +794,10 @@ flag deleteGroupInputs(Group G, mask linkType) {
   FOR_EVERY_UNIT(G, if (deleteUnitInputs(U, linkType)) return TCL_ERROR);
   if (linkType == ALL_LINKS && G->outputType & ELMAN_CLAMP)
     for (P = G->outputProcs; P; P = P->next) {
-      if (P->type & ELMAN_CLAMP) P->otherData = NULL;
+      if (P->type & ELMAN_CLAMP) {
+	P->otherData = NULL;
+	freeNetPlan(Net);
+      }
     }
   return TCL_OK;
 }
@@ -807,7 +881,7 @@ static void setLinkWeights(Unit U, real prop, real value, mask linkType) {
     if (LINK_TYPE_MATCH(linkType, B)) {
       for (stop = l + B->numUnits; l < stop; l++)
 	if (randProb() < prop)
-	  U->incoming[l].weight = value;
+	  U->weight[l] = value;
     } else l += B->numUnits;
   });
 }
@@ -820,7 +894,7 @@ static void injectLinkWeightNoise(Unit U, real prop, real range,
     if (LINK_TYPE_MATCH(linkType, B)) {
       for (stop = l + B->numUnits; l < stop; l++)
 	if (randProb() < prop)
-	  U->incoming[l].weight = noiseProc(U->incoming[l].weight, range);
+	  U->weight[l] = noiseProc(U->weight[l], range);
     } else l += B->numUnits;
   });
 }
@@ -833,7 +907,7 @@ static void randomizeLinkWeights(Unit U, real prop, real range,
     if (LINK_TYPE_MATCH(linkType, B)) {
       for (stop = l + B->numUnits; l < stop; l++)
 	if (randProb() < prop)
-	  U->incoming[l].weight = noiseProc(0, range);
+	  U->weight[l] = noiseProc(0, range);
     } else l += B->numUnits;
   });
 }
@@ -878,29 +952,760 @@ static int numThawedLinks(void) {
   return n;
 }
 
-static void printBinaryLinkData(Tcl_Channel channel, Link L, Link2 M,
+static void printBinaryLinkData(Tcl_Channel channel, Unit U, int l,
 				int numValues) {
-  writeBinReal(channel, L->weight);
+  writeBinReal(channel, U->weight[l]);
   if (numValues > 1)
-    writeBinReal(channel, M->lastWeightDelta);
+    writeBinReal(channel, U->lastWeightDelta[l]);
 #ifdef ADVANCED
   if (numValues > 2)
-    writeBinReal(channel, M->lastValue);
+    writeBinReal(channel, U->lastValue[l]);
 #endif /* ADVANCED */
 }
 
-static void printTextLinkData(Tcl_Channel channel, Link L, Link2 M,
+static void printTextLinkData(Tcl_Channel channel, Unit U, int l,
 			      int numValues) {
-  writeReal(channel, L->weight, "", "");
+  writeReal(channel, U->weight[l], "", "");
   if (numValues > 1)
-    writeReal(channel, M->lastWeightDelta, " ", "");
+    writeReal(channel, U->lastWeightDelta[l], " ", "");
 #ifdef ADVANCED
   if (numValues > 2)
-    writeReal(channel, M->lastValue, " ", "");
+    writeReal(channel, U->lastValue[l], " ", "");
 #endif /* ADVANCED */
   cprintf(channel, "\n");
 }
 
+/* Mapped weight files hold every link in the byte order of the machine that
+   wrote them.  After the header, each group has the weights of all of its
+   units' links, then their last weight changes and, if ADVANCED, their last
+   values, each array padded to 64 bytes.  That is how a packed group keeps
+   them in its link matrix, so a group loads with one copy per array.  The
+   fingerprint covers the size and sources of every group, unit and block, so
+   a file only loads into a network with the same topology. */
+#define WEIGHT_MAP_VERSION  1
+#define WEIGHT_MAP_ALIGN(x) (((x) + 63) & ~((long long) 63))
+#ifdef ADVANCED
+#define WEIGHT_MAP_VALUES   3
+#else
+#define WEIGHT_MAP_VALUES   2
+#endif /* ADVANCED */
+
+typedef struct weightMapHeader {
+  int        cookie;            /* MAPPED_WEIGHT_COOKIE in network order */
+  int        byteOrder;
+  int        version;
+  int        realSize;
+  int        numValues;
+  int        totalUpdates;
+  int        numGroups;
+  int        pad;
+  long long  numLinks;
+  unsigned long long fingerprint;
+  long long  data;              /* Offset of the first group's arrays */
+  long long  size;
+} *WeightMapHeader;
+
+/* The number of values per link in the last weight file loaded. */
+static int LoadedValues = 1;
+
+static real *linkValues(Unit U, int k) {
+  switch (k) {
+  case 0:  return U->weight;
+  case 1:  return U->lastWeightDelta;
+#ifdef ADVANCED
+  case 2:  return U->lastValue;
+#endif /* ADVANCED */
+  default: return NULL;
+  }
+}
+
+static unsigned long long hashInt(unsigned long long h, int x) {
+  int i;
+  for (i = 0; i < 4; i++, x >>= 8) {
+    h ^= (unsigned long long) (x & 0xff);
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+static unsigned long long weightFingerprint(void) {
+  unsigned long long h = 14695981039346656037ULL;
+  h = hashInt(h, Net->numGroups);
+  FOR_EACH_GROUP({
+    h = hashInt(h, G->numUnits);
+    FOR_EVERY_UNIT(G, {
+      h = hashInt(h, U->numIncoming);
+      h = hashInt(h, U->numBlocks);
+      FOR_EACH_BLOCK(U, {
+	h = hashInt(h, B->numUnits);
+	h = hashInt(h, B->unit->group->num);
+	h = hashInt(h, B->unit->num);
+      });
+    });
+  });
+  return h;
+}
+
+static long long groupLinks(Group G) {
+  long long n = 0;
+  FOR_EVERY_UNIT(G, n += U->numIncoming);
+  return n;
+}
+
+long long weightMapSize(int numValues) {
+  if (numValues > WEIGHT_MAP_VALUES) numValues = WEIGHT_MAP_VALUES;
+  long long size = WEIGHT_MAP_ALIGN((long long)
+				    sizeof(struct weightMapHeader));
+  FOR_EACH_GROUP(size += numValues *
+		 WEIGHT_MAP_ALIGN(groupLinks(G) * sizeof(real)));
+  return size;
+}
+
+static void fillWeightMapHeader(WeightMapHeader H, int numValues) {
+  memset(H, 0, sizeof *H);
+  H->cookie       = htonl(MAPPED_WEIGHT_COOKIE);
+  H->byteOrder    = MAP_BYTE_ORDER;
+  H->version      = WEIGHT_MAP_VERSION;
+  H->realSize     = sizeof(real);
+  H->numValues    = numValues;
+  H->totalUpdates = Net->totalUpdates;
+  H->numGroups    = Net->numGroups;
+  H->numLinks     = Net->numLinks;
+  H->fingerprint  = weightFingerprint();
+  H->data         = WEIGHT_MAP_ALIGN((long long)
+				     sizeof(struct weightMapHeader));
+  H->size         = weightMapSize(numValues);
+}
+
+static flag mapWriteWeights(Tcl_Channel channel, void *data,
+			    long long size) {
+  char *s = (char *) data;
+  int chunk;
+  for (; size > 0; s += chunk, size -= chunk) {
+    chunk = (size > (1 << 30)) ? (1 << 30) : (int) size;
+    if (Tcl_Write(channel, s, chunk) != chunk) return TCL_ERROR;
+  }
+  return TCL_OK;
+}
+
+/* Every link is saved, so there are no frozen options. */
+flag saveMappedWeights(Tcl_Obj *fileNameObj, int numValues) {
+  const char *fileName = Tcl_GetStringFromObj(fileNameObj, NULL);
+  static char pad[64];
+  struct weightMapHeader header;
+  WeightMapHeader H = &header;
+  Tcl_Channel channel;
+  long long bytes;
+  flag failed;
+  int k;
+
+  if (fileName[0] == '|' || fileName[0] == '-' ||
+      stringEndsIn(fileName, ".gz") || stringEndsIn(fileName, ".Z") ||
+      stringEndsIn(fileName, ".bz") || stringEndsIn(fileName, ".bz2"))
+    return warning("saveMappedWeights: mapped weight files must be plain "
+		   "files, not \"%s\"", fileName);
+  if (numValues > WEIGHT_MAP_VALUES) numValues = WEIGHT_MAP_VALUES;
+  if (!(channel = writeChannel(fileNameObj, FALSE)))
+    return warning("saveMappedWeights: couldn't open the file \"%s\"",
+		   fileName);
+  binaryEncoding(channel);
+  Tcl_SetChannelBufferSize(channel, 1 << 20);
+  fillWeightMapHeader(H, numValues);
+  failed = mapWriteWeights(channel, H, sizeof *H) ||
+    mapWriteWeights(channel, pad, H->data - sizeof *H);
+  FOR_EACH_GROUP({
+    bytes = groupLinks(G) * sizeof(real);
+    for (k = 0; k < numValues && !failed; k++) {
+      if (G->linkMatrix)
+	failed = mapWriteWeights(channel, linkValues(G->unit, k), bytes);
+      else FOR_EVERY_UNIT(G, {
+	if (!failed && U->numIncoming)
+	  failed = mapWriteWeights(channel, linkValues(U, k),
+				   U->numIncoming * sizeof(real));
+      });
+      if (!failed)
+	failed = mapWriteWeights(channel, pad,
+				 WEIGHT_MAP_ALIGN(bytes) - bytes);
+    }
+  });
+  closeChannel(channel);
+  if (failed)
+    return warning("saveMappedWeights: error writing the file \"%s\"",
+		   fileName);
+  return TCL_OK;
+}
+
+/* This checks a mapped weight image against the network before loading any
+   of it.  Frozen links are told apart by block, so they are only loaded a
+   group at a time if everything is being loaded. */
+flag loadWeightMap(char *data, long long size, const char *commandName,
+		   const char *fileName, flag thawed, flag frozen) {
+  struct weightMapHeader expect;
+  WeightMapHeader H = (WeightMapHeader) data;
+  char *problem = NULL;
+  real *source, *values;
+  long long offset, n;
+  int k, l;
+  flag isFrozen;
+
+  if (size < (long long) sizeof(struct weightMapHeader) ||
+      ntohl(H->cookie) != MAPPED_WEIGHT_COOKIE)
+    problem = "missing cookie";
+  else if (H->byteOrder != MAP_BYTE_ORDER)
+    problem = "file was written on a machine with a different byte order";
+  else if (H->version != WEIGHT_MAP_VERSION)
+    problem = "unknown version";
+  else if (H->realSize != sizeof(real))
+    problem = "sizeof(real) doesn't match";
+  else if (H->numValues <= 0 || H->numValues > 3)
+    problem = "bad number of values";
+  else if (H->numLinks != Net->numLinks)
+    return warning("%s: network has %d links but the file \"%s\" contains "
+		   "%lld", commandName, Net->numLinks, fileName, H->numLinks);
+  else {
+    fillWeightMapHeader(&expect, H->numValues);
+    if (H->numGroups != expect.numGroups ||
+	H->fingerprint != expect.fingerprint)
+      problem = "network's connections don't match those";
+    else if (H->data != expect.data || H->size != expect.size ||
+	     size != H->size)
+      problem = "size doesn't match the header";
+  }
+  if (problem)
+    return warning("%s: %s in the file \"%s\"", commandName, problem,
+		   fileName);
+
+  offset = H->data;
+  FOR_EACH_GROUP({
+    n = groupLinks(G);
+    for (k = 0; k < H->numValues; offset += WEIGHT_MAP_ALIGN(n *
+							     sizeof(real)),
+	   k++) {
+      source = (real *) (data + offset);
+      if (k >= WEIGHT_MAP_VALUES) continue;
+      if (thawed && frozen && G->linkMatrix) {
+	memcpy(linkValues(G->unit, k), source, n * sizeof(real));
+	continue;
+      }
+      FOR_EVERY_UNIT(G, {
+	values = linkValues(U, k);
+	if (thawed && frozen) {
+	  if (U->numIncoming)
+	    memcpy(values, source, U->numIncoming * sizeof(real));
+	} else {
+	  l = 0;
+	  FOR_EACH_BLOCK(U, {
+	    isFrozen = ((Net->type | G->type | U->type | B->type) & FROZEN) ?
+	      TRUE : FALSE;
+	    if ((isFrozen) ? frozen : thawed)
+	      memcpy(values + l, source + l, B->numUnits * sizeof(real));
+	    l += B->numUnits;
+	  });
+	}
+	source += U->numIncoming;
+      });
+    }
+  });
+  if (thawed) Net->totalUpdates = H->totalUpdates;
+  LoadedValues = H->numValues;
+  return TCL_OK;
+}
+
+static flag loadMappedWeights(Tcl_Obj *fileNameObj, flag thawed,
+			      flag frozen) {
+  const char *fileName = Tcl_GetStringFromObj(fileNameObj, NULL);
+  char *data;
+  size_t size;
+  flag result;
+
+  if (!(data = mapFile(fileNameObj, &size)))
+    return warning("standardLoadWeights: couldn't map the file \"%s\", "
+		   "mapped weight files can't be compressed", fileName);
+  result = loadWeightMap(data, (long long) size, "standardLoadWeights",
+			 fileName, thawed, frozen);
+  unmapFile(data, size);
+  return result;
+}
+
+/* This loads a weight file into the current network and saves it in another
+   format, leaving the network's links and updates as they were.  A mapped
+   file becomes a binary one unless the format is given, and any other file
+   becomes a mapped one. */
+flag convertWeights(Tcl_Obj *sourceObj, Tcl_Obj *destObj, int format) {
+  real *saved, *s;
+  int k, totalUpdates = Net->totalUpdates, cookie = 0;
+  flag result;
+  Tcl_Channel channel;
+
+  if ((channel = readChannel(sourceObj))) {
+    readBinInt(channel, &cookie);
+    closeChannel(channel);
+  }
+  if (format == WEIGHTS_OTHER)
+    format = (cookie == MAPPED_WEIGHT_COOKIE) ? WEIGHTS_BINARY :
+      WEIGHTS_MAPPED;
+
+  s = saved = realArray(WEIGHT_MAP_VALUES * Net->numLinks + 1,
+			"convertWeights:saved");
+  FOR_EACH_GROUP(FOR_EVERY_UNIT(G, {
+    for (k = 0; k < WEIGHT_MAP_VALUES; k++, s += U->numIncoming)
+      if (U->numIncoming)
+	memcpy(s, linkValues(U, k), U->numIncoming * sizeof(real));
+  }));
+
+  LoadedValues = 1;
+  if (!(result = standardLoadWeights(sourceObj, TRUE, TRUE)))
+    result = (format == WEIGHTS_MAPPED) ?
+      saveMappedWeights(destObj, LoadedValues) :
+      standardSaveWeights(destObj, (format == WEIGHTS_BINARY),
+			  LoadedValues, TRUE, TRUE);
+
+  s = saved;
+  FOR_EACH_GROUP(FOR_EVERY_UNIT(G, {
+    for (k = 0; k < WEIGHT_MAP_VALUES; k++, s += U->numIncoming)
+      if (U->numIncoming)
+	memcpy(linkValues(U, k), s, U->numIncoming * sizeof(real));
+  }));
+  FREE(saved);
+  Net->totalUpdates = totalUpdates;
+  return result;
+}
+
+/* This fills an image of a mapped weight file, which must have
+   weightMapSize(numValues) bytes.  If links isn't NULL, it gets the number
+   of links into each group. */
+void copyWeightMap(char *image, int numValues, long long *links) {
+  struct weightMapHeader header;
+  long long offset, bytes, n;
+  real *dest;
+  int k;
+
+  if (numValues > WEIGHT_MAP_VALUES) numValues = WEIGHT_MAP_VALUES;
+  fillWeightMapHeader(&header, numValues);
+  memset(image, 0, header.data);
+  memcpy(image, &header, sizeof header);
+  offset = header.data;
+  FOR_EACH_GROUP({
+    n = groupLinks(G);
+    if (links) links[g] = n;
+    bytes = n * sizeof(real);
+    for (k = 0; k < numValues; k++) {
+      if (G->linkMatrix)
+	memcpy(image + offset, linkValues(G->unit, k), bytes);
+      else {
+	dest = (real *) (image + offset);
+	FOR_EVERY_UNIT(G, {
+	  if (U->numIncoming)
+	    memcpy(dest, linkValues(U, k), U->numIncoming * sizeof(real));
+	  dest += U->numIncoming;
+	});
+      }
+      memset(image + offset + bytes, 0, WEIGHT_MAP_ALIGN(bytes) - bytes);
+      offset += WEIGHT_MAP_ALIGN(bytes);
+    }
+  });
+}
+
+/* A checkpoint copies the link values into an image of a mapped weight file,
+   which a background thread writes to a temporary file and renames into
+   place, so training only waits for the copy.  Unless the image is written
+   as it is, the thread encodes it as a standard binary weight file, deflated
+   with gzip if the name ends in .gz.  Training also waits if
+   CHECKPOINT_QUEUE checkpoints are already waiting to be written. */
+#define CHECKPOINT_QUEUE  2
+#define CHECKPOINT_BLOCK  (1 << 20)
+
+typedef struct checkpoint *Checkpoint;
+struct checkpoint {
+  char       *fileName;         /* Native paths */
+  char       *tempName;
+  Tcl_Channel channel;
+  flag        mapped;
+  flag        compress;
+  int         keep;
+  int         numValues;
+  int         numGroups;
+  long long  *groupLinks;
+  char       *image;
+  long long   size;
+  char       *error;
+  Checkpoint  next;
+};
+
+static struct checkpointer {
+  Checkpoint  first;
+  Checkpoint  last;
+  int         pending;
+  int         written;
+  int         failed;
+  char       *lastFile;
+  char       *lastError;
+  char      **kept;             /* Files written, oldest first */
+  int         numKept;
+  char       *spare;            /* An image to reuse */
+  long long   spareSize;
+#ifdef HAVE_THREADS
+  pthread_t       thread;
+  pthread_mutex_t lock;
+  pthread_cond_t  ready;        /* A checkpoint was queued or stop was set */
+  pthread_cond_t  done;         /* A checkpoint was written */
+  flag            running;
+  flag            stop;
+#endif /* HAVE_THREADS */
+} Checkpointer;
+
+static void lockCheckpoints(void) {
+#ifdef HAVE_THREADS
+  if (Checkpointer.running) pthread_mutex_lock(&Checkpointer.lock);
+#endif /* HAVE_THREADS */
+}
+
+static void unlockCheckpoints(void) {
+#ifdef HAVE_THREADS
+  if (Checkpointer.running) pthread_mutex_unlock(&Checkpointer.lock);
+#endif /* HAVE_THREADS */
+}
+
+static char *checkpointImage(Checkpoint C) {
+  char *image;
+  C->size = weightMapSize(C->numValues);
+  lockCheckpoints();
+  if ((image = Checkpointer.spare) && Checkpointer.spareSize == C->size)
+    Checkpointer.spare = NULL;
+  else image = NULL;
+  unlockCheckpoints();
+  if (!image)
+    image = (char *) safeMalloc(C->size, "checkpointImage:image");
+  copyWeightMap(image, C->numValues, C->groupLinks);
+  return image;
+}
+
+static flag writeCheckpointBytes(Checkpoint C, Tcl_ZlibStream zs,
+				 char *data, int bytes) {
+  Tcl_Obj *in, *out;
+  unsigned char *s;
+  int n;
+  flag failed = FALSE;
+  if (!zs) return (Tcl_Write(C->channel, data, bytes) != bytes);
+  in = Tcl_NewByteArrayObj((unsigned char *) data, bytes);
+  out = Tcl_NewObj();
+  Tcl_IncrRefCount(in);
+  Tcl_IncrRefCount(out);
+  if (Tcl_ZlibStreamPut(zs, in, (bytes) ? TCL_ZLIB_NO_FLUSH :
+			TCL_ZLIB_FINALIZE) != TCL_OK ||
+      Tcl_ZlibStreamGet(zs, out, -1) != TCL_OK)
+    failed = TRUE;
+  else {
+    s = Tcl_GetByteArrayFromObj(out, &n);
+    failed = (n && Tcl_Write(C->channel, (char *) s, n) != n);
+  }
+  Tcl_DecrRefCount(in);
+  Tcl_DecrRefCount(out);
+  return failed;
+}
+
+/* This matches standardSaveWeights() with every link. */
+static flag encodeCheckpoint(Checkpoint C) {
+  WeightMapHeader H = (WeightMapHeader) C->image;
+  char *buf, *s, *end;
+  real *values[WEIGHT_MAP_VALUES];
+  long long offset = H->data, l;
+  int g, k, x;
+  flag failed = FALSE;
+  Tcl_ZlibStream zs = NULL;
+
+  if (C->compress &&
+      Tcl_ZlibStreamInit(NULL, TCL_ZLIB_STREAM_DEFLATE, TCL_ZLIB_FORMAT_GZIP,
+			 TCL_ZLIB_COMPRESS_FAST, NULL, &zs) != TCL_OK)
+    return TCL_ERROR;
+  s = buf = (char *) safeMalloc(CHECKPOINT_BLOCK, "encodeCheckpoint:buf");
+  end = buf + CHECKPOINT_BLOCK - WEIGHT_MAP_VALUES * sizeof(int);
+  x = HTONL(BINARY_WEIGHT_COOKIE); memcpy(s, &x, sizeof(int));
+  x = HTONL((int) H->numLinks);    memcpy(s + 4, &x, sizeof(int));
+  x = HTONL(H->numValues);         memcpy(s + 8, &x, sizeof(int));
+  x = HTONL(H->totalUpdates);      memcpy(s + 12, &x, sizeof(int));
+  s += 4 * sizeof(int);
+  for (g = 0; g < C->numGroups && !failed; g++) {
+    for (k = 0; k < H->numValues; k++) {
+      values[k] = (real *) (C->image + offset);
+      offset += WEIGHT_MAP_ALIGN(C->groupLinks[g] * sizeof(real));
+    }
+    for (l = 0; l < C->groupLinks[g] && !failed; l++) {
+      for (k = 0; k < H->numValues; k++) {
+#ifdef FLOAT_REAL
+	memcpy(&x, values[k] + l, sizeof(int));
+#else
+	float f = (isNaN(values[k][l])) ? NaNf : (float) values[k][l];
+	memcpy(&x, &f, sizeof(int));
+#endif /* FLOAT_REAL */
+	x = HTONL(x);
+	memcpy(s, &x, sizeof(int));
+	s += sizeof(int);
+      }
+      if (s >= end) {
+	failed = writeCheckpointBytes(C, zs, buf, s - buf);
+	s = buf;
+      }
+    }
+  }
+  if (!failed && s > buf) failed = writeCheckpointBytes(C, zs, buf, s - buf);
+  if (!failed && zs) failed = writeCheckpointBytes(C, zs, buf, 0);
+  if (zs) Tcl_ZlibStreamClose(zs);
+  FREE(buf);
+  return failed;
+}
+
+/* Names are in the same series if they only differ in their runs of
+   digits, such as run.1000.wt.gz and run.2000.wt.gz. */
+static flag sameSeries(const char *a, const char *b) {
+  while (*a && *b) {
+    if (isdigit((int) *a) && isdigit((int) *b)) {
+      while (isdigit((int) *a)) a++;
+      while (isdigit((int) *b)) b++;
+    } else if (*a++ != *b++) return FALSE;
+  }
+  return (!*a && !*b) ? TRUE : FALSE;
+}
+
+/* Only files written with -keep are listed, and each series is cut down to
+   the newest keep files on its own.  A file written again without -keep is
+   dropped from the list so it won't be removed later. */
+static void keepCheckpoint(Checkpoint C) {
+  int i, j, n;
+  for (i = j = 0; i < Checkpointer.numKept; i++) {
+    if (!strcmp(Checkpointer.kept[i], C->fileName)) {
+      FREE(Checkpointer.kept[i]);
+    } else Checkpointer.kept[j++] = Checkpointer.kept[i];
+  }
+  Checkpointer.numKept = j;
+  if (C->keep <= 0) return;
+  Checkpointer.kept = (char **) safeRealloc(Checkpointer.kept,
+					    (j + 1) * sizeof(char *),
+					    "keepCheckpoint:kept");
+  Checkpointer.kept[j++] = copyString(C->fileName);
+  for (i = j - 1, n = 0; i >= 0; i--) {
+    if (!sameSeries(Checkpointer.kept[i], C->fileName) || ++n <= C->keep)
+      continue;
+    remove(Checkpointer.kept[i]);
+    FREE(Checkpointer.kept[i]);
+  }
+  for (i = n = 0; i < j; i++)
+    if (Checkpointer.kept[i]) Checkpointer.kept[n++] = Checkpointer.kept[i];
+  Checkpointer.numKept = n;
+}
+
+/* This runs on the checkpoint thread if there is one.  The list of kept files
+   is only touched here. */
+static void writeCheckpoint(Checkpoint C) {
+  const char *problem = NULL;
+  flag failed;
+#ifdef HAVE_THREADS
+  if (Checkpointer.running) Tcl_SpliceChannel(C->channel);
+#endif /* HAVE_THREADS */
+  if (C->mapped)
+    failed = (mapWriteWeights(C->channel, C->image, C->size) != TCL_OK);
+  else failed = encodeCheckpoint(C);
+  if (Tcl_Close(NULL, C->channel) != TCL_OK) failed = TRUE;
+  C->channel = NULL;
+  if (failed) problem = "error writing";
+  else {
+#ifdef MACHINE_WINDOWS
+    remove(C->fileName);
+#endif /* MACHINE_WINDOWS */
+    if (rename(C->tempName, C->fileName)) problem = "couldn't rename";
+  }
+  if (problem) {
+    remove(C->tempName);
+    C->error = (char *) safeMalloc(strlen(problem) + strlen(C->fileName) + 32,
+				   "writeCheckpoint:C->error");
+    sprintf(C->error, "checkpointWeights: %s \"%s\"", problem, C->fileName);
+  } else keepCheckpoint(C);
+}
+
+/* This is called with the lock held. */
+static void finishCheckpoint(Checkpoint C) {
+  if (!(Checkpointer.first = C->next)) Checkpointer.last = NULL;
+  Checkpointer.pending--;
+  if (C->error) {
+    Checkpointer.failed++;
+    FREE(Checkpointer.lastError);
+    Checkpointer.lastError = C->error;
+  } else {
+    Checkpointer.written++;
+    FREE(Checkpointer.lastFile);
+    Checkpointer.lastFile = copyString(C->fileName);
+  }
+  if (Checkpointer.spare) FREE(Checkpointer.spare);
+  Checkpointer.spare = C->image;
+  Checkpointer.spareSize = C->size;
+  FREE(C->fileName);
+  FREE(C->tempName);
+  FREE(C->groupLinks);
+  FREE(C);
+}
+
+#ifdef HAVE_THREADS
+static void *checkpointThread(void *data) {
+  Checkpoint C;
+  pthread_mutex_lock(&Checkpointer.lock);
+  while (TRUE) {
+    while (!Checkpointer.first && !Checkpointer.stop)
+      pthread_cond_wait(&Checkpointer.ready, &Checkpointer.lock);
+    if (!(C = Checkpointer.first)) break;
+    pthread_mutex_unlock(&Checkpointer.lock);
+    writeCheckpoint(C);
+    pthread_mutex_lock(&Checkpointer.lock);
+    finishCheckpoint(C);
+    pthread_cond_broadcast(&Checkpointer.done);
+  }
+  pthread_mutex_unlock(&Checkpointer.lock);
+  return NULL;
+}
+#endif /* HAVE_THREADS */
+
+/* This waits for the checkpoints to be written and stops the thread. */
+void finishCheckpoints(void) {
+#ifdef HAVE_THREADS
+  if (!Checkpointer.running) return;
+  pthread_mutex_lock(&Checkpointer.lock);
+  Checkpointer.stop = TRUE;
+  pthread_cond_signal(&Checkpointer.ready);
+  pthread_mutex_unlock(&Checkpointer.lock);
+  pthread_join(Checkpointer.thread, NULL);
+  pthread_mutex_destroy(&Checkpointer.lock);
+  pthread_cond_destroy(&Checkpointer.ready);
+  pthread_cond_destroy(&Checkpointer.done);
+  Checkpointer.running = FALSE;
+  Checkpointer.stop = FALSE;
+#endif /* HAVE_THREADS */
+}
+
+static void finishCheckpointsOnExit(ClientData data) {
+  finishCheckpoints();
+}
+
+#ifdef HAVE_THREADS
+static void startCheckpointThread(void) {
+  static flag exitHandler = FALSE;
+  if (!exitHandler) {
+    Tcl_CreateExitHandler(finishCheckpointsOnExit, NULL);
+    exitHandler = TRUE;
+  }
+  pthread_mutex_init(&Checkpointer.lock, NULL);
+  pthread_cond_init(&Checkpointer.ready, NULL);
+  pthread_cond_init(&Checkpointer.done, NULL);
+  Checkpointer.running = TRUE;
+  if (pthread_create(&Checkpointer.thread, NULL, checkpointThread, NULL)) {
+    pthread_mutex_destroy(&Checkpointer.lock);
+    pthread_cond_destroy(&Checkpointer.ready);
+    pthread_cond_destroy(&Checkpointer.done);
+    Checkpointer.running = FALSE;
+  }
+}
+#endif /* HAVE_THREADS */
+
+/* Every link is saved, as in a mapped weight file.  Errors in writing are
+   reported by checkpointStatus. */
+flag checkpointWeights(Tcl_Obj *fileNameObj, int numValues, int keep,
+		       flag mapped) {
+  const char *fileName = Tcl_GetStringFromObj(fileNameObj, NULL);
+  Tcl_Obj *tempObj;
+  Checkpoint C;
+  flag compress = stringEndsIn(fileName, ".gz");
+
+  if (fileName[0] == '|' || fileName[0] == '-' ||
+      stringEndsIn(fileName, ".Z") || stringEndsIn(fileName, ".bz") ||
+      stringEndsIn(fileName, ".bz2") || (mapped && compress))
+    return warning("checkpointWeights: checkpoints must be plain files or "
+		   "end in .gz, not \"%s\"", fileName);
+  if (numValues > WEIGHT_MAP_VALUES) numValues = WEIGHT_MAP_VALUES;
+
+  C = (Checkpoint) safeCalloc(1, sizeof *C, "checkpointWeights:C");
+  C->fileName = copyString(Tcl_FSGetNativePath(fileNameObj));
+  tempObj = Tcl_ObjPrintf("%s.tmp", fileName);
+  Tcl_IncrRefCount(tempObj);
+  C->tempName = copyString(Tcl_FSGetNativePath(tempObj));
+  C->channel = Tcl_FSOpenFileChannel(NULL, tempObj, "w", 0666);
+  Tcl_DecrRefCount(tempObj);
+  if (!C->channel || !C->fileName || !C->tempName) {
+    if (C->channel) Tcl_Close(NULL, C->channel);
+    FREE(C->fileName);
+    FREE(C->tempName);
+    FREE(C);
+    return warning("checkpointWeights: couldn't open the file \"%s.tmp\"",
+		   fileName);
+  }
+  binaryEncoding(C->channel);
+  Tcl_SetChannelBufferSize(C->channel, 1 << 20);
+  C->mapped = mapped;
+  C->compress = compress;
+  C->keep = keep;
+  C->numValues = numValues;
+  C->numGroups = Net->numGroups;
+  C->groupLinks = (long long *) safeCalloc(C->numGroups + 1,
+					   sizeof(long long),
+					   "checkpointWeights:C->groupLinks");
+
+#ifdef HAVE_THREADS
+  if (!Checkpointer.running) startCheckpointThread();
+  if (Checkpointer.running) {
+    pthread_mutex_lock(&Checkpointer.lock);
+    while (Checkpointer.pending >= CHECKPOINT_QUEUE)
+      pthread_cond_wait(&Checkpointer.done, &Checkpointer.lock);
+    pthread_mutex_unlock(&Checkpointer.lock);
+  }
+#endif /* HAVE_THREADS */
+  C->image = checkpointImage(C);
+
+  lockCheckpoints();
+  if (Checkpointer.last) Checkpointer.last->next = C;
+  else Checkpointer.first = C;
+  Checkpointer.last = C;
+  Checkpointer.pending++;
+#ifdef HAVE_THREADS
+  if (Checkpointer.running) {
+    Tcl_CutChannel(C->channel);
+    pthread_cond_signal(&Checkpointer.ready);
+    pthread_mutex_unlock(&Checkpointer.lock);
+    return TCL_OK;
+  }
+#endif /* HAVE_THREADS */
+  writeCheckpoint(C);
+  finishCheckpoint(C);
+  return TCL_OK;
+}
+
+/* This returns the checkpoints that are still being written, those written
+   and failed, and the last file written and error, waiting first if asked. */
+flag checkpointStatus(flag wait) {
+  Tcl_Obj *list = Tcl_NewListObj(0, NULL);
+  lockCheckpoints();
+#ifdef HAVE_THREADS
+  if (Checkpointer.running)
+    while (wait && Checkpointer.pending)
+      pthread_cond_wait(&Checkpointer.done, &Checkpointer.lock);
+#endif /* HAVE_THREADS */
+  Tcl_ListObjAppendElement(Interp, list, Tcl_NewStringObj("pending", -1));
+  Tcl_ListObjAppendElement(Interp, list,
+			   Tcl_NewIntObj(Checkpointer.pending));
+  Tcl_ListObjAppendElement(Interp, list, Tcl_NewStringObj("written", -1));
+  Tcl_ListObjAppendElement(Interp, list,
+			   Tcl_NewIntObj(Checkpointer.written));
+  Tcl_ListObjAppendElement(Interp, list, Tcl_NewStringObj("failed", -1));
+  Tcl_ListObjAppendElement(Interp, list, Tcl_NewIntObj(Checkpointer.failed));
+  Tcl_ListObjAppendElement(Interp, list, Tcl_NewStringObj("last", -1));
+  Tcl_ListObjAppendElement(Interp, list,
+			   Tcl_NewStringObj((Checkpointer.lastFile) ?
+					    Checkpointer.lastFile : "", -1));
+  Tcl_ListObjAppendElement(Interp, list, Tcl_NewStringObj("error", -1));
+  Tcl_ListObjAppendElement(Interp, list,
+			   Tcl_NewStringObj((Checkpointer.lastError) ?
+					    Checkpointer.lastError : "", -1));
+  unlockCheckpoints();
+  Tcl_SetObjResult(Interp, list);
+  return TCL_OK;
+}
+
 /* numValues will not be > 2 if not ADVANCED */
 flag standardSaveWeights(Tcl_Obj *fileNameObj, flag binary, int numValues,
 			 flag thawed, flag frozen)
@@ -908,7 +1713,7 @@ flag standardSaveWeights(Tcl_Obj *fileNameObj, flag binary, int numValues,
   const char *fileName = Tcl_GetStringFromObj(fileNameObj, NULL);
   int numLinks = 0, thawedLinks, i, si, nCallsToPrintLinkData = 0;
   Tcl_Channel channel;
-  void (*printLinkData)(Tcl_Channel, Link, Link2, int);
+  void (*printLinkData)(Tcl_Channel, Unit, int, int);
 
   if (!(channel = writeChannel(fileNameObj, FALSE)))
     return warning("standardSaveWeights: couldn't open the file \"%s\"",
@@ -945,8 +1750,7 @@ flag standardSaveWeights(Tcl_Obj *fileNameObj, flag binary, int numValues,
               (!thawed && (!((Net->type | G->type | U->type | B->type)
                  & FROZEN)))) i += B->numUnits;
           else for (si = i + B->numUnits; i < si; i++) {
-            printLinkData(channel, U->incoming + i, U->incoming2 + i,
-              numValues);
+            printLinkData(channel, U, i, numValues);
             nCallsToPrintLinkData++;
             }
 	})})})}
@@ -956,35 +1760,35 @@ flag standardSaveWeights(Tcl_Obj *fileNameObj, flag binary, int numValues,
   return TCL_OK;
 }
 
-static flag readBinaryLinkData(Tcl_Channel channel, Link L, Link2 M,
+static flag readBinaryLinkData(Tcl_Channel channel, Unit U, int l,
 			       int numValues, ParseRec R) {
   real v=0 ;
-  if (readBinReal(channel, &L->weight))
+  if (readBinReal(channel, U->weight + l))
   return warning("standardLoadWeights: channel \"%s\" ended prematurely",
 		 Tcl_GetStringFromObj(R->fileName, NULL));
   if (numValues > 1)
-    readBinReal(channel, &M->lastWeightDelta);
+    readBinReal(channel, U->lastWeightDelta + l);
   if (numValues > 2) {
     readBinReal(channel, &v);
 #ifdef ADVANCED
-    M->lastValue = v;
+    U->lastValue[l] = v;
 #endif // ADVANCED
   }
   return TCL_OK;
 }
 
-static flag readTextLinkData(Tcl_Channel channel, Link L, Link2 M,
+static flag readTextLinkData(Tcl_Channel channel, Unit U, int l,
 			     int numValues, ParseRec R) {
   real v;
-  if (readReal(R, &L->weight))
+  if (readReal(R, U->weight + l))
     return warning("standardLoadWeights: error reading weight on line "
 		   "%d of\nfile \"%s\"", R->line, R->fileName);
   if (numValues > 1)
-    readReal(R, &M->lastWeightDelta);
+    readReal(R, U->lastWeightDelta + l);
   if (numValues > 2)
     readReal(R, &v);
 #ifdef ADVANCED
-  M->lastValue = v;
+  U->lastValue[l] = v;
 #endif /* ADVANCED */
   return TCL_OK;
 }
@@ -996,7 +1800,7 @@ flag standardLoadWeights(Tcl_Obj *fileNameObj, flag thawed, flag frozen) {
   Tcl_Channel channel;
   struct parseRec rec;
   ParseRec R = &rec;
-  flag (*readLinkData)(Tcl_Channel, Link, Link2, int, ParseRec);
+  flag (*readLinkData)(Tcl_Channel, Unit, int, int, ParseRec);
   rec.buf = NULL;
   rec.fileName = fileNameObj;
 
@@ -1012,6 +1816,11 @@ flag standardLoadWeights(Tcl_Obj *fileNameObj, flag thawed, flag frozen) {
     result = warning("standardLoadWeights: file \"%s\" is empty", fileName);
     goto done;}
 
+  if (i == MAPPED_WEIGHT_COOKIE) {
+    closeChannel(channel);
+    return loadMappedWeights(fileNameObj, thawed, frozen);
+  }
+
   if (i == BINARY_WEIGHT_COOKIE) {
     binaryEncoding(channel);
     print(1, "standardLoadWeights: binary\n");
@@ -1127,8 +1936,7 @@ flag standardLoadWeights(Tcl_Obj *fileNameObj, flag thawed, flag frozen) {
               (!thawed && (!((Net->type | G->type | U->type | B->type)
                  & FROZEN)))) i += B->numUnits;
           else for (si = i + B->numUnits; i < si; i++) {
-            readLinkData(channel, U->incoming + i, U->incoming2 + i,
-             numValues, R);
+            readLinkData(channel, U, i, numValues, R);
             //print(1, "\b\b\b\b% 4d", jjj++);
           };
 
@@ -1136,6 +1944,7 @@ flag standardLoadWeights(Tcl_Obj *fileNameObj, flag thawed, flag frozen) {
   print(1,"\n");
   if (totalUpdates >= 0 && thawed)
     Net->totalUpdates = totalUpdates;
+  LoadedValues = numValues;
 
  done:
   if (rec.buf) freeString(rec.buf);
@@ -1151,7 +1960,7 @@ flag loadXerionWeights(Tcl_Obj *fileNameObj) {
   int fromUnit, toUnit;
   real weight;
   Group F, T;
-  Link L;
+  int l;
   const char *fileName = Tcl_GetStringFromObj(fileNameObj, NULL);
 
   if (!(channel = readChannel(fileNameObj)))
@@ -1203,13 +2012,14 @@ flag loadXerionWeights(Tcl_Obj *fileNameObj) {
       goto done;
     }
 
-    if (!(L = lookupLink(F->unit + fromUnit, T->unit + toUnit, NULL, ALL_LINKS))) {
+    if ((l = lookupLink(F->unit + fromUnit, T->unit + toUnit,
+			ALL_LINKS)) < 0) {
       result = warning("loadXerionWeights: missing link from %s:%d to %s:%d",
 		       F->name, fromUnit, T->name, toUnit);
       goto done;
     }
-    initLinkValues(L, getLink2(T->unit + toUnit, L));
-    L->weight = weight;
+    initLinkValues(T->unit + toUnit, l);
+    T->unit[toUnit].weight[l] = weight;
     Tcl_DStringFree(&ds);
   }
 
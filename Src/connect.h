@@ -6,10 +6,9 @@ extern mask lookupLinkType(char *typeName);
 extern flag registerLinkType(char *typeName, mask *type);
 extern flag unregisterLinkType(char *typeName);
 extern flag listLinkTypes(void);
-extern Link lookupLink(Unit preUnit, Unit postUnit, int *num, mask linkType);
+extern int  lookupLink(Unit preUnit, Unit postUnit, mask linkType);
 extern Unit lookupPreUnit(Unit postUnit, int num);
-extern int  getLinkType(Unit U, Link L);
-extern Link2 getLink2(Unit U, Link L);
+extern int  getLinkType(Unit U, int l);
 
 extern void randomizeUnitWeights(Unit U, real range, real mean, real reqRange,
 				 real reqMean, mask linkType, flag doFrozen);
@@ -24,7 +23,10 @@ extern void setUnitBlockValues(Unit U, flag ext, MemInfo M, char *value,
 extern void setGroupBlockValues(Group G, flag ext, MemInfo M, char *value,
 				mask linkType);
 extern void setBlockValues(flag ext, MemInfo M, char *value, mask linkType);
-extern void initLinkValues(Link L, Link2 M);
+extern void initLinkValues(Unit U, int l);
+extern void setUnitLinks(Unit U, real *values, int size);
+extern flag packGroupLinks(Group G);
+extern void unpackGroupLinks(Group G);
 
 extern flag connectUnits(Unit preUnit, Unit postUnit, mask linkType,
 			 real range, real mean, flag frozen);
@@ -60,6 +62,21 @@ extern flag lesionLinks(Group G, real proportion, int mode, real value,
 extern flag standardSaveWeights(Tcl_Obj *fileNameObj, flag binary, int numValues,
 				flag thawed, flag frozen);
 extern flag standardLoadWeights(Tcl_Obj *fileNameObj, flag thawed, flag frozen);
+/* Weight file formats for convertWeights. */
+#define WEIGHTS_OTHER   0
+#define WEIGHTS_MAPPED  1
+#define WEIGHTS_BINARY  2
+#define WEIGHTS_TEXT    3
+extern flag saveMappedWeights(Tcl_Obj *fileNameObj, int numValues);
+extern long long weightMapSize(int numValues);
+extern void copyWeightMap(char *image, int numValues, long long *links);
+extern flag loadWeightMap(char *data, long long size, const char *commandName,
+			  const char *fileName, flag thawed, flag frozen);
+extern flag convertWeights(Tcl_Obj *sourceObj, Tcl_Obj *destObj, int format);
+extern flag checkpointWeights(Tcl_Obj *fileNameObj, int numValues, int keep,
+			      flag mapped);
+extern flag checkpointStatus(flag wait);
+extern void finishCheckpoints(void);
 extern flag loadXerionWeights(Tcl_Obj *fileNameObj);
 
 extern char **LinkTypeName;
@@ -281,9 +281,8 @@ int C_elmanConnect(TCL_CMDARGS) {
 }
 
 int C_copyConnect(TCL_CMDARGS) {
-  Group source, copy;
+  Group source, copy, G;
   int offset, set = 0;
-  Unit U;
   GroupProc P;
   CopyData D;
   char *curString;
@@ -307,17 +306,17 @@ int C_copyConnect(TCL_CMDARGS) {
 
   curString = Tcl_GetStringFromObj(objv[3], NULL);
   if (subString(curString, "inputs", 6))
-    offset = OFFSET(U, input);
+    offset = OFFSET(G, input);
   else if (subString(curString, "externalInputs", 1))
-    offset = OFFSET(U, externalInput);
+    offset = OFFSET(G, externalInput);
   else if (subString(curString, "outputs", 7))
-    offset = OFFSET(U, output);
+    offset = OFFSET(G, output);
   else if (subString(curString, "targets", 1))
-    offset = OFFSET(U, target);
+    offset = OFFSET(G, target);
   else if (subString(curString, "inputDerivs", 6))
-    offset = OFFSET(U, inputDeriv);
+    offset = OFFSET(G, inputDeriv);
   else if (subString(curString, "outputDerivs", 7))
-    offset = OFFSET(U, outputDeriv);
+    offset = OFFSET(G, outputDeriv);
   else return warning("%s: bad field type: %s\n", commandName, curString);
 
   for (P = copy->inputProcs; P && !set; P = P->next)
@@ -368,11 +367,11 @@ int C_deleteLinkType(TCL_CMDARGS) {
 }
 
 int C_saveWeights(TCL_CMDARGS) {
-  flag binary = TRUE, frozen = TRUE, thawed = TRUE;
+  flag binary = TRUE, frozen = TRUE, thawed = TRUE, mapped = FALSE;
   int arg, values = 1;
   const char *commandName = Tcl_GetStringFromObj(objv[0], NULL);
   const char *usage = "saveWeights <file-name> [-values <num-values> | -text |\n"
-    "\t-noFrozen | -onlyFrozen]";
+    "\t-mapped | -noFrozen | -onlyFrozen]";
   Tcl_Obj *fileNameObj = objv[1];
   const char *fileName = Tcl_GetStringFromObj(objv[1], NULL);
   if (objc == 2 && !strcmp(Tcl_GetStringFromObj(objv[1], NULL), "-h"))
@@ -392,6 +391,9 @@ int C_saveWeights(TCL_CMDARGS) {
     case 't':
       binary = FALSE;
       break;
+    case 'm':
+      mapped = TRUE;
+      break;
     case 'n':
       frozen = FALSE;
       break;
@@ -402,6 +404,9 @@ int C_saveWeights(TCL_CMDARGS) {
     }
   }
   if (arg != objc) return usageError(commandName, usage);
+  if (mapped && (!binary || !frozen || !thawed))
+    return warning("%s: mapped weight files hold all of the links in binary",
+		   commandName);
 
 #ifdef ADVANCED
   if (values > 3) values = 3;
@@ -411,7 +416,9 @@ int C_saveWeights(TCL_CMDARGS) {
 
   eval(".setPath _weights %s", objv[1]);
 
-  if (Net->saveWeights(fileNameObj, binary, values, thawed, frozen))
+  if (mapped) {
+    if (saveMappedWeights(fileNameObj, values)) return TCL_ERROR;
+  } else if (Net->saveWeights(fileNameObj, binary, values, thawed, frozen))
     return TCL_ERROR;
   return result(fileName);
 }
@@ -453,6 +460,84 @@ int C_loadWeights(TCL_CMDARGS) {
   return result(fileName);
 }
 
+int C_convertWeights(TCL_CMDARGS) {
+  int format = WEIGHTS_OTHER;
+  const char *commandName = Tcl_GetStringFromObj(objv[0], NULL);
+  const char *usage = "convertWeights <source-file> <dest-file> [-mapped | "
+    "-binary | -text]";
+  if (objc == 2 && !strcmp(Tcl_GetStringFromObj(objv[1], NULL), "-h"))
+    return commandHelp(commandName);
+  if (objc != 3 && objc != 4) return usageError(commandName, usage);
+  if (!Net) return warning("%s: no current network", commandName);
+
+  if (objc == 4) {
+    const char *option = Tcl_GetStringFromObj(objv[3], NULL);
+    if (option[0] != '-') return usageError(commandName, usage);
+    switch (option[1]) {
+    case 'm': format = WEIGHTS_MAPPED; break;
+    case 'b': format = WEIGHTS_BINARY; break;
+    case 't': format = WEIGHTS_TEXT;   break;
+    default: return usageError(commandName, usage);
+    }
+  }
+
+  if (convertWeights(objv[1], objv[2], format)) return TCL_ERROR;
+  return result(Tcl_GetStringFromObj(objv[2], NULL));
+}
+
+int C_checkpointWeights(TCL_CMDARGS) {
+  flag mapped = FALSE;
+  int arg, values = 3, keep = 0;
+  const char *commandName = Tcl_GetStringFromObj(objv[0], NULL);
+  const char *usage = "checkpointWeights <file-name> [-values <num-values> |\n"
+    "\t-keep <num-files> | -mapped]";
+  if (objc == 2 && !strcmp(Tcl_GetStringFromObj(objv[1], NULL), "-h"))
+    return commandHelp(commandName);
+  if (objc < 2) return usageError(commandName, usage);
+  if (!Net) return warning("%s: no current network", commandName);
+
+  /* Read the options. */
+  for (arg = 2; arg < objc && Tcl_GetStringFromObj(objv[arg], NULL)[0] == '-'; arg++) {
+    switch (Tcl_GetStringFromObj(objv[arg], NULL)[1]) {
+    case 'v':
+      if (++arg >= objc) return usageError(commandName, usage);
+      Tcl_GetIntFromObj(interp, objv[arg], &values);
+      if (values < 1)
+	return warning("%s: numValues must be positive", commandName);
+      break;
+    case 'k':
+      if (++arg >= objc) return usageError(commandName, usage);
+      Tcl_GetIntFromObj(interp, objv[arg], &keep);
+      if (keep < 0)
+	return warning("%s: num-files can't be negative", commandName);
+      break;
+    case 'm':
+      mapped = TRUE;
+      break;
+    default: return usageError(commandName, usage);
+    }
+  }
+  if (arg != objc) return usageError(commandName, usage);
+
+  if (checkpointWeights(objv[1], values, keep, mapped)) return TCL_ERROR;
+  return result(Tcl_GetStringFromObj(objv[1], NULL));
+}
+
+int C_checkpointStatus(TCL_CMDARGS) {
+  flag wait = FALSE;
+  const char *commandName = Tcl_GetStringFromObj(objv[0], NULL);
+  const char *usage = "checkpointStatus [-wait]";
+  if (objc == 2 && !strcmp(Tcl_GetStringFromObj(objv[1], NULL), "-h"))
+    return commandHelp(commandName);
+  if (objc > 2) return usageError(commandName, usage);
+  if (objc == 2) {
+    if (strcmp(Tcl_GetStringFromObj(objv[1], NULL), "-wait"))
+      return usageError(commandName, usage);
+    wait = TRUE;
+  }
+  return checkpointStatus(wait);
+}
+
 int C_loadXerionWeights(TCL_CMDARGS) {
   const char *commandName = Tcl_GetStringFromObj(objv[0], NULL);
   const char *usage = "loadXerionWeights <file-name>";
@@ -1478,6 +1563,12 @@ void registerConnectCommands(void) {
 		  "loads the link weights and other values from a file");
   registerCommand((Tcl_ObjCmdProc *)C_loadXerionWeights, "loadXerionWeights",
 		  "loads weights from a Xerion text-format weight file");
+  registerCommand((Tcl_ObjCmdProc *)C_convertWeights, "convertWeights",
+		  "converts a weight file between the mapped and other formats");
+  registerCommand((Tcl_ObjCmdProc *)C_checkpointWeights, "checkpointWeights",
+		  "saves the link values in a file in the background");
+  registerCommand((Tcl_ObjCmdProc *)C_checkpointStatus, "checkpointStatus",
+		  "reports on the checkpoints being written");
 
   registerCommand((Tcl_ObjCmdProc *)NULL, "", "");
   registerCommand((Tcl_ObjCmdProc *)C_disconnectGroups, "disconnectGroups",
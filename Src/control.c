@@ -13,6 +13,9 @@
 #include "control.h"
 #include "parallel.h"
 #include "canvRect.h"
+#include "kernel.h"
+#include "pool.h"
+#include "act.h"
 
 typedef struct task *Task;
 struct task {
@@ -281,6 +284,7 @@ flag signalSetListsChanged(void) {
 }
 
 flag signalNetStructureChanged(void) {
+  freeNetPlan(Net);
   if (Net->autoPlot) autoPlot(0);
   else if (UnitUp) drawUnitsLater();
   if (LinkUp) {
@@ -483,10 +487,6 @@ void initializeSimulator(void) {
     "on this machine", sizeof(real), sizeof(int));
   */
 
-  if (sizeof(struct link) % 4)
-    fatalError("sizeof(struct link) (%d) is not divisible by 4 "
-	       "on this machine", sizeof(struct link));
-
 #ifndef AVOID_NAN_TEST
   if (!isNaN(NaN) || !isNaNf(NaNf) || !isNaNd(NaNd))
     fatalError("NaN is not NaN on this machine.\nSet the AVOID_NAN_TEST variable to override this check.");
@@ -498,6 +498,8 @@ void initializeSimulator(void) {
   initLinkTypes();
   registerLinkType(BIAS_NAME, &i);
   buildSigmoidTable();
+  initKernels();
+  initPool();
   timeSeedRand();
 
   signal(SIGABRT, signalHandler);
@@ -8,7 +8,12 @@
 
 #define DEF_N_numUpdates          100
 #define DEF_N_batchSize           0    /* This means full batch mode */
+#define DEF_N_numThreads          1
+#define DEF_N_threadUnits         1000
+#define DEF_N_threadLinks         100000
+#define DEF_N_sparseFraction      0.1
 #define DEF_N_reportInterval      10
+#define DEF_N_outputFlushInterval 100
 #define DEF_N_criterion           0.0
 #define DEF_N_trainGroupCrit      0.0
 #define DEF_N_testGroupCrit       0.5
@@ -122,6 +127,7 @@
 /* EXAMPLE SET FIELDS */
 #define DEF_S_mode                ORDERED
 #define DEF_S_pipeLoop            TRUE
+#define DEF_S_pipePrefetch        4
 #define DEF_S_maxTime             1.0
 #define DEF_S_minTime             0.0
 #define DEF_S_graceTime           0.0
@@ -166,8 +172,12 @@
 
 /* Magic Cookies */
 #define BINARY_EXAMPLE_COOKIE 0xaaaaaaaa /* 10101010... */
+#define MAPPED_EXAMPLE_COOKIE 0xaaaaaaab /* Version 2, memory mapped */
 #define OLD_BINARY_WEIGHT_COOKIE  0x55555555 /* 01010101... */
 #define BINARY_WEIGHT_COOKIE  0x55555556
+#define MAPPED_WEIGHT_COOKIE  0x55555557 /* Memory mapped */
+#define OUTPUT_COLUMNS_COOKIE 0x33333333 /* 00110011... */
+#define SAVED_STATE_COOKIE    0x66666666 /* 01100110... */
 
 #define BIAS_NAME        "bias"   /* The name of the bias group */
 #define NUM_COLORS       101      /* Colors in blue-red colormap */
@@ -983,7 +983,6 @@ flag drawLinks(ClientData junk) {
 
 flag updateLinkDisplay(void) {
   int value = Net->linkDisplayValue, i, si, n = 0;
-  Link L; Link2 M;
   real v, av;
   real mean = 0.0;
   real meanAbs = 0.0;
@@ -1003,16 +1002,14 @@ flag updateLinkDisplay(void) {
   FOR_EACH_GROUP({
     if (G->inPosition != -1) {
       FOR_EVERY_UNIT(G, {
-	L = U->incoming;
-	M = U->incoming2;
 	i = 0;
 	FOR_EACH_BLOCK(U, {
 	  if (B->unit[0].group->outPosition != -1) {
 	    for (si = i + B->numUnits; i < si; i++) {
 	      switch (value) {
-	      case UV_LINK_WEIGHTS: v = L[i].weight; break;
-	      case UV_LINK_DERIVS:  v = L[i].deriv;  break;
-	      case UV_LINK_DELTAS:  v = M[i].lastWeightDelta; break;
+	      case UV_LINK_WEIGHTS: v = U->weight[i]; break;
+	      case UV_LINK_DERIVS:  v = U->deriv[i];  break;
+	      case UV_LINK_DELTAS:  v = U->lastWeightDelta[i]; break;
 	      default: return warning("updateLinkDisplay called with bad "
 				      "Net->linkDisplayValue");
 	      }
@@ -1039,16 +1036,14 @@ flag updateLinkDisplay(void) {
   FOR_EACH_GROUP({
     if (G->inPosition != -1) {
       FOR_EVERY_UNIT(G, {
-	L = U->incoming;
-	M = U->incoming2;
 	i = 0;
 	FOR_EACH_BLOCK(U, {
 	  if (B->unit[0].group->outPosition != -1) {
 	    for (si = i + B->numUnits; i < si; i++) {
 	      switch (value) {
-	      case UV_LINK_WEIGHTS: v = L[i].weight; break;
-	      case UV_LINK_DERIVS:  v = L[i].deriv;  break;
-	      case UV_LINK_DELTAS:  v = M[i].lastWeightDelta; break;
+	      case UV_LINK_WEIGHTS: v = U->weight[i]; break;
+	      case UV_LINK_DERIVS:  v = U->deriv[i];  break;
+	      case UV_LINK_DELTAS:  v = U->lastWeightDelta[i]; break;
 	      default: return warning("updateLinkDisplay called with bad "
 				      "Net->linkDisplayValue");
 	      }
@@ -390,8 +390,7 @@ int C_lockUnit(TCL_CMDARGS) {
 /* Not user callable */
 int C_unitInfo(TCL_CMDARGS) {
   Unit U, T = NULL;
-  Link L;
-  int tick, g, u;
+  int tick, g, u, l;
   flag printIt, targets;
   real value = NaN;
   char *from = NULL, *to = NULL, *valName = NULL;
@@ -431,23 +430,23 @@ int C_unitInfo(TCL_CMDARGS) {
       if (printIt) print(0, "Use the right mouse button to select a unit.\n");
       else return TCL_OK;
     }
-    if ((L = lookupLink(U, Net->unitDisplayUnit, NULL, ALL_LINKS))) {
+    if ((l = lookupLink(U, Net->unitDisplayUnit, ALL_LINKS)) >= 0) {
       from = U->name; to = Net->unitDisplayUnit->name;
       T = Net->unitDisplayUnit;
-    } else if ((L = lookupLink(Net->unitDisplayUnit, U, NULL, ALL_LINKS))) {
+    } else if ((l = lookupLink(Net->unitDisplayUnit, U, ALL_LINKS)) >= 0) {
       from = Net->unitDisplayUnit->name; to = U->name; T = U;
     }
-    if (L) {
+    if (l >= 0) {
       switch (Net->unitDisplayValue) {
-      case UV_LINK_WEIGHTS: valName = "Weight"; value = L->weight; break;
-      case UV_LINK_DERIVS:  valName = "Deriv";  value = L->deriv;  break;
+      case UV_LINK_WEIGHTS: valName = "Weight"; value = T->weight[l]; break;
+      case UV_LINK_DERIVS:  valName = "Deriv";  value = T->deriv[l];  break;
       case UV_LINK_DELTAS:  valName = "Delta";
-	value = getLink2(T, L)->lastWeightDelta;
+	value = T->lastWeightDelta[l];
 	break;
       }
       if (printIt) {
 	print(0, "%-6s = %9.6f for link \"%s\"->\"%s\" of type \"%s\"\n",
-	      valName, value, from, to, LinkTypeName[getLinkType(T, L)]);
+	      valName, value, from, to, LinkTypeName[getLinkType(T, l)]);
       } else eval("set .unitUnit {%s%s%s}; set .unitValue %9.6f",
 		  (to == U->name) ? "->" : "", U->name, (from == U->name) ?
 		  "->" : "", value);
@@ -461,48 +460,55 @@ int C_unitInfo(TCL_CMDARGS) {
     switch (Net->unitDisplayValue) {
     case UV_OUT_TARG:
       if (targets) {
-        if (!U->targetHistory || Net->ticksOnExample == 1) value = U->target;
+        if (!U->group->targetHistory || Net->ticksOnExample == 1)
+          value = UNIT_VAL(U, target);
         else if (ViewTick >= Net->ticksOnExample - Net->historyLength)
-          value = GET_HISTORY(U, targetHistory, HISTORY_INDEX(ViewTick));
+          value = GET_UNIT_HISTORY(U, targetHistory, HISTORY_INDEX(ViewTick));
         valName = "Target";
       } else {
-        if (!U->outputHistory || Net->ticksOnExample == 1) value = U->output;
+        if (!U->group->outputHistory || Net->ticksOnExample == 1)
+          value = UNIT_VAL(U, output);
         else if (ViewTick >= Net->ticksOnExample - Net->historyLength)
-          value = GET_HISTORY(U, outputHistory, HISTORY_INDEX(ViewTick));
+          value = GET_UNIT_HISTORY(U, outputHistory, HISTORY_INDEX(ViewTick));
         valName = "Output";
       }
       break;
     case UV_OUTPUTS:
-      if (!U->outputHistory || Net->ticksOnExample == 1) value = U->output;
+      if (!U->group->outputHistory || Net->ticksOnExample == 1)
+        value = UNIT_VAL(U, output);
       else if (ViewTick >= Net->ticksOnExample - Net->historyLength)
-        value = GET_HISTORY(U, outputHistory, HISTORY_INDEX(ViewTick));
+        value = GET_UNIT_HISTORY(U, outputHistory, HISTORY_INDEX(ViewTick));
             valName = "Output";
       break;
     case UV_TARGETS:
-      if (!U->targetHistory || Net->ticksOnExample == 1) value = U->target;
+      if (!U->group->targetHistory || Net->ticksOnExample == 1)
+        value = UNIT_VAL(U, target);
       else if (ViewTick >= Net->ticksOnExample - Net->historyLength)
-	value = GET_HISTORY(U, targetHistory, HISTORY_INDEX(ViewTick));
+	value = GET_UNIT_HISTORY(U, targetHistory, HISTORY_INDEX(ViewTick));
       valName = "Target";
       break;
     case UV_INPUTS:
-      if (!U->inputHistory || Net->ticksOnExample == 1) value = U->input;
+      if (!U->group->inputHistory || Net->ticksOnExample == 1)
+        value = UNIT_VAL(U, input);
       else if (ViewTick >= Net->ticksOnExample - Net->historyLength)
-        value = GET_HISTORY(U, inputHistory, HISTORY_INDEX(ViewTick));
+        value = GET_UNIT_HISTORY(U, inputHistory, HISTORY_INDEX(ViewTick));
       valName = "Input";
       break;
     case UV_EXT_INPUTS:
-      value = (tick == Net->ticksOnExample - 1) ? U->externalInput : NaN;
+      value = (tick == Net->ticksOnExample - 1) ?
+	UNIT_VAL(U, externalInput) : NaN;
       valName = "Ext. Input";
       break;
     case UV_OUTPUT_DERIVS:
-      if (!U->outputDerivHistory || Net->ticksOnExample == 1)
-        value = U->outputDeriv;
+      if (!U->group->outputDerivHistory || Net->ticksOnExample == 1)
+        value = UNIT_VAL(U, outputDeriv);
       else if (ViewTick >= Net->ticksOnExample - Net->historyLength)
-        value = GET_HISTORY(U, outputDerivHistory, HISTORY_INDEX(ViewTick));
+        value = GET_UNIT_HISTORY(U, outputDerivHistory,
+                                 HISTORY_INDEX(ViewTick));
             valName = "OutputDeriv";
       break;
     case UV_INPUT_DERIVS:
-      value = (tick == Net->ticksOnExample - 1) ? U->inputDeriv : NaN;
+      value = (tick == Net->ticksOnExample - 1) ? UNIT_VAL(U, inputDeriv) : NaN;
       valName = "InputDeriv";
       break;
     case UV_GAIN:
@@ -527,7 +533,6 @@ int C_unitInfo(TCL_CMDARGS) {
 
 int C_graphUnitValue(TCL_CMDARGS) {
   Unit U;
-  Link L;
   flag targets;
   char value[128], update[32];
   int g, u, lnum;
@@ -550,11 +555,11 @@ int C_graphUnitValue(TCL_CMDARGS) {
     if (!Net->unitDisplayUnit)
       return warning("Use the right mouse button to select a unit.\n");
 
-    if ((L = lookupLink(U, Net->unitDisplayUnit, &lnum, ALL_LINKS))) {
+    if ((lnum = lookupLink(U, Net->unitDisplayUnit, ALL_LINKS)) >= 0) {
       sprintf(value, "group(%d).unit(%d).", Net->unitDisplayUnit->group->num,
               Net->unitDisplayUnit->num);
-    } else L = lookupLink(Net->unitDisplayUnit, U, &lnum, ALL_LINKS);
-    if (L) {
+    } else lnum = lookupLink(Net->unitDisplayUnit, U, ALL_LINKS);
+    if (lnum >= 0) {
       switch (Net->unitDisplayValue) {
       case UV_LINK_WEIGHTS:
         sprintf(value + strlen(value), "incoming(%d).weight", lnum);
@@ -757,7 +762,6 @@ int C_lockLink(TCL_CMDARGS) {
 /* Not user callable */
 int C_linkInfo(TCL_CMDARGS) {
   Unit preUnit, postUnit;
-  Link L;
   int lnum, g, u;
   real value;
   char *valName;
@@ -784,18 +788,17 @@ int C_linkInfo(TCL_CMDARGS) {
   }
   if (lnum >= postUnit->numIncoming)
     return warning("%s: link %d out of range\n", lnum);
-  L = postUnit->incoming + lnum;
 
   if (!(preUnit = lookupPreUnit(postUnit, lnum)))
     return warning("%s: pre unit not found", commandName);
 
   switch (Net->linkDisplayValue) {
   case UV_LINK_WEIGHTS:
-    value = L->weight; valName = "Weight"; break;
+    value = postUnit->weight[lnum]; valName = "Weight"; break;
   case UV_LINK_DERIVS:
-    value = L->deriv; valName = "Deriv"; break;
+    value = postUnit->deriv[lnum]; valName = "Deriv"; break;
   case UV_LINK_DELTAS:
-    value = postUnit->incoming2[lnum].lastWeightDelta;
+    value = postUnit->lastWeightDelta[lnum];
     valName = "Delta"; break;
   default:
     return warning("%s: bad linkValue %d\n", commandName, Net->linkDisplayValue);
@@ -803,7 +806,7 @@ int C_linkInfo(TCL_CMDARGS) {
   if (printIt) {
     print(0, "%-6s = %9.6f for link \"%s\"->\"%s\" of type %s\n", valName,
 	  value, preUnit->name, postUnit->name,
-	  LinkTypeName[getLinkType(postUnit, L)]);
+	  LinkTypeName[getLinkType(postUnit, lnum)]);
   } else {
     eval("set .linkFromUnit {%s}; set .linkToUnit {%s}; set .linkValue %f; "
          "set .linkG2 %d; set .linkU2 %d; set .linkLNum %d",
@@ -2,14 +2,18 @@
 #include <string.h>
 #include <netinet/in.h>
 #include <ctype.h>
+#ifdef HAVE_THREADS
+#include <pthread.h>
+#endif /* HAVE_THREADS */
 #include "util.h"
 #include "type.h"
 #include "network.h"
 #include "example.h"
 #include "control.h"
 #include "object.h"
+#include "pool.h"
 
-String buf = NULL;
+THREAD_LOCAL String buf = NULL;
 
 
 /* This doesn't reset the set state so you can switch sets and continue where
@@ -93,6 +97,7 @@ ExampleSet newExampleSet(char *name) {
   ExampleSet S = (ExampleSet) safeCalloc(1, sizeof *S, "addExamples:S");
   S->name               = copyString(name);
   S->pipeLoop           = DEF_S_pipeLoop;
+  S->pipePrefetch       = DEF_S_pipePrefetch;
   S->maxTime            = DEF_S_maxTime;
   S->minTime            = DEF_S_minTime;
   S->graceTime          = DEF_S_graceTime;
@@ -128,7 +133,8 @@ static void cleanExample(Example E) {
   if (E->event) {
     for (i = 0; i < E->numEvents; i++) {
       V = E->event + i;
-      if (!V->sharedInputs) {
+      /* Mapped ranges and events belong to the map */
+      if (!V->sharedInputs && !E->map) {
 	for (L = V->input; L; L = N) {
 	  N = L->next;
 	  FREE(L->val);
@@ -136,7 +142,7 @@ static void cleanExample(Example E) {
 	  free(L);
 	}
       }
-      if (!V->sharedTargets) {
+      if (!V->sharedTargets && !E->map) {
 	for (L = V->target; L; L = N) {
 	  N = L->next;
 	  FREE(L->val);
@@ -147,7 +153,7 @@ static void cleanExample(Example E) {
       if (V->proc) Tcl_DecrRefCount(V->proc);
       freeEventExtension(V);
     }
-    free(E->event);
+    if (!E->map) free(E->event);
   }
 }
 
@@ -163,11 +169,16 @@ static void clearExample(Example E) {
   E->proc = NULL;
 }
 
+static void releaseExampleMap(ExampleMap M);
+static void stopPipeReader(ExampleSet S);
+static void freePipeQueue(ExampleSet S);
+
 static void freeExample(Example E) {
   if (!E) return;
   cleanExample(E);
   freeExampleExtension(E);
-  free(E);
+  if (E->map) releaseExampleMap(E->map);
+  else free(E);
 }
 
 void initEvent(Event V, Example E) {
@@ -197,20 +208,37 @@ static flag normalEvent(Event V, ExampleSet S) {
 }
 
 static flag parseError(ParseRec R, const char *fmt, ...) {
-  char message[256];
+  char message[256], *fileName;
   va_list args;
   if (fmt[0]) {
     va_start(args, fmt);
     vsprintf(message, fmt, args);
     va_end(args);
-    error("loadExamples: %s on %s %d of file \"%s\"",
-	  message, (R->binary) ? "example" : "line", R->line, R->fileName);
+    fileName = (R->fileName) ? Tcl_GetString(R->fileName) : "";
+    if (R->message) {
+      /* This may be another thread, so the shared Buffer is avoided */
+      clearString(R->message);
+      stringAppend(R->message, "loadExamples: ");
+      stringAppend(R->message, message);
+      stringAppend(R->message, " on ");
+      snprintf(message, sizeof message, "%s %d of file \"",
+	       (R->binary) ? "example" : "line", R->line);
+      stringAppend(R->message, message);
+      stringAppend(R->message, fileName);
+      stringAppend(R->message, "\"");
+    } else
+      error("loadExamples: %s on %s %d of file \"%s\"",
+	    message, (R->binary) ? "example" : "line", R->line, fileName);
   }
+  /* A saved error is left for the caller to report and clean up */
+  if (R->message) return TCL_ERROR;
   if (R->channel) closeChannel(R->channel);
   R->channel = NULL;
   Tcl_DecrRefCount(R->fileName);
   freeString(R->buf);
   R->buf = NULL;
+  FREE(R->text);
+  R->textPos = R->textEnd = NULL;
 
   return TCL_ERROR;
 }
@@ -227,6 +255,7 @@ static void freeExampleSet(ExampleSet S) {
   FREE(S->example);
   FREE(S->permuted);
   if (S->proc) Tcl_DecrRefCount(S->proc);
+  freePipeQueue(S);
   if (S->pipeParser) {
     parseError(S->pipeParser, "");
     free(S->pipeParser);
@@ -238,11 +267,27 @@ static void freeExampleSet(ExampleSet S) {
 }
 
 /* This puts all the examples in arrays and does some other calculations */
+/* The default .initExample and .initEvent in lensrc.tcl are empty, and calling
+   them once per example can take longer than mapping the examples. */
+static flag initProcDefined(char *name) {
+  struct Tcl_CmdInfo junk;
+  Tcl_InterpState state;
+  const char *body;
+  flag defined = TRUE;
+  if (!Tcl_GetCommandInfo(Interp, name, &junk)) return FALSE;
+  state = Tcl_SaveInterpState(Interp, TCL_OK);
+  if (eval("info body %s", name) == TCL_OK) {
+    for (body = Tcl_GetStringResult(Interp); isspace((int) *body); body++);
+    if (!*body) defined = FALSE;
+  }
+  Tcl_RestoreInterpState(Interp, state);
+  return defined;
+}
+
 static void compileExampleSet(ExampleSet S) {
   Example E;
   int i, v;
   real totalFreq = 0.0, scale, sum;
-  struct Tcl_CmdInfo junk;
 
   /* Count the number of examples and events */
   for (S->numExamples = 0, S->numEvents = 0, E = S->firstExample;
@@ -266,13 +311,13 @@ static void compileExampleSet(ExampleSet S) {
     totalFreq += E->frequency;
   }
   /* Should this be done on the pipe example? */
-  if (Tcl_GetCommandInfo(Interp, ".initExample", &junk))
+  if (initProcDefined(".initExample"))
     for (E = S->firstExample; E; E = E->next)
       eval("catch {.initExample root.set(%d).example(%d)}", S->num, E->num);
-  if (Tcl_GetCommandInfo(Interp, ".initEvent", &junk))
+  if (initProcDefined(".initEvent"))
     for (E = S->firstExample; E; E = E->next)
       for (v = 0; v < E->numEvents; v++)
-	eval("catch {.initEvent root.set(%d).example(%d).event(%d)",
+	eval("catch {.initEvent root.set(%d).example(%d).event(%d)}",
 	     S->num, E->num, v);
 
   /* Determine the event probabilities for probabilistic choosing. */
@@ -344,8 +389,17 @@ Range newRange(Event V, Range L, flag doingInputs) {
   return N;
 }
 
+#ifdef HAVE_THREADS
+/* Examples may be parsed by several threads at once. */
+static pthread_mutex_t GroupNameLock = PTHREAD_MUTEX_INITIALIZER;
+#endif /* HAVE_THREADS */
+
 static char *registerGroupName(char *name, ExampleSet S) {
   int i;
+  char *groupName;
+#ifdef HAVE_THREADS
+  pthread_mutex_lock(&GroupNameLock);
+#endif /* HAVE_THREADS */
   for (i = 0; i < S->numGroupNames && strcmp(S->groupName[i], name); i++);
   if (i == S->numGroupNames) {
     if (S->maxGroupNames == 0) {
@@ -359,7 +413,11 @@ static char *registerGroupName(char *name, ExampleSet S) {
     }
     S->groupName[S->numGroupNames++] = copyString(name);
   }
-  return S->groupName[i];
+  groupName = S->groupName[i];
+#ifdef HAVE_THREADS
+  pthread_mutex_unlock(&GroupNameLock);
+#endif /* HAVE_THREADS */
+  return groupName;
 }
 
 static flag readEventRanges(Event V, ExampleSet S, ParseRec R,
@@ -385,7 +443,8 @@ static flag readEventRanges(Event V, ExampleSet S, ParseRec R,
 	}
 	else {
 	  if (readBlock(R, buf)) {
-	    parseError(R, Tcl_GetStringResult(Interp));
+	    parseError(R, (R->message) ? R->message->s :
+		       Tcl_GetStringResult(Interp));
 	    goto error;}
 	  if (buf->s[0])
 	    if (!(L->groupName = registerGroupName(buf->s, S))) {
@@ -406,7 +465,8 @@ static flag readEventRanges(Event V, ExampleSet S, ParseRec R,
 	}
 	else {
 	  if (readBlock(R, buf)) {
-	    parseError(R, Tcl_GetStringResult(Interp));
+	    parseError(R, (R->message) ? R->message->s :
+		       Tcl_GetStringResult(Interp));
 	    goto error;}
 	  if (buf->s[0])
 	    if (!(L->groupName = registerGroupName(buf->s, S))) {
@@ -811,13 +871,290 @@ static flag readExample(Example E, ParseRec R) {
   return TCL_ERROR;
 }
 
+/*************************** Parallel Text Parsing ***************************/
+
+/* Text files are read in rounds of about this many characters per thread.
+   Each round is cut at likely example boundaries, the pieces are parsed by
+   the thread pool, and the examples are registered in file order.  A piece
+   that fails to parse is handed back, with the rest of the file, to the
+   serial parser so that errors are reported just as before. */
+#define PARSE_ROUND_CHARS (1 << 22)
+#define PARSE_MAX_DEPTH   32
+
+typedef struct parseChunk {
+  char   *start;
+  char   *end;
+  int     line;               /* The line before the first one in the piece */
+  Example first;
+  Example last;
+  flag    failed;
+} *ParseChunk;
+
+typedef struct parseJob {
+  ExampleSet S;
+  ParseChunk chunk;
+} *ParseJob;
+
+/* Finds up to numPieces pieces of text that probably hold whole examples.
+   A piece ends at the start of a line after a ';' that is outside of any
+   brackets or quotes and has nothing but spaces after it on its line.
+   Comment lines are skipped as getLine() does.  The pieces start at brk[0],
+   which is 0, and piece i ends at brk[i + 1], lines[i] lines into text.
+   Returns the number of pieces.  This is only a guess, checked by parsing. */
+static int findExampleBreaks(char *text, long len, flag atEnd, int numPieces,
+			     long *brk, int *lines) {
+  char stack[PARSE_MAX_DEPTH], c, *nl;
+  int depth = 0, line = 0, pieces = 0, lastLine = 0;
+  long p, last = 0;
+  flag lineStart = TRUE, ended = FALSE, protect = FALSE;
+
+  brk[0] = 0;
+  lines[0] = 0;
+  for (p = 0; p < len; p++) {
+    c = text[p];
+    if (lineStart) {
+      lineStart = FALSE;
+      if (c == '#') {
+	if (!(nl = memchr(text + p, '\n', len - p))) break;
+	p = nl - text;
+	line++;
+	lineStart = TRUE;
+	continue;
+      }
+    }
+    if (c == '\n') {
+      line++;
+      lineStart = TRUE;
+      if (ended) {
+	last = p + 1;
+	lastLine = line;
+	if (pieces + 1 < numPieces &&
+	    last >= len * (pieces + 1) / numPieces) {
+	  brk[++pieces] = last;
+	  lines[pieces] = line;
+	}
+	ended = FALSE;
+      }
+      continue;
+    }
+    if (ended && !isspace((int) c)) ended = FALSE;
+    if (c == '\\') {
+      protect = 1 - protect;
+      continue;
+    }
+    if (protect) {
+      protect = FALSE;
+      continue;
+    }
+    switch (c) {
+    case '{': case '(': case '[':
+      if (depth == PARSE_MAX_DEPTH) {
+	p = len;
+	atEnd = FALSE;
+      } else stack[depth++] = c;
+      break;
+    case '}': if (depth && stack[depth - 1] == '{') depth--; break;
+    case ')': if (depth && stack[depth - 1] == '(') depth--; break;
+    case ']': if (depth && stack[depth - 1] == '[') depth--; break;
+    case '"':
+      if (depth && stack[depth - 1] == '"') depth--;
+      else if (depth < PARSE_MAX_DEPTH) stack[depth++] = c;
+      break;
+    case ';': if (!depth) ended = TRUE; break;
+    }
+  }
+  if (atEnd && ended) {
+    last = len;
+    lastLine = line;
+  }
+  if (last > brk[pieces]) {
+    brk[++pieces] = last;
+    lines[pieces] = lastLine;
+  }
+  return pieces;
+}
+
+/* Parses one piece into a list of examples without reporting errors. */
+static void parseChunkTask(void *data, int task) {
+  ParseJob J = (ParseJob) data;
+  ParseChunk C = J->chunk + task;
+  struct parseRec rec;
+  ParseRec R = &rec;
+  flag ownBuf = (buf == NULL);
+  Example E;
+
+  if (ownBuf) buf = newString(128);
+  R->channel = NULL;
+  R->fileName = NULL;
+  R->binary = FALSE;
+  R->buf = newString(128);
+  startParser(R, 0);
+  R->cookiePos = sizeof(int);
+  R->line = C->line;
+  R->textPos = C->start;
+  R->textEnd = C->end;
+  R->message = newString(64);
+
+  while (!fileDone(R)) {
+    E = newExample(J->S);
+    if (readExample(E, R)) {
+      freeExample(E);
+      C->failed = TRUE;
+      break;
+    }
+    E->next = NULL;
+    if (C->last) C->last->next = E;
+    else C->first = E;
+    C->last = E;
+  }
+
+  freeString(R->buf);
+  freeString(R->message);
+  if (ownBuf) {
+    freeString(buf);
+    buf = NULL;
+  }
+}
+
+static void freeChunkExamples(ParseChunk C) {
+  Example E, N;
+  for (E = C->first; E; E = N) {
+    N = E->next;
+    freeExample(E);
+  }
+  C->first = C->last = NULL;
+}
+
+/* Returns TRUE if the current line holds nothing but the start of the next
+   example, or nothing more at all, so the rest of the file can be split up. */
+static flag atExampleStart(ParseRec R) {
+  char *s;
+  if (R->cookiePos < sizeof(int) || R->textPos) return FALSE;
+  for (s = R->s; *s && isspace((int) *s); s++);
+  if (!*s) return TRUE;
+  for (s = R->buf->s; s < R->s && isspace((int) *s); s++);
+  return (s == R->s);
+}
+
+/* Reads the rest of a text file using numTasks threads.  Whatever was not
+   parsed, due to an error or the example limit, is left in R's read-ahead
+   block.  Returns TRUE if halted. */
+static flag readExamplesInParallel(ExampleSet S, ParseRec R, int numTasks,
+				   int maxExamples, int *examplesRead) {
+  struct parseJob job;
+  ParseChunk C;
+  Example E, N;
+  Tcl_Obj *data = Tcl_NewObj();
+  char *text, *s;
+  long len = 0, maxLen, rest = 0, *brk;
+  int c, numChunks, line, got, *lines;
+  flag eof = FALSE, done = FALSE, halted = FALSE;
+
+  Tcl_IncrRefCount(data);
+  brk = (long *) safeMalloc((numTasks + 1) * sizeof(long),
+			    "readExamplesInParallel:brk");
+  lines = intArray(numTasks + 1, "readExamplesInParallel:lines");
+  job.S = S;
+  job.chunk = (ParseChunk) safeCalloc(numTasks, sizeof(struct parseChunk),
+				      "readExamplesInParallel:job.chunk");
+  maxLen = R->buf->numChars + 2;
+  text = (char *) safeMalloc(maxLen, "readExamplesInParallel:text");
+
+  /* Start with the current line unless only spaces are left on it. */
+  for (s = R->s; *s && isspace((int) *s); s++);
+  if (*s) {
+    len = R->buf->numChars;
+    memcpy(text, R->buf->s, len);
+    text[len++] = '\n';
+    line = R->line - 1;
+  } else line = R->line;
+  R->buf->s[0] = '\0';
+  R->buf->numChars = 0;
+  R->s = R->buf->s;
+
+  while (!eof && !done && !halted &&
+	 (!maxExamples || *examplesRead < maxExamples)) {
+    if (Tcl_ReadChars(R->channel, data, numTasks * PARSE_ROUND_CHARS, 0) < 0
+	|| Tcl_Eof(R->channel)) eof = TRUE;
+    s = Tcl_GetStringFromObj(data, &got);
+    if (len + got + 1 > maxLen) {
+      maxLen = len + got + 1;
+      text = (char *) safeRealloc(text, maxLen, "readExamplesInParallel:text");
+    }
+    memcpy(text + len, s, got);
+    len += got;
+    text[len] = '\0';
+
+    if (!(numChunks = findExampleBreaks(text, len, eof, numTasks, brk, lines)))
+      continue;
+    for (c = 0; c < numChunks; c++) {
+      C = job.chunk + c;
+      C->start = text + brk[c];
+      C->end = text + brk[c + 1];
+      C->line = line + lines[c];
+      C->first = C->last = NULL;
+      C->failed = FALSE;
+    }
+    poolRun(numChunks, parseChunkTask, &job);
+
+    /* Register the examples in order, stopping at the first failure. */
+    for (c = 0; c < numChunks; c++) {
+      C = job.chunk + c;
+      if (C->failed || done) {
+	if (!done) {
+	  rest = brk[c];
+	  line += lines[c];
+	  done = TRUE;
+	}
+	freeChunkExamples(C);
+	continue;
+      }
+      for (E = C->first; E; E = N) {
+	N = E->next;
+	if (maxExamples && *examplesRead >= maxExamples) {
+	  freeExample(E);
+	  done = TRUE;
+	} else {
+	  registerExample(E, S);
+	  (*examplesRead)++;
+	}
+      }
+      C->first = C->last = NULL;
+    }
+    if (!done) {
+      rest = brk[numChunks];
+      line += lines[numChunks];
+    }
+    halted = smartUpdate(FALSE);
+
+    /* Keep the unfinished text for the next round. */
+    if (!done) {
+      memmove(text, text + rest, len - rest);
+      len -= rest;
+      rest = 0;
+    }
+  }
+
+  R->text = text;
+  R->textPos = text + rest;
+  R->textEnd = text + len;
+  R->line = line;
+  Tcl_DecrRefCount(data);
+  FREE(brk);
+  FREE(lines);
+  FREE(job.chunk);
+  return halted;
+}
+
 static flag readBinaryExampleSet(char *setName, ParseRec R, ExampleSet *Sp,
 				 flag pipe, int maxExamples);
+static flag mapExampleSet(char *setName, Tcl_Obj *fileNameObj, ExampleSet *Sp,
+			  flag pipe, int maxExamples);
 static flag readExampleSet(char *setName, Tcl_Obj *fileNameObj, ExampleSet *Sp,
 			   flag pipe, int maxExamples) {
   ExampleSet S = *Sp;
   Example E = NULL;
-  int val, examplesRead;
+  int val, examplesRead, numTasks;
   flag halted;
   struct parseRec rec;
   ParseRec R = &rec;
@@ -831,12 +1168,18 @@ static flag readExampleSet(char *setName, Tcl_Obj *fileNameObj, ExampleSet *Sp,
   R->buf = NULL;
   R->s = NULL;
   R->line = 0;
+  R->text = R->textPos = R->textEnd = NULL;
+  R->message = NULL;
 
   /* Look for the binary cookie */
   if (readBinInt(R->channel, &val))
     return parseError(R, "example file empty");
   if (val == BINARY_EXAMPLE_COOKIE)
     return readBinaryExampleSet(setName, R, Sp, pipe, maxExamples);
+  if (val == MAPPED_EXAMPLE_COOKIE) {
+    parseError(R, "");
+    return mapExampleSet(setName, fileNameObj, Sp, pipe, maxExamples);
+  }
   R->buf = newString(128);
   R->binary = FALSE;
   if (startParser(R, HTONL(val))) {
@@ -896,9 +1239,10 @@ static flag readExampleSet(char *setName, Tcl_Obj *fileNameObj, ExampleSet *Sp,
   }
 
   if (pipe) {
-    if (S->pipeParser)
+    if (S->pipeParser) {
+      stopPipeReader(S);
       parseError(S->pipeParser, "");
-    else
+    } else
       S->pipeParser = (ParseRec) safeMalloc(sizeof(struct parseRec),
 					    "readExampleSet:S->pipeParser");
     S->pipeParser->channel = R->channel;
@@ -909,16 +1253,28 @@ static flag readExampleSet(char *setName, Tcl_Obj *fileNameObj, ExampleSet *Sp,
     S->pipeParser->binary = FALSE;
     memcpy(S->pipeParser->cookie, R->cookie, sizeof(int));
     S->pipeParser->cookiePos = R->cookiePos;
+    S->pipeParser->text = NULL;
+    S->pipeParser->textPos = S->pipeParser->textEnd = NULL;
+    S->pipeParser->message = NULL;
     exampleSetMode(S, PIPE);
     return TCL_OK;
   }
 
-  /* This loops over examples */
+  /* This loops over examples, handing the rest of the file to the thread
+     pool as soon as it is lined up on an example. */
+  numTasks = (Net && Net->numThreads > 1) ? poolTasks(Net->numThreads) : 1;
   for (examplesRead = 0, halted = FALSE; !fileDone(R) && !halted &&
-	 (!maxExamples || examplesRead < maxExamples); examplesRead++) {
+	 (!maxExamples || examplesRead < maxExamples);) {
+    if (numTasks > 1 && atExampleStart(R)) {
+      halted = readExamplesInParallel(S, R, numTasks, maxExamples,
+				      &examplesRead);
+      numTasks = 1;
+      continue;
+    }
     E = newExample(S);
     if (readExample(E, R)) goto abort;
     registerExample(E, S);
+    examplesRead++;
 
     halted = smartUpdate(FALSE);
   }
@@ -1210,9 +1566,10 @@ static flag readBinaryExampleSet(char *setName, ParseRec R, ExampleSet *Sp,
     goto abort;}
 
   if (pipe) {
-    if (S->pipeParser)
+    if (S->pipeParser) {
+      stopPipeReader(S);
       parseError(S->pipeParser, "");
-    else
+    } else
       S->pipeParser = (ParseRec) safeMalloc(sizeof(struct parseRec),
 					    "readExampleSet:S->pipeParser");
     S->pipeParser->channel = R->channel;
@@ -1221,6 +1578,9 @@ static flag readBinaryExampleSet(char *setName, ParseRec R, ExampleSet *Sp,
     S->pipeParser->buf = NULL;
     S->pipeParser->s = NULL;
     S->pipeParser->binary = TRUE;
+    S->pipeParser->text = NULL;
+    S->pipeParser->textPos = S->pipeParser->textEnd = NULL;
+    S->pipeParser->message = NULL;
     exampleSetMode(S, PIPE);
     return TCL_OK;
   }
@@ -1251,6 +1611,308 @@ abort:
   return TCL_ERROR;
 }
 
+/************************** Mapped Binary Example Files **********************/
+
+/* Version 2 binary files are written in the byte order of the machine that
+   wrote them so they can be mapped and used in place.  A header is followed
+   by fixed-size tables of examples, events and ranges, then the strings, then
+   the unit values and indices.  Offsets in the header and in range records
+   are from the start of the file, string offsets are from the start of the
+   string section, and a range list shared by several events is stored once. */
+#define MAP_VERSION     2
+#define MAP_ALIGN(x)    (((x) + 7) & ~((long long) 7))
+
+typedef struct mapHeader {
+  int        cookie;            /* MAPPED_EXAMPLE_COOKIE in network order */
+  int        byteOrder;
+  int        version;
+  int        realSize;
+  int        numExamples;
+  int        numEvents;
+  int        numRanges;
+  int        pad;
+  long long  proc;              /* Offset of the set proc, or -1 */
+  real       maxTime;
+  real       minTime;
+  real       graceTime;
+  real       defaultInput;
+  real       activeInput;
+  real       defaultTarget;
+  real       activeTarget;
+  real       pad2;
+  long long  example;           /* Section offsets */
+  long long  event;
+  long long  range;
+  long long  string;
+  long long  data;
+  long long  size;
+} *MapHeader;
+
+typedef struct mapExample {
+  long long  name;
+  long long  proc;
+  int        firstEvent;
+  int        numEvents;
+  real       frequency;
+  int        pad;
+} *MapExample;
+
+typedef struct mapEvent {
+  long long  proc;
+  int        input;             /* First range of the list, if any */
+  int        numInputs;
+  int        target;
+  int        numTargets;
+  int        sharedInputs;
+  int        sharedTargets;
+  real       maxTime;
+  real       minTime;
+  real       graceTime;
+  real       defaultInput;
+  real       activeInput;
+  real       defaultTarget;
+  real       activeTarget;
+  int        pad;
+} *MapEvent;
+
+typedef struct mapRange {
+  long long  groupName;
+  long long  data;              /* Offset of the values or unit indices */
+  int        numUnits;
+  int        firstUnit;
+  int        sparse;
+  real       value;
+} *MapRange;
+
+/* The examples, events and ranges loaded from one file are each allocated in
+   a single block that is freed along with the mapping when the last example
+   is freed. */
+struct exampleMap {
+  char      *data;
+  size_t     size;
+  int        refs;
+  Example    example;
+  Event      event;
+  Range      range;
+};
+
+static void releaseExampleMap(ExampleMap M) {
+  if (--M->refs > 0) return;
+  unmapFile(M->data, M->size);
+  FREE(M->example);
+  FREE(M->event);
+  FREE(M->range);
+  free(M);
+}
+
+/* Checks every offset and count so nothing can point outside the mapping.
+   Returns a description of the first problem or NULL. */
+static char *badExampleMap(ExampleMap M) {
+  MapHeader H = (MapHeader) M->data;
+  MapExample X;
+  MapEvent Y;
+  MapRange Z;
+  long long size = (long long) M->size, strings, end;
+  int i, events;
+
+  if (size < (long long) sizeof(struct mapHeader) ||
+      ntohl(H->cookie) != MAPPED_EXAMPLE_COOKIE)
+    return "missing cookie";
+  if (H->byteOrder != MAP_BYTE_ORDER)
+    return "file was written on a machine with a different byte order";
+  if (H->version != MAP_VERSION)
+    return "unknown version";
+  if (H->realSize != sizeof(real))
+    return "sizeof(real) doesn't match";
+  if (H->size != size)
+    return "file size doesn't match the header";
+  if (H->numExamples < 0 || H->numEvents < 0 || H->numRanges < 0)
+    return "bad table sizes";
+  if ((H->example | H->event | H->range | H->string | H->data) & 7 ||
+      H->example < (long long) sizeof(struct mapHeader) ||
+      H->event < H->example +
+      (long long) H->numExamples * sizeof(struct mapExample) ||
+      H->range < H->event +
+      (long long) H->numEvents * sizeof(struct mapEvent) ||
+      H->string < H->range +
+      (long long) H->numRanges * sizeof(struct mapRange) ||
+      H->data < H->string || H->data > size)
+    return "bad section offsets";
+  strings = H->data - H->string;
+  if (strings && M->data[H->data - 1])
+    return "unterminated string";
+#define BAD_STRING(s) ((s) < -1 || (s) >= strings)
+  if (BAD_STRING(H->proc)) return "bad set proc";
+
+  X = (MapExample) (M->data + H->example);
+  for (i = events = 0; i < H->numExamples; i++, X++) {
+    if (BAD_STRING(X->name) || BAD_STRING(X->proc))
+      return "bad example name or proc";
+    if (X->frequency < 0.0) return "bad example frequency";
+    if (X->firstEvent != events || X->numEvents <= 0 ||
+	(long long) events + X->numEvents > H->numEvents)
+      return "bad example events";
+    events += X->numEvents;
+  }
+  Y = (MapEvent) (M->data + H->event);
+  for (i = 0; i < H->numEvents; i++, Y++) {
+    if (BAD_STRING(Y->proc)) return "bad event proc";
+    if (Y->numInputs < 0 || (Y->numInputs &&
+	(Y->input < 0 || (long long) Y->input + Y->numInputs > H->numRanges)))
+      return "bad event inputs";
+    if (Y->numTargets < 0 || (Y->numTargets &&
+	(Y->target < 0 ||
+	 (long long) Y->target + Y->numTargets > H->numRanges)))
+      return "bad event targets";
+  }
+  Z = (MapRange) (M->data + H->range);
+  for (i = 0; i < H->numRanges; i++, Z++) {
+    if (BAD_STRING(Z->groupName)) return "bad range group name";
+    if (Z->numUnits < 0 || Z->data < H->data ||
+	Z->data % ((Z->sparse) ? sizeof(int) : sizeof(real)))
+      return "bad range";
+    end = Z->data + (long long) Z->numUnits *
+      ((Z->sparse) ? sizeof(int) : sizeof(real));
+    if (end > size) return "range values run past the end of the file";
+  }
+#undef BAD_STRING
+  return NULL;
+}
+
+static char *mapString(ExampleMap M, long long s) {
+  return (s < 0) ? NULL : M->data + ((MapHeader) M->data)->string + s;
+}
+
+/* Links a run of ranges into a list. */
+static Range mapRangeList(ExampleMap M, int first, int num) {
+  int r;
+  if (num == 0) return NULL;
+  for (r = first; r < first + num - 1; r++)
+    M->range[r].next = M->range + r + 1;
+  return M->range + first;
+}
+
+static flag mapExampleSet(char *setName, Tcl_Obj *fileNameObj, ExampleSet *Sp,
+			  flag pipe, int maxExamples) {
+  ExampleSet S = *Sp;
+  ExampleMap M;
+  MapHeader H;
+  MapExample X;
+  MapEvent Y;
+  MapRange Z;
+  Example E;
+  Event V;
+  Range L;
+  int i, v, numExamples;
+  flag halted;
+  char *problem, *fileName = Tcl_GetStringFromObj(fileNameObj, NULL);
+
+  if (pipe)
+    return error("loadExamples: mapped example file \"%s\" can't be used as "
+		 "a pipe", fileName);
+  M = (ExampleMap) safeCalloc(1, sizeof *M, "mapExampleSet:M");
+  M->refs = 1;
+  if (!(M->data = mapFile(fileNameObj, &M->size))) {
+    releaseExampleMap(M);
+    return error("loadExamples: couldn't map the file \"%s\", mapped example "
+		 "files can't be compressed", fileName);
+  }
+  if ((problem = badExampleMap(M))) {
+    releaseExampleMap(M);
+    return error("loadExamples: %s in mapped example file \"%s\"", problem,
+		 fileName);
+  }
+  H = (MapHeader) M->data;
+
+  if (!S) registerExampleSet((S = *Sp = newExampleSet(setName)));
+  if (H->proc >= 0) {
+    if (S->proc) Tcl_DecrRefCount(S->proc);
+    S->proc = Tcl_NewStringObj(mapString(M, H->proc), -1);
+    Tcl_IncrRefCount(S->proc);
+    if (Tcl_EvalObjEx(Interp, S->proc, TCL_EVAL_GLOBAL) != TCL_OK) {
+      releaseExampleMap(M);
+      return TCL_ERROR;
+    }
+  }
+  S->maxTime       = H->maxTime;
+  S->minTime       = H->minTime;
+  S->graceTime     = H->graceTime;
+  S->defaultInput  = H->defaultInput;
+  S->activeInput   = H->activeInput;
+  S->defaultTarget = H->defaultTarget;
+  S->activeTarget  = H->activeTarget;
+
+  M->example = (Example) safeCalloc(H->numExamples, sizeof(struct example),
+				    "mapExampleSet:M->example");
+  M->event = (Event) safeCalloc(H->numEvents, sizeof(struct event),
+				"mapExampleSet:M->event");
+  M->range = (Range) safeCalloc(H->numRanges, sizeof(struct range),
+				"mapExampleSet:M->range");
+
+  /* The values are used where they lie */
+  Z = (MapRange) (M->data + H->range);
+  for (i = 0; i < H->numRanges; i++, Z++) {
+    L = M->range + i;
+    L->groupName = mapString(M, Z->groupName);
+    L->numUnits  = Z->numUnits;
+    L->firstUnit = Z->firstUnit;
+    L->value     = Z->value;
+    if (Z->sparse) L->unit = (int *) (M->data + Z->data);
+    else L->val = (real *) (M->data + Z->data);
+  }
+
+  numExamples = H->numExamples;
+  if (maxExamples && maxExamples < numExamples) numExamples = maxExamples;
+  X = (MapExample) (M->data + H->example);
+  for (i = 0, halted = FALSE; i < numExamples && !halted; i++, X++) {
+    E = M->example + i;
+    E->set = S;
+    E->map = M;
+    M->refs++;
+    /* The name is copied because it can be changed */
+    if (X->name >= 0) E->name = copyString(mapString(M, X->name));
+    if (X->proc >= 0) {
+      E->proc = Tcl_NewStringObj(mapString(M, X->proc), -1);
+      Tcl_IncrRefCount(E->proc);
+    }
+    E->frequency = X->frequency;
+    E->numEvents = X->numEvents;
+    E->event = M->event + X->firstEvent;
+
+    Y = (MapEvent) (M->data + H->event) + X->firstEvent;
+    for (v = 0; v < E->numEvents; v++, Y++) {
+      V = E->event + v;
+      V->example       = E;
+      V->input         = mapRangeList(M, Y->input, Y->numInputs);
+      V->sharedInputs  = Y->sharedInputs;
+      V->target        = mapRangeList(M, Y->target, Y->numTargets);
+      V->sharedTargets = Y->sharedTargets;
+      V->maxTime       = Y->maxTime;
+      V->minTime       = Y->minTime;
+      V->graceTime     = Y->graceTime;
+      V->defaultInput  = Y->defaultInput;
+      V->activeInput   = Y->activeInput;
+      V->defaultTarget = Y->defaultTarget;
+      V->activeTarget  = Y->activeTarget;
+      if (Y->proc >= 0) {
+	V->proc = Tcl_NewStringObj(mapString(M, Y->proc), -1);
+	Tcl_IncrRefCount(V->proc);
+      }
+      initEventExtension(V);
+    }
+    initExampleExtension(E);
+    registerExample(E, S);
+
+    halted = smartUpdate(FALSE);
+  }
+
+  /* The examples now hold the map */
+  releaseExampleMap(M);
+  compileExampleSet(S);
+  if (halted) return result("mapExampleSet: halted prematurely");
+  return TCL_OK;
+}
+
 /* A mode of 0 means do nothing if the set exists.
    1 means override the set
    2 means add to the set
@@ -1275,13 +1937,214 @@ flag loadExamples(char *setName, Tcl_Obj *fileNameObj, int mode, int numExamples
   return result(setName);
 }
 
+/******************************** Pipe Prefetching ***************************/
+
+#ifdef HAVE_THREADS
+/* While one example from a pipe is being used, a reader thread parses up to
+   pipePrefetch more into spare examples.  The reader quits at the end of the
+   pipe or on an error, which the main thread then handles as it always has.
+   Standard input and Tcl channels are left alone since the interpreter may
+   be using them. */
+struct pipeQueue {
+  pthread_t       thread;
+  pthread_mutex_t lock;
+  pthread_cond_t  ready;        /* An example was added or the reader quit */
+  pthread_cond_t  space;        /* An example was taken or stop was set */
+  Example        *example;
+  int             size;
+  int             first;
+  int             count;
+  flag            running;
+  flag            stop;         /* The reader should quit */
+  flag            stopped;      /* The reader has quit */
+  flag            failed;       /* It quit on a parse error */
+  String          message;
+};
+
+static void *pipeReader(void *data) {
+  ExampleSet S = (ExampleSet) data;
+  PipeQueue Q = S->pipeQueue;
+  ParseRec R = S->pipeParser;
+  Example E;
+  flag failed = FALSE, stop;
+  char c;
+
+  buf = newString(128);
+  Tcl_SpliceChannel(R->channel);
+  for (;;) {
+    pthread_mutex_lock(&Q->lock);
+    while (Q->count == Q->size && !Q->stop)
+      pthread_cond_wait(&Q->space, &Q->lock);
+    stop = Q->stop;
+    pthread_mutex_unlock(&Q->lock);
+    if (stop) break;
+
+    /* fileDone() takes an empty buffer as the end of a binary pipe, so this
+       waits for more data or the real end. */
+    if (R->binary) {
+      if (Tcl_InputBuffered(R->channel) == 0) {
+	if (Tcl_Read(R->channel, &c, 1) != 1) break;
+	Tcl_Ungets(R->channel, &c, 1, FALSE);
+      }
+    } else if (fileDone(R)) break;
+    E = newExample(S);
+    if ((R->binary) ? readBinaryExample(E, R) : readExample(E, R)) {
+      freeExample(E);
+      failed = TRUE;
+      break;
+    }
+
+    pthread_mutex_lock(&Q->lock);
+    Q->example[(Q->first + Q->count++) % Q->size] = E;
+    pthread_cond_signal(&Q->ready);
+    pthread_mutex_unlock(&Q->lock);
+  }
+  Tcl_CutChannel(R->channel);
+  freeString(buf);
+  buf = NULL;
+
+  pthread_mutex_lock(&Q->lock);
+  Q->failed = failed;
+  Q->stopped = TRUE;
+  pthread_cond_signal(&Q->ready);
+  pthread_mutex_unlock(&Q->lock);
+  return NULL;
+}
+
+static flag startPipeReader(ExampleSet S) {
+  PipeQueue Q = S->pipeQueue;
+  ParseRec R = S->pipeParser;
+
+  if (S->pipePrefetch <= 0 || Tcl_GetString(R->fileName)[0] == '-')
+    return TCL_ERROR;
+  if (!Q) {
+    Q = S->pipeQueue = (PipeQueue) safeCalloc(1, sizeof *Q,
+					      "startPipeReader:Q");
+    pthread_mutex_init(&Q->lock, NULL);
+    pthread_cond_init(&Q->ready, NULL);
+    pthread_cond_init(&Q->space, NULL);
+    Q->message = newString(64);
+  }
+  if (Q->size != S->pipePrefetch) {
+    Q->size = S->pipePrefetch;
+    Q->example = (Example *) safeRealloc(Q->example, Q->size *
+					 sizeof(Example), "startPipeReader");
+  }
+  Q->first = Q->count = 0;
+  Q->stop = Q->stopped = Q->failed = FALSE;
+
+  /* The channel belongs to the reader until it is stopped */
+  R->message = Q->message;
+  Tcl_CutChannel(R->channel);
+  if (pthread_create(&Q->thread, NULL, pipeReader, S)) {
+    Tcl_SpliceChannel(R->channel);
+    R->message = NULL;
+    return TCL_ERROR;
+  }
+  Q->running = TRUE;
+  return TCL_OK;
+}
+
+/* This waits for the reader to quit and discards any examples it left. */
+static void stopPipeReader(ExampleSet S) {
+  PipeQueue Q = S->pipeQueue;
+  if (!Q || !Q->running) return;
+  pthread_mutex_lock(&Q->lock);
+  Q->stop = TRUE;
+  pthread_cond_signal(&Q->space);
+  pthread_mutex_unlock(&Q->lock);
+  pthread_join(Q->thread, NULL);
+  Tcl_SpliceChannel(S->pipeParser->channel);
+  S->pipeParser->message = NULL;
+
+  for (; Q->count > 0; Q->count--) {
+    freeExample(Q->example[Q->first]);
+    Q->first = (Q->first + 1) % Q->size;
+  }
+  Q->running = FALSE;
+}
+
+static void freePipeQueue(ExampleSet S) {
+  PipeQueue Q = S->pipeQueue;
+  if (!Q) return;
+  stopPipeReader(S);
+  pthread_mutex_destroy(&Q->lock);
+  pthread_cond_destroy(&Q->ready);
+  pthread_cond_destroy(&Q->space);
+  FREE(Q->example);
+  freeString(Q->message);
+  FREE(S->pipeQueue);
+}
+
+/* Returns the next prefetched example, starting the reader if needed.  This
+   returns NULL if the pipe isn't prefetched or the reader has quit, leaving
+   the queue's failed flag set if it quit on an error. */
+static Example nextPrefetchedExample(ExampleSet S) {
+  PipeQueue Q = S->pipeQueue;
+  Example E = NULL;
+
+  if ((!Q || !Q->running) && startPipeReader(S)) return NULL;
+  Q = S->pipeQueue;
+  pthread_mutex_lock(&Q->lock);
+  while (!Q->count && !Q->stopped)
+    pthread_cond_wait(&Q->ready, &Q->lock);
+  if (Q->count) {
+    E = Q->example[Q->first];
+    Q->first = (Q->first + 1) % Q->size;
+    Q->count--;
+    pthread_cond_signal(&Q->space);
+  }
+  pthread_mutex_unlock(&Q->lock);
+  if (!E) stopPipeReader(S);
+  return E;
+}
+
+/* The pipe example may be pointed to elsewhere, so the prefetched one is
+   moved into it. */
+static void takePipeExample(ExampleSet S, Example E) {
+  Example P = S->pipeExample;
+  int v;
+  cleanExample(P);
+  clearExample(P);
+  P->name      = E->name;
+  P->numEvents = E->numEvents;
+  P->event     = E->event;
+  P->frequency = E->frequency;
+  P->proc      = E->proc;
+  for (v = 0; v < P->numEvents; v++)
+    P->event[v].example = P;
+  clearExample(E);
+  freeExample(E);
+}
+
+#else
+static void stopPipeReader(ExampleSet S) {}
+static void freePipeQueue(ExampleSet S) {}
+#endif /* HAVE_THREADS */
+
 static flag readPipeExample(ExampleSet S) {
   ParseRec R = S->pipeParser;
+#ifdef HAVE_THREADS
+  Example E;
+#endif /* HAVE_THREADS */
 
   if (!R || !R->channel) {
     error("example set \"%s\" is in PIPE mode but has no open pipe",
 	    S->name);
     goto abort;}
+#ifdef HAVE_THREADS
+  if ((E = nextPrefetchedExample(S))) {
+    takePipeExample(S, E);
+    S->pipeExampleNum++;
+    return result("");
+  }
+  if (S->pipeQueue && S->pipeQueue->failed) {
+    S->pipeQueue->failed = FALSE;
+    error("%s", S->pipeQueue->message->s);
+    parseError(R, "");
+    goto abort;
+  }
+#endif /* HAVE_THREADS */
   if (fileDone(R)) {
     if (S->pipeLoop) {
       /* Reopen the pipe (and close the old one) */
@@ -1658,15 +2521,863 @@ flag writeBinaryExampleFile(ExampleSet S, Tcl_Obj *fileNameObj) {
   return TCL_OK;
 }
 
+typedef struct mapWriter {
+  MapRange   range;
+  Range     *source;            /* The range each record came from */
+  int        numRanges;
+  int        maxRanges;
+  char      *string;
+  long long  stringSize;
+  long long  maxString;
+  char     **groupName;         /* Group names already in the strings */
+  long long *groupString;
+  int        numGroupNames;
+  long long  dataSize;
+} *MapWriter;
+
+static long long mapAddString(MapWriter W, char *s, int len) {
+  long long offset = W->stringSize;
+  if (!s) return -1;
+  if (len < 0) len = strlen(s);
+  while (W->stringSize + len + 1 > W->maxString) {
+    W->maxString = (W->maxString) ? W->maxString * 2 : 1024;
+    W->string = (char *) safeRealloc(W->string, W->maxString,
+				     "mapAddString:W->string");
+  }
+  memcpy(W->string + offset, s, len);
+  W->string[offset + len] = '\0';
+  W->stringSize += len + 1;
+  return offset;
+}
+
+static long long mapAddProc(MapWriter W, Tcl_Obj *proc) {
+  int len;
+  char *s;
+  if (!proc) return -1;
+  s = Tcl_GetStringFromObj(proc, &len);
+  return mapAddString(W, s, len);
+}
+
+/* Group names are stored once each */
+static long long mapAddGroupName(MapWriter W, char *name) {
+  int i;
+  if (!name) return -1;
+  for (i = 0; i < W->numGroupNames; i++)
+    if (W->groupName[i] == name || !strcmp(W->groupName[i], name))
+      return W->groupString[i];
+  W->groupName = (char **) safeRealloc(W->groupName, (i + 1) * sizeof(char *),
+				       "mapAddGroupName:W->groupName");
+  W->groupString = (long long *) safeRealloc(W->groupString, (i + 1) *
+	 sizeof(long long), "mapAddGroupName:W->groupString");
+  W->groupName[i] = name;
+  W->groupString[i] = mapAddString(W, name, -1);
+  W->numGroupNames++;
+  return W->groupString[i];
+}
+
+/* Returns the index of the first range in the list and the list length. */
+static int mapAddRangeList(MapWriter W, Range L, int *num) {
+  int first = W->numRanges;
+  MapRange Z;
+  for (*num = 0; L; L = L->next, (*num)++) {
+    if (W->numRanges == W->maxRanges) {
+      W->maxRanges = (W->maxRanges) ? W->maxRanges * 2 : 1024;
+      W->range = (MapRange) safeRealloc(W->range, W->maxRanges *
+		   sizeof(struct mapRange), "mapAddRangeList:W->range");
+      W->source = (Range *) safeRealloc(W->source, W->maxRanges *
+		   sizeof(Range), "mapAddRangeList:W->source");
+    }
+    W->source[W->numRanges] = L;
+    Z = W->range + W->numRanges++;
+    memset(Z, 0, sizeof *Z);
+    Z->groupName = mapAddGroupName(W, L->groupName);
+    Z->numUnits  = L->numUnits;
+    Z->firstUnit = L->firstUnit;
+    Z->sparse    = (L->val) ? FALSE : TRUE;
+    Z->value     = L->value;
+    /* Dense values are used in place, so they are aligned for real. */
+    if (!Z->sparse)
+      W->dataSize += -W->dataSize & (long long) (sizeof(real) - 1);
+    Z->data      = W->dataSize;
+    W->dataSize += (long long) L->numUnits *
+      ((Z->sparse) ? sizeof(int) : sizeof(real));
+  }
+  return (*num) ? first : -1;
+}
+
+/* Shared lists are found among the lists this example has already stored. */
+static void mapEventList(MapWriter W, Range L, flag shared, Range *list,
+			 int *listFirst, int *listNum, int *lists,
+			 int *first, int *num, int *sharedOut) {
+  int i;
+  *sharedOut = FALSE;
+  if (!L) {
+    *first = -1;
+    *num = 0;
+    return;
+  }
+  if (shared) {
+    for (i = 0; i < *lists && list[i] != L; i++);
+    if (i < *lists) {
+      *first = listFirst[i];
+      *num = listNum[i];
+      *sharedOut = TRUE;
+      return;
+    }
+  }
+  *first = mapAddRangeList(W, L, num);
+  list[*lists] = L;
+  listFirst[*lists] = *first;
+  listNum[(*lists)++] = *num;
+}
+
+static flag mapWrite(Tcl_Channel channel, void *data, long long size) {
+  char *s = (char *) data;
+  int chunk;
+  for (; size > 0; s += chunk, size -= chunk) {
+    chunk = (size > (1 << 30)) ? (1 << 30) : (int) size;
+    if (Tcl_Write(channel, s, chunk) != chunk) return TCL_ERROR;
+  }
+  return TCL_OK;
+}
+
+flag writeMappedExampleFile(ExampleSet S, Tcl_Obj *fileNameObj) {
+  struct mapHeader header;
+  struct mapWriter writer;
+  MapHeader H = &header;
+  MapWriter W = &writer;
+  MapExample X, example = NULL;
+  MapEvent Y, event = NULL;
+  Range *list = NULL, L;
+  int *listFirst = NULL, *listNum = NULL, lists, pass;
+  int i, v, numEvents, maxEvents;
+  long long pad = 0, at;
+  flag halted = FALSE, failed = FALSE;
+  Example E;
+  Event V;
+  Tcl_Channel channel;
+  char *fileName = Tcl_GetStringFromObj(fileNameObj, NULL);
+
+  if (fileName[0] == '|' || fileName[0] == '-' ||
+      stringEndsIn(fileName, ".gz") || stringEndsIn(fileName, ".Z") ||
+      stringEndsIn(fileName, ".bz") || stringEndsIn(fileName, ".bz2"))
+    return warning("writeMappedExampleFile: mapped example files must be "
+		   "plain files, not \"%s\"", fileName);
+
+  for (E = S->firstExample, numEvents = maxEvents = 0; E; E = E->next) {
+    numEvents += E->numEvents;
+    if (E->numEvents > maxEvents) maxEvents = E->numEvents;
+  }
+  memset(W, 0, sizeof *W);
+  example = (MapExample) safeCalloc(S->numExamples, sizeof(struct mapExample),
+				    "writeMappedExampleFile:example");
+  event = (MapEvent) safeCalloc(numEvents, sizeof(struct mapEvent),
+				"writeMappedExampleFile:event");
+  list = (Range *) safeMalloc(2 * maxEvents * sizeof(Range) + 1,
+			      "writeMappedExampleFile:list");
+  listFirst = intArray(2 * maxEvents + 1, "writeMappedExampleFile:listFirst");
+  listNum = intArray(2 * maxEvents + 1, "writeMappedExampleFile:listNum");
+
+  /* Build the tables */
+  memset(H, 0, sizeof *H);
+  H->proc = mapAddProc(W, S->proc);
+  for (E = S->firstExample, X = example, Y = event, numEvents = 0;
+       E && !halted; E = E->next, X++) {
+    X->name = mapAddString(W, E->name, -1);
+    X->proc = mapAddProc(W, E->proc);
+    X->firstEvent = numEvents;
+    X->numEvents = E->numEvents;
+    X->frequency = E->frequency;
+    numEvents += E->numEvents;
+    /* Unshared lists are stored first so shared ones can find them */
+    for (pass = 0, lists = 0; pass < 2; pass++) {
+      for (v = 0; v < E->numEvents; v++) {
+	V = E->event + v;
+	if ((V->sharedInputs != FALSE) == pass)
+	  mapEventList(W, V->input, V->sharedInputs, list, listFirst, listNum,
+		       &lists, &Y[v].input, &Y[v].numInputs,
+		       &Y[v].sharedInputs);
+	if ((V->sharedTargets != FALSE) == pass)
+	  mapEventList(W, V->target, V->sharedTargets, list, listFirst,
+		       listNum, &lists, &Y[v].target, &Y[v].numTargets,
+		       &Y[v].sharedTargets);
+      }
+    }
+    for (v = 0; v < E->numEvents; v++, Y++) {
+      V = E->event + v;
+      Y->proc          = mapAddProc(W, V->proc);
+      Y->maxTime       = V->maxTime;
+      Y->minTime       = V->minTime;
+      Y->graceTime     = V->graceTime;
+      Y->defaultInput  = V->defaultInput;
+      Y->activeInput   = V->activeInput;
+      Y->defaultTarget = V->defaultTarget;
+      Y->activeTarget  = V->activeTarget;
+    }
+    halted = smartUpdate(FALSE);
+  }
+  if (halted) goto done;
+
+  /* Fill in the header */
+  H->cookie        = htonl(MAPPED_EXAMPLE_COOKIE);
+  H->byteOrder     = MAP_BYTE_ORDER;
+  H->version       = MAP_VERSION;
+  H->realSize      = sizeof(real);
+  H->numExamples   = S->numExamples;
+  H->numEvents     = numEvents;
+  H->numRanges     = W->numRanges;
+  H->maxTime       = S->maxTime;
+  H->minTime       = S->minTime;
+  H->graceTime     = S->graceTime;
+  H->defaultInput  = S->defaultInput;
+  H->activeInput   = S->activeInput;
+  H->defaultTarget = S->defaultTarget;
+  H->activeTarget  = S->activeTarget;
+  H->example = MAP_ALIGN((long long) sizeof(struct mapHeader));
+  H->event   = H->example +
+    MAP_ALIGN((long long) H->numExamples * sizeof(struct mapExample));
+  H->range   = H->event +
+    MAP_ALIGN((long long) H->numEvents * sizeof(struct mapEvent));
+  H->string  = H->range +
+    MAP_ALIGN((long long) H->numRanges * sizeof(struct mapRange));
+  H->data    = H->string + MAP_ALIGN(W->stringSize);
+  H->size    = H->data + W->dataSize;
+  for (i = 0; i < W->numRanges; i++)
+    W->range[i].data += H->data;
+
+  if (!(channel = writeChannel(fileNameObj, FALSE))) {
+    failed = TRUE;
+    error("writeMappedExampleFile: couldn't open the file \"%s\"", fileName);
+    goto done;
+  }
+  binaryEncoding(channel);
+  failed =
+    mapWrite(channel, H, sizeof(struct mapHeader)) ||
+    mapWrite(channel, example,
+	     (long long) H->numExamples * sizeof(struct mapExample)) ||
+    mapWrite(channel, event,
+	     (long long) H->numEvents * sizeof(struct mapEvent)) ||
+    mapWrite(channel, W->range,
+	     (long long) H->numRanges * sizeof(struct mapRange)) ||
+    mapWrite(channel, W->string, W->stringSize) ||
+    mapWrite(channel, &pad, H->data - H->string - W->stringSize);
+  for (i = 0, at = H->data; i < W->numRanges && !failed; i++) {
+    L = W->source[i];
+    failed = mapWrite(channel, &pad, W->range[i].data - at) ||
+      ((W->range[i].sparse) ?
+       mapWrite(channel, L->unit, (long long) L->numUnits * sizeof(int)) :
+       mapWrite(channel, L->val, (long long) L->numUnits * sizeof(real)));
+    at = W->range[i].data + (long long) L->numUnits *
+      ((W->range[i].sparse) ? sizeof(int) : sizeof(real));
+  }
+  closeChannel(channel);
+  if (failed)
+    error("writeMappedExampleFile: error writing the file \"%s\"", fileName);
+
+ done:
+  FREE(example);
+  FREE(event);
+  FREE(list);
+  FREE(listFirst);
+  FREE(listNum);
+  FREE(W->range);
+  FREE(W->source);
+  FREE(W->string);
+  FREE(W->groupName);
+  FREE(W->groupString);
+  if (halted)
+    return error("writeMappedExampleFile: halted prematurely");
+  return (failed) ? TCL_ERROR : TCL_OK;
+}
+
 /*****************************************************************************/
 /* These procedures are for writing network targets and outputs to a file so
    performance can be analyzed by an external program. */
 
+/* Each example's record is copied from the history rows into a block of raw
+   values.  Full blocks are encoded and written in large chunks, by a writer
+   thread when the channel can be given to one.  There are only OUTPUT_BLOCKS
+   blocks, so if the file can't keep up the network waits for it. */
+#define OUTPUT_BLOCKS      4
+#define OUTPUT_BLOCK_WORDS (1 << 18)
+#define OUTPUT_CHUNK       (1 << 16)
+#define OUTPUT_MAX_ENTRY   64
+
+typedef union {
+  int  i;
+  real r;
+} OutputWord;
+
+typedef struct outputBlock {
+  OutputWord *word;
+  int         size;
+  int         used;
+  flag        flush;            /* Flush the channel after writing it */
+} *OutputBlock;
+
+/* A columnar file starts with a header and a table of the groups written.
+   Each block then becomes a chunk holding its records as columns: the
+   examples (updates, example, ticks, first row), the ticks (tick, event), and
+   for each group the outputs and the targets, one row of units per tick.  The
+   targets column is empty unless it is an output group.  A column is compressed with zlib if asked and if
+   that makes it smaller.  When the file is closed, a table of the chunks is
+   added and its offset put in the header.  Like mapped example files, these
+   are in the byte order of the machine that wrote them and everything is
+   aligned to 8 bytes. */
+#define COLUMN_VERSION  1
+
+typedef struct columnHeader {
+  int        cookie;            /* OUTPUT_COLUMNS_COOKIE in network order */
+  int        byteOrder;
+  int        version;
+  int        realSize;
+  int        numGroups;
+  int        compressed;
+  int        numChunks;
+  int        numExamples;
+  long long  index;             /* Offset of the chunk table, 0 until closed */
+} *ColumnHeader;
+
+typedef struct columnGroup {
+  int        numUnits;
+  int        targets;
+  int        nameLength;        /* The name follows, padded to 8 bytes */
+  int        pad;
+} *ColumnGroup;
+
+typedef struct columnChunk {
+  long long  offset;
+  int        firstExample;
+  int        numExamples;
+} *ColumnChunk;
+
+/* A chunk starts with this, followed by the size of each column. */
+typedef struct chunkHeader {
+  int        numExamples;
+  int        numRows;
+  int        numColumns;
+  int        pad;
+} *ChunkHeader;
+
+typedef struct columnSize {
+  int        stored;            /* Less than raw if it is compressed */
+  int        raw;
+} *ColumnSize;
+
+struct outputWriter {
+  Tcl_Channel     channel;
+  flag            binary;
+  flag            shared;       /* The interpreter may be using the channel */
+  flag            failed;
+  struct outputBlock block[OUTPUT_BLOCKS];
+  int             fill;         /* The block being filled */
+  int             first;        /* The oldest block waiting to be written */
+  int             count;        /* The number waiting */
+  int             examples;     /* Examples since the last flush */
+  char           *chunk;
+  int             chunkUsed;
+  flag            columnar;
+  flag            compress;
+  int             numGroups;    /* The groups of a columnar file */
+  int            *groupUnits;
+  flag           *groupTargets;
+  int             tickWords;    /* The size of each tick in a record */
+  int             numColumns;
+  char          **columnStart;
+  struct columnSize *columnSize;
+  Tcl_Obj       **columnObj;
+  char           *column;       /* The raw columns of a chunk */
+  long long       columnBytes;
+  ColumnChunk     index;
+  int             numChunks;
+  int             maxChunks;
+  int             numExamples;
+  long long       offset;       /* Bytes written to the file */
+#ifdef HAVE_THREADS
+  pthread_t       thread;
+  pthread_mutex_t lock;
+  pthread_cond_t  ready;        /* A block was queued or stop was set */
+  pthread_cond_t  space;        /* A block was written */
+  flag            running;
+  flag            stop;
+#endif
+};
+
+static void writeOutputChunk(OutputWriter W) {
+  if (W->chunkUsed && !W->failed &&
+      Tcl_Write(W->channel, W->chunk, W->chunkUsed) != W->chunkUsed)
+    W->failed = TRUE;
+  W->chunkUsed = 0;
+}
+
+static char *outputSpace(OutputWriter W) {
+  if (W->chunkUsed > OUTPUT_CHUNK - OUTPUT_MAX_ENTRY) writeOutputChunk(W);
+  return W->chunk + W->chunkUsed;
+}
+
+/* This matches writeBinInt() and, if isFlag, writeBinFlag() or otherwise the
+   "%d %d" lines of the text format. */
+static void encodeOutputPair(OutputWriter W, int a, int b, flag isFlag) {
+  char *s = outputSpace(W);
+  if (!W->binary) {
+    W->chunkUsed += sprintf(s, "%d %d\n", a, b);
+    return;
+  }
+  a = HTONL(a);
+  memcpy(s, &a, sizeof(int));
+  if (isFlag) {
+    s[sizeof(int)] = (char) b;
+    W->chunkUsed += sizeof(int) + 1;
+  } else {
+    b = HTONL(b);
+    memcpy(s + sizeof(int), &b, sizeof(int));
+    W->chunkUsed += 2 * sizeof(int);
+  }
+}
+
+/* This matches writeBinReal(). */
+static char *encodeBinReal(char *s, real r) {
+  int y;
+#ifdef FLOAT_REAL
+  memcpy(&y, &r, sizeof(int));
+#else
+  float x = (isNaN(r)) ? NaNf : (float) r;
+  memcpy(&y, &x, sizeof(int));
+#endif /* FLOAT_REAL */
+  y = HTONL(y);
+  memcpy(s, &y, sizeof(int));
+  return s + sizeof(int);
+}
+
+/* This matches writeReal(). */
+static char *encodeTextReal(char *s, real r) {
+  if (isNaN(r)) return s + sprintf(s, "%s", NO_VALUE);
+  return s + sprintf(s, "%g", r);
+}
+
+/* The block holds whole records laid out as: updates, example, ticks,
+   groups, and then for each tick: tick, event, and for each group: units,
+   isOutput, the outputs and then the targets if it is an output group. */
+static void encodeOutputBlock(OutputWriter W, OutputBlock B) {
+  OutputWord *w = B->word, *end = B->word + B->used;
+  OutputWord *output, *target;
+  int ticks, groups, g, u, n;
+  char *s;
+
+  while (w < end) {
+    ticks = w[2].i;
+    groups = w[3].i;
+    encodeOutputPair(W, w[0].i, w[1].i, FALSE);
+    encodeOutputPair(W, ticks, groups, FALSE);
+    w += 4;
+    for (; ticks > 0; ticks--) {
+      encodeOutputPair(W, w[0].i, w[1].i, FALSE);
+      w += 2;
+      for (g = 0; g < groups; g++) {
+	n = w[0].i;
+	encodeOutputPair(W, n, w[1].i, W->binary);
+	output = w + 2;
+	target = (w[1].i) ? output + n : NULL;
+	w = output + ((target) ? 2 * n : n);
+	for (u = 0; u < n; u++) {
+	  s = outputSpace(W);
+	  if (W->binary) {
+	    s = encodeBinReal(s, output[u].r);
+	    if (target) s = encodeBinReal(s, target[u].r);
+	  } else {
+	    s = encodeTextReal(s, output[u].r);
+	    if (target) {
+	      *s++ = ' ';
+	      s = encodeTextReal(s, target[u].r);
+	    }
+	    *s++ = '\n';
+	  }
+	  W->chunkUsed = s - W->chunk;
+	}
+      }
+    }
+  }
+}
+
+static void writeOutputBytes(OutputWriter W, void *data, long long bytes) {
+  static char zeros[8];
+  int pad = (int) (MAP_ALIGN(bytes) - bytes);
+  if (!W->failed && (Tcl_Write(W->channel, (char *) data, bytes) != bytes ||
+		     Tcl_Write(W->channel, zeros, pad) != pad))
+    W->failed = TRUE;
+  W->offset += bytes + pad;
+}
+
+/* This uses a stream because the writer has no interpreter.  It returns NULL
+   if compressing fails, in which case the column is stored raw. */
+static Tcl_Obj *deflateColumn(char *data, int bytes) {
+  Tcl_ZlibStream zs;
+  Tcl_Obj *in, *out;
+  if (Tcl_ZlibStreamInit(NULL, TCL_ZLIB_STREAM_DEFLATE, TCL_ZLIB_FORMAT_ZLIB,
+			 TCL_ZLIB_COMPRESS_FAST, NULL, &zs) != TCL_OK)
+    return NULL;
+  in = Tcl_NewByteArrayObj((unsigned char *) data, bytes);
+  out = Tcl_NewObj();
+  Tcl_IncrRefCount(in);
+  Tcl_IncrRefCount(out);
+  if (Tcl_ZlibStreamPut(zs, in, TCL_ZLIB_FINALIZE) != TCL_OK ||
+      Tcl_ZlibStreamGet(zs, out, -1) != TCL_OK) {
+    Tcl_DecrRefCount(out);
+    out = NULL;
+  }
+  Tcl_DecrRefCount(in);
+  Tcl_ZlibStreamClose(zs);
+  return out;
+}
+
+static void writeColumnChunk(OutputWriter W, OutputBlock B) {
+  OutputWord *w, *end = B->word + B->used;
+  struct chunkHeader C;
+  int *example, *tick, t, g, c, u, n, row, stored;
+  long long bytes, total;
+  real *v;
+  unsigned char *packed;
+
+  C.numExamples = C.numRows = C.pad = 0;
+  C.numColumns = W->numColumns;
+  for (w = B->word; w < end; w += 4 + w[2].i * W->tickWords) {
+    C.numExamples++;
+    C.numRows += w[2].i;
+  }
+  if (!C.numExamples) return;
+
+  /* Lay out the raw columns */
+  for (c = total = 0; c < W->numColumns; c++) {
+    if (c == 0)      bytes = (long long) C.numExamples * 4 * sizeof(int);
+    else if (c == 1) bytes = (long long) C.numRows * 2 * sizeof(int);
+    else if (c % 2 && !W->groupTargets[(c - 2) / 2]) bytes = 0;
+    else bytes = (long long) C.numRows * W->groupUnits[(c - 2) / 2] *
+	   sizeof(real);
+    W->columnSize[c].raw = W->columnSize[c].stored = (int) bytes;
+    total += MAP_ALIGN(bytes);
+  }
+  if (total > W->columnBytes) {
+    FREE(W->column);
+    W->columnBytes = total;
+    W->column = (char *) safeMalloc(total, "writeColumnChunk");
+  }
+  for (c = total = 0; c < W->numColumns; c++) {
+    W->columnStart[c] = W->column + total;
+    total += MAP_ALIGN(W->columnSize[c].raw);
+  }
+
+  /* Sort the records into the columns */
+  example = (int *) W->columnStart[0];
+  tick = (int *) W->columnStart[1];
+  for (w = B->word, row = 0; w < end;) {
+    example[0] = w[0].i;
+    example[1] = w[1].i;
+    example[2] = w[2].i;
+    example[3] = row;
+    example += 4;
+    t = w[2].i;
+    w += 4;
+    for (; t > 0; t--, row++) {
+      tick[0] = w[0].i;
+      tick[1] = w[1].i;
+      tick += 2;
+      w += 2;
+      for (g = 0, c = 2; g < W->numGroups; g++, c += 2) {
+	n = w[0].i;
+	w += 2;
+	v = (real *) W->columnStart[c] + row * n;
+	for (u = 0; u < n; u++) v[u] = w[u].r;
+	w += n;
+	if (!W->groupTargets[g]) continue;
+	v = (real *) W->columnStart[c + 1] + row * n;
+	for (u = 0; u < n; u++) v[u] = w[u].r;
+	w += n;
+      }
+    }
+  }
+
+  for (c = 0; c < W->numColumns; c++) {
+    W->columnObj[c] = NULL;
+    if (!W->compress || W->columnSize[c].raw == 0) continue;
+    if (!(W->columnObj[c] = deflateColumn(W->columnStart[c],
+					  W->columnSize[c].raw))) continue;
+    Tcl_GetByteArrayFromObj(W->columnObj[c], &stored);
+    if (stored < W->columnSize[c].raw) W->columnSize[c].stored = stored;
+  }
+
+  if (W->numChunks == W->maxChunks) {
+    W->maxChunks = imax(64, W->maxChunks * 2);
+    W->index = (ColumnChunk) safeRealloc(W->index, W->maxChunks *
+					 sizeof(struct columnChunk),
+					 "writeColumnChunk");
+  }
+  W->index[W->numChunks].offset = W->offset;
+  W->index[W->numChunks].firstExample = W->numExamples;
+  W->index[W->numChunks].numExamples = C.numExamples;
+  W->numChunks++;
+  W->numExamples += C.numExamples;
+
+  writeOutputBytes(W, &C, sizeof C);
+  writeOutputBytes(W, W->columnSize, W->numColumns *
+		   sizeof(struct columnSize));
+  for (c = 0; c < W->numColumns; c++) {
+    if (W->columnSize[c].stored < W->columnSize[c].raw) {
+      packed = Tcl_GetByteArrayFromObj(W->columnObj[c], NULL);
+      writeOutputBytes(W, packed, W->columnSize[c].stored);
+    } else writeOutputBytes(W, W->columnStart[c], W->columnSize[c].raw);
+    if (W->columnObj[c]) Tcl_DecrRefCount(W->columnObj[c]);
+  }
+}
+
+static void writeOutputBlock(OutputWriter W, OutputBlock B) {
+  if (W->columnar) writeColumnChunk(W, B);
+  else {
+    encodeOutputBlock(W, B);
+    writeOutputChunk(W);
+  }
+  if (B->flush && !W->failed && Tcl_Flush(W->channel) != TCL_OK)
+    W->failed = TRUE;
+  B->used = 0;
+  B->flush = FALSE;
+}
+
+#ifdef HAVE_THREADS
+static void *outputWriterThread(void *data) {
+  OutputWriter W = (OutputWriter) data;
+  OutputBlock B;
+
+  Tcl_SpliceChannel(W->channel);
+  for (;;) {
+    pthread_mutex_lock(&W->lock);
+    while (!W->count && !W->stop)
+      pthread_cond_wait(&W->ready, &W->lock);
+    B = (W->count) ? W->block + W->first : NULL;
+    pthread_mutex_unlock(&W->lock);
+    if (!B) break;
+
+    writeOutputBlock(W, B);
+
+    pthread_mutex_lock(&W->lock);
+    W->first = (W->first + 1) % OUTPUT_BLOCKS;
+    W->count--;
+    pthread_cond_signal(&W->space);
+    pthread_mutex_unlock(&W->lock);
+  }
+  Tcl_CutChannel(W->channel);
+  return NULL;
+}
+#endif /* HAVE_THREADS */
+
+/* This hands the filled block to the writer, waiting until another is free,
+   or writes it right away if there is no writer thread. */
+static void queueOutputBlock(OutputWriter W) {
+#ifdef HAVE_THREADS
+  if (W->running) {
+    pthread_mutex_lock(&W->lock);
+    W->count++;
+    W->fill = (W->fill + 1) % OUTPUT_BLOCKS;
+    pthread_cond_signal(&W->ready);
+    while (W->count == OUTPUT_BLOCKS)
+      pthread_cond_wait(&W->space, &W->lock);
+    pthread_mutex_unlock(&W->lock);
+    return;
+  }
+#endif /* HAVE_THREADS */
+  writeOutputBlock(W, W->block + W->fill);
+}
+
+/* Returns the block to fill with a record of the given number of words. */
+static OutputBlock outputBlockFor(OutputWriter W, int words) {
+  OutputBlock B = W->block + W->fill;
+  if (B->used && B->used + words > B->size) {
+    queueOutputBlock(W);
+    B = W->block + W->fill;
+  }
+  if (words > B->size) {
+    B->size = imax(words, OUTPUT_BLOCK_WORDS);
+    FREE(B->word);
+    B->word = (OutputWord *) safeMalloc(B->size * sizeof(OutputWord),
+					"outputBlockFor");
+  }
+  return B;
+}
+
+static void writeColumnHeader(OutputWriter W, long long index) {
+  struct columnHeader H;
+  memset(&H, 0, sizeof H);
+  H.cookie      = htonl(OUTPUT_COLUMNS_COOKIE);
+  H.byteOrder   = MAP_BYTE_ORDER;
+  H.version     = COLUMN_VERSION;
+  H.realSize    = sizeof(real);
+  H.numGroups   = W->numGroups;
+  H.compressed  = W->compress;
+  H.numChunks   = W->numChunks;
+  H.numExamples = W->numExamples;
+  H.index       = index;
+  writeOutputBytes(W, &H, sizeof H);
+}
+
+/* The groups written are fixed when the file is started. */
+static void startColumnFile(OutputWriter W, Network N) {
+  struct columnGroup C;
+  Group G;
+  int g, n;
+
+  for (g = 0; g < N->numGroups; g++)
+    if (N->group[g]->type & WRITE_OUTPUTS) W->numGroups++;
+  W->groupUnits = intArray(W->numGroups, "startColumnFile:W->groupUnits");
+  W->groupTargets = (flag *) safeMalloc(W->numGroups * sizeof(flag),
+					"startColumnFile:W->groupTargets");
+  W->tickWords = 2;
+  for (g = n = 0; g < N->numGroups; g++) {
+    G = N->group[g];
+    if (!(G->type & WRITE_OUTPUTS)) continue;
+    W->groupUnits[n] = G->numUnits;
+    W->groupTargets[n] = (G->type & OUTPUT) ? TRUE : FALSE;
+    W->tickWords += 2 + ((W->groupTargets[n]) ? 2 : 1) * G->numUnits;
+    n++;
+  }
+  W->numColumns = 2 + 2 * W->numGroups;
+  W->columnStart = (char **) safeMalloc(W->numColumns * sizeof(char *),
+					"startColumnFile:W->columnStart");
+  W->columnSize = (ColumnSize) safeMalloc(W->numColumns *
+					  sizeof(struct columnSize),
+					  "startColumnFile:W->columnSize");
+  W->columnObj = (Tcl_Obj **) safeMalloc(W->numColumns * sizeof(Tcl_Obj *),
+					 "startColumnFile:W->columnObj");
+
+  Tcl_SetChannelOption(NULL, W->channel, "-translation", "binary");
+  writeColumnHeader(W, 0);
+  for (g = n = 0; g < N->numGroups; g++) {
+    G = N->group[g];
+    if (!(G->type & WRITE_OUTPUTS)) continue;
+    C.numUnits   = W->groupUnits[n];
+    C.targets    = W->groupTargets[n++];
+    C.nameLength = strlen(G->name);
+    C.pad        = 0;
+    writeOutputBytes(W, &C, sizeof C);
+    writeOutputBytes(W, G->name, C.nameLength + 1);
+  }
+}
+
+/* This adds the chunk table and puts its offset in the header. */
+static void finishColumnFile(OutputWriter W) {
+  long long index = W->offset;
+  writeOutputBytes(W, W->index, W->numChunks * sizeof(struct columnChunk));
+  if (!W->failed && Tcl_Seek(W->channel, 0, SEEK_SET) < 0)
+    W->failed = TRUE;
+  writeColumnHeader(W, index);
+}
+
+static flag sameColumnGroups(OutputWriter W) {
+  int n = 0;
+  FOR_EACH_GROUP({
+    if (G->type & WRITE_OUTPUTS) {
+      if (n == W->numGroups || W->groupUnits[n] != G->numUnits ||
+	  W->groupTargets[n] != ((G->type & OUTPUT) ? TRUE : FALSE))
+	return FALSE;
+      n++;
+    }
+  });
+  return (n == W->numGroups);
+}
+
+static void closeOutputFilesOnExit(ClientData data) {
+  closeAllNetOutputFiles();
+}
+
+/* Standard output and Tcl channels are written by the caller and flushed
+   after every example, as other output may be going to them. */
+static OutputWriter newOutputWriter(Network N) {
+  static flag exitHandler = FALSE;
+  OutputWriter W = (OutputWriter) safeCalloc(1, sizeof *W,
+					     "newOutputWriter:W");
+  W->channel = N->outputFile;
+  W->binary  = N->binaryOutputFile;
+  W->shared  = (N->outputFileName[0] == '-');
+  W->columnar = N->columnarOutputFile;
+  W->compress = N->compressedOutputFile;
+  W->chunk   = (char *) safeMalloc(OUTPUT_CHUNK, "newOutputWriter:W->chunk");
+  if (!exitHandler) {
+    Tcl_CreateExitHandler(closeOutputFilesOnExit, NULL);
+    exitHandler = TRUE;
+  }
+  N->outputWriter = W;
+  if (W->shared) return W;
+  Tcl_SetChannelBufferSize(W->channel, OUTPUT_CHUNK);
+  if (W->columnar) startColumnFile(W, N);
+#ifdef HAVE_THREADS
+  pthread_mutex_init(&W->lock, NULL);
+  pthread_cond_init(&W->ready, NULL);
+  pthread_cond_init(&W->space, NULL);
+  /* The channel belongs to the writer until it is stopped */
+  Tcl_CutChannel(W->channel);
+  if (pthread_create(&W->thread, NULL, outputWriterThread, W))
+    Tcl_SpliceChannel(W->channel);
+  else W->running = TRUE;
+#endif /* HAVE_THREADS */
+  return W;
+}
+
+/* This writes whatever is left and frees the writer.  It returns TCL_ERROR
+   if anything couldn't be written. */
+static flag freeOutputWriter(Network N) {
+  OutputWriter W = N->outputWriter;
+  flag failed;
+  int b;
+  if (!W) return TCL_OK;
+  if (W->block[W->fill].used) {
+    W->block[W->fill].flush = TRUE;
+    queueOutputBlock(W);
+  }
+#ifdef HAVE_THREADS
+  if (W->running) {
+    pthread_mutex_lock(&W->lock);
+    W->stop = TRUE;
+    pthread_cond_signal(&W->ready);
+    pthread_mutex_unlock(&W->lock);
+    pthread_join(W->thread, NULL);
+    Tcl_SpliceChannel(W->channel);
+  }
+  if (!W->shared) {
+    pthread_mutex_destroy(&W->lock);
+    pthread_cond_destroy(&W->ready);
+    pthread_cond_destroy(&W->space);
+  }
+#endif /* HAVE_THREADS */
+  if (W->columnar) finishColumnFile(W);
+  failed = W->failed;
+  for (b = 0; b < OUTPUT_BLOCKS; b++)
+    FREE(W->block[b].word);
+  FREE(W->chunk);
+  FREE(W->groupUnits);
+  FREE(W->groupTargets);
+  FREE(W->columnStart);
+  FREE(W->columnSize);
+  FREE(W->columnObj);
+  FREE(W->column);
+  FREE(W->index);
+  FREE(N->outputWriter);
+  return (failed) ? TCL_ERROR : TCL_OK;
+}
+
 /* This closes the previous one, unless you choose append and the filename is
-   the same, in which case nothing happens. */
-flag openNetOutputFile(Tcl_Obj *fileNameObj, flag binary, flag append) {
+   the same, in which case nothing happens.  Columnar files must be seekable
+   and are compressed by chunk, so they can't be pipes or appended to. */
+flag openNetOutputFile(Tcl_Obj *fileNameObj, flag binary, flag append,
+		       flag columnar, flag compress) {
   Tcl_Channel channel;
   const char *fileName = Tcl_GetStringFromObj(fileNameObj, NULL);
+  if (compress) columnar = TRUE;
+  if (columnar && append)
+    return error("openNetOutputFile: columnar files can't be appended to");
+  if (columnar && (fileName[0] == '-' || fileName[0] == '|' ||
+		   stringEndsIn(fileName, ".gz") ||
+		   stringEndsIn(fileName, ".Z") ||
+		   stringEndsIn(fileName, ".bz") ||
+		   stringEndsIn(fileName, ".bz2")))
+    return error("openNetOutputFile: columnar files must be plain files, "
+		 "use -compress to compress them");
   if (Net->outputFile) {
     if (append && !strcmp(fileName, Net->outputFileName))
       return TCL_OK;
@@ -1676,17 +3387,42 @@ flag openNetOutputFile(Tcl_Obj *fileNameObj, flag binary, flag append) {
     return error("openNetOutputFile: couldn't open the file \"%s\"",
 		 fileName);
   Net->binaryOutputFile = (binary) ? TRUE : FALSE;
+  Net->columnarOutputFile = (columnar) ? TRUE : FALSE;
+  Net->compressedOutputFile = (compress) ? TRUE : FALSE;
   Net->outputFileName = copyString(fileName);
   return TCL_OK;
 }
 
+/* This finishes writing the records and closes the channel. */
+flag closeOutputFile(Network N) {
+  flag failed;
+  if (!N->outputWriter && N->columnarOutputFile) newOutputWriter(N);
+  failed = freeOutputWriter(N);
+  closeChannel(N->outputFile);
+  N->outputFile = NULL;
+  return failed;
+}
+
 flag closeNetOutputFile(void) {
+  flag failed;
   if (!Net->outputFile)
     return error("netCloseOutputFile: no file open");
-  closeChannel(Net->outputFile);
-  Net->outputFile = NULL;
+  failed = closeOutputFile(Net);
+  if (failed)
+    error("closeNetOutputFile: error writing the file \"%s\"",
+	  Net->outputFileName);
   FREE(Net->outputFileName);
-  return TCL_OK;
+  return failed;
+}
+
+/* Called on exit so buffered records aren't lost. */
+void closeAllNetOutputFiles(void) {
+  int n;
+  for (n = 0; n < Root->numNetworks; n++)
+    if (Root->net[n]->outputFile) {
+      closeOutputFile(Root->net[n]);
+      FREE(Root->net[n]->outputFileName);
+    }
 }
 
 void groupWriteBinaryValues(Group G, int tick, Tcl_Channel channel) {
@@ -1694,9 +3430,9 @@ void groupWriteBinaryValues(Group G, int tick, Tcl_Channel channel) {
   writeBinInt(channel, G->numUnits);
   writeBinFlag(channel, (G->type & OUTPUT) ? 1 : 0);
   FOR_EVERY_UNIT(G, {
-    writeBinReal(channel, GET_HISTORY(U, outputHistory, index));
+    writeBinReal(channel, GET_UNIT_HISTORY(U, outputHistory, index));
     if (G->type & OUTPUT)
-      writeBinReal(channel, GET_HISTORY(U, targetHistory, index));
+      writeBinReal(channel, GET_UNIT_HISTORY(U, targetHistory, index));
   });
 }
 
@@ -1704,43 +3440,310 @@ void groupWriteTextValues(Group G, int tick, Tcl_Channel channel) {
   int index = HISTORY_INDEX(tick);
   cprintf(channel, "%d %d\n", G->numUnits, (G->type & OUTPUT) ? 1 : 0);
   FOR_EVERY_UNIT(G, {
-    writeReal(channel, GET_HISTORY(U, outputHistory, index), "", "");
+    writeReal(channel, GET_UNIT_HISTORY(U, outputHistory, index), "", "");
     if (G->type & OUTPUT)
-      writeReal(channel, GET_HISTORY(U, targetHistory, index), " ","");
+      writeReal(channel, GET_UNIT_HISTORY(U, targetHistory, index), " ","");
     cprintf(channel, "\n");
   });
 }
 
+static OutputWord *copyHistoryRow(OutputWord *w, Group G, real *history,
+				  int index) {
+  real *row = (history) ? history + index * G->numUnits : NULL;
+  int u;
+  for (u = 0; u < G->numUnits; u++)
+    w[u].r = (row) ? row[u] : NaN;
+  return w + G->numUnits;
+}
+
 flag standardWriteExample(Example E) {
-  int tick, groups = 0;
-  Tcl_Channel channel = Net->outputFile;
+  OutputWriter W = Net->outputWriter;
+  OutputBlock B;
+  OutputWord *w;
+  int tick, index, groups = 0, tickWords = 2, words;
 
-  if (!channel)
+  if (!Net->outputFile)
     return error("writeExample: no output file open");
-  FOR_EACH_GROUP(if (G->type & WRITE_OUTPUTS) groups++);
-  if (Net->binaryOutputFile) {
-    writeBinInt(channel, Net->totalUpdates);
-    writeBinInt(channel, E->num);
-    writeBinInt(channel, Net->ticksOnExample);
-    writeBinInt(channel, groups);
-    for (tick = 0; tick < Net->ticksOnExample; tick++) {
-      writeBinInt(channel, tick);
-      writeBinInt(channel, Net->eventHistory[tick]);
-      FOR_EACH_GROUP({
-	if (G->type & WRITE_OUTPUTS) groupWriteBinaryValues(G, tick, channel);
-      });
+  if (!W) W = newOutputWriter(Net);
+  if (W->columnar && !sameColumnGroups(W))
+    return error("writeExample: the WRITE_OUTPUTS groups have changed since "
+		 "the columnar file \"%s\" was started", Net->outputFileName);
+  FOR_EACH_GROUP({
+    if (G->type & WRITE_OUTPUTS) {
+      groups++;
+      tickWords += 2 + ((G->type & OUTPUT) ? 2 : 1) * G->numUnits;
     }
-  } else {
-    cprintf(channel, "%d %d\n", Net->totalUpdates, E->num);
-    cprintf(channel, "%d %d\n", Net->ticksOnExample, groups);
-    for (tick = 0; tick < Net->ticksOnExample; tick++) {
-      cprintf(channel, "%d %d\n", tick, Net->eventHistory[tick]);
-      FOR_EACH_GROUP({
-	if (G->type & WRITE_OUTPUTS) groupWriteTextValues(G, tick, channel);
-      });
+  });
+  words = 4 + Net->ticksOnExample * tickWords;
+  B = outputBlockFor(W, words);
+
+  w = B->word + B->used;
+  w[0].i = Net->totalUpdates;
+  w[1].i = E->num;
+  w[2].i = Net->ticksOnExample;
+  w[3].i = groups;
+  w += 4;
+  for (tick = 0; tick < Net->ticksOnExample; tick++) {
+    index = HISTORY_INDEX(tick);
+    w[0].i = tick;
+    w[1].i = Net->eventHistory[tick];
+    w += 2;
+    FOR_EACH_GROUP({
+      if (G->type & WRITE_OUTPUTS) {
+	w[0].i = G->numUnits;
+	w[1].i = (G->type & OUTPUT) ? 1 : 0;
+	w = copyHistoryRow(w + 2, G, G->outputHistory, index);
+	if (G->type & OUTPUT)
+	  w = copyHistoryRow(w, G, G->targetHistory, index);
+      }
+    });
+  }
+  B->used += words;
+
+  if (W->shared || (Net->outputFlushInterval > 0 &&
+		    ++W->examples >= Net->outputFlushInterval)) {
+    B->flush = TRUE;
+    W->examples = 0;
+    queueOutputBlock(W);
+  } else if (B->used >= OUTPUT_BLOCK_WORDS) queueOutputBlock(W);
+  return TCL_OK;
+}
+
+/* Returns the data of a column, inflating it if it was compressed, or NULL if
+   it doesn't fit in the file or doesn't inflate to its raw size.  An inflated
+   column is held in *obj until the caller releases it. */
+static char *readColumn(char *data, long long size, long long offset,
+			ColumnSize Z, Tcl_Obj **obj) {
+  Tcl_Obj *packed;
+  int bytes;
+  char *raw;
+  *obj = NULL;
+  if (Z->stored < 0 || Z->raw < Z->stored || offset + Z->stored > size)
+    return NULL;
+  if (Z->stored == Z->raw) return data + offset;
+  packed = Tcl_NewByteArrayObj((unsigned char *) data + offset, Z->stored);
+  Tcl_IncrRefCount(packed);
+  if (Tcl_ZlibInflate(Interp, TCL_ZLIB_FORMAT_ZLIB, packed, Z->raw, NULL)
+      == TCL_OK) {
+    *obj = Tcl_GetObjResult(Interp);
+    Tcl_IncrRefCount(*obj);
+  }
+  Tcl_DecrRefCount(packed);
+  Tcl_ResetResult(Interp);
+  if (!*obj) return NULL;
+  raw = (char *) Tcl_GetByteArrayFromObj(*obj, &bytes);
+  if (bytes != Z->raw) return NULL;
+  return raw;
+}
+
+static Tcl_Obj *columnValues(real *v, int n) {
+  Tcl_Obj *list = Tcl_NewListObj(0, NULL);
+  char s[OUTPUT_MAX_ENTRY];
+  int u;
+  for (u = 0; u < n; u++) {
+    encodeTextReal(s, v[u]);
+    Tcl_ListObjAppendElement(Interp, list, Tcl_NewStringObj(s, -1));
+  }
+  return list;
+}
+
+/* This appends the examples from first to last in the chunk to the list. */
+static char *readColumnChunk(char *data, long long size, ColumnChunk X,
+			     int numGroups, int *units, flag *targets,
+			     int group, int first, int last, Tcl_Obj *list) {
+  ChunkHeader C;
+  ColumnSize Z;
+  Tcl_Obj **obj, *example, *ticks, *tick, *values;
+  char **column, *problem = NULL;
+  long long offset;
+  int *ex, *tk, c, e, g, t, row, n, raw;
+
+  if (X->offset < 0 || X->offset & 7 ||
+      X->offset + (long long) sizeof(struct chunkHeader) > size)
+    return "bad chunk offset";
+  C = (ChunkHeader) (data + X->offset);
+  if (C->numExamples != X->numExamples || C->numRows < 0 ||
+      C->numColumns != 2 + 2 * numGroups ||
+      X->offset + (long long) sizeof(struct chunkHeader) +
+      (long long) C->numColumns * sizeof(struct columnSize) > size)
+    return "bad chunk header";
+  Z = (ColumnSize) (C + 1);
+  column = (char **) safeCalloc(C->numColumns, sizeof(char *),
+				"readColumnChunk:column");
+  obj = (Tcl_Obj **) safeCalloc(C->numColumns, sizeof(Tcl_Obj *),
+				"readColumnChunk:obj");
+
+  /* Only the columns that are needed are read */
+  offset = X->offset + sizeof(struct chunkHeader) +
+    C->numColumns * sizeof(struct columnSize);
+  for (c = 0; c < C->numColumns && !problem; c++) {
+    g = c / 2 - 1;
+    if (c == 0)      raw = C->numExamples * 4 * sizeof(int);
+    else if (c == 1) raw = C->numRows * 2 * sizeof(int);
+    else if (c % 2 && !targets[g]) raw = 0;
+    else raw = C->numRows * units[g] * sizeof(real);
+    if (Z[c].raw != raw || Z[c].stored < 0)
+      problem = "bad column size";
+    else if ((c < 2 || group < 0 || g == group) &&
+	     !(column[c] = readColumn(data, size, offset, Z + c, obj + c)))
+      problem = "bad column";
+    offset += MAP_ALIGN(Z[c].stored);
+  }
+
+  ex = (int *) column[0];
+  tk = (int *) column[1];
+  for (e = imax(first - X->firstExample, 0);
+       !problem && e < C->numExamples && X->firstExample + e <= last; e++) {
+    row = ex[4 * e + 3];
+    n = ex[4 * e + 2];
+    if (row < 0 || n < 0 || (long long) row + n > C->numRows) {
+      problem = "bad example rows";
+      break;
+    }
+    example = Tcl_NewListObj(0, NULL);
+    Tcl_ListObjAppendElement(Interp, example, Tcl_NewIntObj(ex[4 * e]));
+    Tcl_ListObjAppendElement(Interp, example, Tcl_NewIntObj(ex[4 * e + 1]));
+    ticks = Tcl_NewListObj(0, NULL);
+    for (t = row; t < row + n; t++) {
+      tick = Tcl_NewListObj(0, NULL);
+      Tcl_ListObjAppendElement(Interp, tick, Tcl_NewIntObj(tk[2 * t]));
+      Tcl_ListObjAppendElement(Interp, tick, Tcl_NewIntObj(tk[2 * t + 1]));
+      for (g = 0; g < numGroups; g++) {
+	if (group >= 0 && g != group) continue;
+	c = 2 + 2 * g;
+	values = Tcl_NewListObj(0, NULL);
+	Tcl_ListObjAppendElement(Interp, values, columnValues
+				 ((real *) column[c] + t * units[g], units[g]));
+	if (targets[g])
+	  Tcl_ListObjAppendElement(Interp, values, columnValues
+				   ((real *) column[c + 1] + t * units[g],
+				    units[g]));
+	Tcl_ListObjAppendElement(Interp, tick, values);
+      }
+      Tcl_ListObjAppendElement(Interp, ticks, tick);
+    }
+    Tcl_ListObjAppendElement(Interp, example, ticks);
+    Tcl_ListObjAppendElement(Interp, list, example);
+  }
+
+  for (c = 0; c < C->numColumns; c++)
+    if (obj[c]) Tcl_DecrRefCount(obj[c]);
+  FREE(obj);
+  FREE(column);
+  return problem;
+}
+
+/* This maps a columnar output file and returns the records from first to
+   last, with just the one group if a name is given, reading only the chunks
+   and columns that hold them.  Info instead returns the number of records
+   and the groups. */
+flag readNetOutput(Tcl_Obj *fileNameObj, char *groupName, int first,
+		   int last, flag info) {
+  const char *fileName = Tcl_GetString(fileNameObj);
+  ColumnHeader H;
+  ColumnGroup C;
+  ColumnChunk X;
+  Tcl_Obj *list = NULL, *groupInfo;
+  char *data, *problem = NULL, **name = NULL;
+  long long size, offset;
+  size_t mapSize;
+  int *units = NULL, g, group = -1, lo, hi, mid;
+  flag *targets = NULL;
+
+  if (!(data = mapFile(fileNameObj, &mapSize)))
+    return error("readNetOutput: couldn't map the file \"%s\"", fileName);
+  size = (long long) mapSize;
+  H = (ColumnHeader) data;
+  if (size < (long long) sizeof(struct columnHeader) ||
+      ntohl(H->cookie) != OUTPUT_COLUMNS_COOKIE)
+    problem = "missing cookie";
+  else if (H->byteOrder != MAP_BYTE_ORDER)
+    problem = "file was written on a machine with a different byte order";
+  else if (H->version != COLUMN_VERSION)
+    problem = "unknown version";
+  else if (H->realSize != sizeof(real))
+    problem = "sizeof(real) doesn't match";
+  else if (H->index == 0)
+    problem = "file was never closed";
+  else if (H->numGroups < 0 || H->numChunks < 0 || H->numExamples < 0 ||
+	   H->index & 7 || H->index < (long long) sizeof(struct columnHeader) ||
+	   H->index + (long long) H->numChunks * sizeof(struct columnChunk)
+	   > size)
+    problem = "bad chunk table";
+  if (problem) goto done;
+
+  units = intArray(H->numGroups + 1, "readNetOutput:units");
+  targets = (flag *) safeMalloc((H->numGroups + 1) * sizeof(flag),
+				"readNetOutput:targets");
+  name = (char **) safeMalloc((H->numGroups + 1) * sizeof(char *),
+			      "readNetOutput:name");
+  offset = sizeof(struct columnHeader);
+  for (g = 0; g < H->numGroups; g++) {
+    C = (ColumnGroup) (data + offset);
+    if (offset + (long long) sizeof(struct columnGroup) > H->index ||
+	C->numUnits < 0 || C->nameLength < 0 ||
+	(offset += sizeof(struct columnGroup) +
+	 MAP_ALIGN((long long) C->nameLength + 1)) > H->index ||
+	((char *) (C + 1))[C->nameLength]) {
+      problem = "bad group table";
+      goto done;
     }
+    units[g] = C->numUnits;
+    targets[g] = (C->targets) ? TRUE : FALSE;
+    name[g] = (char *) (C + 1);
+    if (groupName && !strcmp(groupName, name[g])) group = g;
+  }
+  if (groupName && group < 0) {
+    FREE(units);
+    FREE(targets);
+    FREE(name);
+    unmapFile(data, mapSize);
+    return error("readNetOutput: the file \"%s\" has no group \"%s\"",
+		 fileName, groupName);
   }
-  Tcl_Flush(channel);
+
+  list = Tcl_NewListObj(0, NULL);
+  if (info) {
+    Tcl_ListObjAppendElement(Interp, list, Tcl_NewIntObj(H->numExamples));
+    for (g = 0; g < H->numGroups; g++) {
+      groupInfo = Tcl_NewListObj(0, NULL);
+      Tcl_ListObjAppendElement(Interp, groupInfo,
+			       Tcl_NewStringObj(name[g], -1));
+      Tcl_ListObjAppendElement(Interp, groupInfo, Tcl_NewIntObj(units[g]));
+      Tcl_ListObjAppendElement(Interp, groupInfo, Tcl_NewIntObj(targets[g]));
+      Tcl_ListObjAppendElement(Interp, list, groupInfo);
+    }
+    goto done;
+  }
+
+  if (last < 0 || last >= H->numExamples) last = H->numExamples - 1;
+  if (first < 0) first = 0;
+  X = (ColumnChunk) (data + H->index);
+  for (lo = 0, hi = H->numChunks; lo + 1 < hi;) {
+    mid = (lo + hi) / 2;
+    if (X[mid].firstExample <= first) lo = mid;
+    else hi = mid;
+  }
+  for (; lo < H->numChunks && !problem && X[lo].firstExample <= last; lo++) {
+    if (X[lo].numExamples < 0 || (lo && X[lo].firstExample !=
+				  X[lo - 1].firstExample +
+				  X[lo - 1].numExamples))
+      problem = "bad chunk table";
+    else if (X[lo].firstExample + X[lo].numExamples > first)
+      problem = readColumnChunk(data, size, X + lo, H->numGroups, units,
+				targets, group, first, last, list);
+  }
+
+ done:
+  FREE(units);
+  FREE(targets);
+  FREE(name);
+  unmapFile(data, mapSize);
+  if (problem) {
+    if (list) Tcl_DecrRefCount(list);
+    return error("readNetOutput: %s in the file \"%s\"", problem, fileName);
+  }
+  Tcl_SetObjResult(Interp, list);
   return TCL_OK;
 }
 
@@ -1812,6 +3815,7 @@ Example copyExample(Example E) {
   C->event = copyEvents(C);
   C->next = NULL;
   C->ext = NULL;
+  C->map = NULL;
   initExampleExtension(C);
   return C;
 }
@@ -1988,10 +3992,10 @@ flag loadDenseRange(Range L, Unit *netUnit, int numNetUnits, mask type) {
 		     "dense range");
     if (type == INPUT)
       for (i = 0; i < L->numUnits; i++, u++)
-	G->unit[u].externalInput = L->val[i];
+	G->externalInput[u] = L->val[i];
     else
       for (i = 0; i < L->numUnits; i++, u++)
-	G->unit[u].target = L->val[i];
+	G->target[u] = L->val[i];
   } else {            /* The range applies to the whole net */
     if ((u = L->firstUnit) < 0 || u >= numNetUnits)
       return error("loadEvent: unit %d out of range", u);
@@ -2000,10 +4004,10 @@ flag loadDenseRange(Range L, Unit *netUnit, int numNetUnits, mask type) {
 		     "dense range");
     if (type == INPUT)
       for (i = 0; i < L->numUnits; i++, u++)
-	netUnit[u]->externalInput = L->val[i];
+	UNIT_VAL(netUnit[u], externalInput) = L->val[i];
     else
       for (i = 0; i < L->numUnits; i++, u++)
-	netUnit[u]->target = L->val[i];
+	UNIT_VAL(netUnit[u], target) = L->val[i];
   }
   return TCL_OK;
 }
@@ -2022,7 +4026,7 @@ flag loadSparseRange(Range L, Unit *netUnit, int numNetUnits, int offset) {
   if (G) {            /* The range applies to a group */
     if (L->unit[0] < 0) /* This is a * so all units are set */
       for (u = 0; u < G->numUnits; u++)
-	*((real *) Obj((char *) (G->unit + u), offset)) = L->value;
+	GROUP_FIELD(G, offset)[u] = L->value;
     else for (i = 0; i < L->numUnits; i++) {
       if (i + 1 < L->numUnits && L->unit[i + 1] < 0) { /* This is a span */
 	if ((u = L->unit[i]) < 0 || u >= G->numUnits)
@@ -2032,18 +4036,18 @@ flag loadSparseRange(Range L, Unit *netUnit, int numNetUnits, int offset) {
 	  return error("loadEvent: span end unit %d out of "
 			 "range in group %s", v, G->name);
 	for (; u <= v; u++)
-	  *((real *) Obj((char *) (G->unit + u), offset)) = L->value;
+	  GROUP_FIELD(G, offset)[u] = L->value;
       } else { /* Just a single unit */
 	if ((u = L->unit[i]) < 0 || u >= G->numUnits)
 	  return error("loadEvent: unit %d out of range "
 			 "in group %s", u, G->name);
-	*((real *) Obj((char *) (G->unit + u), offset)) = L->value;
+	GROUP_FIELD(G, offset)[u] = L->value;
       }
     }
   } else {            /* The range applies to the whole net */
     if (L->unit[0] < 0) /* This is a * so all units are set */
       for (u = 0; u < numNetUnits; u++)
-	*((real *) Obj((char *) (netUnit[u]), offset)) = L->value;
+	UNIT_FIELD(netUnit[u], offset) = L->value;
     else for (i = 0; i < L->numUnits; i++) {
       if (i + 1 < L->numUnits && L->unit[i + 1] < 0) { /* This is a span */
 	if ((u = L->unit[i]) < 0 || u >= numNetUnits)
@@ -2051,11 +4055,11 @@ flag loadSparseRange(Range L, Unit *netUnit, int numNetUnits, int offset) {
 	if ((v = -L->unit[++i]) < u || v >= numNetUnits)
 	  return error("loadEvent: span end unit %d out of range",v);
 	for (; u <= v; u++)
-	  *((real *) Obj((char *) (netUnit[u]), offset)) = L->value;
+	  UNIT_FIELD(netUnit[u], offset) = L->value;
       } else { /* Just a single unit */
 	if ((u = L->unit[i]) < 0 || u >= numNetUnits)
 	  return error("loadEvent: unit %d out of range", u);
-	*((real *) Obj((char *) (netUnit[u]), offset)) = L->value;
+	UNIT_FIELD(netUnit[u], offset) = L->value;
       }
     }
   }
@@ -2065,10 +4069,11 @@ flag loadSparseRange(Range L, Unit *netUnit, int numNetUnits, int offset) {
 void injectExternalInputNoise(void) {
   FOR_EACH_GROUP({
     if (G->type & EXT_INPUT_NOISE) {
-      FOR_EACH_UNIT(G, {
+      real *X = G->externalInput;
+      FOR_EACH_UNIT2(G, {
 	real range = chooseValue(G->noiseRange, Net->noiseRange);
-	if (!isNaN(U->externalInput))
-	  U->externalInput = G->noiseProc(U->externalInput, range);
+	if (!isNaN(X[u]))
+	  X[u] = G->noiseProc(X[u], range);
       });
     }
   });
@@ -2083,10 +4088,11 @@ void injectExternalInputNoise(void) {
 flag standardLoadEvent(Event V) {
   int u;
   Range L;
+  Group G;
 
   /* First set all units' external inputs to the event's default input */
   for (u = 0; u < Net->numInputs; u++)
-    Net->input[u]->externalInput = V->defaultInput;
+    UNIT_VAL(Net->input[u], externalInput) = V->defaultInput;
   /* Now process each of the input ranges */
   for (L = V->input; L; L = L->next) {
     if (L->val) {         /* This is a dense range */
@@ -2094,7 +4100,7 @@ flag standardLoadEvent(Event V) {
 	return TCL_ERROR;
     } else if (L->unit) { /* This is a sparse range */
       if (loadSparseRange(L, Net->input, Net->numInputs,
-			  OFFSET(Net->input[0], externalInput)))
+			  OFFSET(G, externalInput)))
 	return TCL_ERROR;
     }
   }
@@ -2102,7 +4108,7 @@ flag standardLoadEvent(Event V) {
 
   /* First set all units' targets to the event's default target */
   for (u = 0; u < Net->numOutputs; u++)
-    Net->output[u]->target = V->defaultTarget;
+    UNIT_VAL(Net->output[u], target) = V->defaultTarget;
   /* Now process each of the target ranges */
   for (L = V->target; L; L = L->next) {
     if (L->val) {         /* This is a dense range */
@@ -2110,7 +4116,7 @@ flag standardLoadEvent(Event V) {
 	return TCL_ERROR;
     } else if (L->unit) { /* This is a sparse range */
       if (loadSparseRange(L, Net->output, Net->numOutputs,
-			  OFFSET(Net->output[0], target)))
+			  OFFSET(G, target)))
 	return TCL_ERROR;
     }
   }
@@ -5,6 +5,8 @@ typedef struct exampleSet *ExampleSet;
 typedef struct example    *Example;
 typedef struct event      *Event;
 typedef struct range      *Range;
+typedef struct exampleMap *ExampleMap;
+typedef struct pipeQueue  *PipeQueue;
 
 #include "network.h"
 #include "extension.h"
@@ -30,6 +32,8 @@ struct exampleSet {
   ParseRec   pipeParser;
   flag       pipeLoop;
   int        pipeExampleNum;
+  int        pipePrefetch;
+  PipeQueue  pipeQueue;     /* hidden */
 
   Tcl_Obj   *proc;
   Tcl_Obj   *chooseExample;
@@ -62,6 +66,7 @@ struct example {
   real       frequency;
   real       probability;
   Tcl_Obj   *proc;
+  ExampleMap map;               /* Non-null if the ranges live in a mapped file */
 };
 
 
@@ -125,11 +130,17 @@ extern flag loadExamples(char *setName, Tcl_Obj *fileNameObj,
 			 int mode, int numExamples);
 extern flag writeExampleFile(ExampleSet S, Tcl_Obj *fileNameObj, flag append);
 extern flag writeBinaryExampleFile(ExampleSet S, Tcl_Obj *fileNameObj);
-extern flag openNetOutputFile(Tcl_Obj *fileNameObj, flag binary, flag append);
+extern flag writeMappedExampleFile(ExampleSet S, Tcl_Obj *fileNameObj);
+extern flag openNetOutputFile(Tcl_Obj *fileNameObj, flag binary, flag append,
+			      flag columnar, flag compress);
+extern flag closeOutputFile(Network N);
 extern flag closeNetOutputFile(void);
+extern void closeAllNetOutputFiles(void);
 extern void groupWriteBinaryValues(Group G, int tick, Tcl_Channel channel);
 extern void groupWriteTextValues(Group G, int tick, Tcl_Channel channel);
 extern flag standardWriteExample(Example E);
+extern flag readNetOutput(Tcl_Obj *fileNameObj, char *groupName, int first,
+			  int last, flag info);
 extern flag deleteExampleSet(ExampleSet S);
 extern flag deleteAllExampleSets(void);
 extern flag moveExamples(ExampleSet from, char *toName, int first, int num,
@@ -217,10 +217,10 @@ int C_moveExamples(TCL_CMDARGS) {
 int C_saveExamples(TCL_CMDARGS) {
   int arg;
   ExampleSet S;
-  flag code, binary = FALSE, append = FALSE;
+  flag code, binary = FALSE, mapped = FALSE, append = FALSE;
   Tcl_Obj *fileNameObj;
   const char *fileName;
-  const char *usage = "saveExamples <example-set> <file-name> [-binary | -append]";
+  const char *usage = "saveExamples <example-set> <file-name> [-binary | -mapped |\n\t-append]";
   const char *commandName = Tcl_GetStringFromObj(objv[0], NULL);
   if (objc == 2 && !strcmp(Tcl_GetStringFromObj(objv[1], NULL), "-h"))
     return commandHelp(commandName);
@@ -233,6 +233,7 @@ int C_saveExamples(TCL_CMDARGS) {
   for (arg = 3; arg < objc && Tcl_GetStringFromObj(objv[arg], NULL)[0] == '-'; arg++) {
     switch (Tcl_GetStringFromObj(objv[arg], NULL)[1]) {
     case 'b': binary = TRUE; break;
+    case 'm': mapped = TRUE; break;
     case 'a': append = TRUE; break;
     default: return usageError(commandName, usage);
     }
@@ -241,12 +242,16 @@ int C_saveExamples(TCL_CMDARGS) {
 
   if (binary && append)
     return warning("saveExamples: you cannot use both the -binary and -append flags");
+  if (mapped && (binary || append))
+    return warning("saveExamples: the -mapped flag can't be used with -binary or -append");
 
   startTask(SAVING_EXAMPLES);
   fileNameObj = objv[2];
   fileName = Tcl_GetStringFromObj(objv[2], NULL);
   if (binary)
     code = writeBinaryExampleFile(S, fileNameObj);
+  else if (mapped)
+    code = writeMappedExampleFile(S, fileNameObj);
   else
     code = writeExampleFile(S, fileNameObj, append);
   stopTask(SAVING_EXAMPLES);
@@ -0,0 +1,659 @@
+#include <string.h>
+#include "system.h"
+#include "util.h"
+#include "type.h"
+#include "network.h"
+#include "act.h"
+#include "kernel.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+  !defined(DOUBLE_REAL)
+#define X86_KERNELS
+#include <immintrin.h>
+#endif
+
+real (*dotLinks)(real sum, real *W, real *O, int n);
+void (*dotLinksBack)(real inputDeriv, real *W, real *WD, real *O, real *D,
+		     int n);
+void (*dotLinksBackSenders)(real inputDeriv, real *W, real *D, int n);
+void (*contrastLinksBack)(real output, real deriv, real *WD, real *O, real *D,
+			  int n);
+real (*distanceLinks)(real sum, real *W, real *O, int n);
+void (*distanceLinksBack)(real inputDeriv, real *W, real *WD, real *O,
+			  real *D, int n);
+int  (*minMaxValues)(real *x, int n, real *min, real *max);
+void (*sigmoidValues)(real *y, real *x, real gain, int n);
+void (*tanhValues)(real *y, real *x, real gain, int n);
+void (*expValues)(real *y, real *x, double shift, int n);
+real (*crossEntropySum)(real *Y, real *T, int n);
+real (*divergenceSum)(real *Y, real *T, int n);
+char *KernelName;
+flag ExactMath = FALSE;
+
+
+/********************************* Scalar ************************************/
+
+/* This sums in the same order as the old unrolled loop in dotProductInput. */
+static real scalarDotLinks(real sum, real *W, real *O, int n) {
+  real *sW = W + n;
+  for (; W + 10 < sW; O += 10, W += 10)
+    sum += O[0] * W[0] + O[1] * W[1] +
+      O[2] * W[2] + O[3] * W[3] +
+      O[4] * W[4] + O[5] * W[5] +
+      O[6] * W[6] + O[7] * W[7] +
+      O[8] * W[8] + O[9] * W[9];
+  for (; W < sW; O++, W++)
+    sum += O[0] * W[0];
+  return sum;
+}
+
+static void scalarDotLinksBack(real inputDeriv, real *W, real *WD, real *O,
+			       real *D, int n) {
+  int i;
+  for (i = 0; i < n; i++) {
+    D[i]  += inputDeriv * W[i];
+    WD[i] += inputDeriv * O[i];
+  }
+}
+
+static void scalarDotLinksBackSenders(real inputDeriv, real *W, real *D,
+				      int n) {
+  int i;
+  for (i = 0; i < n; i++)
+    D[i] += inputDeriv * W[i];
+}
+
+static void scalarContrastLinksBack(real output, real deriv, real *WD,
+				    real *O, real *D, int n) {
+  int i;
+  for (i = 0; i < n; i++)
+    WD[i] += output * O[i] - deriv * D[i];
+}
+
+static real scalarDistanceLinks(real sum, real *W, real *O, int n) {
+  int i;
+  for (i = 0; i < n; i++)
+    sum += SQUARE(W[i] - O[i]);
+  return sum;
+}
+
+static void scalarDistanceLinksBack(real inputDeriv, real *W, real *WD,
+				    real *O, real *D, int n) {
+  real delta;
+  int i;
+  for (i = 0; i < n; i++) {
+    delta = inputDeriv * (W[i] - O[i]);
+    D[i]  -= delta;
+    WD[i] += delta;
+  }
+}
+
+/* This returns the index of the first smallest value. */
+static int scalarMinMaxValues(real *x, int n, real *min, real *max) {
+  real lo = x[0], hi = x[0];
+  int i, m = 0;
+  for (i = 1; i < n; i++) {
+    if (x[i] < lo) {lo = x[i]; m = i;}
+    if (x[i] > hi) hi = x[i];
+  }
+  *min = lo;
+  *max = hi;
+  return m;
+}
+
+/* The vector versions find the extremes first and then look for the first
+   copy of the minimum. */
+static int firstIndex(real *x, int i, int n, real v) {
+  for (; i < n; i++)
+    if (x[i] == v) break;
+  return i;
+}
+
+/* The scalar activations are the original ones, with the sigmoid looked up
+   in a table and the rest from libm. */
+static void scalarSigmoidValues(real *y, real *x, real gain, int n) {
+  int i;
+  for (i = 0; i < n; i++)
+    y[i] = fastSigmoid(x[i] * gain);
+}
+
+static void scalarTanhValues(real *y, real *x, real gain, int n) {
+  int i;
+  for (i = 0; i < n; i++)
+    y[i] = CALC_TANH(gain * x[i]);
+}
+
+static void scalarExpValues(real *y, real *x, double shift, int n) {
+  int i;
+  for (i = 0; i < n; i++)
+    y[i] = EXP(x[i] - shift);
+}
+
+/* These skip units with NaN targets. */
+static real scalarCrossEntropySum(real *Y, real *T, int n) {
+  real error = 0.0;
+  int i;
+  for (i = 0; i < n; i++)
+    if (!isNaN(T[i])) error += CROSS_ENTROPY_ERROR(Y[i], T[i]);
+  return error;
+}
+
+static real scalarDivergenceSum(real *Y, real *T, int n) {
+  real error = 0.0;
+  int i;
+  for (i = 0; i < n; i++)
+    if (!isNaN(T[i])) error += DIVERGENCE_ERROR(Y[i], T[i]);
+  return error;
+}
+
+/* This is only used when ExactMath is set.  It is clamped like
+   fastSigmoid. */
+static void exactSigmoidValues(real *y, real *x, real gain, int n) {
+  real v;
+  int i;
+  for (i = 0; i < n; i++) {
+    v = x[i] * gain;
+    if (v < -SIGMOID_RANGE) v = -SIGMOID_RANGE;
+    else if (v > SIGMOID_RANGE) v = SIGMOID_RANGE;
+    y[i] = SIGMOID(v, 1.0);
+  }
+}
+
+static flag scalarSupported(void) {
+  return TRUE;
+}
+
+#ifdef X86_KERNELS
+
+/********************************** SSE2 *************************************/
+
+/* The backward kernels do a separate multiply and add on each link, so they
+   give exactly the same derivatives as the scalar version.  Only the order
+   of the forward sums differs. */
+
+__attribute__((target("sse2")))
+static real sse2DotLinks(real sum, real *W, real *O, int n) {
+  float t[4];
+  __m128 acc = _mm_setzero_ps();
+  int i;
+  for (i = 0; i + 4 <= n; i += 4)
+    acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(W + i),
+				     _mm_loadu_ps(O + i)));
+  _mm_storeu_ps(t, acc);
+  sum += (t[0] + t[1]) + (t[2] + t[3]);
+  return scalarDotLinks(sum, W + i, O + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static void sse2DotLinksBack(real inputDeriv, real *W, real *WD, real *O,
+			     real *D, int n) {
+  __m128 d = _mm_set1_ps(inputDeriv);
+  int i;
+  for (i = 0; i + 4 <= n; i += 4) {
+    _mm_storeu_ps(D + i, _mm_add_ps(_mm_loadu_ps(D + i),
+				    _mm_mul_ps(d, _mm_loadu_ps(W + i))));
+    _mm_storeu_ps(WD + i, _mm_add_ps(_mm_loadu_ps(WD + i),
+				     _mm_mul_ps(d, _mm_loadu_ps(O + i))));
+  }
+  scalarDotLinksBack(inputDeriv, W + i, WD + i, O + i, D + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static void sse2DotLinksBackSenders(real inputDeriv, real *W, real *D, int n) {
+  __m128 d = _mm_set1_ps(inputDeriv);
+  int i;
+  for (i = 0; i + 4 <= n; i += 4)
+    _mm_storeu_ps(D + i, _mm_add_ps(_mm_loadu_ps(D + i),
+				    _mm_mul_ps(d, _mm_loadu_ps(W + i))));
+  scalarDotLinksBackSenders(inputDeriv, W + i, D + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static void sse2ContrastLinksBack(real output, real deriv, real *WD, real *O,
+				  real *D, int n) {
+  __m128 a = _mm_set1_ps(output), b = _mm_set1_ps(deriv);
+  int i;
+  for (i = 0; i + 4 <= n; i += 4)
+    _mm_storeu_ps(WD + i, _mm_add_ps(_mm_loadu_ps(WD + i),
+		  _mm_sub_ps(_mm_mul_ps(a, _mm_loadu_ps(O + i)),
+			     _mm_mul_ps(b, _mm_loadu_ps(D + i)))));
+  scalarContrastLinksBack(output, deriv, WD + i, O + i, D + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static real sse2DistanceLinks(real sum, real *W, real *O, int n) {
+  float t[4];
+  __m128 acc = _mm_setzero_ps(), d;
+  int i;
+  for (i = 0; i + 4 <= n; i += 4) {
+    d = _mm_sub_ps(_mm_loadu_ps(W + i), _mm_loadu_ps(O + i));
+    acc = _mm_add_ps(acc, _mm_mul_ps(d, d));
+  }
+  _mm_storeu_ps(t, acc);
+  sum += (t[0] + t[1]) + (t[2] + t[3]);
+  return scalarDistanceLinks(sum, W + i, O + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static void sse2DistanceLinksBack(real inputDeriv, real *W, real *WD, real *O,
+				  real *D, int n) {
+  __m128 d = _mm_set1_ps(inputDeriv), delta;
+  int i;
+  for (i = 0; i + 4 <= n; i += 4) {
+    delta = _mm_mul_ps(d, _mm_sub_ps(_mm_loadu_ps(W + i), _mm_loadu_ps(O + i)));
+    _mm_storeu_ps(D + i, _mm_sub_ps(_mm_loadu_ps(D + i), delta));
+    _mm_storeu_ps(WD + i, _mm_add_ps(_mm_loadu_ps(WD + i), delta));
+  }
+  scalarDistanceLinksBack(inputDeriv, W + i, WD + i, O + i, D + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static int sse2MinMaxValues(real *x, int n, real *min, real *max) {
+  float t[4], u[4];
+  __m128 lo, hi, v;
+  real a, b;
+  int i, bits;
+  if (n < 8) return scalarMinMaxValues(x, n, min, max);
+  lo = hi = _mm_loadu_ps(x);
+  for (i = 4; i + 4 <= n; i += 4) {
+    v = _mm_loadu_ps(x + i);
+    lo = _mm_min_ps(lo, v);
+    hi = _mm_max_ps(hi, v);
+  }
+  _mm_storeu_ps(t, lo);
+  _mm_storeu_ps(u, hi);
+  a = MIN(MIN(t[0], t[1]), MIN(t[2], t[3]));
+  b = MAX(MAX(u[0], u[1]), MAX(u[2], u[3]));
+  for (; i < n; i++) {
+    if (x[i] < a) a = x[i];
+    if (x[i] > b) b = x[i];
+  }
+  *min = a;
+  *max = b;
+  v = _mm_set1_ps(a);
+  for (i = 0; i + 4 <= n; i += 4)
+    if ((bits = _mm_movemask_ps(_mm_cmpeq_ps(_mm_loadu_ps(x + i), v))))
+      return i + __builtin_ctz(bits);
+  return firstIndex(x, i, n, a);
+}
+
+static flag sse2Supported(void) {
+  return __builtin_cpu_supports("sse2");
+}
+
+#define VEC_WIDTH  4
+#define VEC_TARGET "sse2"
+#define VEC(name)  sse2##name
+#include "kernelMath.h"
+#undef VEC_WIDTH
+#undef VEC_TARGET
+#undef VEC
+
+
+/********************************** AVX2 *************************************/
+
+/* The tail calls into the scalar code would otherwise skip the vzeroupper
+   that the compiler adds on return, leaving every later SSE instruction to
+   pay for the dirty upper state. */
+
+__attribute__((target("avx2,fma")))
+static real avx2DotLinks(real sum, real *W, real *O, int n) {
+  float t[4];
+  __m256 acc = _mm256_setzero_ps();
+  __m128 s;
+  int i;
+  for (i = 0; i + 8 <= n; i += 8)
+    acc = _mm256_fmadd_ps(_mm256_loadu_ps(W + i), _mm256_loadu_ps(O + i), acc);
+  s = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+  _mm_storeu_ps(t, s);
+  _mm256_zeroupper();
+  sum += (t[0] + t[1]) + (t[2] + t[3]);
+  return scalarDotLinks(sum, W + i, O + i, n - i);
+}
+
+__attribute__((target("avx2,fma")))
+static void avx2DotLinksBack(real inputDeriv, real *W, real *WD, real *O,
+			     real *D, int n) {
+  __m256 d = _mm256_set1_ps(inputDeriv);
+  int i;
+  for (i = 0; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(D + i, _mm256_add_ps(_mm256_loadu_ps(D + i),
+		     _mm256_mul_ps(d, _mm256_loadu_ps(W + i))));
+    _mm256_storeu_ps(WD + i, _mm256_add_ps(_mm256_loadu_ps(WD + i),
+		     _mm256_mul_ps(d, _mm256_loadu_ps(O + i))));
+  }
+  _mm256_zeroupper();
+  scalarDotLinksBack(inputDeriv, W + i, WD + i, O + i, D + i, n - i);
+}
+
+__attribute__((target("avx2,fma")))
+static void avx2DotLinksBackSenders(real inputDeriv, real *W, real *D, int n) {
+  __m256 d = _mm256_set1_ps(inputDeriv);
+  int i;
+  for (i = 0; i + 8 <= n; i += 8)
+    _mm256_storeu_ps(D + i, _mm256_add_ps(_mm256_loadu_ps(D + i),
+		     _mm256_mul_ps(d, _mm256_loadu_ps(W + i))));
+  _mm256_zeroupper();
+  scalarDotLinksBackSenders(inputDeriv, W + i, D + i, n - i);
+}
+
+__attribute__((target("avx2,fma")))
+static void avx2ContrastLinksBack(real output, real deriv, real *WD, real *O,
+				  real *D, int n) {
+  __m256 a = _mm256_set1_ps(output), b = _mm256_set1_ps(deriv);
+  int i;
+  for (i = 0; i + 8 <= n; i += 8)
+    _mm256_storeu_ps(WD + i, _mm256_add_ps(_mm256_loadu_ps(WD + i),
+		     _mm256_sub_ps(_mm256_mul_ps(a, _mm256_loadu_ps(O + i)),
+				   _mm256_mul_ps(b, _mm256_loadu_ps(D + i)))));
+  _mm256_zeroupper();
+  scalarContrastLinksBack(output, deriv, WD + i, O + i, D + i, n - i);
+}
+
+__attribute__((target("avx2,fma")))
+static real avx2DistanceLinks(real sum, real *W, real *O, int n) {
+  float t[4];
+  __m256 acc = _mm256_setzero_ps(), d;
+  __m128 s;
+  int i;
+  for (i = 0; i + 8 <= n; i += 8) {
+    d = _mm256_sub_ps(_mm256_loadu_ps(W + i), _mm256_loadu_ps(O + i));
+    acc = _mm256_fmadd_ps(d, d, acc);
+  }
+  s = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+  _mm_storeu_ps(t, s);
+  _mm256_zeroupper();
+  sum += (t[0] + t[1]) + (t[2] + t[3]);
+  return scalarDistanceLinks(sum, W + i, O + i, n - i);
+}
+
+__attribute__((target("avx2,fma")))
+static void avx2DistanceLinksBack(real inputDeriv, real *W, real *WD, real *O,
+				  real *D, int n) {
+  __m256 d = _mm256_set1_ps(inputDeriv), delta;
+  int i;
+  for (i = 0; i + 8 <= n; i += 8) {
+    delta = _mm256_mul_ps(d, _mm256_sub_ps(_mm256_loadu_ps(W + i),
+					   _mm256_loadu_ps(O + i)));
+    _mm256_storeu_ps(D + i, _mm256_sub_ps(_mm256_loadu_ps(D + i), delta));
+    _mm256_storeu_ps(WD + i, _mm256_add_ps(_mm256_loadu_ps(WD + i), delta));
+  }
+  _mm256_zeroupper();
+  scalarDistanceLinksBack(inputDeriv, W + i, WD + i, O + i, D + i, n - i);
+}
+
+__attribute__((target("avx2,fma")))
+static int avx2MinMaxValues(real *x, int n, real *min, real *max) {
+  float t[4], u[4];
+  __m256 lo, hi, v;
+  __m128 l, h;
+  real a, b;
+  int i, bits;
+  if (n < 16) return scalarMinMaxValues(x, n, min, max);
+  lo = hi = _mm256_loadu_ps(x);
+  for (i = 8; i + 8 <= n; i += 8) {
+    v = _mm256_loadu_ps(x + i);
+    lo = _mm256_min_ps(lo, v);
+    hi = _mm256_max_ps(hi, v);
+  }
+  l = _mm_min_ps(_mm256_castps256_ps128(lo), _mm256_extractf128_ps(lo, 1));
+  h = _mm_max_ps(_mm256_castps256_ps128(hi), _mm256_extractf128_ps(hi, 1));
+  _mm_storeu_ps(t, l);
+  _mm_storeu_ps(u, h);
+  a = MIN(MIN(t[0], t[1]), MIN(t[2], t[3]));
+  b = MAX(MAX(u[0], u[1]), MAX(u[2], u[3]));
+  for (; i < n; i++) {
+    if (x[i] < a) a = x[i];
+    if (x[i] > b) b = x[i];
+  }
+  *min = a;
+  *max = b;
+  v = _mm256_set1_ps(a);
+  for (i = 0; i + 8 <= n; i += 8)
+    if ((bits = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(x + i), v,
+						 _CMP_EQ_OQ)))) {
+      _mm256_zeroupper();
+      return i + __builtin_ctz(bits);
+    }
+  _mm256_zeroupper();
+  return firstIndex(x, i, n, a);
+}
+
+static flag avx2Supported(void) {
+  return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+}
+
+#define VEC_WIDTH  8
+#define VEC_TARGET "avx2,fma"
+#define VEC(name)  avx2##name
+#include "kernelMath.h"
+#undef VEC_WIDTH
+#undef VEC_TARGET
+#undef VEC
+
+
+/********************************* AVX-512 ***********************************/
+
+__attribute__((target("avx512f")))
+static real avx512DotLinks(real sum, real *W, real *O, int n) {
+  __m512 acc = _mm512_setzero_ps();
+  int i;
+  for (i = 0; i + 16 <= n; i += 16)
+    acc = _mm512_fmadd_ps(_mm512_loadu_ps(W + i), _mm512_loadu_ps(O + i), acc);
+  sum += _mm512_reduce_add_ps(acc);
+  _mm256_zeroupper();
+  return scalarDotLinks(sum, W + i, O + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+static void avx512DotLinksBack(real inputDeriv, real *W, real *WD, real *O,
+			       real *D, int n) {
+  __m512 d = _mm512_set1_ps(inputDeriv);
+  int i;
+  for (i = 0; i + 16 <= n; i += 16) {
+    _mm512_storeu_ps(D + i, _mm512_add_ps(_mm512_loadu_ps(D + i),
+		     _mm512_mul_ps(d, _mm512_loadu_ps(W + i))));
+    _mm512_storeu_ps(WD + i, _mm512_add_ps(_mm512_loadu_ps(WD + i),
+		     _mm512_mul_ps(d, _mm512_loadu_ps(O + i))));
+  }
+  _mm256_zeroupper();
+  scalarDotLinksBack(inputDeriv, W + i, WD + i, O + i, D + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+static void avx512DotLinksBackSenders(real inputDeriv, real *W, real *D,
+				      int n) {
+  __m512 d = _mm512_set1_ps(inputDeriv);
+  int i;
+  for (i = 0; i + 16 <= n; i += 16)
+    _mm512_storeu_ps(D + i, _mm512_add_ps(_mm512_loadu_ps(D + i),
+		     _mm512_mul_ps(d, _mm512_loadu_ps(W + i))));
+  _mm256_zeroupper();
+  scalarDotLinksBackSenders(inputDeriv, W + i, D + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+static void avx512ContrastLinksBack(real output, real deriv, real *WD,
+				    real *O, real *D, int n) {
+  __m512 a = _mm512_set1_ps(output), b = _mm512_set1_ps(deriv);
+  int i;
+  for (i = 0; i + 16 <= n; i += 16)
+    _mm512_storeu_ps(WD + i, _mm512_add_ps(_mm512_loadu_ps(WD + i),
+		     _mm512_sub_ps(_mm512_mul_ps(a, _mm512_loadu_ps(O + i)),
+				   _mm512_mul_ps(b, _mm512_loadu_ps(D + i)))));
+  _mm256_zeroupper();
+  scalarContrastLinksBack(output, deriv, WD + i, O + i, D + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+static real avx512DistanceLinks(real sum, real *W, real *O, int n) {
+  __m512 acc = _mm512_setzero_ps(), d;
+  int i;
+  for (i = 0; i + 16 <= n; i += 16) {
+    d = _mm512_sub_ps(_mm512_loadu_ps(W + i), _mm512_loadu_ps(O + i));
+    acc = _mm512_fmadd_ps(d, d, acc);
+  }
+  sum += _mm512_reduce_add_ps(acc);
+  _mm256_zeroupper();
+  return scalarDistanceLinks(sum, W + i, O + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+static void avx512DistanceLinksBack(real inputDeriv, real *W, real *WD,
+				    real *O, real *D, int n) {
+  __m512 d = _mm512_set1_ps(inputDeriv), delta;
+  int i;
+  for (i = 0; i + 16 <= n; i += 16) {
+    delta = _mm512_mul_ps(d, _mm512_sub_ps(_mm512_loadu_ps(W + i),
+					   _mm512_loadu_ps(O + i)));
+    _mm512_storeu_ps(D + i, _mm512_sub_ps(_mm512_loadu_ps(D + i), delta));
+    _mm512_storeu_ps(WD + i, _mm512_add_ps(_mm512_loadu_ps(WD + i), delta));
+  }
+  _mm256_zeroupper();
+  scalarDistanceLinksBack(inputDeriv, W + i, WD + i, O + i, D + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+static int avx512MinMaxValues(real *x, int n, real *min, real *max) {
+  __m512 lo, hi, v;
+  real a, b;
+  int i, bits;
+  if (n < 32) return scalarMinMaxValues(x, n, min, max);
+  lo = hi = _mm512_loadu_ps(x);
+  for (i = 16; i + 16 <= n; i += 16) {
+    v = _mm512_loadu_ps(x + i);
+    lo = _mm512_min_ps(lo, v);
+    hi = _mm512_max_ps(hi, v);
+  }
+  a = _mm512_reduce_min_ps(lo);
+  b = _mm512_reduce_max_ps(hi);
+  for (; i < n; i++) {
+    if (x[i] < a) a = x[i];
+    if (x[i] > b) b = x[i];
+  }
+  *min = a;
+  *max = b;
+  v = _mm512_set1_ps(a);
+  for (i = 0; i + 16 <= n; i += 16)
+    if ((bits = _mm512_cmp_ps_mask(_mm512_loadu_ps(x + i), v, _CMP_EQ_OQ))) {
+      _mm256_zeroupper();
+      return i + __builtin_ctz(bits);
+    }
+  _mm256_zeroupper();
+  return firstIndex(x, i, n, a);
+}
+
+static flag avx512Supported(void) {
+  return __builtin_cpu_supports("avx512f");
+}
+
+#define VEC_WIDTH  16
+#define VEC_TARGET "avx512f"
+#define VEC(name)  avx512##name
+#include "kernelMath.h"
+#undef VEC_WIDTH
+#undef VEC_TARGET
+#undef VEC
+
+#endif /* X86_KERNELS */
+
+
+/********************************* Dispatch **********************************/
+
+typedef struct kernelSet {
+  char *name;
+  flag (*supported)(void);
+  real (*dotLinks)(real sum, real *W, real *O, int n);
+  void (*dotLinksBack)(real inputDeriv, real *W, real *WD, real *O, real *D,
+		       int n);
+  void (*dotLinksBackSenders)(real inputDeriv, real *W, real *D, int n);
+  void (*contrastLinksBack)(real output, real deriv, real *WD, real *O,
+			    real *D, int n);
+  real (*distanceLinks)(real sum, real *W, real *O, int n);
+  void (*distanceLinksBack)(real inputDeriv, real *W, real *WD, real *O,
+			    real *D, int n);
+  int  (*minMaxValues)(real *x, int n, real *min, real *max);
+  void (*sigmoidValues)(real *y, real *x, real gain, int n);
+  void (*tanhValues)(real *y, real *x, real gain, int n);
+  void (*expValues)(real *y, real *x, double shift, int n);
+  real (*crossEntropySum)(real *Y, real *T, int n);
+  real (*divergenceSum)(real *Y, real *T, int n);
+} *KernelSet;
+
+#define KERNEL_SET(name, k) {name, k##Supported, k##DotLinks, k##DotLinksBack,\
+  k##DotLinksBackSenders, k##ContrastLinksBack, k##DistanceLinks,\
+  k##DistanceLinksBack, k##MinMaxValues, k##SigmoidValues, k##TanhValues,\
+  k##ExpValues, k##CrossEntropySum, k##DivergenceSum}
+
+/* In order of preference. */
+static struct kernelSet KernelSets[] = {
+#ifdef X86_KERNELS
+  KERNEL_SET("AVX512", avx512),
+  KERNEL_SET("AVX2",   avx2),
+  KERNEL_SET("SSE2",   sse2),
+#endif /* X86_KERNELS */
+  KERNEL_SET("scalar", scalar),
+  {NULL}
+};
+
+static KernelSet Kernel;
+
+/* With ExactMath, the activations all come from libm, whatever the set. */
+static void setKernel(KernelSet K) {
+  Kernel              = K;
+  KernelName          = K->name;
+  dotLinks            = K->dotLinks;
+  dotLinksBack        = K->dotLinksBack;
+  dotLinksBackSenders = K->dotLinksBackSenders;
+  contrastLinksBack   = K->contrastLinksBack;
+  distanceLinks       = K->distanceLinks;
+  distanceLinksBack   = K->distanceLinksBack;
+  minMaxValues        = K->minMaxValues;
+  if (ExactMath) {
+    sigmoidValues   = exactSigmoidValues;
+    tanhValues      = scalarTanhValues;
+    expValues       = scalarExpValues;
+    crossEntropySum = scalarCrossEntropySum;
+    divergenceSum   = scalarDivergenceSum;
+  } else {
+    sigmoidValues   = K->sigmoidValues;
+    tanhValues      = K->tanhValues;
+    expValues       = K->expValues;
+    crossEntropySum = K->crossEntropySum;
+    divergenceSum   = K->divergenceSum;
+  }
+}
+
+void useExactMath(flag exact) {
+  ExactMath = exact;
+  setKernel(Kernel);
+}
+
+void initKernels(void) {
+  KernelSet K;
+#ifdef X86_KERNELS
+  __builtin_cpu_init();
+#endif /* X86_KERNELS */
+  for (K = KernelSets; K->name; K++)
+    if (K->supported()) break;
+  setKernel(K);
+}
+
+flag useKernel(const char *name) {
+  KernelSet K;
+  for (K = KernelSets; K->name; K++)
+    if (!strcasecmp(K->name, name)) {
+      if (!K->supported())
+	return warning("The %s kernels aren't supported on this machine",
+		       K->name);
+      setKernel(K);
+      return TCL_OK;
+    }
+  return warning("Unknown kernel set: \"%s\"", name);
+}
+
+void listKernels(void) {
+  KernelSet K;
+  for (K = KernelSets; K->name; K++)
+    if (K->supported()) append("%s ", K->name);
+}
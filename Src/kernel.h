@@ -0,0 +1,44 @@
+#ifndef KERNEL_H
+#define KERNEL_H
+
+/* Inner loops over one block of links, whose weights are in W and derivs in
+   WD.  The versions used are picked once by initKernels() to suit the
+   instruction set of the machine. */
+extern real (*dotLinks)(real sum, real *W, real *O, int n);
+extern void (*dotLinksBack)(real inputDeriv, real *W, real *WD, real *O,
+			    real *D, int n);
+/* This does only the senders' derivs, for when the link derivs are done
+   separately. */
+extern void (*dotLinksBackSenders)(real inputDeriv, real *W, real *D, int n);
+/* The Boltzmann contrast, output * O - deriv * D, added into the link derivs.
+   O and D are the senders' outputs in the two phases. */
+extern void (*contrastLinksBack)(real output, real deriv, real *WD, real *O,
+				 real *D, int n);
+/* The squared distance between the weights and the senders' outputs, and
+   its derivs. */
+extern real (*distanceLinks)(real sum, real *W, real *O, int n);
+extern void (*distanceLinksBack)(real inputDeriv, real *W, real *WD, real *O,
+				 real *D, int n);
+
+/* The smallest and largest of n > 0 values.  This returns the index of the
+   first copy of the smallest. */
+extern int  (*minMaxValues)(real *x, int n, real *min, real *max);
+
+/* The activations over n units.  Each set has its own approximations, but
+   with ExactMath they all use libm. */
+extern void (*sigmoidValues)(real *y, real *x, real gain, int n);
+extern void (*tanhValues)(real *y, real *x, real gain, int n);
+extern void (*expValues)(real *y, real *x, double shift, int n);
+/* The errors summed over the units whose targets aren't NaN. */
+extern real (*crossEntropySum)(real *Y, real *T, int n);
+extern real (*divergenceSum)(real *Y, real *T, int n);
+
+extern char *KernelName;
+extern flag ExactMath;
+
+extern void initKernels(void);
+extern flag useKernel(const char *name);
+extern void listKernels(void);
+extern void useExactMath(flag exact);
+
+#endif /* KERNEL_H */
@@ -163,7 +163,7 @@ set tcl_precision 8
 ### These are the default procedures executed when a USR1 or USR2 signal is
 # received.  You can send the signal with "kill -USR1 <process-id>".
 
-set defaultSigUSR1Proc {saveWeights quicksave.wt.gz -v 3}
+set defaultSigUSR1Proc {saveWeights quicksave.wt.gz -v 3; saveState quicksave.state}
 set defaultSigUSR2Proc {view}
 
 ### These procedures will be called whenever an object of the corresponding
@@ -1,5 +1,6 @@
 #include <string.h>
 #include "system.h"
+#include <netinet/in.h>
 #include "util.h"
 #include "type.h"
 #include "network.h"
@@ -9,7 +10,7 @@
 #include "display.h"
 #include "train.h"
 
-Network Net = NULL;       /* The currently active net */
+THREAD_LOCAL Network Net = NULL; /* The currently active net */
 struct rootrec root = {0, NULL, 0, NULL};
 RootRec Root = &root;
 
@@ -115,16 +116,11 @@ static void freeUnit(Unit U, flag all) {
   if (!U) return;
   if (all) {
     FREE(U->name);
-    FREE(U->inputHistory);
-    FREE(U->outputHistory);
-    FREE(U->targetHistory);
-    FREE(U->outputDerivHistory);
     freeUnitExtension(U);
   }
   if (!(U->group->net->type & OPTIMIZED)) {
     FREE(U->block);
-    FREE(U->incoming);
-    FREE(U->incoming2);
+    if (!U->group->linkMatrix) FREE(U->weight);
   }
 }
 
@@ -135,6 +131,13 @@ static void freeGroupProc(GroupProc P) {
   FREE(P);
 }
 
+static void freeGroupHistories(Group G) {
+  FREE(G->inputHistory);
+  FREE(G->outputHistory);
+  FREE(G->targetHistory);
+  FREE(G->outputDerivHistory);
+}
+
 static void freeGroup(Group G, flag all) {
   GroupProc P, Q;
   if (!G) return;
@@ -144,10 +147,15 @@ static void freeGroup(Group G, flag all) {
     for (P = G->outputProcs; P; P = Q) {Q = P->next; freeGroupProc(P);}
     for (P = G->costProcs;   P; P = Q) {Q = P->next; freeGroupProc(P);}
     freeGroupExtension(G);
+    freeGroupHistories(G);
   }
   FOR_EVERY_UNIT(G, freeUnit(U, all));
+  freeSparseIndex(G);
+  FREE(G->liveUnit);
+  freeNetPlan(G->net);
   if (!(G->net->type & OPTIMIZED)) {
-    FREE(G->output);
+    FREE(G->linkMatrix);
+    FREE(G->input);
     FREE(G->unit);
     free(G);
   }
@@ -175,10 +183,12 @@ static void freeNet(Network N, flag all) {
     if (N->preTickBackProc) Tcl_DecrRefCount(N->preTickBackProc);
     if (N->sigUSR1Proc)     Tcl_DecrRefCount(N->sigUSR1Proc);
     if (N->sigUSR2Proc)     Tcl_DecrRefCount(N->sigUSR2Proc);
+    if (N->outputFile) closeOutputFile(N);
     FREE(N->outputFileName);
-    if (N->outputFile) closeChannel(N->outputFile);
     freeNetworkExtension(N);
   }
+  freeNetPlan(N);
+  freeCheckpoints(N);
   for (g = 0; g < N->numGroups; g++)
     freeGroup(N->group[g], all);
   if (!(N->type & OPTIMIZED)) {
@@ -206,24 +216,20 @@ static char *unusedUnitName(Group G) {
   return new;
 }
 
-static void buildUnitHistories(Group G, Unit U) {
-  FREE(U->inputHistory);
-  FREE(U->outputHistory);
-  FREE(U->targetHistory);
-  FREE(U->outputDerivHistory);
+static void buildGroupHistories(Group G) {
+  int size = Net->historyLength * G->numUnits;
+  freeGroupHistories(G);
 
-  if (Net->historyLength <= 0) return;
+  if (size <= 0) return;
 
-  U->inputHistory = realArray(Net->historyLength,
-			      "buildUnitHistories:U->inputHistory");
-  U->outputHistory = realArray(Net->historyLength,
-			       "buildUnitHistories:U->outputHistory");
+  G->inputHistory = realArray(size, "buildGroupHistories:G->inputHistory");
+  G->outputHistory = realArray(size, "buildGroupHistories:G->outputHistory");
   if (G->costType & ERROR_MASKS || G->type & USE_TARGET_HIST)
-    U->targetHistory = realArray(Net->historyLength,
-				 "buildUnitHistories:U->targetHistory");
+    G->targetHistory = realArray(size,
+				 "buildGroupHistories:G->targetHistory");
   if (G->costType || G->type & USE_OUT_DERIV_HIST)
-    U->outputDerivHistory = realArray(Net->historyLength,
-            "buildUnitHistories:U->outputDerivHistory");
+    G->outputDerivHistory = realArray(size,
+            "buildGroupHistories:G->outputDerivHistory");
 }
 
 /* Assumes there is a current network.  The name is not copied here for
@@ -240,8 +246,8 @@ static flag initUnit(Unit U, char *name, int num, Group G) {
   U->num   = num;
   U->group = G;
 
-  U->target        = DEF_U_target;
-  U->externalInput = DEF_U_externalInput;
+  UNIT_VAL(U, target)        = DEF_U_target;
+  UNIT_VAL(U, externalInput) = DEF_U_externalInput;
   U->gain          = chooseValue(G->gain, Net->gain);
   U->dtScale       = DEF_U_dtScale;
 
@@ -384,6 +390,7 @@ void removeProc(Group G, unsigned int class, mask type) {
 }
 
 flag finalizeGroupType(Group G, flag wasOutput, flag wasInput) {
+  freeNetPlan(G->net);
   if (initGroupTypes(G)) return TCL_ERROR;
 
   if (wasOutput) {
@@ -393,7 +400,7 @@ flag finalizeGroupType(Group G, flag wasOutput, flag wasInput) {
     if (!(G->type & INPUT))    changeNumInputs(-G->numUnits);
   } else if (G->type & INPUT)  changeNumInputs(G->numUnits);
 
-  FOR_EVERY_UNIT(G, buildUnitHistories(G, U));
+  buildGroupHistories(G);
   return TCL_OK;
 }
 
@@ -441,6 +448,23 @@ flag setGroupType(Group G, int numTypes, unsigned int *typeClass, mask *type,
   return finalizeGroupType(G, wasOutput, wasInput);
 }
 
+/* The arrays of unit values and the output caches are one block, starting at
+   G->input.  The deriv cache must follow the output cache. */
+#define GROUP_VALUES 9
+
+static void setGroupValues(Group G, real *values) {
+  int n = G->numUnits;
+  G->input            = values;
+  G->output           = values + n;
+  G->target           = values + 2 * n;
+  G->externalInput    = values + 3 * n;
+  G->adjustedTarget   = values + 4 * n;
+  G->inputDeriv       = values + 5 * n;
+  G->outputDeriv      = values + 6 * n;
+  G->outputCache      = values + 7 * n;
+  G->outputDerivCache = values + 8 * n;
+}
+
 flag addGroup(char *name, int numTypes, unsigned int *typeClass, mask *type,
 	      unsigned int *typeMode, int numUnits) {
   Group G;
@@ -501,8 +525,7 @@ flag addGroup(char *name, int numTypes, unsigned int *typeClass, mask *type,
   G->numUnits = numUnits;
   Net->numUnits += numUnits;
   G->unit = safeCalloc(numUnits, sizeof(struct unit), "addGroup:G->unit");
-  G->output = realArray(2 * numUnits, "addGroup:G->output");
-  G->outputDeriv = G->output + numUnits;
+  setGroupValues(G, realArray(GROUP_VALUES * numUnits, "addGroup:G->input"));
 
   if (setGroupType(G, numTypes, typeClass, type, typeMode)) return TCL_ERROR;
 
@@ -547,7 +570,12 @@ flag addNet(char *name, mask type, int timeIntervals,
 
   N->numUpdates      = DEF_N_numUpdates;
   N->batchSize       = DEF_N_batchSize;
+  N->numThreads      = DEF_N_numThreads;
+  N->threadUnits     = DEF_N_threadUnits;
+  N->threadLinks     = DEF_N_threadLinks;
+  N->sparseFraction  = DEF_N_sparseFraction;
   N->reportInterval  = DEF_N_reportInterval;
+  N->outputFlushInterval = DEF_N_outputFlushInterval;
   N->criterion       = DEF_N_criterion;
   N->trainGroupCrit  = DEF_N_trainGroupCrit;
   N->testGroupCrit   = DEF_N_testGroupCrit;
@@ -651,12 +679,61 @@ flag setTime(Network N, int timeIntervals, int ticksPerInterval,
   N->resetHistory = (flag *) intArray(N->historyLength,
 				      "setHistoryLength:N->resetHistory");
   FOR_EACH_GROUP({
-    FOR_EVERY_UNIT(G, buildUnitHistories(G, U));
+    buildGroupHistories(G);
     if (initGroupTypes(G)) return TCL_ERROR;
   });
   return TCL_OK;
 }
 
+/* This sets the ticks between the checkpoints saved for backprop through
+   time and shortens the histories to match.  If ticks is negative, it is
+   chosen to use the least memory, but if megabytes is positive, checkpoints
+   are only used if the full histories would need more than that. */
+flag setCheckpointTicks(Network N, int ticks, real megabytes) {
+  int k, span = N->maxTicks - ((N->type & CONTINUOUS) ? 1 : 0),
+    row = checkpointRowSize(), state = checkpointStateSize() + row;
+  double memory, least = 0.0;
+
+  if (ticks < 0) {
+    if (megabytes > 0.0 && (double) N->maxTicks * row * sizeof(real) <=
+	megabytes * 1048576.0)
+      ticks = 0;
+    else for (k = 1; k < span; k++) {
+      memory = (double) (k + 1) * row + (double) ((span + k - 1) / k + 1) *
+	state;
+      if (least == 0.0 || memory < least) {
+	least = memory;
+	ticks = k;
+      }
+    }
+  }
+  if (ticks < 0 || ticks >= span) ticks = 0;
+  N->checkpointTicks = ticks;
+  if (ticks > 0) N->streamTicks = 0;
+  freeCheckpoints(N);
+  return setTime(N, N->timeIntervals, N->ticksPerInterval,
+		 (ticks > 0) ? ticks + 1 : N->maxTicks, FALSE);
+}
+
+/* This makes a continuous network backpropagate every ticks ticks through
+   the last ticks + overlap ticks, rather than once at the end of each
+   example, so the histories only need to hold that many. */
+flag setStreamTicks(Network N, int ticks, int overlap) {
+  if (ticks > 0 && !(N->type & CONTINUOUS))
+    return warning("setTime: only continuous networks can stream");
+  if (overlap < 0)
+    return warning("setTime: the stream overlap cannot be negative");
+  N->streamTicks = imax(ticks, 0);
+  N->streamOverlap = overlap;
+  if (N->streamTicks > 0) {
+    N->checkpointTicks = 0;
+    freeCheckpoints(N);
+  }
+  return setTime(N, N->timeIntervals, N->ticksPerInterval, (N->streamTicks) ?
+		 imin(N->streamTicks + overlap + 1, N->maxTicks) : N->maxTicks,
+		 FALSE);
+}
+
 flag orderGroups(int argc, char *argv[]) {
   flag changed = 0;
   int g;
@@ -759,47 +836,52 @@ flag deleteAllNets(void) {
 
 /************************************* Resetting *****************************/
 
+/* The offsets are those of the value arrays in the group structure. */
 flag copyUnitValues(Group from, int fromoff, Group to, int tooff) {
   int i;
+  real *F = GROUP_FIELD(from, fromoff), *T = GROUP_FIELD(to, tooff);
   if (from->numUnits != to->numUnits)
     return warning("copyUnitValues: group \"%s\" and group \"%s\" aren't "
                    "the same size", from, to);
   for (i = 0; i < from->numUnits; i++)
-    *(real *) ((char *) (to->unit + i) + tooff) =
-      *(real *) ((char *) (from->unit + i) + fromoff);
+    T[i] = F[i];
   return TCL_OK;
 }
 
 flag setUnitValues(Group G, int offset, real value) {
   int i;
+  real *V = GROUP_FIELD(G, offset);
   for (i = 0; i < G->numUnits; i++)
-    *(real *) ((char *) (G->unit + i) + offset) = value;
+    V[i] = value;
   return TCL_OK;
 }
 
+static void clearUnitHistory(real *history, Unit U, real value) {
+  int i, n = U->group->numUnits;
+  if (!history) return;
+  for (i = 0; i < Net->historyLength; i++)
+    history[i * n + U->num] = value;
+}
+
 static void resetUnitValues(Unit U) {
-  int size = Net->historyLength * sizeof(real);
-  U->output = chooseValue(U->group->initOutput, Net->initOutput);
-  U->input  = chooseValue(U->group->initInput,  Net->initInput);
-  U->outputDeriv = U->inputDeriv = U->gainDeriv = 0.0;
-  U->externalInput = U->target = NaN;
+  Group G = U->group;
+  UNIT_VAL(U, output) = chooseValue(U->group->initOutput, Net->initOutput);
+  UNIT_VAL(U, input)  = chooseValue(U->group->initInput,  Net->initInput);
+  UNIT_VAL(U, outputDeriv) = UNIT_VAL(U, inputDeriv) = U->gainDeriv = 0.0;
+  UNIT_VAL(U, externalInput) = UNIT_VAL(U, target) = NaN;
   U->gain = chooseValue(U->group->gain, Net->gain);
 
-  if (U->inputHistory)
-    memset(U->inputHistory, 0, size);
-  if (U->outputHistory)
-    memset(U->outputHistory, 0, size);
-  if (U->targetHistory)
-    memset(U->targetHistory, 0, size);
-  if (U->outputDerivHistory)
-    memset(U->outputDerivHistory, 0, size);
+  clearUnitHistory(G->inputHistory, U, 0.0);
+  clearUnitHistory(G->outputHistory, U, 0.0);
+  clearUnitHistory(G->targetHistory, U, 0.0);
+  clearUnitHistory(G->outputDerivHistory, U, 0.0);
 }
 
 flag standardResetNet(flag randomize) {
   FOR_EACH_GROUP({
     FOR_EACH_UNIT(G, {
       resetUnitValues(U);
-      FOR_EACH_LINK(U, initLinkValues(L, getLink2(U, L)));
+      FOR_EACH_LINK(U, initLinkValues(U, l));
     });
     resetForwardIntegrators(G);
     resetBackwardIntegrators(G);
@@ -826,9 +908,9 @@ flag standardResetNet(flag randomize) {
 flag resetDerivs(void) {
   if (!Net) return TCL_ERROR;
   FOR_EACH_GROUP({
-    FOR_EACH_UNIT(G, {
-      U->outputDeriv = U->inputDeriv = U->gainDeriv = 0.0;
-      FOR_EACH_LINK(U, L->deriv = 0.0);
+    FOR_EACH_UNIT2(G, {
+      G->outputDeriv[u] = G->inputDeriv[u] = U->gainDeriv = 0.0;
+      FOR_EACH_LINK(U, U->deriv[l] = 0.0);
     });
   });
   return TCL_OK;
@@ -836,28 +918,29 @@ flag resetDerivs(void) {
 
 /*********************************** Unit Lesioning **************************/
 
-static void fillNaN(real *a, int len) {
-  int i;
-  if (!a) return;
-  for (i = 0; i < len; i++)
-    a[i] = NaN;
+/* The live units of G are listed again, and the incoming links of every
+   group skip the new lesioned senders, once the plan is recompiled. */
+static void lesionsChanged(Group G) {
+  int g;
+  G->numLive = -1;
+  for (g = 0; g < G->net->numGroups; g++)
+    freeLiveIndex(G->net->group[g]);
+  freeNetPlan(G->net);
 }
 
 flag lesionUnit(Unit U) {
   Group G = U->group;
-  U->output = U->outputDeriv = 0;
-  G->output[U->num] = G->outputDeriv[U->num] = 0;
-  U->input = U->inputDeriv = U->target = U->adjustedTarget = NaN;
-  if (U->inputHistory)
-    fillNaN(U->inputHistory, Net->historyLength);
-  if (U->outputHistory)
-    fillNaN(U->outputHistory, Net->historyLength);
-  if (U->targetHistory)
-    fillNaN(U->targetHistory, Net->historyLength);
-  if (U->outputDerivHistory)
-    fillNaN(U->outputDerivHistory, Net->historyLength);
+  int u = U->num;
+  G->output[u] = G->outputDeriv[u] = 0;
+  G->outputCache[u] = G->outputDerivCache[u] = 0;
+  G->input[u] = G->inputDeriv[u] = G->target[u] = G->adjustedTarget[u] = NaN;
+  clearUnitHistory(G->inputHistory, U, NaN);
+  clearUnitHistory(G->outputHistory, U, NaN);
+  clearUnitHistory(G->targetHistory, U, NaN);
+  clearUnitHistory(G->outputDerivHistory, U, NaN);
   U->type |= LESIONED;
   G->type |= LESIONED;
+  lesionsChanged(G);
   return TCL_OK;
 }
 
@@ -868,9 +951,19 @@ flag healUnit(Unit V) {
     if (U->type & LESIONED) {allHealthy = FALSE; break;}
   });
   if (allHealthy) V->group->type &= ~LESIONED;
+  lesionsChanged(V->group);
   return TCL_OK;
 }
 
+/* This lists the live units of a lesioned group, in order. */
+void buildLiveUnits(Group G) {
+  if (!G->liveUnit)
+    G->liveUnit = (Unit *) safeMalloc(G->numUnits * sizeof(Unit),
+				      "buildLiveUnits:G->liveUnit");
+  G->numLive = 0;
+  FOR_EVERY_UNIT(G, if (!(U->type & LESIONED)) G->liveUnit[G->numLive++] = U);
+}
+
 #ifdef JUNK
 flag printGroupUnitValues(Tcl_Channel channel, Group G, int *field,
 			  char **format, int numFields) {
@@ -924,14 +1017,14 @@ flag printGroupUnitValues(Tcl_Channel channel, Group G, int *field,
 
 static int unitSize(Unit U) {
   return U->numBlocks * sizeof(struct block) +
-    U->numIncoming * (sizeof(struct link) + sizeof(struct link2));
+    U->numIncoming * LINK_VALUES * sizeof(real);
 }
 
 static int groupSize(Group G) {
   int size = sizeof(struct group);
-  size += 2 * G->numUnits * sizeof(real);
+  size += GROUP_VALUES * G->numUnits * sizeof(real);
   size += G->numUnits * sizeof(struct unit);
-  FOR_EACH_UNIT(G, size += unitSize(U));
+  FOR_EVERY_UNIT(G, size += unitSize(U));
   return size;
 }
 
@@ -967,44 +1060,59 @@ void *duplicate(void *data, int size, int command) {
   return NULL;
 }
 
+/* The procedures are still shared with the original group. */
 Group duplicateGroup(Group H, Network New) {
-  GroupProc P;
   Group G = (Group) duplicate(H, sizeof(struct group), 1);
   G->net  = New;
+  G->sparseIndex = NULL;
+  G->liveIndex = NULL;
+  G->liveUnit = NULL;
   G->unit = duplicate(G->unit, G->numUnits * sizeof(struct unit), 1);
+  return G;
+}
+
+/* This points the group's procedures at it and at the other groups in its
+   network. */
+static void fixGroupProcs(Group G) {
+  GroupProc P;
   for (P = G->inputProcs;  P; P = P->next) P->group = G;
   for (P = G->outputProcs; P; P = P->next) {
     P->group = G;
     if (P->type & ELMAN_CLAMP && P->otherData)
-      P->otherData = (void *) New->group[((Group) P->otherData)->num];
+      P->otherData = (void *) G->net->group[((Group) P->otherData)->num];
   }
   for (P = G->costProcs;   P; P = P->next) P->group = G;
-  return G;
 }
 
 void duplicateCaches(Group G) {
-  G->output = duplicate(G->output, 2 * G->numUnits * sizeof(real), 1);
-  G->outputDeriv = G->output + G->numUnits;
+  setGroupValues(G, duplicate(G->input, GROUP_VALUES * G->numUnits *
+			      sizeof(real), 1));
 }
 
+/* A dense link matrix is copied whole so the rows stay contiguous. */
 void duplicateLinks(Group G) {
+  int n = G->denseIncoming;
+  if (G->linkMatrix)
+    G->linkMatrix = duplicate(G->linkMatrix, LINK_VALUES * G->numUnits * n *
+			      sizeof(real), 1);
   FOR_EVERY_UNIT(G, {
     U->group = G;
     U->block = duplicate(U->block, U->numBlocks * sizeof(struct block), 1);
-    U->incoming = duplicate(U->incoming, U->numIncoming *
-			    sizeof(struct link), 1);
+    if (G->linkMatrix)
+      setUnitLinks(U, G->linkMatrix + u * n, G->numUnits * n);
+    else if (U->weight)
+      setUnitLinks(U, duplicate(U->weight, LINK_VALUES * U->numIncoming *
+				sizeof(real), 1), U->numIncoming);
   });
 }
 
 void fixLinks(Group G) {
   Network N = G->net;
   FOR_EVERY_UNIT(G, {
-    U->incoming2 = duplicate(U->incoming2,
-			     U->numIncoming * sizeof(struct link2), 1);
     FOR_EACH_BLOCK(U, {
       Group H = N->group[B->unit->group->num];
       B->unit   = H->unit + B->unit->num;
-      B->output = H->output + B->unit->num;
+      B->output = H->outputCache + B->unit->num;
     });
   });
 }
@@ -1012,6 +1120,9 @@ void fixLinks(Group G) {
 Network duplicateNet(void) {
   int i;
   Network New = (Network) duplicate(Net, sizeof(struct network), 1);
+  New->plan   = NULL;
+  New->checkpoints = NULL;
+  New->outputWriter = NULL;
   New->group  = duplicate(Net->group, New->numGroups * sizeof(Group), 1);
   for (i = 0; i < New->numGroups; i++)
     New->group[i] = duplicateGroup(New->group[i], New);
@@ -1034,6 +1145,7 @@ Network duplicateNet(void) {
 }
 
 flag optimizeNet(void) {
+  int i;
   char *chunk;
   Network New;
   int size = netSize();
@@ -1043,9 +1155,407 @@ flag optimizeNet(void) {
   New = duplicateNet();
   duplicate(NULL, 0, 2);
   New->type |= OPTIMIZED;
+  for (i = 0; i < New->numGroups; i++)
+    fixGroupProcs(New->group[i]);
 
   Root->net[Net->num] = New;
   freeNet(Net, FALSE);
   useNet(New);
   return result("%d", size);
 }
+
+/* This copies a procedure list without its data. */
+static GroupProc copyGroupProcs(GroupProc L) {
+  GroupProc P, Q, list = NULL;
+  for (P = L; P; P = P->next) {
+    Q = (GroupProc) safeCalloc(1, sizeof(*Q), "copyGroupProcs:Q");
+    Q->type = P->type;
+    Q->class = P->class;
+    Q->otherData = P->otherData;
+    if (list) {
+      Q->prev = list->prev;
+      Q->prev->next = Q;
+      list->prev = Q;
+    } else {
+      list = Q;
+      Q->prev = Q;
+    }
+  }
+  return list;
+}
+
+/* A clone is a copy of the current network that can be run in another
+   thread.  It has its own units, links, caches, histories and procedures,
+   but shares the extensions, history arrays, and example sets of the
+   original.  It is not registered and must be freed with freeNetClone. */
+Network cloneNet(void) {
+  int i, size = netSize();
+  Network Master = Net, New;
+  duplicate(safeMalloc(size, "cloneNet:chunk"), size, 0);
+  New = duplicateNet();
+  duplicate(NULL, 0, 2);
+  New->type |= OPTIMIZED;
+  /* A clone may run whole examples of its own. */
+  New->eventHistory = intArray(New->maxTicks, "cloneNet:eventHistory");
+  memcpy(New->eventHistory, Master->eventHistory, New->maxTicks * sizeof(int));
+  New->resetHistory = (flag *) intArray(New->historyLength,
+					"cloneNet:resetHistory");
+  memcpy(New->resetHistory, Master->resetHistory,
+	 New->historyLength * sizeof(flag));
+
+  Net = New;
+  for (i = 0; i < New->numGroups; i++) {
+    Group G = New->group[i];
+    G->inputProcs  = copyGroupProcs(G->inputProcs);
+    G->outputProcs = copyGroupProcs(G->outputProcs);
+    G->costProcs   = copyGroupProcs(G->costProcs);
+    fixGroupProcs(G);
+    initGroupTypes(G);
+    G->inputHistory = G->outputHistory = NULL;
+    G->targetHistory = G->outputDerivHistory = NULL;
+    buildGroupHistories(G);
+  }
+  Net = Master;
+  return New;
+}
+
+/* The network structure is at the start of the clone's memory block. */
+void freeNetClone(Network N) {
+  int i;
+  GroupProc P, Q;
+  freeNetPlan(N);
+  freeCheckpoints(N);
+  for (i = 0; i < N->numGroups; i++) {
+    Group G = N->group[i];
+    for (P = G->inputProcs;  P; P = Q) {Q = P->next; freeGroupProc(P);}
+    for (P = G->outputProcs; P; P = Q) {Q = P->next; freeGroupProc(P);}
+    for (P = G->costProcs;   P; P = Q) {
+      Q = P->next;
+      /* cosineErrorInit allocates its own data. */
+      if (P->type == COSINE) FREE(P->otherData);
+      freeGroupProc(P);
+    }
+    freeGroupHistories(G);
+    freeSparseIndex(G);
+    FREE(G->liveUnit);
+  }
+  FREE(N->eventHistory);
+  FREE(N->resetHistory);
+  free(N);
+}
+
+
+/******************************** Saving State *******************************/
+
+/* A state file holds what training needs to carry on where it stopped, for a
+   network rebuilt by the same script.  It has the writable numeric fields of
+   the network and its groups, the random number generators, the position and
+   order of each example set, and a mapped weight image with the weight,
+   lastWeightDelta and, if ADVANCED, the lastValue of every link, whose
+   fingerprint checks the network's connections.  Like mapped weight files,
+   it is in the writer's byte order, and the sections are aligned so the
+   whole file can be used where it is mapped. */
+#define STATE_VERSION      1
+#define STATE_ALIGN(x)     (((x) + 63) & ~((long long) 63))
+#define STATE_PAD(x)       (((x) + 7) & ~((long long) 7))
+#define STATE_NAME_LENGTH  40
+
+typedef struct stateHeader {
+  int        cookie;            /* SAVED_STATE_COOKIE in network order */
+  int        byteOrder;
+  int        version;
+  int        realSize;
+  int        numParams;
+  int        numSets;
+  long long  params;            /* Offsets of the sections */
+  long long  random;
+  long long  sets;
+  long long  weights;
+  long long  size;
+} *StateHeader;
+
+typedef struct stateParam {
+  int        group;             /* -1 for the network */
+  int        size;
+  char       name[STATE_NAME_LENGTH];
+  char       value[8];
+} *StateParam;
+
+typedef struct stateRandom {
+  RandState  rand;
+  char       random[RANDOM_STATE_SIZE];
+} *StateRandom;
+
+/* This is followed by the name and, if the set has a permuted order, the
+   numbers of its examples in that order, each padded to 8 bytes. */
+typedef struct stateSet {
+  int        nameLength;
+  int        numExamples;
+  int        currentExampleNum;
+  int        permuted;
+} *StateSet;
+
+static flag isStateParam(MemInfo M) {
+  return (M->type == OBJ && M->writable &&
+	  strlen(M->name) < STATE_NAME_LENGTH &&
+	  (M->info == IntInfo || M->info == RealInfo)) ? TRUE : FALSE;
+}
+
+static int numStateParams(ObjInfo O) {
+  MemInfo M;
+  int n = 0;
+  for (M = O->members; M; M = M->next)
+    if (M->type != SPACER && isStateParam(M)) n++;
+  return n;
+}
+
+static StateParam addStateParams(StateParam P, ObjInfo O, char *object,
+				 int group) {
+  MemInfo M;
+  for (M = O->members; M; M = M->next) {
+    if (M->type == SPACER || !isStateParam(M)) continue;
+    P->group = group;
+    P->size = (M->info == IntInfo) ? sizeof(int) : sizeof(real);
+    strcpy(P->name, M->name);
+    memcpy(P->value, object + M->offset, P->size);
+    P++;
+  }
+  return P;
+}
+
+static long long stateSetBytes(ExampleSet S) {
+  long long bytes = sizeof(struct stateSet) + STATE_PAD(strlen(S->name) + 1);
+  if (S->permuted && S->numExamples > 0)
+    bytes += STATE_PAD(S->numExamples * sizeof(int));
+  return bytes;
+}
+
+static flag writeState(Tcl_Obj *fileNameObj) {
+  const char *fileName = Tcl_GetStringFromObj(fileNameObj, NULL);
+  struct stateHeader header;
+  StateHeader H = &header;
+  StateParam P;
+  StateSet T;
+  Tcl_Obj *tempObj;
+  Tcl_Channel channel;
+  char *image, *rec, *s;
+  long long setBytes = 0, n;
+  int i, *num;
+  flag failed;
+
+  memset(H, 0, sizeof *H);
+  H->cookie    = HTONL(SAVED_STATE_COOKIE);
+  H->byteOrder = MAP_BYTE_ORDER;
+  H->version   = STATE_VERSION;
+  H->realSize  = sizeof(real);
+  n = numStateParams(NetInfo) +
+    (long long) Net->numGroups * numStateParams(GroupInfo);
+  H->numParams = (int) n;
+  H->numSets   = Root->numExampleSets;
+  FOR_EACH_SET(setBytes += stateSetBytes(S));
+  H->params  = STATE_ALIGN((long long) sizeof *H);
+  H->random  = H->params + STATE_ALIGN(n * sizeof(struct stateParam));
+  H->sets    = H->random + STATE_ALIGN((long long) sizeof(struct stateRandom));
+  H->weights = H->sets + STATE_ALIGN(setBytes);
+  H->size    = H->weights + weightMapSize(3);
+
+  image = (char *) safeCalloc(H->size, 1, "saveState:image");
+  memcpy(image, H, sizeof *H);
+  P = addStateParams((StateParam) (image + H->params), NetInfo, (char *) Net,
+		     -1);
+  FOR_EACH_GROUP(P = addStateParams(P, GroupInfo, (char *) G, g));
+  saveRandState(&((StateRandom) (image + H->random))->rand);
+  saveRandomState(((StateRandom) (image + H->random))->random);
+  rec = image + H->sets;
+  FOR_EACH_SET({
+    T = (StateSet) rec;
+    T->nameLength = strlen(S->name);
+    T->numExamples = S->numExamples;
+    T->currentExampleNum = S->currentExampleNum;
+    T->permuted = (S->permuted && S->numExamples > 0);
+    rec += sizeof *T;
+    strcpy(rec, S->name);
+    rec += STATE_PAD(T->nameLength + 1);
+    if (T->permuted) {
+      num = (int *) rec;
+      for (i = 0; i < S->numExamples; i++) num[i] = S->permuted[i]->num;
+      rec += STATE_PAD(S->numExamples * sizeof(int));
+    }
+  });
+  copyWeightMap(image + H->weights, 3, NULL);
+
+  /* The file is renamed into place so a partial one never replaces it. */
+  tempObj = Tcl_ObjPrintf("%s.tmp", fileName);
+  Tcl_IncrRefCount(tempObj);
+  if (!(channel = writeChannel(tempObj, FALSE))) {
+    Tcl_DecrRefCount(tempObj);
+    FREE(image);
+    return warning("saveState: couldn't open the file \"%s.tmp\"", fileName);
+  }
+  binaryEncoding(channel);
+  Tcl_SetChannelBufferSize(channel, 1 << 20);
+  for (s = image, n = H->size, failed = FALSE; n > 0 && !failed;
+       s += i, n -= i) {
+    i = (n > (1 << 30)) ? (1 << 30) : (int) n;
+    failed = (Tcl_Write(channel, s, i) != i);
+  }
+  if (Tcl_Flush(channel) != TCL_OK) failed = TRUE;
+  closeChannel(channel);
+  FREE(image);
+  if (!failed && Tcl_FSRenameFile(tempObj, fileNameObj)) failed = TRUE;
+  if (failed) Tcl_FSDeleteFile(tempObj);
+  Tcl_DecrRefCount(tempObj);
+  if (failed)
+    return warning("saveState: error writing the file \"%s\"", fileName);
+  return TCL_OK;
+}
+
+/* Link derivs are cleared at the start of each batch, so the state is only
+   complete between updates.  If saveState is called by a proc or a signal
+   while training is in the middle of one, the file is written once
+   finishUpdate() is called after totalUpdates has been incremented. */
+static flag UpdateInProgress = FALSE;
+static Tcl_Obj *PendingState = NULL;
+
+flag saveState(Tcl_Obj *fileNameObj) {
+  const char *fileName = Tcl_GetStringFromObj(fileNameObj, NULL);
+  if (fileName[0] == '|' || fileName[0] == '-' ||
+      stringEndsIn(fileName, ".gz") || stringEndsIn(fileName, ".Z") ||
+      stringEndsIn(fileName, ".bz") || stringEndsIn(fileName, ".bz2"))
+    return warning("saveState: state files must be plain files, not \"%s\"",
+		   fileName);
+  if (!UpdateInProgress) return writeState(fileNameObj);
+  Tcl_IncrRefCount(fileNameObj);
+  if (PendingState) Tcl_DecrRefCount(PendingState);
+  PendingState = fileNameObj;
+  return TCL_OK;
+}
+
+void startUpdate(void) {
+  UpdateInProgress = TRUE;
+}
+
+void finishUpdate(void) {
+  Tcl_Obj *fileNameObj = PendingState;
+  Tcl_InterpState state;
+  UpdateInProgress = FALSE;
+  if (!fileNameObj) return;
+  PendingState = NULL;
+  state = Tcl_SaveInterpState(Interp, TCL_OK);
+  if (Net && writeState(fileNameObj))
+    error("%s", Tcl_GetStringResult(Interp));
+  Tcl_RestoreInterpState(Interp, state);
+  Tcl_DecrRefCount(fileNameObj);
+}
+
+/* This returns what is wrong with the header and example set records of a
+   state file, or NULL.  The weight image is checked when it is loaded. */
+static char *badState(char *data, long long size) {
+  StateHeader H = (StateHeader) data;
+  StateSet T;
+  char *s, *end;
+  int i, e, *num;
+
+  if (size < (long long) sizeof *H || NTOHL(H->cookie) != SAVED_STATE_COOKIE)
+    return "missing cookie";
+  if (H->byteOrder != MAP_BYTE_ORDER)
+    return "file was written on a machine with a different byte order";
+  if (H->version != STATE_VERSION) return "unknown version";
+  if (H->realSize != sizeof(real)) return "sizeof(real) doesn't match";
+  if (H->size != size || H->numParams < 0 || H->numSets < 0 ||
+      H->params != STATE_ALIGN((long long) sizeof *H) ||
+      H->random != H->params +
+      STATE_ALIGN((long long) H->numParams * sizeof(struct stateParam)) ||
+      H->sets != H->random +
+      STATE_ALIGN((long long) sizeof(struct stateRandom)) ||
+      H->weights < H->sets || H->weights > size || H->weights % 64)
+    return "size doesn't match the header";
+  for (i = 0; i < H->numParams; i++)
+    if (((StateParam) (data + H->params))[i].name[STATE_NAME_LENGTH - 1])
+      return "bad parameter name";
+  s = data + H->sets;
+  end = data + H->weights;
+  for (i = 0; i < H->numSets; i++) {
+    T = (StateSet) s;
+    if (end - s < (long long) sizeof *T) return "example sets are cut off";
+    s += sizeof *T;
+    if (T->nameLength < 0 || T->numExamples < 0 ||
+	end - s < STATE_PAD((long long) T->nameLength + 1) ||
+	s[T->nameLength])
+      return "bad example set name";
+    s += STATE_PAD(T->nameLength + 1);
+    if (T->permuted) {
+      if (end - s < STATE_PAD((long long) T->numExamples * sizeof(int)))
+	return "example sets are cut off";
+      num = (int *) s;
+      for (e = 0; e < T->numExamples; e++)
+	if (num[e] < 0 || num[e] >= T->numExamples)
+	  return "bad example order";
+      s += STATE_PAD((long long) T->numExamples * sizeof(int));
+    }
+  }
+  return NULL;
+}
+
+static void loadStateParam(StateParam P) {
+  ObjInfo O = (P->group < 0) ? NetInfo : GroupInfo;
+  char *object;
+  MemInfo M;
+  if (P->group >= Net->numGroups) return;
+  if (!(M = lookupMember(P->name, O)) || !isStateParam(M) ||
+      P->size != ((M->info == IntInfo) ? sizeof(int) : sizeof(real)))
+    return;
+  object = (P->group < 0) ? (char *) Net : (char *) Net->group[P->group];
+  memcpy(object + M->offset, P->value, P->size);
+}
+
+/* Example sets are matched by name and only restored if they have the same
+   number of examples.  Nothing is changed unless the whole file checks out
+   and its links match the network. */
+flag loadState(Tcl_Obj *fileNameObj) {
+  const char *fileName = Tcl_GetStringFromObj(fileNameObj, NULL);
+  StateHeader H;
+  StateParam P;
+  StateSet T;
+  ExampleSet S;
+  char *data, *s, *problem;
+  size_t size;
+  int i, e, *num;
+
+  if (!(data = mapFile(fileNameObj, &size)))
+    return warning("loadState: couldn't map the file \"%s\", state files "
+		   "can't be compressed", fileName);
+  if ((problem = badState(data, (long long) size))) {
+    unmapFile(data, size);
+    return warning("loadState: %s in the file \"%s\"", problem, fileName);
+  }
+  H = (StateHeader) data;
+  if (loadWeightMap(data + H->weights, H->size - H->weights, "loadState",
+		    fileName, TRUE, TRUE)) {
+    unmapFile(data, size);
+    return TCL_ERROR;
+  }
+
+  for (i = 0, P = (StateParam) (data + H->params); i < H->numParams; i++)
+    loadStateParam(P + i);
+  restoreRandState(&((StateRandom) (data + H->random))->rand);
+  restoreRandomState(((StateRandom) (data + H->random))->random);
+  s = data + H->sets;
+  for (i = 0; i < H->numSets; i++) {
+    T = (StateSet) s;
+    s += sizeof *T;
+    S = lookupExampleSet(s);
+    s += STATE_PAD(T->nameLength + 1);
+    num = (int *) s;
+    if (T->permuted) s += STATE_PAD((long long) T->numExamples * sizeof(int));
+    if (!S || S->numExamples != T->numExamples ||
+	T->currentExampleNum < -1 || T->currentExampleNum >= S->numExamples)
+      continue;
+    S->currentExampleNum = T->currentExampleNum;
+    if (T->permuted && S->permuted)
+      for (e = 0; e < S->numExamples; e++)
+	S->permuted[e] = S->example[num[e]];
+  }
+  unmapFile(data, size);
+  return TCL_OK;
+}
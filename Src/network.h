@@ -6,8 +6,11 @@ typedef struct group     *Group;
 typedef struct groupProc *GroupProc;
 typedef struct unit      *Unit;
 typedef struct block     *Block;
-typedef struct link      *Link;
-typedef struct link2     *Link2;
+typedef struct sparseIndex *SparseIndex;
+typedef struct liveIndex *LiveIndex;
+typedef struct netPlan   *NetPlan;
+typedef struct checkpoints *Checkpoints;
+typedef struct outputWriter *OutputWriter;
 typedef struct rootrec   *RootRec;
 
 #include <stdlib.h>
@@ -44,6 +47,8 @@ struct network {
   int        numLinks;
   NetExt     ext;
   RootRec    root;
+  NetPlan    plan;                     /* hidden */
+  Checkpoints checkpoints;             /* hidden */
 
   ExampleSet trainingSet;
   ExampleSet testingSet;
@@ -53,6 +58,10 @@ struct network {
   int        ticksPerInterval;
   int        maxTicks;
   int        historyLength;
+  int        checkpointTicks;
+  int        streamTicks;
+  int        streamOverlap;
+  flag       streamUpdates;
   int        backpropTicks;
 
   int        totalUpdates;
@@ -70,6 +79,10 @@ struct network {
 
   int        numUpdates;
   int        batchSize;
+  int        numThreads;
+  int        threadUnits;
+  int        threadLinks;
+  real       sparseFraction;
   int        reportInterval;
   real       criterion;
   real       trainGroupCrit;
@@ -153,6 +166,10 @@ struct network {
   char      *outputFileName;
   Tcl_Channel outputFile;               /* hidden */
   flag       binaryOutputFile;
+  flag       columnarOutputFile;
+  flag       compressedOutputFile;
+  int        outputFlushInterval;
+  OutputWriter outputWriter;            /* hidden */
 
   /* Update and training functions (all hidden). */
   flag     (*netTrain)(void);
@@ -195,11 +212,28 @@ struct group {
   Network    net;
   int        numUnits;
   Unit       unit;
+  real      *input;
   real      *output;
+  real      *target;
+  real      *externalInput;
+  real      *adjustedTarget;
+  real      *inputDeriv;
   real      *outputDeriv;
+  real      *outputCache;                     /* hidden */
+  real      *outputDerivCache;                /* hidden */
+  real      *inputHistory;                    /* hidden */
+  real      *outputHistory;                   /* hidden */
+  real      *targetHistory;                   /* hidden */
+  real      *outputDerivHistory;              /* hidden */
   int        numIncoming;
   int        numOutgoing;
   GroupExt   ext;
+  int        denseIncoming;                   /* hidden */
+  real      *linkMatrix;                      /* hidden */
+  SparseIndex sparseIndex;                    /* hidden */
+  LiveIndex  liveIndex;                       /* hidden */
+  Unit      *liveUnit;                        /* hidden */
+  int        numLive;                         /* hidden */
 
   real       trainGroupCrit;
   real       testGroupCrit;
@@ -274,24 +308,15 @@ struct unit {
   int        numBlocks;
   Block      block;
   int        numIncoming;
-  Link       incoming;
-  Link2      incoming2;
+  real      *weight;
+  real      *deriv;
+  real      *lastWeightDelta;
+#ifdef ADVANCED
+  real      *lastValue;
+#endif /* ADVANCED */
   int        numOutgoing;
   UnitExt    ext;
 
-  real       input;
-  real       output;
-  real       target;
-  real       externalInput;
-  real       adjustedTarget;
-  real       inputDeriv;
-  real       outputDeriv;
-
-  real      *inputHistory;
-  real      *outputHistory;
-  real      *targetHistory;
-  real      *outputDerivHistory;
-
   real       gain;
   real       gainDeriv;
   real       dtScale;
@@ -320,21 +345,17 @@ struct block {
 };
 
 
-/* Keep this as small as possible.  It is most of the memory usage. */
-struct link {
-  real       weight;
-  real       deriv;
-};
-
-struct link2 {
-  real       lastWeightDelta;
+/* The values of a unit's incoming links are kept in parallel arrays, one
+   per field, in a single block starting at U->weight.  Keep this as small as
+   possible.  It is most of the memory usage. */
 #ifdef ADVANCED
-  real       lastValue;
+#define LINK_VALUES 4
+#else
+#define LINK_VALUES 3
 #endif /* ADVANCED */
-};
 
 
-extern Network Net;              /* This is the current network */
+extern THREAD_LOCAL Network Net; /* This is the current network */
 extern RootRec Root;             /* Holds the arrays of networks and sets */
 
 
@@ -385,10 +406,20 @@ extern RootRec Root;             /* Holds the arrays of networks and sets */
   }}
 
 
+/* A lesioned group lists its live units once the network's plan has been
+   compiled.  Lesioning or healing a unit leaves the list in place but marks
+   it out of date, with numLive -1, so loops that are already running it are
+   not disturbed.  Until it is rebuilt, the lesioned units are tested for. */
+#define LIVE_UNITS(G) ((G)->liveUnit && (G)->numLive >= 0)
+
 #define FOR_EACH_UNIT(G, proc) {\
   Unit U; Unit sU;\
   if (G->type & LESIONED) {\
-    for (U = G->unit, sU = U + G->numUnits; U < sU; U++)\
+    if (LIVE_UNITS(G)) {\
+      Unit *_L; Unit *_sL;\
+      for (_L = G->liveUnit, _sL = _L + G->numLive; _L < _sL; _L++)\
+	{U = *_L; proc;}\
+    } else for (U = G->unit, sU = U + G->numUnits; U < sU; U++)\
       if (!(U->type & LESIONED)) {proc;}\
   } else {\
     for (U = G->unit, sU = U + G->numUnits; U < sU; U++)\
@@ -397,7 +428,11 @@ extern RootRec Root;             /* Holds the arrays of networks and sets */
 #define FOR_EACH_UNIT2(G, proc) {\
   int u; Unit U; Unit sU;\
   if (G->type & LESIONED) {\
-    for (u = 0, U = G->unit, sU = U + G->numUnits; U < sU; u++, U++)\
+    if (LIVE_UNITS(G)) {\
+      Unit *_L; Unit *_sL;\
+      for (_L = G->liveUnit, _sL = _L + G->numLive; _L < _sL; _L++)\
+	{U = *_L; u = U - G->unit; proc;}\
+    } else for (u = 0, U = G->unit, sU = U + G->numUnits; U < sU; u++, U++)\
       if (!(U->type & LESIONED)) {proc;}\
   } else {\
     for (u = 0, U = G->unit, sU = U + G->numUnits; U < sU; u++, U++)\
@@ -408,6 +443,16 @@ extern RootRec Root;             /* Holds the arrays of networks and sets */
   for (u = 0, U = G->unit, sU = U + G->numUnits; U < sU; u++, U++)\
     {proc;}}
 
+/* The units' input, output, target and derivative values are stored in
+   arrays in their group, one array per field, so loops over the units read
+   memory in order.  This is one unit's value of a field. */
+#define UNIT_VAL(U, field) ((U)->group->field[(U)->num])
+/* The array at the given offset in the group structure. */
+#define GROUP_FIELD(G, offset) (*(real **) ((char *) (G) + (offset)))
+#define UNIT_FIELD(U, offset) (GROUP_FIELD((U)->group, offset)[(U)->num])
+/* The link value array at the given offset in the unit structure. */
+#define LINK_FIELD(U, offset) (*(real **) ((char *) (U) + (offset)))
+
 #define FOR_EACH_UNIT_IN_LIST(_list, _proc) {\
   char *_l = _list; flag _code;\
   if (!strcmp(_list, "*")) {\
@@ -432,8 +477,8 @@ extern RootRec Root;             /* Holds the arrays of networks and sets */
     {proc;}}}
 
 #define FOR_EACH_LINK(U, proc) {\
-  Link L; Link sL;\
-  for (L = U->incoming, sL = L + U->numIncoming; L < sL; L++)\
+  int l;\
+  for (l = 0; l < U->numIncoming; l++)\
     {proc;}}
 
 
@@ -504,22 +549,16 @@ extern RootRec Root;             /* Holds the arrays of networks and sets */
 #define GET_HISTORY(U, array, index) \
      (((U)->array) ? (U)->array[index] : NaN)
 
+/* A group keeps the history of each unit field in one array, with a row of
+   numUnits values for each tick, so a tick is stored or restored at once. */
+#define HISTORY_ROW(G, array, index) ((G)->array + (index) * (G)->numUnits)
+#define SET_UNIT_HISTORY(U, array, index, value) \
+     if ((U)->group->array) \
+       HISTORY_ROW((U)->group, array, index)[(U)->num] = (value)
+#define GET_UNIT_HISTORY(U, array, index) \
+     (((U)->group->array) ? \
+      HISTORY_ROW((U)->group, array, index)[(U)->num] : NaN)
 
-#define STORE_TO_HISTORY(G, value, array, tick) {\
-  int index = HISTORY_INDEX(tick);\
-  FOR_EACH_UNIT(G, if (U->array) U->array[index] = U->value;)}
-
-#define STORE_TO_OTHER_HISTORY(G, value, H, array, tick) {\
-  int index = HISTORY_INDEX(tick);\
-  FOR_EACH_UNIT2(H, if (U->array) U->array[index] = G->unit[u].value;)}
-
-#define RESTORE_FROM_HISTORY(G, array, tick, value) {\
-  int index = HISTORY_INDEX(tick);\
-  FOR_EACH_UNIT(G, U->value = (U->array) ? U->array[index] : NaN;)}
-
-#define RESTORE_FROM_OTHER_HISTORY(G, array, tick, H, value) {\
-  int index = HISTORY_INDEX(tick);\
-  FOR_EACH_UNIT2(G, H->unit[u].value = (U->array) ? U->array[index] : NaN;)}
 
 #define SET_VALUES(G, value, val) {\
   FOR_EACH_UNIT(G, U->value = val);}
@@ -529,23 +568,6 @@ extern RootRec Root;             /* Holds the arrays of networks and sets */
     error("COPY_VALUES used with mis-matched groups");\
   FOR_EACH_UNIT2(F, T->unit[u].valueT = U->valueF);}
 
-#define COPY_HISTORY(F, arrayF, tickF, T, arrayT, tickT) {\
-  int indexF = HISTORY_INDEX(tickF), indexT = HISTORY_INDEX(tickF);\
-  if (F->numUnits > T->numUnits)\
-    error("COPY_HISTORY used with mis-matched groups");\
-  FOR_EACH_UNIT2(F, T->unit[u].arrayT[indexT] = U->arrayF[indexF]);}
-
-#define CLEAR_HISTORY(G, tick) {\
-  int index = HISTORY_INDEX(tick);\
-  FOR_EACH_UNIT(G, SET_HISTORY(U, outputHistory, index, NaN));\
-  if (G->costType & ERROR_MASKS)\
-    FOR_EACH_UNIT(G, SET_HISTORY(U, targetHistory, index, NaN));}
-
-#define STORE_HISTORY(G, tick) {\
-  STORE_TO_HISTORY(G, output, outputHistory, tick);\
-  if (G->costType & ERROR_MASKS)\
-    STORE_TO_HISTORY(G, target, targetHistory, tick);}
-
 #define RUN_PROC(proc) {\
   if (Net->proc && Tcl_EvalObjEx(Interp, Net->proc, TCL_EVAL_GLOBAL) \
     != TCL_OK) return error(Tcl_GetStringResult(Interp));}
@@ -574,6 +596,8 @@ extern flag addNet(char *name, mask type, int numTimeIntervals,
 		   int numTicksPerInterval);
 extern flag setTime(Network N, int numTimeIntervals, int numTicksPerInterval,
 		    int historyLength, flag setDT);
+extern flag setCheckpointTicks(Network N, int ticks, real megabytes);
+extern flag setStreamTicks(Network N, int ticks, int overlap);
 extern flag orderGroups(int argc, char *argv[]);
 extern flag orderGroupsObj(int objc, Tcl_Obj *objv[]);
 extern flag deleteGroup(Group G);
@@ -587,10 +611,17 @@ extern flag resetDerivs(void);
 
 extern flag lesionUnit(Unit U);
 extern flag healUnit(Unit U);
+extern void buildLiveUnits(Group G);
 #ifdef JUNK
 extern flag printGroupUnitValues(Tcl_Channel channel, Group G, int *field,
 				 char **format, int numFields);
 #endif
 extern flag optimizeNet(void);
+extern Network cloneNet(void);
+extern void freeNetClone(Network N);
+extern flag saveState(Tcl_Obj *fileNameObj);
+extern void startUpdate(void);
+extern void finishUpdate(void);
+extern flag loadState(Tcl_Obj *fileNameObj);
 
 #endif /* NETWORK_H */
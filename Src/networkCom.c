@@ -352,6 +352,20 @@ int C_orderGroups(TCL_CMDARGS) {
   return signalNetStructureChanged();
 }
 
+int C_compileNet(TCL_CMDARGS) {
+  const char *usage = "compileNet";
+  const char *commandName = Tcl_GetStringFromObj(objv[0], NULL);
+  if (objc == 2 && !strcmp(Tcl_GetStringFromObj(objv[1], NULL), "-h"))
+    return commandHelp(commandName);
+  if (objc != 1)
+    return usageError(commandName, usage);
+  if (!Net) return warning("%s: no current network", commandName);
+
+  result("");
+  appendNetPlan();
+  return TCL_OK;
+}
+
 int C_deleteNets(TCL_CMDARGS) {
   Network N;
   flag code;
@@ -401,10 +415,14 @@ int C_deleteGroups(TCL_CMDARGS) {
 }
 
 int C_setTime(TCL_CMDARGS) {
-  int timeIntervals, ticksPerInterval, historyLength = -1, arg;
-  flag setDT = -1;
+  int timeIntervals, ticksPerInterval, historyLength = -1, arg,
+    checkpointTicks = 0, streamTicks, streamOverlap;
+  double megabytes = 0.0;
+  flag setDT = -1, checkpoint = FALSE, stream = FALSE;
   const char *usage = "setTime [-intervals <timeIntervals> |\n"
-    "\t-ticks <ticksPerInterval> | -history <historyLength> | -dtfixed]";
+    "\t-ticks <ticksPerInterval> | -history <historyLength> | -dtfixed |\n"
+    "\t-checkpoint <checkpointTicks> | -memory <megabytes> |\n"
+    "\t-stream <streamTicks> | -overlap <streamOverlap>]";
   const char *commandName = Tcl_GetStringFromObj(objv[0], NULL);
   if (objc == 2 && !strcmp(Tcl_GetStringFromObj(objv[1], NULL), "-h"))
     return commandHelp(commandName);
@@ -419,6 +437,8 @@ int C_setTime(TCL_CMDARGS) {
 		  Net->ticksPerInterval, Net->historyLength);
   timeIntervals = Net->timeIntervals;
   ticksPerInterval = Net->ticksPerInterval;
+  streamTicks = Net->streamTicks;
+  streamOverlap = Net->streamOverlap;
 
   for (arg = 1; arg < objc && Tcl_GetStringFromObj(objv[arg], NULL)[0] == '-'; arg++) {
     switch (Tcl_GetStringFromObj(objv[arg], NULL)[1]) {
@@ -438,14 +458,49 @@ int C_setTime(TCL_CMDARGS) {
     case 'd':
       setDT = FALSE;
       break;
+    case 'c':
+      if (++arg >= objc) return usageError(commandName, usage);
+      Tcl_GetIntFromObj(interp, objv[arg], &checkpointTicks);
+      checkpoint = TRUE;
+      break;
+    case 'm':
+      if (++arg >= objc) return usageError(commandName, usage);
+      Tcl_GetDoubleFromObj(interp, objv[arg], &megabytes);
+      checkpointTicks = -1;
+      checkpoint = TRUE;
+      break;
+    case 's':
+      if (++arg >= objc) return usageError(commandName, usage);
+      Tcl_GetIntFromObj(interp, objv[arg], &streamTicks);
+      stream = TRUE;
+      break;
+    case 'o':
+      if (++arg >= objc) return usageError(commandName, usage);
+      Tcl_GetIntFromObj(interp, objv[arg], &streamOverlap);
+      stream = TRUE;
+      break;
     default: return usageError(commandName, usage);
     }
   }
   if (arg != objc) return usageError(commandName, usage);
   if (setDT == -1) setDT = FALSE;
 
+  /* Checkpoints and streaming stay on until the history length is set. */
+  if (historyLength >= 0) Net->checkpointTicks = Net->streamTicks = 0;
+  else if (!checkpoint && !stream) {
+    if (Net->checkpointTicks > 0) {
+      checkpointTicks = Net->checkpointTicks;
+      checkpoint = TRUE;
+    } else if (Net->streamTicks > 0) stream = TRUE;
+  }
+  if (checkpoint || stream) historyLength = Net->historyLength;
+
   if (setTime(Net, timeIntervals, ticksPerInterval, historyLength, setDT))
     return TCL_ERROR;
+  if (checkpoint && setCheckpointTicks(Net, checkpointTicks, megabytes))
+    return TCL_ERROR;
+  if (stream && setStreamTicks(Net, streamTicks, streamOverlap))
+    return TCL_ERROR;
   if (signalNetStructureChanged()) return TCL_ERROR;
   return result("%d %d %d", Net->timeIntervals,
 		Net->ticksPerInterval, Net->historyLength);
@@ -471,30 +526,31 @@ int C_setHistoryLength(TCL_CMDARGS) {
 }
 #endif
 
+/* This returns the offset of a unit value array in the group structure. */
 static flag unitOffset(char *name, int *offsetp, const char *command) {
-  Unit U;
+  Group G;
   int offset;
 
   switch (name[0]) {
   case 'i':
     if (subString(name, "inputDeriv", 6)) {
-      offset = OFFSET(U, inputDeriv);
+      offset = OFFSET(G, inputDeriv);
     } else {
-      offset = OFFSET(U, input);
+      offset = OFFSET(G, input);
     }
     break;
   case 'o':
     if (subString(name, "outputDeriv", 7)) {
-      offset = OFFSET(U, outputDeriv);
+      offset = OFFSET(G, outputDeriv);
     } else {
-      offset = OFFSET(U, output);
+      offset = OFFSET(G, output);
     }
     break;
   case 't':
-    offset = OFFSET(U, target);
+    offset = OFFSET(G, target);
     break;
   case 'e':
-    offset = OFFSET(U, externalInput);
+    offset = OFFSET(G, externalInput);
     break;
   default:
     return warning("%s: unrecognized unit field: %s\n", command, name);
@@ -538,7 +594,7 @@ int C_copyUnitValues(TCL_CMDARGS) {
 }
 
 int C_resetUnitValues(TCL_CMDARGS) {
-  Unit U;
+  Group G;
   int offset;
   real value = 0.0;
   double tempDbl;
@@ -553,11 +609,11 @@ int C_resetUnitValues(TCL_CMDARGS) {
     if (Tcl_GetStringFromObj(objv[2], NULL)[0] != '-')
       return usageError(commandName, usage);
     if (unitOffset(Tcl_GetStringFromObj(objv[2], NULL) + 1, &offset, commandName)) return TCL_ERROR;
-    if (offset == OFFSET(U, input) || offset == OFFSET(U, output) ||
-	offset == OFFSET(U, target))
+    if (offset == OFFSET(G, input) || offset == OFFSET(G, output) ||
+	offset == OFFSET(G, target))
       value = NaN;
   } else {
-    offset = OFFSET(U, output);
+    offset = OFFSET(G, output);
     value = NaN;
   }
   if (objc > 3) Tcl_GetDoubleFromObj(interp, objv[3], &tempDbl);
@@ -565,13 +621,13 @@ int C_resetUnitValues(TCL_CMDARGS) {
 
   FOR_EACH_GROUP_IN_LIST(Tcl_GetStringFromObj(objv[1], NULL), {
     if (isNaN(value)) {
-      if (offset == OFFSET(U, input))
+      if (offset == OFFSET(G, input))
 	value = chooseValue(G->initInput, Net->initInput);
       else
 	value = chooseValue(G->initOutput, Net->initOutput);
     }
     if (setUnitValues(G, offset, value)) return TCL_ERROR;
-    if (offset == OFFSET(U, output)) cacheOutputs(G);
+    if (offset == OFFSET(G, output)) cacheOutputs(G);
   });
 
   return TCL_OK;
@@ -640,7 +696,7 @@ int C_polarity(TCL_CMDARGS) {
     FOR_EACH_GROUP_IN_LIST(Tcl_GetStringFromObj(objv[2], NULL), {
       scale = 1.0 / (G->maxOutput - G->minOutput);
       FOR_EACH_UNIT(G, {
-        real x = (U->output - G->minOutput) * scale;
+        real x = (UNIT_VAL(U, output) - G->minOutput) * scale;
         real d = (x <= 0 || x >= 1) ? 1.0 :
           (x * LOG(x) + (1.0-x)*LOG(1.0-x)) / LOG(2) + 1.0;
         G->polaritySum += d;
@@ -661,6 +717,32 @@ int C_polarity(TCL_CMDARGS) {
   return TCL_OK;
 }
 
+int C_saveState(TCL_CMDARGS) {
+  const char *commandName = Tcl_GetStringFromObj(objv[0], NULL);
+  const char *usage = "saveState <file-name>";
+  if (objc == 2 && !strcmp(Tcl_GetStringFromObj(objv[1], NULL), "-h"))
+    return commandHelp(commandName);
+  if (objc != 2) return usageError(commandName, usage);
+  if (!Net) return warning("%s: no current network", commandName);
+
+  if (saveState(objv[1])) return TCL_ERROR;
+  return result(Tcl_GetStringFromObj(objv[1], NULL));
+}
+
+int C_loadState(TCL_CMDARGS) {
+  const char *commandName = Tcl_GetStringFromObj(objv[0], NULL);
+  const char *usage = "loadState <file-name>";
+  if (objc == 2 && !strcmp(Tcl_GetStringFromObj(objv[1], NULL), "-h"))
+    return commandHelp(commandName);
+  if (objc != 2) return usageError(commandName, usage);
+  if (!Net) return warning("%s: no current network", commandName);
+
+  if (loadState(objv[1])) return TCL_ERROR;
+  if (updateUnitDisplay()) return TCL_ERROR;
+  if (updateLinkDisplay()) return TCL_ERROR;
+  return result(Tcl_GetStringFromObj(objv[1], NULL));
+}
+
 void registerNetworkCommands(void) {
   registerCommand((Tcl_ObjCmdProc *)C_addNet, "addNet",
 		  "creates a new network and makes it the active network");
@@ -672,10 +754,16 @@ void registerNetworkCommands(void) {
 		  "adds a group to the active network");
   registerCommand((Tcl_ObjCmdProc *)C_orderGroups, "orderGroups",
 		  "sets the order in which groups are updated");
+  registerCommand((Tcl_ObjCmdProc *)C_compileNet, "compileNet",
+		  "rebuilds and describes the plan the network runs each tick");
   registerCommand((Tcl_ObjCmdProc *)C_deleteNets, "deleteNets",
 		  "deletes a list of networks or the active network");
   registerCommand((Tcl_ObjCmdProc *)C_deleteGroups, "deleteGroups",
 		  "deletes a list of groups from the active network");
+  registerCommand((Tcl_ObjCmdProc *)C_saveState, "saveState",
+		  "saves the network's training state in a file");
+  registerCommand((Tcl_ObjCmdProc *)C_loadState, "loadState",
+		  "restores the network's training state from a file");
   registerCommand((Tcl_ObjCmdProc *)NULL, "", "");
 
   registerCommand((Tcl_ObjCmdProc *)C_groupType, "groupType",
@@ -139,6 +139,14 @@ static void initNetInfo(void) {
 	    0, 0, IntInfo);
   addMember(NetInfo, "historyLength", OBJ, OFFSET(N, historyLength), FALSE,
 	    0, 0, IntInfo);
+  addMember(NetInfo, "checkpointTicks", OBJ, OFFSET(N, checkpointTicks),
+	    FALSE, 0, 0, IntInfo);
+  addMember(NetInfo, "streamTicks", OBJ, OFFSET(N, streamTicks), FALSE,
+	    0, 0, IntInfo);
+  addMember(NetInfo, "streamOverlap", OBJ, OFFSET(N, streamOverlap), FALSE,
+	    0, 0, IntInfo);
+  addMember(NetInfo, "streamUpdates", OBJ, OFFSET(N, streamUpdates), TRUE,
+	    0, 0, FlagInfo);
   addMember(NetInfo, "backpropTicks", OBJ, OFFSET(N, backpropTicks), TRUE,
 	    0, 0, IntInfo);
   addSpacer(NetInfo);
@@ -171,6 +179,14 @@ static void initNetInfo(void) {
 	    0, 0, IntInfo);
   addMember(NetInfo, "batchSize", OBJ, OFFSET(N, batchSize), TRUE,
 	    0, 0, IntInfo);
+  addMember(NetInfo, "numThreads", OBJ, OFFSET(N, numThreads), TRUE,
+	    0, 0, IntInfo);
+  addMember(NetInfo, "threadUnits", OBJ, OFFSET(N, threadUnits), TRUE,
+	    0, 0, IntInfo);
+  addMember(NetInfo, "threadLinks", OBJ, OFFSET(N, threadLinks), TRUE,
+	    0, 0, IntInfo);
+  addMember(NetInfo, "sparseFraction", OBJ, OFFSET(N, sparseFraction), TRUE,
+	    0, 0, RealInfo);
   addMember(NetInfo, "reportInterval", OBJ, OFFSET(N, reportInterval), TRUE,
 	    0, 0, IntInfo);
   addMember(NetInfo, "criterion", OBJ, OFFSET(N, criterion), TRUE,
@@ -288,6 +304,12 @@ static void initNetInfo(void) {
 	    0, 0, StringInfo);
   addMember(NetInfo, "binaryOutputFile", OBJ, OFFSET(N, binaryOutputFile),
 	    FALSE, 0, 0, FlagInfo);
+  addMember(NetInfo, "columnarOutputFile", OBJ,
+	    OFFSET(N, columnarOutputFile), FALSE, 0, 0, FlagInfo);
+  addMember(NetInfo, "compressedOutputFile", OBJ,
+	    OFFSET(N, compressedOutputFile), FALSE, 0, 0, FlagInfo);
+  addMember(NetInfo, "outputFlushInterval", OBJ,
+	    OFFSET(N, outputFlushInterval), TRUE, 0, 0, IntInfo);
 }
 
 /*****************************************************************************/
@@ -330,8 +352,18 @@ static void initGroupInfo(void) {
 	    0, 0, IntInfo);
   addMember(GroupInfo, "unit", OBJA, OFFSET(G, unit), FALSE,
 	    getGroupNumUnits, 0, UnitInfo);
+  addMember(GroupInfo, "input", OBJA, OFFSET(G, input), TRUE,
+	    getGroupNumUnits, 0, RealInfo);
   addMember(GroupInfo, "output", OBJA, OFFSET(G, output), TRUE,
 	    getGroupNumUnits, 0, RealInfo);
+  addMember(GroupInfo, "target", OBJA, OFFSET(G, target), TRUE,
+	    getGroupNumUnits, 0, RealInfo);
+  addMember(GroupInfo, "externalInput", OBJA, OFFSET(G, externalInput), TRUE,
+	    getGroupNumUnits, 0, RealInfo);
+  addMember(GroupInfo, "adjustedTarget", OBJA, OFFSET(G, adjustedTarget), TRUE,
+	    getGroupNumUnits, 0, RealInfo);
+  addMember(GroupInfo, "inputDeriv", OBJA, OFFSET(G, inputDeriv), TRUE,
+	    getGroupNumUnits, 0, RealInfo);
   addMember(GroupInfo, "outputDeriv", OBJA, OFFSET(G, outputDeriv), TRUE,
 	    getGroupNumUnits, 0, RealInfo);
   addMember(GroupInfo, "numIncoming", OBJ, OFFSET(G, numIncoming), FALSE,
@@ -474,9 +506,13 @@ int getUnitHistoryLength(void *u) {
   if (U->group && U->group->net) return U->group->net->historyLength;
   else return 0;
 }
+int getUnitGroupUnits(void *U) {
+  return ((Unit) U)->group->numUnits;
+}
 
 static void initUnitInfo(void) {
   Unit U;
+  Group G;
   addMember(UnitInfo, "name", OBJ, OFFSET(U, name), TRUE,
 	    0, 0, StringInfo);
   addMember(UnitInfo, "num", OBJ, OFFSET(U, num), FALSE,
@@ -493,9 +529,9 @@ static void initUnitInfo(void) {
 	    getUnitNumBlocks, 0, BlockInfo);
   addMember(UnitInfo, "numIncoming", OBJ, OFFSET(U, numIncoming), FALSE,
 	    0, 0, IntInfo);
-  addMember(UnitInfo, "incoming", OBJA, OFFSET(U, incoming), FALSE,
+  addMember(UnitInfo, "incoming", OBJA, OFFSET(U, weight), FALSE,
 	    getUnitNumIncoming, 0, LinkInfo);
-  addMember(UnitInfo, "incoming2", OBJA, OFFSET(U, incoming2), FALSE,
+  addMember(UnitInfo, "incoming2", OBJA, OFFSET(U, weight), FALSE,
 	    getUnitNumIncoming, 0, Link2Info);
   addMember(UnitInfo, "numOutgoing", OBJ, OFFSET(U, numOutgoing), FALSE,
 	    0, 0, IntInfo);
@@ -503,31 +539,31 @@ static void initUnitInfo(void) {
 	    0, 0, UnitExtInfo);
   addSpacer(UnitInfo);
 
-  addMember(UnitInfo, "input", OBJ, OFFSET(U, input), TRUE,
+  addMember(UnitInfo, "input", OBJU, OFFSET(G, input), TRUE,
 	    0, 0, RealInfo);
-  addMember(UnitInfo, "output", OBJ, OFFSET(U, output), TRUE,
+  addMember(UnitInfo, "output", OBJU, OFFSET(G, output), TRUE,
 	    0, 0, RealInfo);
-  addMember(UnitInfo, "target", OBJ, OFFSET(U, target), TRUE,
+  addMember(UnitInfo, "target", OBJU, OFFSET(G, target), TRUE,
 	    0, 0, RealInfo);
-  addMember(UnitInfo, "externalInput", OBJ, OFFSET(U, externalInput), TRUE,
+  addMember(UnitInfo, "externalInput", OBJU, OFFSET(G, externalInput), TRUE,
 	    0, 0, RealInfo);
-  addMember(UnitInfo, "adjustedTarget", OBJ, OFFSET(U, adjustedTarget), TRUE,
+  addMember(UnitInfo, "adjustedTarget", OBJU, OFFSET(G, adjustedTarget), TRUE,
 	    0, 0, RealInfo);
-  addMember(UnitInfo, "inputDeriv", OBJ, OFFSET(U, inputDeriv), TRUE,
+  addMember(UnitInfo, "inputDeriv", OBJU, OFFSET(G, inputDeriv), TRUE,
 	    0, 0, RealInfo);
-  addMember(UnitInfo, "outputDeriv", OBJ, OFFSET(U, outputDeriv), TRUE,
+  addMember(UnitInfo, "outputDeriv", OBJU, OFFSET(G, outputDeriv), TRUE,
 	    0, 0, RealInfo);
   addSpacer(UnitInfo);
 
-  addMember(UnitInfo, "inputHistory", OBJA, OFFSET(U, inputHistory), TRUE,
-	    getUnitHistoryLength, 0, RealInfo);
-  addMember(UnitInfo, "outputHistory", OBJA, OFFSET(U, outputHistory), TRUE,
-	    getUnitHistoryLength, 0, RealInfo);
-  addMember(UnitInfo, "targetHistory", OBJA, OFFSET(U, targetHistory), TRUE,
-	    getUnitHistoryLength, 0, RealInfo);
-  addMember(UnitInfo, "outputDerivHistory", OBJA,
-	    OFFSET(U, outputDerivHistory), TRUE, getUnitHistoryLength, 0,
-	    RealInfo);
+  addMember(UnitInfo, "inputHistory", OBJUA, OFFSET(G, inputHistory), TRUE,
+	    getUnitHistoryLength, getUnitGroupUnits, RealInfo);
+  addMember(UnitInfo, "outputHistory", OBJUA, OFFSET(G, outputHistory), TRUE,
+	    getUnitHistoryLength, getUnitGroupUnits, RealInfo);
+  addMember(UnitInfo, "targetHistory", OBJUA, OFFSET(G, targetHistory), TRUE,
+	    getUnitHistoryLength, getUnitGroupUnits, RealInfo);
+  addMember(UnitInfo, "outputDerivHistory", OBJUA,
+	    OFFSET(G, outputDerivHistory), TRUE, getUnitHistoryLength,
+	    getUnitGroupUnits, RealInfo);
   addSpacer(UnitInfo);
 
   addMember(UnitInfo, "gain", OBJ, OFFSET(U, gain), TRUE,
@@ -589,31 +625,34 @@ static void initBlockInfo(void) {
 }
 
 /*****************************************************************************/
+/* A link is named by its place in the unit's weight array.  Its other values
+   are found at the same place in the unit's other link arrays. */
 static void linkName(void *link, char *dest) {
-  Link L = (Link) link;
-  if (L) sprintf(dest, "%g", L->weight);
+  real *W = (real *) link;
+  if (W) sprintf(dest, "%g", *W);
 }
 
 static void initLinkInfo(void) {
-  Link L;
-  addMember(LinkInfo, "weight", OBJ, OFFSET(L, weight), TRUE,
+  Unit U;
+  addMember(LinkInfo, "weight", OBJL, OFFSET(U, weight), TRUE,
 	    0, 0, RealInfo);
-  addMember(LinkInfo, "deriv", OBJ, OFFSET(L, deriv), FALSE,
+  addMember(LinkInfo, "deriv", OBJL, OFFSET(U, deriv), FALSE,
 	    0, 0, RealInfo);
 }
 
 
 static void link2Name(void *link2, char *dest) {
-  Link2 M = (Link2) link2;
-  if (M) sprintf(dest, "%g", M->lastWeightDelta);
+  Unit U;
+  real *D = (real *) ObjL(link2, OFFSET(U, lastWeightDelta));
+  if (D) sprintf(dest, "%g", *D);
 }
 
 static void initLink2Info(void) {
-  Link2 M;
-  addMember(Link2Info, "lastWeightDelta", OBJ, OFFSET(M, lastWeightDelta),
+  Unit U;
+  addMember(Link2Info, "lastWeightDelta", OBJL, OFFSET(U, lastWeightDelta),
 	    TRUE, 0, 0, RealInfo);
 #ifdef ADVANCED
-  addMember(Link2Info, "lastValue", OBJ, OFFSET(M, lastValue), TRUE,
+  addMember(Link2Info, "lastValue", OBJL, OFFSET(U, lastValue), TRUE,
 	    0, 0, RealInfo);
 #endif /* ADVANCED */
 }
@@ -666,6 +705,8 @@ static void initExampleSetInfo(void) {
 	    0, 0, FlagInfo);
   addMember(ExampleSetInfo, "pipeExampleNum", OBJ, OFFSET(S, pipeExampleNum),
 	    FALSE, 0, 0, IntInfo);
+  addMember(ExampleSetInfo, "pipePrefetch", OBJ, OFFSET(S, pipePrefetch),
+	    TRUE, 0, 0, IntInfo);
   addSpacer(ExampleSetInfo);
 
   addMember(ExampleSetInfo, "proc", OBJ, OFFSET(S, proc), TRUE,
@@ -1129,9 +1170,9 @@ void createObjects(void) {
 		       NULL, NULL);
   BlockInfo = newObject("Block", sizeof(struct block), 6, blockName,
 			NULL, NULL);
-  LinkInfo = newObject("Link", sizeof(struct link), 6, linkName,
+  LinkInfo = newObject("Link", sizeof(real), 6, linkName,
 		       NULL, NULL);
-  Link2Info = newObject("Link2", sizeof(struct link2), 6, link2Name,
+  Link2Info = newObject("Link2", sizeof(real), 6, link2Name,
 			NULL, NULL);
   ExampleSetInfo = newObject("Example Set", sizeof(struct exampleSet), 2,
 			     exampleSetName, NULL, NULL);
@@ -1245,6 +1286,29 @@ void *Obj(char *object, int offset) {
   return (void *) (object + offset);
 }
 
+/* Return a pointer to the unit's value in its group's array */
+void *ObjU(char *unit, int offset) {
+  return (void *) &UNIT_FIELD((Unit) unit, offset);
+}
+
+/* Return a pointer to the unit's first value in its group's array of rows */
+void *ObjUA(char *unit, int offset) {
+  real *rows = GROUP_FIELD(((Unit) unit)->group, offset);
+  if (!rows) return NULL;
+  return (void *) (rows + ((Unit) unit)->num);
+}
+
+/* The unit whose links were last reached by a lookup or print.  A link
+   object points into this unit's weight array. */
+static Unit LinkUnit;
+
+/* Return a pointer to the link's value in its unit's array */
+void *ObjL(char *link, int offset) {
+  if (!link || !LinkUnit) return NULL;
+  return (void *) &LINK_FIELD(LinkUnit, offset)[(real *) link -
+						LinkUnit->weight];
+}
+
 /* Return a pointer to the object */
 void *ObjP(char *object, int offset) {
   if (!*(void **)(object + offset))
@@ -1324,6 +1388,7 @@ static void *lookupObject(char *path, char *object, ObjInfo O,
   if (type == OBJ)
     fatalError("type was OBJ in lookupObject");
   if (type == OBJP) {
+    if (O == UnitInfo) LinkUnit = (Unit) object;
     if (!(M = lookupMember(memberName, O))) {
       warning("lookupObject: field \"%s\" not found in object of type %s",
 	      memberName, O->name);
@@ -1334,10 +1399,23 @@ static void *lookupObject(char *path, char *object, ObjInfo O,
       return lookupObject(newPath, Obj(object, M->offset), M->info,
 			  OBJP, -1, -1, M->writable, retObjInfo, retType,
 			  retRows, retCols, retWrit);
+    else if (M->type == OBJU)
+      return lookupObject(newPath, ObjU(object, M->offset), M->info,
+			  OBJP, -1, -1, M->writable, retObjInfo, retType,
+			  retRows, retCols, retWrit);
+    else if (M->type == OBJL)
+      return lookupObject(newPath, ObjL(object, M->offset), M->info,
+			  OBJP, -1, -1, M->writable, retObjInfo, retType,
+			  retRows, retCols, retWrit);
     else if (M->type == OBJPP)
       return lookupObject(newPath, ObjPP(object, M->offset), M->info,
 			  OBJP, -1, -1, M->writable, retObjInfo, retType,
 			  retRows, retCols, retWrit);
+    else if (M->type == OBJUA)
+      return lookupObject(newPath, ObjUA(object, M->offset), M->info,
+			  OBJUA, M->rows(object), M->cols(object),
+			  M->writable, retObjInfo, retType, retRows, retCols,
+			  retWrit);
     else {
       rows = (M->rows) ? M->rows(object) : -1;
       cols = (M->cols) ? M->cols(object) : -1;
@@ -1361,6 +1439,10 @@ static void *lookupObject(char *path, char *object, ObjInfo O,
       return lookupObject(newPath, ObjA(object, O->size, index), O,
 			  OBJP, -1, -1, writable, retObjInfo, retType,
 			  retRows, retCols, retWrit);
+    case OBJUA:
+      return lookupObject(newPath, ObjA(object, O->size * cols, index), O,
+			  OBJP, -1, -1, writable, retObjInfo, retType,
+			  retRows, retCols, retWrit);
     case OBJPA:
       return lookupObject(newPath, ObjPA(object, index), O,
 			  OBJP, -1, -1, writable, retObjInfo, retType,
@@ -1446,6 +1528,7 @@ void printObject(char *object, ObjInfo O, int type, int rows,
       Tcl_AppendResult(Interp, Buffer, NULL);
     } else {
       append("--%s--", O->name);
+      if (O == UnitInfo) LinkUnit = (Unit) object;
       for (M = O->members; M; M = M->next) {
 	if (M->type == SPACER) continue;
 	append("\n");
@@ -1454,9 +1537,19 @@ void printObject(char *object, ObjInfo O, int type, int rows,
 	if (M->type == OBJ)
 	  printObject(Obj(object, M->offset), M->info, OBJP, -1, -1, depth + 1,
 		      initDepth, maxDepth);
+	else if (M->type == OBJU)
+	  printObject(ObjU(object, M->offset), M->info, OBJP, -1, -1,
+		      depth + 1, initDepth, maxDepth);
+	else if (M->type == OBJL)
+	  printObject(ObjL(object, M->offset), M->info, OBJP, -1, -1,
+		      depth + 1, initDepth, maxDepth);
 	else if (M->type == OBJPP)
 	  printObject(ObjPP(object, M->offset), M->info, OBJP, -1, -1,
 		      depth + 1, initDepth, maxDepth);
+	else if (M->type == OBJUA)
+	  printObject(ObjUA(object, M->offset), M->info, OBJUA,
+		      M->rows(object), M->cols(object), depth + 1, initDepth,
+		      maxDepth);
 	else {
 	  rows = (M->rows) ? M->rows(object) : -1;
 	  cols = (M->cols) ? M->cols(object) : -1;
@@ -1466,7 +1559,7 @@ void printObject(char *object, ObjInfo O, int type, int rows,
       }
     }
   } else { /* It is an array */
-    if (type == OBJA || type == OBJPA) { /* 1D array */
+    if (type == OBJA || type == OBJPA || type == OBJUA) { /* 1D array */
       append("--%s(%d)--", O->name, rows);
       if (depth < maxDepth)
 	for (i = 0; i < rows; i++) {
@@ -1476,6 +1569,9 @@ void printObject(char *object, ObjInfo O, int type, int rows,
 	  if (type == OBJA)
 	    printObject(ObjA(object, O->size, i), O, OBJP, -1, -1,
 			depth + 1, initDepth, maxDepth);
+	  else if (type == OBJUA)
+	    printObject(ObjA(object, O->size * cols, i), O, OBJP, -1, -1,
+			depth + 1, initDepth, maxDepth);
 	  else
 	    printObject(ObjPA(object, i), O, OBJP, -1, -1,
 			depth + 1, initDepth, maxDepth);
@@ -1513,8 +1609,11 @@ flag writeParameters(Tcl_Channel channel, char *path) {
     return warning("writeParameters: can only write fields of "
 		   "container objects");
   for (M = O->members; M; M = M->next) {
-    if (M->type != OBJ || !M->writable) continue;
-    M->info->getName(object + M->offset, value);
+    if ((M->type != OBJ && M->type != OBJU && M->type != OBJL) ||
+	!M->writable) continue;
+    M->info->getName((M->type == OBJ) ? Obj(object, M->offset) :
+		     (M->type == OBJU) ? ObjU(object, M->offset) :
+		     ObjL(object, M->offset), value);
     if (path[0])
       cprintf(channel, "setObj %s.%s {%s}\n", path, M->name, value);
     else cprintf(channel, "setObj %s {%s}\n", M->name, value);
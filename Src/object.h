@@ -1,7 +1,8 @@
 #ifndef OBJECT_H
 #define OBJECT_H
 
-enum memberTypes{SPACER, OBJ, OBJP, OBJPP, OBJA, OBJPA, OBJAA, OBJPAA};
+enum memberTypes{SPACER, OBJ, OBJP, OBJPP, OBJA, OBJPA, OBJAA, OBJPAA, OBJU,
+		  OBJL, OBJUA};
 /* Key
  * -----
  * OBJ    : Object
@@ -11,6 +12,10 @@ enum memberTypes{SPACER, OBJ, OBJP, OBJPP, OBJA, OBJPA, OBJAA, OBJPAA};
  * OBJPA  : Pointer to Array of Objects
  * OBJAA  : Array of Arrays or Objects
  * OBJPAA : Pointer to Array of Arrays of Objects
+ * OBJU   : Unit value in an array of the unit's group, at the array's offset
+ * OBJL   : Link value in an array of the link's unit, at the array's offset
+ * OBJUA  : Array of a unit's values in an array of its group, at the array's
+ *          offset, which has a row of cols values for each element
  */
 
 typedef struct objInfo *ObjInfo;
@@ -44,6 +49,9 @@ struct memInfo {
 extern void *Obj(char *object, int offset);
 extern void *ObjP(char *object, int offset);
 extern void *ObjPP(char *object, int offset);
+extern void *ObjU(char *unit, int offset);
+extern void *ObjL(char *link, int offset);
+extern void *ObjUA(char *unit, int offset);
 extern void *ObjA(char *array, int size, int index);
 extern void *ObjPA(char *array, int index);
 extern void *ObjAA(char *array, int size, int row, int col);
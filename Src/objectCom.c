@@ -197,6 +197,7 @@ static flag addField(char *win, char *name, void *object, ObjInfo O, int type,
     break;
   case OBJA:
   case OBJPA:
+  case OBJUA:
     sprintf(Buffer, ".addObjectArray %s {%s} {%s} {%s} %d", win, name,
 	    O->name, dest, (object) ? 1 : 0);
     break;
@@ -232,6 +233,8 @@ int C_sendObjectArray(TCL_CMDARGS) {
   for (i = 0; i < rows && i < MAX_ARRAY; i++) {
     if (type == OBJA)
       O->getName(ObjA(object, O->size, i), value);
+    else if (type == OBJUA)
+      O->getName(ObjA(object, O->size * cols, i), value);
     else
       O->getName(ObjPA(object, i), value);
     sprintf(Buffer + strlen(Buffer), "{%s} ", value);
@@ -312,6 +315,14 @@ int C_loadObject(TCL_CMDARGS) {
 	if (addField(win, M->name, Obj(object, M->offset), M->info, OBJP,
 		     -1, -1, M->writable, FALSE)) return TCL_ERROR;
 	break;
+      case OBJU:
+	if (addField(win, M->name, ObjU(object, M->offset), M->info, OBJP,
+		     -1, -1, M->writable, FALSE)) return TCL_ERROR;
+	break;
+      case OBJL:
+	if (addField(win, M->name, ObjL(object, M->offset), M->info, OBJP,
+		     -1, -1, M->writable, FALSE)) return TCL_ERROR;
+	break;
       case OBJP:
 	if (addField(win, M->name, ObjP(object, M->offset), M->info, OBJP,
 		     -1, -1, M->writable, FALSE)) return TCL_ERROR;
@@ -326,6 +337,11 @@ int C_loadObject(TCL_CMDARGS) {
 		     M->rows(object), -1, M->writable,
 		     FALSE)) return TCL_ERROR;
 	break;
+      case OBJUA:
+	if (addField(win, M->name, ObjUA(object, M->offset), M->info,
+		     M->type, M->rows(object), M->cols(object), M->writable,
+		     FALSE)) return TCL_ERROR;
+	break;
       case OBJAA:
       case OBJPAA:
 	if (addField(win, M->name, ObjP(object, M->offset), M->info, M->type,
@@ -335,12 +351,15 @@ int C_loadObject(TCL_CMDARGS) {
       }
     }
   }
-  else if (type == OBJA || type == OBJPA) {
+  else if (type == OBJA || type == OBJPA || type == OBJUA) {
     for (i = 0; i < rows && i < MAX_FIELDS; i++) {
       sprintf(label, "%d", i);
       if (type == OBJA) {
 	if (addField(win, label, ObjA(object, O->size, i), O, OBJP,
 		     -1, -1, writable, TRUE)) return TCL_ERROR;
+      } else if (type == OBJUA) {
+	if (addField(win, label, ObjA(object, O->size * cols, i), O, OBJP,
+		     -1, -1, writable, TRUE)) return TCL_ERROR;
       } else {
 	if (addField(win, label, ObjPA(object, i), O, OBJP,
 		     -1, -1, writable, TRUE)) return TCL_ERROR;
@@ -169,9 +169,9 @@ static flag receiveLinkValues(Tcl_Channel channel, int offset,
 	val = NTOHL(buffer[i++]);
 	v = *((float *) &val);
 	if (increment)
-	  *((real *) ((char *) L + offset)) += (isNaNf(v)) ? NaN : (real) v;
+	  LINK_FIELD(U, offset)[l] += (isNaNf(v)) ? NaN : (real) v;
 	else
-	  *((real *) ((char *) L + offset)) =  (isNaNf(v)) ? NaN : (real) v;
+	  LINK_FIELD(U, offset)[l] =  (isNaNf(v)) ? NaN : (real) v;
       });
     });
   });
@@ -229,7 +229,7 @@ static flag sendClientWeights(Client C) {
   FOR_EACH_GROUP({
     FOR_EACH_UNIT(G, {
       FOR_EACH_LINK(U, {
-	v = (isNaN(L->weight)) ? NaNf : (float) L->weight;
+	v = (isNaN(U->weight[l])) ? NaNf : (float) U->weight[l];
 	buffer[i++] = HTONL(*(int *) &v);
 	if (i == PAR_BUF_SIZE) {
 	  if (Tcl_WriteChars(channel, (char *) buffer, blockSize)
@@ -400,7 +400,7 @@ static void asynchronousContinue(Client C, flag groupCritReached) {
 static flag receiveClientDerivs(Client C) {
   real err;
   flag groupCritReached;
-  Link L;
+  Unit U;
 
   if (receiveReal(C->channel, &err) ||
       receiveFlag(C->channel, &groupCritReached) ||
@@ -409,7 +409,7 @@ static flag receiveClientDerivs(Client C) {
     Net->error += err;
   else Net->error = err;
   
-  if (receiveLinkValues(C->channel, OFFSET(L, deriv), Synchronous))
+  if (receiveLinkValues(C->channel, OFFSET(U, deriv), Synchronous))
     return deleteClient(C);
   
   changeState(C, IS_WAITING);
@@ -871,7 +871,7 @@ static flag sendServerDerivs(flag groupCritReached, unsigned int time) {
   FOR_EACH_GROUP({
     FOR_EACH_UNIT(G, {
       FOR_EACH_LINK(U, {
-	v = (isNaN(L->deriv)) ? NaNf : (float) L->deriv;
+	v = (isNaN(U->deriv[l])) ? NaNf : (float) U->deriv[l];
 	buffer[i++] = HTONL(*(int *) &v);
 	if (i == PAR_BUF_SIZE) {
 	  if (Tcl_WriteChars(ServerChannel, (char *) buffer, blockSize) 
@@ -913,9 +913,9 @@ static flag receiveServerStop(void) {
 }
 
 static flag receiveServerWeights(void) {
-  Link L;
+  Unit U;
 
-  if (receiveLinkValues(ServerChannel, OFFSET(L, weight), FALSE))
+  if (receiveLinkValues(ServerChannel, OFFSET(U, weight), FALSE))
     return stopClient();
   
   updateDisplays(ON_UPDATE);
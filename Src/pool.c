@@ -0,0 +1,124 @@
+#include "system.h"
+#ifdef HAVE_THREADS
+#include <pthread.h>
+#endif /* HAVE_THREADS */
+#include "util.h"
+#include "type.h"
+#include "network.h"
+#include "pool.h"
+
+static flag PoolHeld = FALSE;
+
+#ifdef HAVE_THREADS
+/* Worker thread i runs task i + 1 of each job.  A job is finished when
+   Pending reaches zero.  Tasks beyond the number of workers are run by the
+   calling thread after its own. */
+static pthread_mutex_t PoolLock  = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  PoolStart = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t  PoolDone  = PTHREAD_COND_INITIALIZER;
+static pthread_t MainThread;
+static flag      MainThreadSet = FALSE;
+static int       NumWorkers = 0;
+static unsigned  Job = 0;
+static int       JobTasks, Pending;
+static PoolProc  JobProc;
+static void     *JobData;
+static Network   JobNet;
+
+static void *poolWorker(void *arg) {
+  int task = (int) (long) arg;
+  unsigned job = 0;
+  pthread_mutex_lock(&PoolLock);
+  for (;;) {
+    while (job == Job) pthread_cond_wait(&PoolStart, &PoolLock);
+    job = Job;
+    if (task < JobTasks) {
+      pthread_mutex_unlock(&PoolLock);
+      Net = JobNet;
+      JobProc(JobData, task);
+      pthread_mutex_lock(&PoolLock);
+      if (--Pending == 0) pthread_cond_signal(&PoolDone);
+    }
+  }
+  return NULL;
+}
+
+/* Starts workers until there are n of them, if possible. */
+static void growPool(int n) {
+  pthread_t thread;
+  while (NumWorkers < n) {
+    if (pthread_create(&thread, NULL, poolWorker, (void *) (long)
+		       (NumWorkers + 1))) break;
+    pthread_detach(thread);
+    NumWorkers++;
+  }
+}
+#endif /* HAVE_THREADS */
+
+void initPool(void) {
+#ifdef HAVE_THREADS
+  MainThread = pthread_self();
+  MainThreadSet = TRUE;
+#endif /* HAVE_THREADS */
+}
+
+/* While the pool is held, by the mini-batch trainer for example, the other
+   threads are already busy so group work isn't split any further. */
+void holdPool(flag hold) {
+  PoolHeld = hold;
+}
+
+/* Before initPool() there is only the main thread. */
+flag inMainThread(void) {
+#ifdef HAVE_THREADS
+  return (!MainThreadSet || pthread_equal(pthread_self(), MainThread)) ?
+    TRUE : FALSE;
+#else
+  return TRUE;
+#endif /* HAVE_THREADS */
+}
+
+/* Only the main thread uses the pool. */
+static flag poolUsable(void) {
+#ifdef HAVE_THREADS
+  return pthread_equal(pthread_self(), MainThread) && !PoolHeld;
+#else
+  return FALSE;
+#endif /* HAVE_THREADS */
+}
+
+int poolTasks(int numTasks) {
+  return poolUsable() ? numTasks : 1;
+}
+
+/* If some of the threads couldn't be started, their tasks are run here. */
+void poolRun(int numTasks, PoolProc proc, void *data) {
+  int t = 0;
+#ifdef HAVE_THREADS
+  if (numTasks > 1 && poolUsable()) {
+    int started;
+    PoolHeld = TRUE;
+    pthread_mutex_lock(&PoolLock);
+    growPool(numTasks - 1);
+    started = imin(numTasks - 1, NumWorkers);
+    JobTasks = started + 1;
+    Pending  = started;
+    JobProc  = proc;
+    JobData  = data;
+    JobNet   = Net;
+    Job++;
+    pthread_cond_broadcast(&PoolStart);
+    pthread_mutex_unlock(&PoolLock);
+
+    proc(data, 0);
+    for (t = started + 1; t < numTasks; t++) proc(data, t);
+
+    pthread_mutex_lock(&PoolLock);
+    while (Pending > 0) pthread_cond_wait(&PoolDone, &PoolLock);
+    pthread_mutex_unlock(&PoolLock);
+    PoolHeld = FALSE;
+    return;
+  }
+#endif /* HAVE_THREADS */
+  for (t = 0; t < numTasks; t++) proc(data, t);
+}
@@ -0,0 +1,21 @@
+#ifndef POOL_H
+#define POOL_H
+
+/* A persistent pool of threads for splitting up the work on one group.
+   poolRun() runs proc(data, t) for each task t from 0 to numTasks - 1 and
+   returns when they are all done.  The calling thread runs task 0.
+   poolTasks() cuts the number of tasks down to 1 when the pool can't be used
+   from this thread right now. */
+typedef void (*PoolProc)(void *data, int task);
+
+extern void initPool(void);
+extern int  poolTasks(int numTasks);
+extern void poolRun(int numTasks, PoolProc proc, void *data);
+extern void holdPool(flag hold);
+extern flag inMainThread(void);
+
+/* The first and last+1 of n items that belong to a task. */
+#define TASK_FIRST(n, task, numTasks) ((int) ((long) (n) * (task) / (numTasks)))
+#define TASK_LAST(n, task, numTasks) TASK_FIRST(n, (task) + 1, numTasks)
+
+#endif /* POOL_H */
@@ -198,6 +198,18 @@ extern union nandunion NaNdunion;
 #  endif /* LITTLE_END */
 #endif /* FLOAT_REAL */
 
+/* Training can use POSIX threads.  Define NO_THREADS to build without them.
+   The current network is per-thread so each thread can run its own copy. */
+#if !defined(NO_THREADS) && !defined(MACHINE_WINDOWS)
+#  define HAVE_THREADS
+#endif /* NO_THREADS */
+#ifdef HAVE_THREADS
+#  define THREAD_LOCAL __thread
+#else
+#  define THREAD_LOCAL
+#endif /* HAVE_THREADS */
+
+
 /************************** LIMITS AND OTHER STUFF ***************************/
 
 /* System Commands */
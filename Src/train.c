@@ -1,3 +1,4 @@
+#include <string.h>
 #include "system.h"
 #include "util.h"
 #include "type.h"
@@ -7,6 +8,7 @@
 #include "control.h"
 #include "display.h"
 #include "graph.h"
+#include "pool.h"
 
 Algorithm AlgorithmTable = NULL;
 
@@ -118,6 +120,8 @@ flag standardNetTrain(void) {
   if (Net->reportInterval < 0)
     return warning("reportInterval (%d) cannot be negative.",
 		   Net->reportInterval);
+  if (Net->numThreads < 1)
+    return warning("numThreads (%d) must be positive.", Net->numThreads);
 
   A = getAlgorithm(Net->algorithm);
 
@@ -133,6 +137,7 @@ flag standardNetTrain(void) {
   for (i = 1; !done; i++) {
     RUN_PROC(preEpochProc);
 
+    startUpdate();
     if ((value = Net->netTrainBatch(&groupCritReached))) break;
 
     if (Net->error < Net->criterion || groupCritReached)
@@ -155,6 +160,7 @@ flag standardNetTrain(void) {
     updateDisplays(ON_UPDATE);
 
     Net->totalUpdates++;
+    finishUpdate();
 
     if (willReport) {
       printReport(lastReport, i, startTime);
@@ -199,66 +205,158 @@ void updateAdaptiveGain(Group G) {
 }
 
 
+typedef struct weightSplit {
+  void (*updateUnits)(WeightUpdate W);
+  Group  group;
+  int    numTasks;
+  struct weightUpdate *update;
+} *WeightSplit;
+
+static void updateWeightsTask(void *data, int task) {
+  WeightSplit X = (WeightSplit) data;
+  struct group slice;
+  sliceGroup(X->group, &slice, task, X->numTasks);
+  X->update[task].group = &slice;
+  X->updateUnits(X->update + task);
+}
+
+/* This runs the update proc on the group, split among the threads if the
+   group is wide enough, and adds the stats to W. */
+static void updateGroupWeights(Group G, void (*updateUnits)(WeightUpdate W),
+			       WeightUpdate W) {
+  struct weightSplit X;
+  WeightUpdate T;
+  int t, numTasks = groupTasks(G);
+  if (numTasks <= 1) {
+    W->group = G;
+    updateUnits(W);
+    return;
+  }
+  X.updateUnits = updateUnits;
+  X.group       = G;
+  X.numTasks    = numTasks;
+  X.update      = (WeightUpdate) safeCalloc(numTasks, sizeof(struct
+					      weightUpdate), "updateGroupWeights");
+  for (t = 0; t < numTasks; t++) {
+    X.update[t].doStats = W->doStats;
+    X.update[t].scale   = W->scale;
+  }
+  poolRun(numTasks, updateWeightsTask, &X);
+  for (t = 0; t < numTasks; t++) {
+    T = X.update + t;
+    W->derivSum     += T->derivSum;
+    W->gradLin      += T->gradLin;
+    W->lastDeltaLen += T->lastDeltaLen;
+    W->derivLen     += T->derivLen;
+    W->weightCost   += T->weightCost;
+  }
+  FREE(X.update);
+}
+
+void updateWeights(void (*updateUnits)(WeightUpdate W), flag doStats,
+		   double scale) {
+  struct weightUpdate W;
+  memset(&W, 0, sizeof(struct weightUpdate));
+  W.doStats = doStats;
+  W.scale   = scale;
+  Net->gradientLinearity = 1.0;
+  Net->weightCost = 0.0;
+  if (Net->type & FROZEN) return;
+  FOR_EACH_GROUP({
+    if (G->type & FROZEN) continue;
+    if (G->type & ADAPTIVE_GAIN) updateAdaptiveGain(G);
+    updateGroupWeights(G, updateUnits, &W);
+  });
+  if (doStats) {
+    Net->gradientLinearity = (W.lastDeltaLen * W.derivLen == 0.0) ? NaN :
+      W.gradLin / SQRT(W.lastDeltaLen * W.derivLen);
+    Net->weightCost = W.weightCost / 2;
+  }
+}
+
+
 /* This splits the processing of entire block into doStats and no doStats
    cases so the no stats inner loop doesn't need to do extra tests */
-void steepestUpdateWeights(flag doStats) {
+static void steepestUpdateUnits(WeightUpdate W) {
   UPDATE_WEIGHTS({
-    w = L->weight;
-    lastWeightDelta = -learningRate * L->deriv;
+    w = U->weight[l];
+    lastWeightDelta = -learningRate * U->deriv[l];
     if (weightDecay > 0.0) lastWeightDelta -= weightDecay * w;
     w += lastWeightDelta;
     if (!isNaN(B->min) && w < B->min) w = B->min;
     else if (!isNaN(B->max) && w > B->max) w = B->max;
-    M->lastWeightDelta = w - L->weight;
-    L->weight = w;
+    U->lastWeightDelta[l] = w - U->weight[l];
+    U->weight[l] = w;
   });
 }
 
+void steepestUpdateWeights(flag doStats) {
+  updateWeights(steepestUpdateUnits, doStats, 1.0);
+}
+
 /* This is like steepest except that it uses the momentum. */
-void momentumUpdateWeights(flag doStats) {
+static void momentumUpdateUnits(WeightUpdate W) {
   UPDATE_WEIGHTS({
-    w = L->weight;
-    lastWeightDelta = -learningRate * L->deriv +
-      momentum * M->lastWeightDelta;
+    w = U->weight[l];
+    lastWeightDelta = -learningRate * U->deriv[l] +
+      momentum * U->lastWeightDelta[l];
     if (weightDecay > 0.0) lastWeightDelta -= weightDecay * w;
     w += lastWeightDelta;
     if (!isNaN(B->min) && w < B->min) w = B->min;
     else if (!isNaN(B->max) && w > B->max) w = B->max;
-    M->lastWeightDelta = w - L->weight;
-    L->weight = w;
+    U->lastWeightDelta[l] = w - U->weight[l];
+    U->weight[l] = w;
   });
 }
 
+void momentumUpdateWeights(flag doStats) {
+  updateWeights(momentumUpdateUnits, doStats, 1.0);
+}
+
 /* This is exactly like momentum but the length of the weight delta vector
    (before momentum) is always exactly the learning rate. */
-void dougsMomentumUpdateWeights(flag doStats) {
-  double scale, sum = 0.0;
-  FOR_EACH_GROUP({if (G->type & FROZEN) continue;
-    FOR_EACH_UNIT(G, {
-      Link L; Link sL;
-      if (U->type & FROZEN) continue;
-      L = U->incoming;
-      FOR_EACH_BLOCK(U, {
-	    if (B->type & FROZEN) {L += B->numUnits; continue;}
-	    for (sL = L + B->numUnits; L < sL; L++)
-	      sum += SQUARE(L->deriv);
-      });
+static void dougsDerivSumUnits(WeightUpdate W) {
+  Group G = W->group;
+  double sum = W->derivSum;
+  FOR_EACH_UNIT(G, {
+    int l = 0; int sl;
+    if (U->type & FROZEN) continue;
+    FOR_EACH_BLOCK(U, {
+	  if (B->type & FROZEN) {l += B->numUnits; continue;}
+	  for (sl = l + B->numUnits; l < sl; l++)
+	    sum += SQUARE(U->deriv[l]);
     });
   });
-  scale = (sum > 1.0) ? 1.0 / SQRT(sum) : 1.0;
+  W->derivSum = sum;
+}
+
+static void dougsMomentumUpdateUnits(WeightUpdate W) {
+  double scale = W->scale;
   UPDATE_WEIGHTS({
-    w = L->weight;
-    lastWeightDelta = -learningRate * scale * L->deriv +
-      momentum * M->lastWeightDelta;
+    w = U->weight[l];
+    lastWeightDelta = -learningRate * scale * U->deriv[l] +
+      momentum * U->lastWeightDelta[l];
     if (weightDecay > 0.0) lastWeightDelta -= weightDecay * w;
     w += lastWeightDelta;
     if (!isNaN(B->min) && w < B->min) w = B->min;
     else if (!isNaN(B->max) && w > B->max) w = B->max;
-    M->lastWeightDelta = w - L->weight;
-    L->weight = w;
+    U->lastWeightDelta[l] = w - U->weight[l];
+    U->weight[l] = w;
   });
 }
 
+void dougsMomentumUpdateWeights(flag doStats) {
+  struct weightUpdate W;
+  double sum;
+  memset(&W, 0, sizeof(struct weightUpdate));
+  FOR_EACH_GROUP({if (G->type & FROZEN) continue;
+    updateGroupWeights(G, dougsDerivSumUnits, &W);
+  });
+  sum = W.derivSum;
+  updateWeights(dougsMomentumUpdateUnits, doStats,
+		(sum > 1.0) ? 1.0 / SQRT(sum) : 1.0);
+}
+
 
 #ifdef ADVANCED
 /* The link learning rate is stored in the lastValue field. */
@@ -266,54 +364,58 @@ void dougsMomentumUpdateWeights(flag doStats) {
 
 #define OPPOSITE_SIGN(x,y) (IS_NEGATIVE(x) ^ IS_NEGATIVE(y))
 
-void deltabardeltaUpdateWeights(flag doStats) {
+static void deltabardeltaUpdateUnits(WeightUpdate W) {
   real rateIncrement = Net->rateIncrement, rateDecrement = Net->rateDecrement,
     linkLearningRate;
   UPDATE_WEIGHTS({
-    lastWeightDelta = M->lastWeightDelta;
-    deriv = L->deriv;
-    linkLearningRate = M->lastValue;
+    lastWeightDelta = U->lastWeightDelta[l];
+    deriv = U->deriv[l];
+    linkLearningRate = U->lastValue[l];
 
     if (OPPOSITE_SIGN(deriv, lastWeightDelta))
       linkLearningRate += rateIncrement;
     else linkLearningRate *= rateDecrement;
     lastWeightDelta = -linkLearningRate * learningRate * deriv +
       momentum * lastWeightDelta;
-    w = L->weight;
+    w = U->weight[l];
     if (weightDecay > 0.0) lastWeightDelta -= weightDecay * w;
     w += lastWeightDelta;
     if (!isNaN(B->min) && w < B->min) w = B->min;
     else if (!isNaN(B->max) && w > B->max) w = B->max;
-    M->lastWeightDelta = w - L->weight;
-    L->weight = w;
-    M->lastValue = linkLearningRate;
+    U->lastWeightDelta[l] = w - U->weight[l];
+    U->weight[l] = w;
+    U->lastValue[l] = linkLearningRate;
   });
 }
 
+void deltabardeltaUpdateWeights(flag doStats) {
+  updateWeights(deltabardeltaUpdateUnits, doStats, 1.0);
+}
+
 #ifdef JUNK
 /* If lastWeightDelta is 0, I use steepest.  Is this best? */
 /* lastValue stores the lastDeriv */
 void quickpropUpdateWeights(flag doStats) {
   UPDATE_WEIGHTS({
-    deriv = L->deriv;
-    w = L->weight;
-    lastWeightDelta = M->lastWeightDelta;
+    deriv = U->deriv[l];
+    w = U->weight[l];
+    lastWeightDelta = U->lastWeightDelta[l];
     if (lastWeightDelta == 0.0)
       lastWeightDelta = -learningRate * 0.1 * deriv;
     else /* I multiply by the learning rate here to stabilize it */
       lastWeightDelta = learningRate *
-	(deriv * lastWeightDelta) / (M->lastValue - deriv);
-    M->lastValue = deriv;
+	(deriv * lastWeightDelta) / (U->lastValue[l] - deriv);
+    U->lastValue[l] = deriv;
     if (weightDecay > 0.0) lastWeightDelta -= weightDecay * w;
     w += lastWeightDelta;
     if (!isNaN(B->min) && w < B->min) w = B->min;
     else if (!isNaN(B->max) && w > B->max) w = B->max;
-    M->lastWeightDelta = w - L->weight;
-    L->weight = w;
+    U->lastWeightDelta[l] = w - U->weight[l];
+    U->weight[l] = w;
   }, {
-    deriv = L->deriv;
-    w = L->weight;
-    lastWeightDelta = M->lastWeightDelta;
+    deriv = U->deriv[l];
+    w = U->weight[l];
+    lastWeightDelta = U->lastWeightDelta[l];
     gradLin -= lastWeightDelta * deriv;
     lastDeltaLen += SQUARE(lastWeightDelta);
     derivLen += SQUARE(deriv);
@@ -321,14 +423,14 @@ void quickpropUpdateWeights(flag doStats) {
       lastWeightDelta = -learningRate * 0.1 * deriv;
     else /* I multiply by the learning rate here to stabilize it */
       lastWeightDelta = learningRate *
-	(deriv * lastWeightDelta) / (M->lastValue - deriv);
-    M->lastValue = deriv;
+	(deriv * lastWeightDelta) / (U->lastValue[l] - deriv);
+    U->lastValue[l] = deriv;
     if (weightDecay > 0.0) lastWeightDelta -= weightDecay * w;
     w += lastWeightDelta;
     if (!isNaN(B->min) && w < B->min) w = B->min;
     else if (!isNaN(B->max) && w > B->max) w = B->max;
-    M->lastWeightDelta = w - L->weight;
-    L->weight = w;
+    U->lastWeightDelta[l] = w - U->weight[l];
+    U->weight[l] = w;
     weightCost += SQUARE(w);
   });
 }
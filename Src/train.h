@@ -28,47 +28,60 @@ extern void dougsMomentumUpdateWeights(flag doStats);
 extern void deltabardeltaUpdateWeights(flag doStats);
 extern void quickpropUpdateWeights(flag doStats);
 
+/* The update procs work on one slice of a group at a time so that wide
+   groups can be split among threads.  Each slice keeps its own stats, which
+   are added up in order afterwards. */
+typedef struct weightUpdate *WeightUpdate;
+struct weightUpdate {
+  Group      group;
+  flag       doStats;
+  double     scale;              /* Used by dougsMomentum */
+  double     derivSum;           /* Used by dougsMomentum */
+  real       gradLin;
+  real       lastDeltaLen;
+  real       derivLen;
+  real       weightCost;
+};
+
+extern void updateWeights(void (*updateUnits)(WeightUpdate W), flag doStats,
+			  double scale);
+
+/* This is the body of an update proc.  It expects the WeightUpdate W.  The
+   proc works on link l of unit U. */
 #define UPDATE_WEIGHTS(proc) {\
-  Link L, sL; Link2 M;\
-  real learningRate, momentum, lastWeightDelta, deriv, weightDecay,\
-    gradLin = 0.0, lastDeltaLen = 0.0, derivLen = 0.0, weightCost = 0.0, w;\
-  Net->gradientLinearity = 1.0;\
-  Net->weightCost = 0.0;\
-  if (Net->type & FROZEN) return;\
-  FOR_EACH_GROUP({if (G->type & FROZEN) continue;\
-    if (G->type & ADAPTIVE_GAIN) updateAdaptiveGain(G);\
-    FOR_EACH_UNIT(G, {if (U->type & FROZEN) continue;\
-      L = U->incoming; M = U->incoming2;\
-      FOR_EACH_BLOCK(U, {\
-	if (B->type & FROZEN) {\
-	  L += B->numUnits; M += B->numUnits;\
-	} else {\
-  	  learningRate =\
-	    chooseValue3(B->learningRate, G->learningRate, Net->learningRate);\
-	  momentum =\
-	    chooseValue3(B->momentum, G->momentum, Net->momentum);\
-  	  weightDecay =\
-	    chooseValue3(B->weightDecay, G->weightDecay, Net->weightDecay);\
-	  if (!doStats)\
-	    for (sL = L + B->numUnits; L < sL; L++, M++) {proc}\
-	  else\
-            for (sL = L + B->numUnits; L < sL; L++, M++) {\
-              lastWeightDelta = M->lastWeightDelta; \
-              deriv = L->deriv; \
-              gradLin -= lastWeightDelta * deriv; \
-              lastDeltaLen += SQUARE(lastWeightDelta); \
-              derivLen += SQUARE(deriv);\
-              {proc}\
-              weightCost += SQUARE(L->weight);\
-            }\
-        }\
-      });\
+  Group G = W->group; int l, sl;\
+  flag doStats = W->doStats;\
+  real learningRate, momentum, lastWeightDelta, deriv, weightDecay, w,\
+    gradLin = W->gradLin, lastDeltaLen = W->lastDeltaLen,\
+    derivLen = W->derivLen, weightCost = W->weightCost;\
+  FOR_EACH_UNIT(G, {if (U->type & FROZEN) continue;\
+    l = 0;\
+    FOR_EACH_BLOCK(U, {\
+      if (B->type & FROZEN) {\
+	l += B->numUnits;\
+      } else {\
+	learningRate =\
+	  chooseValue3(B->learningRate, G->learningRate, Net->learningRate);\
+	momentum =\
+	  chooseValue3(B->momentum, G->momentum, Net->momentum);\
+	weightDecay =\
+	  chooseValue3(B->weightDecay, G->weightDecay, Net->weightDecay);\
+	if (!doStats)\
+	  for (sl = l + B->numUnits; l < sl; l++) {proc}\
+	else\
+	  for (sl = l + B->numUnits; l < sl; l++) {\
+	    lastWeightDelta = U->lastWeightDelta[l]; \
+	    deriv = U->deriv[l]; \
+	    gradLin -= lastWeightDelta * deriv; \
+	    lastDeltaLen += SQUARE(lastWeightDelta); \
+	    derivLen += SQUARE(deriv);\
+	    {proc}\
+	    weightCost += SQUARE(U->weight[l]);\
+	  }\
+      }\
     });\
   });\
-  if (doStats) {\
-    Net->gradientLinearity = (lastDeltaLen * derivLen == 0.0) ? NaN :\
-      gradLin / SQRT(lastDeltaLen * derivLen);\
-    Net->weightCost = weightCost / 2;\
-  }}
+  W->gradLin = gradLin; W->lastDeltaLen = lastDeltaLen;\
+  W->derivLen = derivLen; W->weightCost = weightCost;}
 
 #endif /* TRAIN_H */
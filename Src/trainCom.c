@@ -9,13 +9,14 @@
 #include "control.h"
 #include "display.h"
 #include "graph.h"
+#include "kernel.h"
 
 int C_train(TCL_CMDARGS) {
   int numUpdatesInt,arg = 1;
   char *numUpdatesStr;
   flag result, train = TRUE;
   const char *usage = "train [<num-updates>] [-report <report-interval> | -algorithm"
-    " <algorithm> | -setOnly]";
+    " <algorithm> | -threads <num-threads> | -setOnly]";
   const char *commandName = Tcl_GetStringFromObj(objv[0], NULL);
   if (objc == 2 && !strcmp(Tcl_GetStringFromObj(objv[1], NULL), "-h"))
     return commandHelp("train");
@@ -43,6 +44,10 @@ int C_train(TCL_CMDARGS) {
       if (lookupTypeMask(Tcl_GetStringFromObj(objv[arg], NULL), ALGORITHM, &(Net->algorithm)))
 	return warning("%s: unrecognized algorithm: %s", commandName, Tcl_GetStringFromObj(objv[arg], NULL));
       break;
+    case 't':
+      if (++arg >= objc) return usageError(commandName, usage);
+      Tcl_GetIntFromObj(interp, objv[arg], &Net->numThreads);
+      break;
     case 's':
       train = FALSE;
       break;
@@ -55,6 +60,7 @@ int C_train(TCL_CMDARGS) {
   if (!train) return TCL_OK;
   startTask(TRAINING);
   result = Net->netTrain();
+  finishUpdate();
   stopTask(TRAINING);
   return result;
 }
@@ -157,8 +163,9 @@ int C_resetDerivs(TCL_CMDARGS) {
 
 int C_openNetOutputFile(TCL_CMDARGS) {
   int arg;
-  flag binary = FALSE, append = FALSE;
-  const char *usage = "openNetOutputFile <file-name> [-binary | -append]";
+  flag binary = FALSE, append = FALSE, columnar = FALSE, compress = FALSE;
+  const char *usage = "openNetOutputFile <file-name> [-binary | -append |\n"
+    "\t-columnar | -compress]";
   const char *commandName = Tcl_GetStringFromObj(objv[0], NULL);
   const char *fileName;
   Tcl_Obj *fileNameObj;
@@ -175,6 +182,11 @@ int C_openNetOutputFile(TCL_CMDARGS) {
     case 'a':
       append = TRUE;
       break;
+    case 'c':
+      if (subString(Tcl_GetStringFromObj(objv[arg], NULL), "-columnar", 3))
+	columnar = TRUE;
+      else compress = TRUE;
+      break;
     default: return usageError(commandName, usage);
     }
   }
@@ -184,7 +196,8 @@ int C_openNetOutputFile(TCL_CMDARGS) {
   eval("set _record(path) [.normalizeDir {} [file dirname %s]];"
        "set _record(file) [file tail %s]", fileName, fileName);
 
-  if (openNetOutputFile(fileNameObj, binary, append)) return TCL_ERROR;
+  if (openNetOutputFile(fileNameObj, binary, append, columnar, compress))
+    return TCL_ERROR;
   if (Gui) return eval(".trainingControlPanel.r.outp configure -text "
 		       "\"Stop Recording\" -command closeNetOutputFile");
   else return TCL_OK;
@@ -204,6 +217,68 @@ int C_closeNetOutputFile(TCL_CMDARGS) {
   else return TCL_OK;
 }
 
+int C_readNetOutput(TCL_CMDARGS) {
+  int arg, first = 0, last = -1;
+  flag info = FALSE;
+  char *groupName = NULL;
+  const char *usage = "readNetOutput <file-name> [-group <group> |\n"
+    "\t-examples <first>[-<last>] | -info]";
+  const char *commandName = Tcl_GetStringFromObj(objv[0], NULL);
+  const char *option;
+  if (objc == 2 && !strcmp(Tcl_GetStringFromObj(objv[1], NULL), "-h")) return commandHelp(commandName);
+  if (objc < 2) return usageError(commandName, usage);
+
+  for (arg = 2; arg < objc; arg++) {
+    option = Tcl_GetStringFromObj(objv[arg], NULL);
+    if (subString(option, "-group", 2) && arg + 1 < objc)
+      groupName = Tcl_GetStringFromObj(objv[++arg], NULL);
+    else if (subString(option, "-examples", 2) && arg + 1 < objc) {
+      option = Tcl_GetStringFromObj(objv[++arg], NULL);
+      switch (sscanf(option, "%d-%d", &first, &last)) {
+      case 1: last = first; break;
+      case 2: break;
+      default:
+	return warning("%s: bad example range: %s", commandName, option);
+      }
+      if (first < 0 || last < first)
+	return warning("%s: bad example range: %s", commandName, option);
+    } else if (subString(option, "-info", 2))
+      info = TRUE;
+    else return usageError(commandName, usage);
+  }
+
+  return readNetOutput(objv[1], groupName, first, last, info);
+}
+
+int C_kernelInfo(TCL_CMDARGS) {
+  const char *usage = "kernelInfo [-list | -exact [<flag>] | <kernel-set>]";
+  const char *commandName = Tcl_GetStringFromObj(objv[0], NULL);
+  const char *arg;
+  int exact;
+  if (objc == 2 && !strcmp(Tcl_GetStringFromObj(objv[1], NULL), "-h")) return commandHelp(commandName);
+  if (objc > 3) return usageError(commandName, usage);
+
+  if (objc >= 2) {
+    arg = Tcl_GetStringFromObj(objv[1], NULL);
+    if (subString(arg, "-exact", 2)) {
+      if (objc == 3) {
+	if (Tcl_GetBooleanFromObj(interp, objv[2], &exact) != TCL_OK)
+	  return TCL_ERROR;
+	useExactMath((flag) exact);
+      }
+      return result("%d", ExactMath);
+    }
+    if (objc == 3) return usageError(commandName, usage);
+    if (!strcmp(arg, "-list")) {
+      result("");
+      listKernels();
+      return TCL_OK;
+    }
+    if (useKernel(arg)) return TCL_ERROR;
+  }
+  return result("%s", KernelName);
+}
+
 #ifdef JUNK
 int C_testBinary(TCL_CMDARGS) {
   int arg = 1, numExamples = 0;
@@ -236,7 +311,6 @@ int C_testBinary(TCL_CMDARGS) {
 
 int C_testCost(TCL_CMDARGS) {
   Group G;
-  Unit U;
   int i, steps = 100;
   real r;
   const char *usage = "testCost <group>";
@@ -246,43 +320,42 @@ int C_testCost(TCL_CMDARGS) {
   if (!(G = lookupGroup(Tcl_GetStringFromObj(objv[1], NULL))))
     return warning("no such group");
   Net->outputCostStrength = 1.0;
-  U = G->unit;
 
   result("");
   for (i = 0; i <= steps; i++) {
     r = (real) i / steps;
-    U->output = r;
+    G->output[0] = r;
     append("%.2g ", r);
 
     Net->outputCost = 0.0;
-    U->outputDeriv = 0.0;
+    G->outputDeriv[0] = 0.0;
     boundedLinearCost(G);
     boundedLinearCostBack(G);
-    append("%f %f  ", Net->outputCost, U->outputDeriv);
+    append("%f %f  ", Net->outputCost, G->outputDeriv[0]);
 
     Net->outputCost = 0.0;
-    U->outputDeriv = 0.0;
+    G->outputDeriv[0] = 0.0;
     boundedQuadraticCost(G);
     boundedQuadraticCostBack(G);
-    append("%f %f  ", Net->outputCost, U->outputDeriv);
+    append("%f %f  ", Net->outputCost, G->outputDeriv[0]);
 
     Net->outputCost = 0.0;
-    U->outputDeriv = 0.0;
+    G->outputDeriv[0] = 0.0;
     convexQuadraticCost(G);
     convexQuadraticCostBack(G);
-    append("%f %f  ", Net->outputCost, U->outputDeriv);
+    append("%f %f  ", Net->outputCost, G->outputDeriv[0]);
 
     Net->outputCost = 0.0;
-    U->outputDeriv = 0.0;
+    G->outputDeriv[0] = 0.0;
     logisticCost(G);
     logisticCostBack(G);
-    append("%f %f  ", Net->outputCost, U->outputDeriv);
+    append("%f %f  ", Net->outputCost, G->outputDeriv[0]);
 
     Net->outputCost = 0.0;
-    U->outputDeriv = 0.0;
+    G->outputDeriv[0] = 0.0;
     cosineCost(G);
     cosineCostBack(G);
-    append("%f %f\n", Net->outputCost, U->outputDeriv);
+    append("%f %f\n", Net->outputCost, G->outputDeriv[0]);
   }
 
   return TCL_OK;
@@ -317,4 +390,8 @@ void registerTrainingCommands(void) {
 		  "begins writing OUTPUT group outputs to a file");
   registerCommand((Tcl_ObjCmdProc *)C_closeNetOutputFile, "closeNetOutputFile",
 		  "stops writing OUTPUT group outputs to the output file");
+  registerCommand((Tcl_ObjCmdProc *)C_readNetOutput, "readNetOutput",
+		  "reads records from a columnar output file");
+  registerCommand((Tcl_ObjCmdProc *)C_kernelInfo, "kernelInfo",
+		  "reports or selects the kernels used in training");
 }
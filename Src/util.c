@@ -10,10 +10,18 @@
 #include <ctype.h>
 #include <netinet/in.h>
 #include <unistd.h>
+#include <fcntl.h>
+#ifndef MACHINE_WINDOWS
+#include <sys/mman.h>
+#endif /* MACHINE_WINDOWS */
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
 #include "util.h"
 #include "type.h"
 #include "parallel.h"
 #include "defaults.h"
+#include "pool.h"
 
 #define MAX_BLOCK_DEPTH 32
 #define MAX_FILENAME    512
@@ -147,7 +155,13 @@ int error(const char *fmt, ...) {
     return error("error() called on Buffer, report this to Doug");
   }
   va_start(args, fmt);
-  if (!Batch && !ParallelState) {
+  /* Other threads can't use the interpreter or the shared Buffer. */
+  if (!inMainThread()) {
+    beep();
+    fprintf(stderr, "Error: ");
+    vfprintf(stderr, fmt, args);
+    fprintf(stderr, "\n");
+  } else if (!Batch && !ParallelState) {
     sprintf(Buffer, "bgerror {");
     vsprintf(Buffer + strlen(Buffer), fmt, args);
     strcat(Buffer, "}");
@@ -447,7 +461,7 @@ char *readName(char *list, String name, flag *result) {
 
 /************************************ Files **********************************/
 
-static int stringEndsIn(const char *s, const char *t) {
+int stringEndsIn(const char *s, const char *t) {
   int ls = strlen(s);
   int lt = strlen(t);
   if (ls < lt) return FALSE;
@@ -616,6 +630,44 @@ flag binaryEncoding(Tcl_Channel channel) {
   return Tcl_SetChannelOption(Interp, channel, "-translation", "binary");
 }
 
+/* Maps a whole uncompressed file into memory.  Pages are shared with other
+   processes mapping the same file, writes go to private copies.  Returns NULL
+   if the file couldn't be opened or is empty. */
+void *mapFile(Tcl_Obj *fileNameObj, size_t *size) {
+  const char *path = Tcl_FSGetNativePath(fileNameObj);
+  struct stat statbuf;
+  void *data;
+  int fd;
+
+  if (!path || (fd = open(path, O_RDONLY | O_BINARY)) < 0) return NULL;
+  if (fstat(fd, &statbuf) || statbuf.st_size <= 0) {
+    close(fd);
+    return NULL;
+  }
+  *size = (size_t) statbuf.st_size;
+#ifndef MACHINE_WINDOWS
+  data = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  if (data == MAP_FAILED) data = NULL;
+#else
+  data = safeMalloc(*size, "mapFile:data");
+  if (read(fd, data, *size) != (int) *size) {
+    free(data);
+    data = NULL;
+  }
+#endif /* MACHINE_WINDOWS */
+  close(fd);
+  return data;
+}
+
+void unmapFile(void *data, size_t size) {
+  if (!data) return;
+#ifndef MACHINE_WINDOWS
+  munmap(data, size);
+#else
+  free(data);
+#endif /* MACHINE_WINDOWS */
+}
+
 
 /************************************ Parsing ********************************/
 
@@ -676,11 +728,27 @@ static flag getLine(ParseRec R) {
 #endif
 
 static flag getOneLine(ParseRec R) {
-  char c = '\0';
+  char c = '\0', *end;
   String S = R->buf;
   R->line++;
 
   clearString(S);
+  /* Lines that were read ahead come first. */
+  if (R->textPos) {
+    if (R->textPos < R->textEnd) {
+      end = memchr(R->textPos, '\n', R->textEnd - R->textPos);
+      if (!end) end = R->textEnd;
+      stringSize(S, end - R->textPos);
+      memcpy(S->s, R->textPos, end - R->textPos);
+      S->numChars = end - R->textPos;
+      S->s[S->numChars] = '\0';
+      R->textPos = (end < R->textEnd) ? end + 1 : end;
+      R->s = S->s;
+      return TCL_OK;
+    }
+    R->textPos = R->textEnd = NULL;
+  }
+  if (!R->channel) return TCL_ERROR;
   /* First copy any cookie that's left up to a newline. */
   while (R->cookiePos < sizeof(int) && c != '\n') {
     c = R->cookie[R->cookiePos++];
@@ -719,6 +787,8 @@ flag startParser(ParseRec R, int word) {
   R->buf->numChars = 0;
   *((int *) R->cookie) = word;
   R->cookiePos = 0;
+  R->text = R->textPos = R->textEnd = NULL;
+  R->message = NULL;
   return TCL_OK;
 }
 
@@ -753,10 +823,54 @@ flag isInteger(char *s) {
   return TRUE;
 }
 
+/* Reads a plain integer of up to 9 digits.  Returns the number of characters
+   used, or 0 if sscanf should handle it. */
+static int fastInt(char *s, int *val) {
+  char *p = s;
+  int v = 0, digits;
+  if (*p == '-') p++;
+  for (digits = 0; isdigit((int) *p); p++, digits++) {
+    if (digits == 9) return 0;
+    v = v * 10 + (*p - '0');
+  }
+  if (!digits) return 0;
+  *val = (*s == '-') ? -v : v;
+  return p - s;
+}
+
+/* Reads a plain decimal such as -0.25 without sscanf.  With at most 15 digits
+   and no exponent, the digits and the power of ten are exact doubles, so the
+   quotient is correctly rounded and so is the float it rounds to, since a
+   double has more than 2 * 24 + 2 bits.  This matches sscanf exactly.
+   Returns the number of characters used, or 0 if sscanf should handle it. */
+static int fastReal(char *s, float *val) {
+  static const double power[16] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7,
+				   1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14,
+				   1e15};
+  char *p = s;
+  double v = 0.0;
+  int digits = 0, places = 0;
+  flag point = FALSE;
+  if (*p == '-') p++;
+  for (;; p++) {
+    if (isdigit((int) *p)) {
+      if (++digits > 15) return 0;
+      v = v * 10.0 + (*p - '0');
+      if (point) places++;
+    } else if (*p == '.' && !point) point = TRUE;
+    else break;
+  }
+  if (!digits || (*p && strchr("eExX", *p))) return 0;
+  v /= power[places];
+  *val = (float) ((*s == '-') ? -v : v);
+  return p - s;
+}
+
 flag readInt(ParseRec R, int *val) {
   int shift;
   if (skipBlank(R)) return TCL_ERROR;
-  if (sscanf(R->s, "%d%n", val, &shift) != 1)
+  if (!(shift = fastInt(R->s, val)) &&
+      sscanf(R->s, "%d%n", val, &shift) != 1)
     return TCL_ERROR;
   R->s += shift;
   return TCL_OK;
@@ -773,7 +887,8 @@ flag readReal(ParseRec R, real *val) {
   if (!strncmp(NO_VALUE, R->s, shift))
     *val = NaN;
   else {
-    if (sscanf(R->s, "%f%n", &v, &shift) != 1)
+    if (!(shift = fastReal(R->s, &v)) &&
+	sscanf(R->s, "%f%n", &v, &shift) != 1)
       return TCL_ERROR;
     *val = (real) v;
   }
@@ -794,6 +909,14 @@ flag readLine(ParseRec R, String S) {
   return TCL_OK;
 }
 
+/* Errors are reported unless the caller asked for them in R->message. */
+static flag blockError(ParseRec R, char *message) {
+  if (!R->message) return error(message);
+  clearString(R->message);
+  stringAppend(R->message, message);
+  return TCL_ERROR;
+}
+
 flag readBlock(ParseRec R, String S) {
   int stack[MAX_BLOCK_DEPTH], depth = 0, temp;
   char *p, protect;
@@ -823,15 +946,15 @@ flag readBlock(ParseRec R, String S) {
 	if (*p == '{' || *p == '(' || *p == '[') stack[depth++] = *p;
 	else if (*p == '}') {
 	  if (stack[depth - 1] == '{') depth--;
-	  else return error("error parsing block, unexpected }");
+	  else return blockError(R, "error parsing block, unexpected }");
 	}
 	else if (*p == ')') {
 	  if (stack[depth - 1] == '(') depth--;
-	  else return error("error parsing block, unexpected )");
+	  else return blockError(R, "error parsing block, unexpected )");
 	}
 	else if (*p == ']') {
 	  if (stack[depth - 1] == '[') depth--;
-	  else return error("error parsing block, unexpected )");
+	  else return blockError(R, "error parsing block, unexpected )");
 	}
 	else if (*p == '"') {
 	  if (stack[depth - 1] == '"') depth--;
@@ -876,7 +999,7 @@ flag stringPeek(ParseRec R, char *s) {
 }
 
 flag fileDone(ParseRec R) {
-  if (!R->channel) return TRUE;
+  if (!R->channel && !R->textPos) return TRUE;
   if (!R->binary) return skipBlank(R);
   if (Tcl_InputBuffered(R->channel) == 0) {
     debug("killing because nothing buffered\n");
@@ -1116,11 +1239,20 @@ double drand48(void) {
 }
 #endif
 
+/* random() runs on one of these tables so that its state can be saved.  They
+   are the size of the default table, so the numbers are the same. */
+static char RandomState[2][RANDOM_STATE_SIZE];
+static int  RandomTable = -1;
+
 void seedRand(unsigned int seed) {
 #ifndef NO_DRAND48
   srand48((long) seed);
 #endif
-  srandom(seed);
+  if (RandomTable >= 0) srandom(seed);
+  else {
+    initstate(seed, RandomState[0], RANDOM_STATE_SIZE);
+    RandomTable = 0;
+  }
   lastSeed = seed;
 }
 
@@ -1145,31 +1277,71 @@ real randProb(void) {
   return (real) drand48();
 }
 
+/* The second of the pair of values randGaussian computes is saved here. */
+static int  GaussSet = 0;
+static real GaussValue, GaussMean, GaussRange;
+
 /* Adapted from Numerical Methods in C, pg. 289 */
 /* The range is the standard deviation, not the variance. */
 real randGaussian(real mean, real range) {
-  static int iset = 0;
-  static real gset, lmean, lrange;
   real fac, rsq, v1, v2;
 
-  if (iset == 0 || lmean != mean || lrange != range) {
+  if (GaussSet == 0 || GaussMean != mean || GaussRange != range) {
     do {
       v1 = randReal(0.0, 1.0);
       v2 = randReal(0.0, 1.0);
       rsq = v1 * v1 + v2 * v2;
     } while (rsq >= 1.0 || rsq == 0.0);
     fac = SQRT(-2.0 * LOG(rsq) / rsq);
-    gset = v1 * fac * range + mean;
-    iset = 1;
-    lmean = mean;
-    lrange = range;
+    GaussValue = v1 * fac * range + mean;
+    GaussSet = 1;
+    GaussMean = mean;
+    GaussRange = range;
     return v2 * fac * range + mean;
   } else {
-    iset = 0;
-    return gset;
+    GaussSet = 0;
+    return GaussValue;
   }
 }
 
+/* Without drand48, only the Gaussian state is saved. */
+void saveRandState(RandState *R) {
+#ifndef NO_DRAND48
+  unsigned short zero[3] = {0, 0, 0}, *old = seed48(zero);
+  memcpy(R->drand, old, sizeof(R->drand));
+  seed48(R->drand);
+#endif
+  R->gaussSet   = GaussSet;
+  R->gaussValue = GaussValue;
+  R->gaussMean  = GaussMean;
+  R->gaussRange = GaussRange;
+}
+
+void restoreRandState(RandState *R) {
+#ifndef NO_DRAND48
+  seed48(R->drand);
+#endif
+  GaussSet   = R->gaussSet;
+  GaussValue = R->gaussValue;
+  GaussMean  = R->gaussMean;
+  GaussRange = R->gaussRange;
+}
+
+/* setstate() stores the position in the old table before reading it from the
+   new one, so a saved state is restored into the other table. */
+void saveRandomState(char *state) {
+  if (RandomTable < 0) seedRand(lastSeed);
+  setstate(RandomState[RandomTable]);
+  memcpy(state, RandomState[RandomTable], RANDOM_STATE_SIZE);
+}
+
+void restoreRandomState(char *state) {
+  if (RandomTable < 0) seedRand(lastSeed);
+  RandomTable = 1 - RandomTable;
+  memcpy(RandomState[RandomTable], state, RANDOM_STATE_SIZE);
+  setstate(RandomState[RandomTable]);
+}
+
 void randSort(int *array, int n) {
   int i, j, temp;
   for (i = 0; i < (n - 1); i++) {
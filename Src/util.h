@@ -22,6 +22,10 @@ typedef struct parseRec {
   int        line;
   String     buf;
   char      *s;
+  char      *text;              /* Owned block of lines read ahead, if any */
+  char      *textPos;           /* Lines up to textEnd come before the channel */
+  char      *textEnd;
+  String     message;           /* If set, errors are saved here instead */
 } *ParseRec;
 
 
@@ -63,10 +67,15 @@ extern char *readName(char *list, String name, flag *result);
 
 extern int ConsoleOutput(ClientData instanceData, const char *buf,
 		    int toWrite, int *errorCode);
+extern int stringEndsIn(const char *s, const char *t);
 extern Tcl_Channel readChannel(Tcl_Obj *fileNameObj);
 extern Tcl_Channel writeChannel(Tcl_Obj *fileName, flag append);
 extern void closeChannel(Tcl_Channel channel);
 extern flag binaryEncoding(Tcl_Channel channel);
+extern void *mapFile(Tcl_Obj *fileNameObj, size_t *size);
+extern void unmapFile(void *data, size_t size);
+/* Mapped files are in the writer's byte order and store this to check it. */
+#define MAP_BYTE_ORDER  0x01020304
 
 extern flag startParser(ParseRec R, int word);    /* returns error code */
 extern flag skipBlank(ParseRec R);                /* returns error code */
@@ -104,6 +113,13 @@ extern flag sendFlag(Tcl_Channel channel, flag f);
 extern flag sendReal(Tcl_Channel channel, real r);
 extern flag sendString(Tcl_Channel channel, const char *s);
 
+/* Everything needed to replay a stretch of random numbers. */
+typedef struct randState {
+  unsigned short drand[3];
+  int  gaussSet;
+  real gaussValue, gaussMean, gaussRange;
+} RandState;
+
 extern void seedRand(unsigned int seed);
 extern void timeSeedRand(void);
 extern unsigned int getSeed(void);
@@ -112,6 +128,12 @@ extern real randReal(real mean, real range);
 extern real randProb(void);
 extern real randGaussian(real mean, real range);
 extern void randSort(int *array, int n);
+extern void saveRandState(RandState *R);
+extern void restoreRandState(RandState *R);
+/* The state of random(), which randInt uses and RandState leaves out. */
+#define RANDOM_STATE_SIZE 128
+extern void saveRandomState(char *state);
+extern void restoreRandomState(char *state);
 
 extern void buildSigmoidTable(void);
 extern real fastSigmoid(real x);